@@ -0,0 +1,261 @@
+#include "batch.h"
+#include "core.h"
+#include <utils/flog.h>
+#include <utils/iq_reader.h>
+#include <signal_path/signal_path.h>
+#include <gui/gui.h>
+#include <gui/smgui.h>
+#include <dsp/stream.h>
+#include <json.hpp>
+#include <filesystem>
+#include <fstream>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <map>
+#include <algorithm>
+
+using nlohmann::json;
+
+namespace batch {
+    bool active = false;
+    std::string outputDir;
+    double sampleRate = 1.0;
+    std::atomic<int64_t> samplesFed = 0;
+
+    std::mutex outputMtx;
+    std::map<std::string, std::ofstream> outputs;
+    std::map<std::string, dsp::channel::RxVFO*> vfos;
+
+    dsp::stream<dsp::complex_t> input;
+
+    bool parseFormat(const std::string& str, SampleFormat& format) {
+        const std::map<std::string, SampleFormat> formats = {
+            { "cu8", SAMPLE_FORMAT_U8 },
+            { "ci8", SAMPLE_FORMAT_S8 },
+            { "ci16", SAMPLE_FORMAT_S16 },
+            { "ci24", SAMPLE_FORMAT_S24 },
+            { "ci32", SAMPLE_FORMAT_S32 },
+            { "cf32", SAMPLE_FORMAT_F32 }
+        };
+        auto it = formats.find(str);
+        if (it == formats.end()) { return false; }
+        format = it->second;
+        return true;
+    }
+
+    // The FFT path is disabled, these are never called
+    float* acquireFFTBuffer(void* ctx) { return NULL; }
+    void releaseFFTBuffer(void* ctx) {}
+
+    // Position of an instance in the recording, from the samples its VFO handed to the decoder. Instances without
+    // a VFO use the position of the feed instead. Must be called with outputMtx locked.
+    int64_t getPosition(const std::string& instance) {
+        auto it = vfos.find(instance);
+        return (it != vfos.end()) ? (int64_t)it->second->getConsumedCount() : (int64_t)samplesFed;
+    }
+
+    // Stop tracking a VFO before it gets deleted
+    void vfoRemoveHandler(std::string name, void* ctx) {
+        std::lock_guard<std::mutex> lck(outputMtx);
+        vfos.erase(name);
+    }
+    EventHandler<std::string> vfoRemoveEvent(vfoRemoveHandler, NULL);
+
+    // Wait for every VFO to go through all the samples that were fed, unless they stop making progress
+    void drain() {
+        int64_t last = -1;
+        auto lastProgress = std::chrono::steady_clock::now();
+        while (true) {
+            int64_t slowest = samplesFed;
+            {
+                std::lock_guard<std::mutex> lck(outputMtx);
+                for (auto& [name, vfo] : vfos) { slowest = std::min<int64_t>(slowest, vfo->getConsumedCount()); }
+            }
+            if (slowest >= samplesFed) { return; }
+
+            auto now = std::chrono::steady_clock::now();
+            if (slowest != last) {
+                last = slowest;
+                lastProgress = now;
+            }
+            else if (now - lastProgress > std::chrono::seconds(1)) {
+                flog::warn("The decoders stopped reading {} samples before the end of the recording", (int64_t)samplesFed - slowest);
+                return;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    int main(std::string jobPath) {
+        flog::info("=====| BATCH MODE |=====");
+
+        // Load the job
+        json job;
+        try {
+            std::ifstream file(jobPath);
+            file >> job;
+        }
+        catch (const std::exception& e) {
+            flog::error("Could not load batch job '{}': {}", jobPath, e.what());
+            return -1;
+        }
+        if (!job.contains("input") || !job.contains("instances") || !job["instances"].is_object()) {
+            flog::error("Batch job must give an input file and the module instances to run");
+            return -1;
+        }
+        std::string inputPath = job["input"];
+        outputDir = job.contains("output") ? (std::string)job["output"] : "batch_output";
+        outputDir = std::filesystem::absolute(outputDir).string();
+
+        // Settings for raw files without metadata
+        SampleFormat rawFormat = SAMPLE_FORMAT_S16;
+        if (job.contains("rawFormat") && !parseFormat(job["rawFormat"], rawFormat)) {
+            flog::error("Unknown raw sample format '{}'", (std::string)job["rawFormat"]);
+            return -1;
+        }
+        double rawSamplerate = job.contains("samplerate") ? (double)job["samplerate"] : 0.0;
+
+        // Open the recording
+        std::unique_ptr<IQReader> reader;
+        try {
+            reader = openIQFile(inputPath, rawFormat, rawSamplerate);
+        }
+        catch (const std::exception& e) {
+            flog::error("Could not open '{}': {}", inputPath, e.what());
+            return -1;
+        }
+        const IQFileInfo& info = reader->getInfo();
+        sampleRate = info.sampleRate;
+        double frequency = job.contains("frequency") ? (double)job["frequency"] : info.frequency;
+        flog::info("Processing '{}' ({}, {} samples at {} S/s)", inputPath, info.container, reader->getSampleCount(), sampleRate);
+
+        // Create the output directory
+        if (!std::filesystem::is_directory(outputDir) && !std::filesystem::create_directories(outputDir)) {
+            flog::error("Could not create output directory '{}'", outputDir);
+            return -1;
+        }
+
+        // Initialize the IQ frontend without buffering so that no samples are ever dropped, and without the FFT
+        // since nothing displays it
+        sigpath::iqFrontEnd.init(&input, sampleRate, false, 1, false, 1024, 20.0, IQFrontEnd::FFTWindow::NUTTALL, acquireFFTBuffer, releaseFFTBuffer, NULL);
+        sigpath::iqFrontEnd.setFFTEnabled(false);
+        double effectiveSr = sigpath::iqFrontEnd.getEffectiveSamplerate();
+        gui::waterfall.setBandwidth(effectiveSr);
+        gui::waterfall.setViewBandwidth(effectiveSr);
+        gui::waterfall.setCenterFrequency(frequency);
+        sigpath::iqFrontEnd.start();
+
+        // Nothing is ever drawn but modules still expect SmGui to be set up
+        SmGui::init(false);
+        active = true;
+
+        // Load the modules given by the job, either by name from the modules directory or by path
+        core::configManager.acquire();
+        std::string modulesDir = core::configManager.conf["modulesDirectory"];
+        core::configManager.release();
+        modulesDir = std::filesystem::absolute(modulesDir).string();
+        if (job.contains("modules")) {
+            for (const std::string& mod : job["modules"]) {
+                std::filesystem::path path = mod;
+                if (path.extension().generic_string() != SDRPP_MOD_EXTENTSION) {
+                    path = std::filesystem::path(modulesDir) / (mod + SDRPP_MOD_EXTENTSION);
+                }
+                path = std::filesystem::absolute(path);
+                flog::info("Loading {0}", path.string());
+                core::moduleManager.loadModule(path.string());
+            }
+        }
+
+        // Create module instances and place their VFOs
+        for (auto& [name, inst] : job["instances"].items()) {
+            if (!inst.contains("module")) {
+                flog::error("Batch instance '{}' is missing its module", name);
+                continue;
+            }
+            std::string mod = inst["module"];
+            flog::info("Initializing {0} ({1})", name, mod);
+            if (core::moduleManager.createInstance(name, mod)) { continue; }
+            if (inst.contains("offset")) { sigpath::vfoManager.setOffset(name, inst["offset"]); }
+            if (inst.contains("bandwidth")) { sigpath::vfoManager.setBandwidth(name, inst["bandwidth"]); }
+        }
+        core::moduleManager.doPostInitAll();
+
+        // Keep track of the VFOs to know how far each decoder got
+        {
+            std::lock_guard<std::mutex> lck(outputMtx);
+            for (auto& [name, inst] : core::moduleManager.instances) {
+                dsp::channel::RxVFO* vfo = sigpath::iqFrontEnd.getVFO(name);
+                if (vfo) { vfos[name] = vfo; }
+            }
+        }
+        sigpath::iqFrontEnd.onVFORemove.bindHandler(&vfoRemoveEvent);
+
+        // Feed the whole recording, the stream only accepts a new block once the previous one was taken
+        int blockSize = std::clamp<int>(sampleRate / 200.0, 1, STREAM_BUFFER_SIZE);
+        auto start = std::chrono::high_resolution_clock::now();
+        while (true) {
+            int count = reader->read(input.writeBuf, blockSize);
+            if (count <= 0) { break; }
+            if (!input.swap(count)) { break; }
+            samplesFed += count;
+        }
+
+        // Let the samples still in the chain through, then stop the front end and the decoders and wait for them
+        drain();
+        sigpath::iqFrontEnd.stop();
+        std::vector<std::string> names;
+        for (auto& [name, inst] : core::moduleManager.instances) { names.push_back(name); }
+        for (auto& name : names) { core::moduleManager.deleteInstance(name); }
+        auto end = std::chrono::high_resolution_clock::now();
+
+        // Shut everything down
+        sigpath::iqFrontEnd.onVFORemove.unbindHandler(&vfoRemoveEvent);
+        for (auto& [name, mod] : core::moduleManager.modules) { mod.end(); }
+        {
+            std::lock_guard<std::mutex> lck(outputMtx);
+            outputs.clear();
+            active = false;
+        }
+
+        // Report the throughput
+        double seconds = std::chrono::duration<double>(end - start).count();
+        double rate = (double)samplesFed / seconds;
+        char report[128];
+        sprintf(report, "%.3fs: %.0f S/s (%.1fx realtime)", seconds, rate, rate / sampleRate);
+        flog::info("Processed {} samples in {}", (int64_t)samplesFed, report);
+        return 0;
+    }
+
+    bool isActive() {
+        return active;
+    }
+
+    std::string getOutputDir() {
+        return outputDir;
+    }
+
+    double getTime(const std::string& instance) {
+        std::lock_guard<std::mutex> lck(outputMtx);
+        return (double)getPosition(instance) / sampleRate;
+    }
+
+    void writeLine(const std::string& instance, const std::string& line) {
+        std::lock_guard<std::mutex> lck(outputMtx);
+        if (!active) { return; }
+
+        // Open the instance's file on its first line
+        auto it = outputs.find(instance);
+        if (it == outputs.end()) {
+            std::string path = outputDir + "/" + instance + ".txt";
+            it = outputs.emplace(instance, std::ofstream(path)).first;
+            if (!it->second.is_open()) { flog::error("Could not open '{}' for writing", path); }
+        }
+
+        // Prefix the line with its time in the recording
+        char time[32];
+        sprintf(time, "[%.3f] ", (double)getPosition(instance) / sampleRate);
+        it->second << time << line << std::endl;
+    }
+}
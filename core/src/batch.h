@@ -0,0 +1,40 @@
+#pragma once
+#include <string>
+
+namespace batch {
+    /**
+     * Run a batch job. The job is a JSON file giving the recording to process, the decoder modules to load along
+     * with the VFO settings of their instances and the directory to write the decoder output to. The recording is
+     * processed as fast as the decoders can keep up instead of in realtime.
+     * @param jobPath Path to the job file.
+     * @return Exit code of the program.
+     */
+    int main(std::string jobPath);
+
+    /**
+     * Check if a batch job is running. Modules use this to write their output to files instead of only showing it.
+     * @return True if a batch job is running, false otherwise.
+     */
+    bool isActive();
+
+    /**
+     * Get the directory the job output goes to.
+     * @return Path to the output directory.
+     */
+    std::string getOutputDir();
+
+    /**
+     * Get the position in the recording an instance's decoder got to, counted from the samples its VFO handed over.
+     * It can be ahead by one VFO output block plus the delay of the decoder's own filters.
+     * @param instance Name of the module instance.
+     * @return Time since the start of the recording in seconds.
+     */
+    double getTime(const std::string& instance);
+
+    /**
+     * Append a line of decoder output to the '<instance>.txt' file of the output directory. Can be called from any thread.
+     * @param instance Name of the module instance the output comes from.
+     * @param line Line of text to write.
+     */
+    void writeLine(const std::string& instance, const std::string& line);
+}
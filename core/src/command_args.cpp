@@ -14,8 +14,11 @@ void CommandArgsParser::defineAll() {
 #endif
 
         define('a', "addr", "Server mode address", "0.0.0.0");
+        define('b', "batch", "Run the decoders of a JSON batch job over a recording without GUI", "");
+        define('\0', "clients", "Server mode maximum number of simultaneous clients", 8);
         define('h', "help", "Show help");
         define('p', "port", "Server mode port", 5259);
+        define('\0', "profile", "Server mode file to periodically dump DSP profiler statistics to as JSON", "");
         define('r', "root", "Root directory, where all config files are stored", std::filesystem::absolute(root).string());
         define('s', "server", "Run in server mode");
         define('\0', "autostart", "Automatically start the SDR after loading");
@@ -1,4 +1,5 @@
 #include <server.h>
+#include <batch.h>
 #include "imgui.h"
 #include <stdio.h>
 #include <gui/main_window.h>
@@ -19,6 +20,9 @@
 #include <stb_image_resize.h>
 #include <gui/gui.h>
 #include <signal_path/signal_path.h>
+#include <dsp/scheduler.h>
+#include <dsp/fft/plan.h>
+#include <dsp/autotune.h>
 
 #ifdef _WIN32
 #include <Windows.h>
@@ -41,6 +45,9 @@ namespace core {
     void setInputSampleRate(double samplerate) {
         // Forward this to the server
         if (args["server"].b()) { server::setInputSampleRate(samplerate); return; }
+
+        // The recording of a batch job sets the samplerate, sources have no say
+        if (batch::isActive()) { return; }
         
         // Update IQ frontend input samplerate and get effective samplerate
         sigpath::iqFrontEnd.setSampleRate(samplerate);
@@ -78,10 +85,11 @@ int sdrpp_main(int argc, char* argv[]) {
     }
 
     bool serverMode = (bool)core::args["server"];
+    std::string batchJob = (std::string)core::args["batch"];
 
 #ifdef _WIN32
     // Free console if the user hasn't asked for a console and not in server mode
-    if (!core::args["con"].b() && !serverMode) { FreeConsole(); }
+    if (!core::args["con"].b() && !serverMode && batchJob.empty()) { FreeConsole(); }
 
     // Set error mode to avoid abnoxious popups
     SetErrorMode(SEM_NOOPENFILEERRORBOX | SEM_NOGPFAULTERRORBOX | SEM_FAILCRITICALERRORS);
@@ -246,9 +254,14 @@ int sdrpp_main(int argc, char* argv[]) {
     defConfig["showMenu"] = true;
     defConfig["showWaterfall"] = true;
     defConfig["source"] = "";
+    defConfig["streamRingSize"] = 0;
+    defConfig["dspWorkerThreads"] = 0;
+    defConfig["fftThreads"] = 1;
+    defConfig["kernelTuning"] = true;
     defConfig["decimation"] = 1;
     defConfig["iqCorrection"] = false;
     defConfig["invertIQ"] = false;
+    defConfig["channelizer"] = 0;
 
     defConfig["streams"]["Radio"]["muted"] = false;
     defConfig["streams"]["Radio"]["sink"] = "Audio";
@@ -353,9 +366,21 @@ int sdrpp_main(int argc, char* argv[]) {
     // Load UI scaling
     style::uiScale = core::configManager.conf["uiScale"];
 
+    // Run DSP blocks on a worker pool instead of one thread each if enabled
+    int dspWorkerThreads = core::configManager.conf["dspWorkerThreads"];
+    if (dspWorkerThreads > 0) { dsp::scheduler::start(dspWorkerThreads); }
+
+    // Load the FFT plans measured in previous runs
+    dsp::fft::setThreadCount(core::configManager.conf["fftThreads"]);
+    dsp::fft::loadWisdom(root + "/fftw_wisdom");
+
+    // Pick the fastest DSP kernels, this has to happen before VOLK is first used
+    dsp::autotune::init(root, core::configManager.conf["kernelTuning"]);
+
     core::configManager.release(true);
 
     if (serverMode) { return server::main(); }
+    if (!batchJob.empty()) { return batch::main(batchJob); }
 
     core::configManager.acquire();
     std::string resDir = core::configManager.conf["resourcesDirectory"];
@@ -411,6 +436,11 @@ int sdrpp_main(int argc, char* argv[]) {
 
     sigpath::iqFrontEnd.stop();
 
+    dsp::scheduler::stop();
+
+    dsp::autotune::stop();
+    dsp::fft::stop();
+
     core::configManager.disableAutoSave();
     core::configManager.save();
 #endif
@@ -0,0 +1,408 @@
+#include "autotune.h"
+#include "filter/fir.h"
+#include "fft/plan.h"
+#include <volk/volk.h>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <filesystem>
+#include <functional>
+#include <algorithm>
+#include <stdlib.h>
+#include <stdio.h>
+#include <json.hpp>
+#include <utils/flog.h>
+
+using nlohmann::json;
+
+// Time spent calling each implementation for each size
+#define AUTOTUNE_MEASURE_TIME   0.005
+
+// Largest number of elements in a benchmarked call
+#define AUTOTUNE_MAX_SIZE       8192
+
+namespace dsp::autotune {
+    std::string rootPath;
+    std::string machine;
+
+    std::mutex resultsMtx;
+    std::vector<KernelResult> kernelResults;
+    std::vector<FIRResult> firResults;
+    std::atomic<int> fftMinTaps = FIR_FFT_MIN_TAPS;
+    bool volkConfigured = false;
+    bool pendingRestart = false;
+
+    std::thread workerThread;
+    std::atomic<bool> running = false;
+
+    std::string configDir() { return rootPath + "/volk"; }
+    std::string configPath() { return rootPath + "/volk/volk_config"; }
+    std::string cachePath() { return rootPath + "/kernel_tuning.json"; }
+
+    // Buffers shared by all benchmarks, filled with values valid for every kernel
+    struct Buffers {
+        Buffers() {
+            for (int i = 0; i < 3; i++) { c[i] = buffer::alloc<complex_t>(AUTOTUNE_MAX_SIZE + 1); }
+            for (int i = 0; i < 2; i++) { f[i] = buffer::alloc<float>(AUTOTUNE_MAX_SIZE + 1); }
+            s = buffer::alloc<int16_t>(AUTOTUNE_MAX_SIZE + 1);
+            for (int i = 0; i <= AUTOTUNE_MAX_SIZE; i++) {
+                float x = (float)((i * 7919) % 2000) / 1000.0f - 1.0f;
+                float y = (float)((i * 104729) % 2000) / 1000.0f - 1.0f;
+                for (int j = 0; j < 3; j++) { c[j][i] = { x, y }; }
+                for (int j = 0; j < 2; j++) { f[j][i] = x; }
+            }
+        }
+
+        ~Buffers() {
+            for (int i = 0; i < 3; i++) { buffer::free(c[i]); }
+            for (int i = 0; i < 2; i++) { buffer::free(f[i]); }
+            buffer::free(s);
+        }
+
+        complex_t* c[3];
+        float* f[2];
+        int16_t* s;
+    };
+
+    double measure(const std::function<void()>& func) {
+        // Warm up the caches first
+        func();
+
+        int calls = 0;
+        auto start = std::chrono::high_resolution_clock::now();
+        double elapsed;
+        do {
+            for (int i = 0; i < 16; i++) { func(); }
+            calls += 16;
+            elapsed = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+        } while (elapsed < AUTOTUNE_MEASURE_TIME);
+        return elapsed * 1e9 / (double)calls;
+    }
+
+    /**
+     * Benchmark all implementations of a VOLK kernel available on this machine.
+     * @param kernel Name of the kernel.
+     * @param desc Implementations of the kernel.
+     * @param sizes Number of points of the benchmarked calls, should match how the kernel is used.
+     * @param call Calls the kernel with the given implementation, number of points and buffer offset.
+     * @return Score of each implementation and the winners.
+     */
+    KernelResult tuneKernel(const char* kernel, volk_func_desc_t desc, const std::vector<int>& sizes, const std::function<void(const char*, int, int)>& call) {
+        KernelResult res;
+        res.kernel = kernel;
+        res.sizes = sizes;
+
+        double bestAligned = INFINITY;
+        double bestUnaligned = INFINITY;
+        for (size_t i = 0; i < desc.n_impls; i++) {
+            // Implementations that don't require alignment are measured on unaligned buffers since that's their worst case
+            const char* impl = desc.impl_names[i];
+            bool aligned = desc.impl_alignment[i];
+            int offset = aligned ? 0 : 1;
+            double score = 0.0;
+            for (int n : sizes) {
+                score += measure([&]() { call(impl, n, offset); }) / (double)n;
+            }
+            score /= (double)sizes.size();
+            res.candidates.push_back({ impl, score, aligned });
+
+            if (score < bestAligned) {
+                bestAligned = score;
+                res.alignedWinner = impl;
+            }
+            if (!aligned && score < bestUnaligned) {
+                bestUnaligned = score;
+                res.unalignedWinner = impl;
+            }
+        }
+
+        // VOLK always has a generic unaligned implementation, but don't write a broken preference if it ever doesn't
+        if (res.unalignedWinner.empty()) { res.unalignedWinner = res.alignedWinner; }
+        return res;
+    }
+
+    std::vector<KernelResult> tuneKernels(Buffers& b) {
+        std::vector<KernelResult> results;
+        complex_t res;
+        float fres;
+        lv_32fc_t phase = lv_cmake(1.0f, 0.0f);
+        lv_32fc_t phaseDelta = lv_cmake(cosf(0.01f), sinf(0.01f));
+
+        // Sizes are those of the filters, blocks and FFTs the DSP actually runs
+        results.push_back(tuneKernel("volk_32fc_32f_dot_prod_32fc", volk_32fc_32f_dot_prod_32fc_get_func_desc(), { 32, 128, 512 }, [&](const char* impl, int n, int u) {
+            volk_32fc_32f_dot_prod_32fc_manual((lv_32fc_t*)&res, (lv_32fc_t*)&b.c[0][u], &b.f[0][u], n, impl);
+        }));
+        results.push_back(tuneKernel("volk_32f_x2_dot_prod_32f", volk_32f_x2_dot_prod_32f_get_func_desc(), { 32, 128, 512 }, [&](const char* impl, int n, int u) {
+            volk_32f_x2_dot_prod_32f_manual(&fres, &b.f[0][u], &b.f[1][u], n, impl);
+        }));
+        results.push_back(tuneKernel("volk_32fc_x2_dot_prod_32fc", volk_32fc_x2_dot_prod_32fc_get_func_desc(), { 32, 128 }, [&](const char* impl, int n, int u) {
+            volk_32fc_x2_dot_prod_32fc_manual((lv_32fc_t*)&res, (lv_32fc_t*)&b.c[0][u], (lv_32fc_t*)&b.c[1][u], n, impl);
+        }));
+#if VOLK_VERSION >= 030100
+        results.push_back(tuneKernel("volk_32fc_s32fc_x2_rotator2_32fc", volk_32fc_s32fc_x2_rotator2_32fc_get_func_desc(), { 2048 }, [&](const char* impl, int n, int u) {
+            volk_32fc_s32fc_x2_rotator2_32fc_manual((lv_32fc_t*)&b.c[2][u], (lv_32fc_t*)&b.c[0][u], &phaseDelta, &phase, n, impl);
+        }));
+#else
+        results.push_back(tuneKernel("volk_32fc_s32fc_x2_rotator_32fc", volk_32fc_s32fc_x2_rotator_32fc_get_func_desc(), { 2048 }, [&](const char* impl, int n, int u) {
+            volk_32fc_s32fc_x2_rotator_32fc_manual((lv_32fc_t*)&b.c[2][u], (lv_32fc_t*)&b.c[0][u], phaseDelta, &phase, n, impl);
+        }));
+#endif
+        results.push_back(tuneKernel("volk_32fc_x2_multiply_32fc", volk_32fc_x2_multiply_32fc_get_func_desc(), { 1024, 4096 }, [&](const char* impl, int n, int u) {
+            volk_32fc_x2_multiply_32fc_manual((lv_32fc_t*)&b.c[2][u], (lv_32fc_t*)&b.c[0][u], (lv_32fc_t*)&b.c[1][u], n, impl);
+        }));
+        results.push_back(tuneKernel("volk_32fc_x2_multiply_conjugate_32fc", volk_32fc_x2_multiply_conjugate_32fc_get_func_desc(), { 1024 }, [&](const char* impl, int n, int u) {
+            volk_32fc_x2_multiply_conjugate_32fc_manual((lv_32fc_t*)&b.c[2][u], (lv_32fc_t*)&b.c[0][u], (lv_32fc_t*)&b.c[1][u], n, impl);
+        }));
+        results.push_back(tuneKernel("volk_32fc_32f_multiply_32fc", volk_32fc_32f_multiply_32fc_get_func_desc(), { 2048 }, [&](const char* impl, int n, int u) {
+            volk_32fc_32f_multiply_32fc_manual((lv_32fc_t*)&b.c[2][u], (lv_32fc_t*)&b.c[0][u], &b.f[0][u], n, impl);
+        }));
+        results.push_back(tuneKernel("volk_32fc_magnitude_32f", volk_32fc_magnitude_32f_get_func_desc(), { 2048 }, [&](const char* impl, int n, int u) {
+            volk_32fc_magnitude_32f_manual(&b.f[1][u], (lv_32fc_t*)&b.c[0][u], n, impl);
+        }));
+        results.push_back(tuneKernel("volk_32fc_s32f_atan2_32f", volk_32fc_s32f_atan2_32f_get_func_desc(), { 1024 }, [&](const char* impl, int n, int u) {
+            volk_32fc_s32f_atan2_32f_manual(&b.f[1][u], (lv_32fc_t*)&b.c[0][u], 1.0f, n, impl);
+        }));
+        results.push_back(tuneKernel("volk_32fc_s32f_power_spectrum_32f", volk_32fc_s32f_power_spectrum_32f_get_func_desc(), { 8192 }, [&](const char* impl, int n, int u) {
+            volk_32fc_s32f_power_spectrum_32f_manual(&b.f[1][u], (lv_32fc_t*)&b.c[0][u], (float)n, n, impl);
+        }));
+        results.push_back(tuneKernel("volk_32f_s32f_convert_16i", volk_32f_s32f_convert_16i_get_func_desc(), { 2048 }, [&](const char* impl, int n, int u) {
+            volk_32f_s32f_convert_16i_manual(&b.s[u], &b.f[0][u], 32767.0f, n, impl);
+        }));
+
+        return results;
+    }
+
+    // Find the filter length above which overlap-save convolution beats direct dot products
+    std::vector<FIRResult> tuneFIR(Buffers& b, const KernelResult& dotProd, const KernelResult& multiply) {
+        std::vector<FIRResult> results;
+        complex_t res;
+        for (int taps : { 64, 128, 256, 512, 1024 }) {
+            FIRResult fr;
+            fr.taps = taps;
+
+            // Filter buffers are read at every offset, so the unaligned implementation is the one used
+            fr.directNs = measure([&]() {
+                volk_32fc_32f_dot_prod_32fc_manual((lv_32fc_t*)&res, (lv_32fc_t*)&b.c[0][1], &b.f[0][1], taps, dotProd.unalignedWinner.c_str());
+            });
+
+            // Same FFT size as the FIR would use
+            int fftSize = 1;
+            while (fftSize < 4 * taps) { fftSize <<= 1; }
+            auto forward = fft::getPlan(fftSize, true);
+            auto backward = fft::getPlan(fftSize, false);
+            complex_t* fftBuf = (complex_t*)fftwf_malloc(fftSize * sizeof(complex_t));
+            complex_t* specBuf = (complex_t*)fftwf_malloc(fftSize * sizeof(complex_t));
+            memcpy(fftBuf, b.c[0], fftSize * sizeof(complex_t));
+            double blockNs = measure([&]() {
+                forward->execute(fftBuf, specBuf);
+                volk_32fc_x2_multiply_32fc_manual((lv_32fc_t*)specBuf, (lv_32fc_t*)specBuf, (lv_32fc_t*)b.c[1], fftSize, multiply.alignedWinner.c_str());
+                backward->execute(specBuf, fftBuf);
+            });
+            fftwf_free(fftBuf);
+            fftwf_free(specBuf);
+            fr.fftNs = blockNs / (double)(fftSize - taps + 1);
+
+            results.push_back(fr);
+        }
+        return results;
+    }
+
+    int selectFFTMinTaps(const std::vector<FIRResult>& results) {
+        // Only switch once FFT convolution stays faster for all longer filters
+        int minTaps = results.back().taps * 2;
+        for (int i = results.size() - 1; i >= 0; i--) {
+            if (results[i].fftNs >= results[i].directNs) { break; }
+            minTaps = results[i].taps;
+        }
+        return minTaps;
+    }
+
+    const KernelResult* findKernel(const std::vector<KernelResult>& results, const std::string& name) {
+        for (const auto& r : results) {
+            if (r.kernel == name) { return &r; }
+        }
+        return NULL;
+    }
+
+    void save() {
+        std::lock_guard<std::mutex> lck(resultsMtx);
+
+        // VOLK preference file, same format as written by volk_profile
+        try {
+            std::filesystem::create_directories(configDir());
+        }
+        catch (const std::exception& e) {
+            flog::error("Could not create '{}': {}", configDir(), e.what());
+            return;
+        }
+        std::ofstream prefs(configPath());
+        if (!prefs.is_open()) {
+            flog::error("Could not write VOLK preferences to '{}'", configPath());
+            return;
+        }
+        prefs << "#this file was generated by SDR++ kernel tuning for " << machine << "\n";
+        for (const auto& r : kernelResults) {
+            prefs << r.kernel << " " << r.alignedWinner << " " << r.unalignedWinner << "\n";
+        }
+        prefs.close();
+
+        // Full results for the diagnostics
+        json cache;
+        cache["machine"] = machine;
+        cache["volkVersion"] = VOLK_VERSION;
+        cache["fftMinTaps"] = fftMinTaps.load();
+        cache["kernels"] = json::array();
+        for (const auto& r : kernelResults) {
+            json k;
+            k["kernel"] = r.kernel;
+            k["sizes"] = r.sizes;
+            k["aligned"] = r.alignedWinner;
+            k["unaligned"] = r.unalignedWinner;
+            k["candidates"] = json::array();
+            for (const auto& c : r.candidates) {
+                k["candidates"].push_back({ { "name", c.name }, { "nsPerSample", c.nsPerSample }, { "aligned", c.aligned } });
+            }
+            cache["kernels"].push_back(k);
+        }
+        cache["fir"] = json::array();
+        for (const auto& f : firResults) {
+            cache["fir"].push_back({ { "taps", f.taps }, { "directNs", f.directNs }, { "fftNs", f.fftNs } });
+        }
+        std::ofstream file(cachePath());
+        file << cache.dump(4);
+    }
+
+    bool load() {
+        if (!std::filesystem::exists(cachePath())) { return false; }
+        try {
+            std::ifstream file(cachePath());
+            json cache = json::parse(file);
+
+            // Results from another machine or VOLK version are useless
+            if (cache["machine"] != machine || cache["volkVersion"] != VOLK_VERSION) {
+                flog::info("Kernel tuning results are for another machine or VOLK version");
+                return false;
+            }
+
+            std::lock_guard<std::mutex> lck(resultsMtx);
+            kernelResults.clear();
+            for (auto& k : cache["kernels"]) {
+                KernelResult r;
+                r.kernel = k["kernel"];
+                r.sizes = k["sizes"].get<std::vector<int>>();
+                r.alignedWinner = k["aligned"];
+                r.unalignedWinner = k["unaligned"];
+                for (auto& c : k["candidates"]) {
+                    r.candidates.push_back({ c["name"], c["nsPerSample"], c["aligned"] });
+                }
+                kernelResults.push_back(r);
+            }
+            firResults.clear();
+            for (auto& f : cache["fir"]) {
+                firResults.push_back({ f["taps"], f["directNs"], f["fftNs"] });
+            }
+            fftMinTaps = cache["fftMinTaps"];
+        }
+        catch (const std::exception& e) {
+            flog::warn("Could not load kernel tuning results: {}", e.what());
+            return false;
+        }
+        return std::filesystem::exists(configPath());
+    }
+
+    void init(std::string root, bool tuneIfNeeded) {
+        rootPath = root;
+        machine = volk_get_machine();
+
+        // VOLK reads its preferences from here the first time a kernel is called. Don't override a user's own choice.
+        if (getenv("VOLK_CONFIGPATH")) {
+            flog::warn("VOLK_CONFIGPATH is set, the kernel tuning results won't be used");
+        }
+        else {
+#ifdef _WIN32
+            _putenv_s("VOLK_CONFIGPATH", root.c_str());
+#else
+            setenv("VOLK_CONFIGPATH", root.c_str(), 1);
+#endif
+        }
+
+        bool loaded = load();
+        if (!loaded && tuneIfNeeded) {
+            flog::info("Tuning DSP kernels for this machine, this is only done once");
+            run();
+            loaded = true;
+            pendingRestart = false;
+        }
+        const char* volkPath = getenv("VOLK_CONFIGPATH");
+        volkConfigured = loaded && volkPath && root == volkPath;
+        flog::info("VOLK machine: {}, FIR FFT convolution from {} taps", machine, fftMinTaps.load());
+    }
+
+    void run() {
+        auto start = std::chrono::high_resolution_clock::now();
+        Buffers b;
+
+        auto kernels = tuneKernels(b);
+        auto fir = tuneFIR(b, *findKernel(kernels, "volk_32fc_32f_dot_prod_32fc"), *findKernel(kernels, "volk_32fc_x2_multiply_32fc"));
+        {
+            std::lock_guard<std::mutex> lck(resultsMtx);
+            kernelResults = kernels;
+            firResults = fir;
+            fftMinTaps = selectFFTMinTaps(fir);
+            pendingRestart = true;
+        }
+        save();
+
+        double elapsed = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+        char buf[32];
+        sprintf(buf, "%.1lfs", elapsed);
+        flog::info("Kernel tuning done in {}", buf);
+    }
+
+    void runAsync() {
+        if (running) { return; }
+        if (workerThread.joinable()) { workerThread.join(); }
+        running = true;
+        workerThread = std::thread([]() {
+            run();
+            running = false;
+        });
+    }
+
+    bool isRunning() {
+        return running;
+    }
+
+    void stop() {
+        if (workerThread.joinable()) { workerThread.join(); }
+    }
+
+    std::string getMachine() {
+        return machine;
+    }
+
+    std::vector<KernelResult> getKernelResults() {
+        std::lock_guard<std::mutex> lck(resultsMtx);
+        return kernelResults;
+    }
+
+    std::vector<FIRResult> getFIRResults() {
+        std::lock_guard<std::mutex> lck(resultsMtx);
+        return firResults;
+    }
+
+    bool isVolkConfigured() {
+        return volkConfigured;
+    }
+
+    bool restartNeeded() {
+        std::lock_guard<std::mutex> lck(resultsMtx);
+        return pendingRestart;
+    }
+
+    int getFFTMinTaps() {
+        return fftMinTaps;
+    }
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <string>
+#include <vector>
+
+namespace dsp {
+    // Benchmarks the implementations of the hot VOLK kernels and the FIR convolution methods on this machine.
+    // The VOLK winners are written as a VOLK preference file in the root directory, VOLK only reads it the first time
+    // a kernel is called so a new tuning takes effect on the next start. The FIR threshold applies to filters created
+    // after tuning.
+    namespace autotune {
+        struct Candidate {
+            std::string name;
+            double nsPerSample;     // Averaged over all benchmarked sizes
+            bool aligned;           // True if the implementation requires aligned buffers
+        };
+
+        struct KernelResult {
+            std::string kernel;
+            std::vector<int> sizes;
+            std::vector<Candidate> candidates;
+            std::string alignedWinner;
+            std::string unalignedWinner;
+        };
+
+        struct FIRResult {
+            int taps;
+            double directNs;        // Nanoseconds per output sample using a dot product
+            double fftNs;           // Nanoseconds per output sample using overlap-save FFT convolution
+        };
+
+        /**
+         * Point VOLK to the preference file in the root directory and load the cached results.
+         * Must be called before any VOLK kernel is used.
+         * @param root Root directory.
+         * @param tuneIfNeeded Run the tuning right away if there are no cached results for this machine.
+         */
+        void init(std::string root, bool tuneIfNeeded);
+
+        // Run the tuning and save the results, blocks for a few seconds
+        void run();
+
+        // Run the tuning in the background, does nothing if it's already running
+        void runAsync();
+        bool isRunning();
+
+        // Wait for a background tuning to finish
+        void stop();
+
+        std::string getMachine();
+        std::vector<KernelResult> getKernelResults();
+        std::vector<FIRResult> getFIRResults();
+
+        // Check if the VOLK preferences written by the tuning are the ones VOLK uses
+        bool isVolkConfigured();
+
+        // Check if the tuning was run again since the start, its VOLK choices are only used after a restart
+        bool restartNeeded();
+
+        // Smallest filter length for which FIR filters use FFT convolution
+        int getFFTMinTaps();
+    }
+}
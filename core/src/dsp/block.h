@@ -4,6 +4,8 @@
 #include <vector>
 #include <algorithm>
 #include "stream.h"
+#include "scheduler.h"
+#include "profiler.h"
 #include "types.h"
 
 namespace dsp {
@@ -63,16 +65,73 @@ namespace dsp {
 
         virtual int run() = 0;
 
+        // Lock the block's settings, used to safely call process() from another thread
+        void acquire() {
+            ctrlMtx.lock();
+        }
+
+        void release() {
+            ctrlMtx.unlock();
+        }
+
+        // Run once, recording statistics for the profiler if it's enabled
+        int profiledRun() {
+            if (!profiler::isEnabled()) { return run(); }
+
+            // Attribute the time spent waiting on streams to this block
+            profiler::BlockStats* prev = profiler::getCurrentStats();
+            profiler::setCurrentStats(&profilerStats);
+            auto start = std::chrono::steady_clock::now();
+            int ret = run();
+            uint64_t dt = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+            profiler::setCurrentStats(prev);
+
+            if (ret >= 0) {
+                profilerStats.calls++;
+                profilerStats.samples += ret;
+                profilerStats.runTime += dt;
+            }
+            return ret;
+        }
+
+        // Check if run() can be called without blocking on any of the streams
+        bool isReady() {
+            for (auto& in : inputs) {
+                if (!in->readable()) { return false; }
+            }
+            for (auto& out : outputs) {
+                if (!out->writable()) { return false; }
+            }
+            return true;
+        }
+
     protected:
         void workerLoop() {
-            while (run() >= 0) {}
+            while (profiledRun() >= 0) {}
         }
 
         virtual void doStart() {
+            profiler::registerBlock(this, &profilerStats);
+
+            // Run as a task on the scheduler if it's enabled and the block supports it
+            if (_block_schedulable && !inputs.empty() && scheduler::isRunning()) {
+                for (auto& in : inputs) {
+                    in->setReaderBlock(this);
+                }
+                for (auto& out : outputs) {
+                    out->setWriterBlock(this);
+                }
+                scheduled = true;
+                scheduler::add(this);
+                return;
+            }
+
             workerThread = std::thread(&block::workerLoop, this);
         }
 
         virtual void doStop() {
+            profiler::unregisterBlock(this);
+
             for (auto& in : inputs) {
                 in->stopReader();
             }
@@ -80,6 +139,18 @@ namespace dsp {
                 out->stopWriter();
             }
 
+            // Remove from the scheduler
+            if (scheduled) {
+                scheduler::remove(this);
+                for (auto& in : inputs) {
+                    in->setReaderBlock(NULL);
+                }
+                for (auto& out : outputs) {
+                    out->setWriterBlock(NULL);
+                }
+                scheduled = false;
+            }
+
             // TODO: Make sure this isn't needed, I don't know why it stops
             if (workerThread.joinable()) {
                 workerThread.join();
@@ -92,14 +163,7 @@ namespace dsp {
                 out->clearWriteStop();
             }
         }
-    
-        void acquire() {
-            ctrlMtx.lock();
-        }
 
-        void release() {
-            ctrlMtx.unlock();
-        }
 
         void registerInput(untyped_stream* inStream) {
             inputs.push_back(inStream);
@@ -119,6 +183,9 @@ namespace dsp {
 
         bool _block_init = false;
 
+        // Must only be set by blocks whose run() reads each input and swaps each output at most once
+        bool _block_schedulable = false;
+
         std::recursive_mutex ctrlMtx;
 
         std::vector<untyped_stream*> inputs;
@@ -127,6 +194,8 @@ namespace dsp {
         bool running = false;
         bool tempStopped = false;
         int tempStopDepth = 0;
+        bool scheduled = false;
         std::thread workerThread;
+        profiler::BlockStats profilerStats;
     };
 }
\ No newline at end of file
@@ -0,0 +1,211 @@
+#pragma once
+#include "../sink.h"
+#include "../taps/low_pass.h"
+#include "../fft/plan.h"
+
+namespace dsp::channel {
+    // 2x oversampled polyphase FFT filter bank. The input is split into `channels` evenly spaced channels,
+    // channel i being centered on i * samplerate / channels and having a samplerate of 2 * samplerate / channels.
+    // The processing cost only depends on the input rate, not on how many channels are bound.
+    class PolyphaseChannelizer : public Sink<complex_t> {
+        using base_type = Sink<complex_t>;
+    public:
+        PolyphaseChannelizer() {}
+
+        PolyphaseChannelizer(stream<complex_t>* in, int channels) { init(in, channels); }
+
+        ~PolyphaseChannelizer() {
+            if (!base_type::_block_init) { return; }
+            base_type::stop();
+            destroyBuffers();
+        }
+
+        void init(stream<complex_t>* in, int channels) {
+            assert(channels >= 2 && !(channels % 2));
+            _channels = channels;
+            initBuffers();
+            base_type::init(in);
+            base_type::_block_schedulable = true;
+        }
+
+        void setChannelCount(int channels) {
+            assert(base_type::_block_init);
+            assert(channels >= 2 && !(channels % 2));
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+            if (!bindings.empty()) {
+                throw std::runtime_error("[PolyphaseChannelizer] Tried to change the channel count while streams are bound");
+            }
+            base_type::tempStop();
+            destroyBuffers();
+            _channels = channels;
+            initBuffers();
+            base_type::tempStart();
+        }
+
+        inline int getChannelCount() { return _channels; }
+
+        void bindStream(int channel, stream<complex_t>* stream) {
+            assert(base_type::_block_init);
+            assert(channel >= 0 && channel < _channels);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+
+            // Check that the stream isn't already bound
+            if (findBinding(stream) != bindings.end()) {
+                throw std::runtime_error("[PolyphaseChannelizer] Tried to bind stream to that is already bound");
+            }
+
+            // Add to the list
+            base_type::tempStop();
+            base_type::registerOutput(stream);
+            bindings.push_back({ channel, stream });
+            base_type::tempStart();
+        }
+
+        void unbindStream(stream<complex_t>* stream) {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+
+            // Check that the stream is bound
+            auto bit = findBinding(stream);
+            if (bit == bindings.end()) {
+                throw std::runtime_error("[PolyphaseChannelizer] Tried to unbind stream to that isn't bound");
+            }
+
+            // Remove from the list
+            base_type::tempStop();
+            bindings.erase(bit);
+            base_type::unregisterOutput(stream);
+            base_type::tempStart();
+        }
+
+        void reset() {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+            base_type::tempStop();
+            buffer::clear(buffer, tapCount - 1);
+            offset = 0;
+            oddHop = false;
+            base_type::tempStart();
+        }
+
+        int process(int count, const complex_t* in) {
+            // Copy data to work buffer
+            memcpy(bufferStart, in, count * sizeof(complex_t));
+
+            // Run the filter bank once every half channel count samples
+            int outCount = 0;
+            for (; offset < count; offset += _channels / 2) {
+                // Apply the reversed prototype filter and fold its phases into the FFT input
+                volk_32fc_32f_multiply_32fc((lv_32fc_t*)workBuf, (lv_32fc_t*)&buffer[offset], rtaps, tapCount);
+                volk_32f_x2_add_32f((float*)fftIn, (float*)workBuf, (float*)&workBuf[_channels], _channels * 2);
+                for (int i = 2 * _channels; i < tapCount; i += _channels) {
+                    volk_32f_x2_add_32f((float*)fftIn, (float*)fftIn, (float*)&workBuf[i], _channels * 2);
+                }
+
+                // Do FFT
+                plan->execute(fftIn, fftOut);
+
+                // Output each bound channel, odd channels are inverted every other hop because of the 2x oversampling
+                for (const auto& b : bindings) {
+                    complex_t val = fftOut[b.channel] * phases[b.channel];
+                    b.out->writeBuf[outCount] = (oddHop && (b.channel & 1)) ? val * -1.0f : val;
+                }
+                oddHop = !oddHop;
+                outCount++;
+            }
+            offset -= count;
+
+            // Move unused data
+            memmove(buffer, &buffer[count], (tapCount - 1) * sizeof(complex_t));
+
+            return outCount;
+        }
+
+        int run() {
+            int count = base_type::_in->read();
+            if (count < 0) { return -1; }
+
+            int outCount = process(count, base_type::_in->readBuf);
+
+            // Swap if some data was generated
+            base_type::_in->flush();
+            if (outCount) {
+                for (const auto& b : bindings) {
+                    if (!b.out->swap(outCount)) { return -1; }
+                }
+            }
+            return outCount;
+        }
+
+    protected:
+        struct Binding {
+            int channel;
+            stream<complex_t>* out;
+        };
+
+        std::vector<Binding>::iterator findBinding(stream<complex_t>* stream) {
+            return std::find_if(bindings.begin(), bindings.end(), [stream](const Binding& b) { return b.out == stream; });
+        }
+
+        void initBuffers() {
+            // Design the prototype filter, passband up to 0.75 channel spacing and stopband from 1.25 channel spacing
+            tap<float> proto = taps::lowPass(1.0, 0.5, _channels);
+
+            // Pad it to a whole number of phases and store it reversed to match the order of the delay buffer
+            tapCount = std::max<int>(2, (proto.size + _channels - 1) / _channels) * _channels;
+            rtaps = buffer::alloc<float>(tapCount);
+            for (int i = 0; i < tapCount; i++) {
+                int j = tapCount - 1 - i;
+                rtaps[i] = (j < proto.size) ? proto.taps[j] : 0.0f;
+            }
+            taps::free(proto);
+
+            // Allocate and clear delay buffer
+            buffer = buffer::alloc<complex_t>(STREAM_BUFFER_SIZE + tapCount);
+            bufferStart = &buffer[tapCount - 1];
+            buffer::clear(buffer, tapCount - 1);
+            workBuf = buffer::alloc<complex_t>(tapCount);
+            offset = 0;
+            oddHop = false;
+
+            // Phase correction to align each channel on the newest sample
+            phases = buffer::alloc<complex_t>(_channels);
+            for (int i = 0; i < _channels; i++) {
+                double phase = -2.0 * DB_M_PI * (double)i / (double)_channels;
+                phases[i] = { (float)cos(phase), (float)sin(phase) };
+            }
+
+            // Plan FFT
+            fftIn = (complex_t*)fftwf_malloc(_channels * sizeof(complex_t));
+            fftOut = (complex_t*)fftwf_malloc(_channels * sizeof(complex_t));
+            plan = fft::getPlan(_channels);
+        }
+
+        void destroyBuffers() {
+            plan.reset();
+            fftwf_free(fftIn);
+            fftwf_free(fftOut);
+            buffer::free(rtaps);
+            buffer::free(buffer);
+            buffer::free(workBuf);
+            buffer::free(phases);
+        }
+
+        int _channels;
+        int tapCount;
+        float* rtaps;
+
+        complex_t* buffer;
+        complex_t* bufferStart;
+        complex_t* workBuf;
+        complex_t* phases;
+        int offset = 0;
+        bool oddHop = false;
+
+        complex_t* fftIn;
+        complex_t* fftOut;
+        std::shared_ptr<fft::Plan> plan;
+
+        std::vector<Binding> bindings;
+    };
+}
@@ -2,6 +2,9 @@
 #include "frequency_xlator.h"
 #include "../multirate/rational_resampler.h"
 
+// Number of input samples mixed and decimated at a time when the VFO has no extra filter, small enough to stay in L1
+#define RX_VFO_TILE_SIZE    2048
+
 namespace dsp::channel {
     class RxVFO : public Processor<complex_t, complex_t> {
         using base_type = Processor<complex_t, complex_t>;
@@ -14,6 +17,7 @@ namespace dsp::channel {
             if (!base_type::_block_init) { return; }
             base_type::stop();
             taps::free(ftaps);
+            buffer::free(tile);
         }
 
         void init(stream<complex_t>* in, double inSamplerate, double outSamplerate, double bandwidth, double offset) {
@@ -23,6 +27,7 @@ namespace dsp::channel {
             _offset = offset;
             filterNeeded = (_bandwidth != _outSamplerate);
             ftaps.taps = NULL;
+            tile = buffer::alloc<complex_t>(RX_VFO_TILE_SIZE);
 
             xlator.init(NULL, -_offset, _inSamplerate);
             resamp.init(NULL, _inSamplerate, _outSamplerate);
@@ -87,10 +92,19 @@ namespace dsp::channel {
         }
 
         inline int process(int count, const complex_t* in, complex_t* out) {
-            xlator.process(count, in, out);
+            // Without a filter, mix and decimate one tile at a time so that the mixed samples never leave the cache
             if (!filterNeeded) {
-                return resamp.process(count, out, out);
+                if (_inSamplerate == _outSamplerate) { return xlator.process(count, in, out); }
+                int outCount = 0;
+                for (int i = 0; i < count; i += RX_VFO_TILE_SIZE) {
+                    int n = std::min<int>(count - i, RX_VFO_TILE_SIZE);
+                    xlator.process(n, &in[i], tile);
+                    outCount += resamp.process(n, tile, &out[outCount]);
+                }
+                return outCount;
             }
+
+            xlator.process(count, in, out);
             count = resamp.process(count, out, out);
             {
                 std::lock_guard<std::mutex> lck(filterMtx);
@@ -110,9 +124,14 @@ namespace dsp::channel {
             if (outCount) {
                 if (!out.swap(outCount)) { return -1; }
             }
+            consumed += count;
             return outCount;
         }
 
+        // Number of input samples whose output was handed to the reader. Since a swap only goes through once the
+        // previous block was flushed, the reader has gone through all of them but the last block.
+        uint64_t getConsumedCount() { return consumed; }
+
     protected:
         void generateTaps() {
             taps::free(ftaps);
@@ -125,6 +144,7 @@ namespace dsp::channel {
         filter::FIR<complex_t, float> filter;
         tap<float> ftaps;
         bool filterNeeded;
+        complex_t* tile;
 
         double _inSamplerate;
         double _outSamplerate;
@@ -132,5 +152,6 @@ namespace dsp::channel {
         double _offset;
 
         std::mutex filterMtx;
+        std::atomic<uint64_t> consumed = 0;
     };
 }
\ No newline at end of file
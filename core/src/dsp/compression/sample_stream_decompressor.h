@@ -1,6 +1,7 @@
 #pragma once
 #include "../processor.h"
 #include "pcm_type.h"
+#include "../convert/iq_to_complex.h"
 
 namespace dsp::compression {
     class SampleStreamDecompressor : public Processor<uint8_t, complex_t> {
@@ -10,7 +11,7 @@ namespace dsp::compression {
 
         SampleStreamDecompressor(stream<uint8_t>* in) { base_type::init(in); }
 
-        inline int process(int count, const uint8_t* in, complex_t* out) {
+        inline static int process(int count, const uint8_t* in, complex_t* out) {
             uint16_t sampleType = *(uint16_t*)&in[2];
             float scaler = *(float*)&in[4];
             const void* dataBuf = &in[8];
@@ -21,12 +22,12 @@ namespace dsp::compression {
             }
             else if (sampleType == PCMType::PCM_TYPE_I16) {
                 int outCount = (count - 8) / (sizeof(int16_t) * 2);
-                volk_16i_s32f_convert_32f((float*)out, (int16_t*)dataBuf, 32768.0f / scaler, outCount * 2);
+                convert::s16ToComplex(outCount, (const int16_t*)dataBuf, out, scaler / 32768.0f);
                 return outCount;
             }
             else if (sampleType == PCMType::PCM_TYPE_I8) {
                 int outCount = (count - 8) / (sizeof(int8_t) * 2);
-                volk_8i_s32f_convert_32f((float*)out, (int8_t*)dataBuf, 128.0f / scaler, outCount * 2);
+                convert::s8ToComplex(outCount, (const int8_t*)dataBuf, out, scaler / 128.0f);
                 return outCount;
             }
             
@@ -0,0 +1,114 @@
+#pragma once
+#include <stdint.h>
+#include "../types.h"
+
+// Raw IQ sample format converters used by the source modules.
+// All of them remove a DC offset and apply a scale in the same pass: out = (in - offset) * scale.
+// The loops are written so that the compiler can vectorize them, which is several times faster than
+// a lookup table since a table lookup can't be vectorized.
+namespace dsp::convert {
+    /**
+     * Convert interleaved integer IQ samples to complex.
+     * @param count Number of complex samples.
+     * @param in Input of count * 2 interleaved I and Q values.
+     * @param out Output complex samples.
+     * @param scale Scale applied after removing the offset.
+     * @param offset Offset removed from the I and Q values, in raw sample units.
+     */
+    template <class T>
+    inline void interleavedToComplex(int count, const T* in, complex_t* out, float scale, complex_t offset = { 0.0f, 0.0f }) {
+        float* fout = (float*)out;
+        const float biasRe = -offset.re * scale;
+        const float biasIm = -offset.im * scale;
+        for (int i = 0; i < count; i++) {
+            fout[2 * i] = (float)in[2 * i] * scale + biasRe;
+            fout[(2 * i) + 1] = (float)in[(2 * i) + 1] * scale + biasIm;
+        }
+    }
+
+    /**
+     * Convert separate I and Q integer buffers to complex.
+     * @param count Number of complex samples.
+     * @param inRe Input I values.
+     * @param inIm Input Q values.
+     * @param out Output complex samples.
+     * @param scale Scale applied after removing the offset.
+     * @param offset Offset removed from the I and Q values, in raw sample units.
+     */
+    template <class T>
+    inline void planarToComplex(int count, const T* inRe, const T* inIm, complex_t* out, float scale, complex_t offset = { 0.0f, 0.0f }) {
+        float* fout = (float*)out;
+        const float biasRe = -offset.re * scale;
+        const float biasIm = -offset.im * scale;
+        for (int i = 0; i < count; i++) {
+            fout[2 * i] = (float)inRe[i] * scale + biasRe;
+            fout[(2 * i) + 1] = (float)inIm[i] * scale + biasIm;
+        }
+    }
+
+    // Unsigned 8bit offset binary IQ (RTL-SDR, rtl_tcp, SpyServer). The default offset is the middle of the range.
+    inline void u8ToComplex(int count, const uint8_t* in, complex_t* out, float scale = 1.0f / 128.0f, complex_t offset = { 127.5f, 127.5f }) {
+        interleavedToComplex(count, in, out, scale, offset);
+    }
+
+    // Signed 8bit IQ
+    inline void s8ToComplex(int count, const int8_t* in, complex_t* out, float scale = 1.0f / 128.0f, complex_t offset = { 0.0f, 0.0f }) {
+        interleavedToComplex(count, in, out, scale, offset);
+    }
+
+    // Signed 16bit IQ
+    inline void s16ToComplex(int count, const int16_t* in, complex_t* out, float scale = 1.0f / 32768.0f, complex_t offset = { 0.0f, 0.0f }) {
+        interleavedToComplex(count, in, out, scale, offset);
+    }
+
+    // Signed 32bit IQ
+    inline void s32ToComplex(int count, const int32_t* in, complex_t* out, float scale = 1.0f / 2147483648.0f, complex_t offset = { 0.0f, 0.0f }) {
+        interleavedToComplex(count, in, out, scale, offset);
+    }
+
+    /**
+     * Convert packed signed 12bit IQ to complex. Each sample is 3 bytes with I in the low 12 bits and Q
+     * in the high 12 bits of a little endian 24bit word.
+     * @param count Number of complex samples.
+     * @param in Input of count * 3 bytes.
+     * @param out Output complex samples.
+     * @param scale Scale applied after removing the offset.
+     * @param offset Offset removed from the I and Q values, in raw sample units.
+     */
+    inline void s12PackedToComplex(int count, const uint8_t* in, complex_t* out, float scale = 1.0f / 2048.0f, complex_t offset = { 0.0f, 0.0f }) {
+        float* fout = (float*)out;
+        const float biasRe = -offset.re * scale;
+        const float biasIm = -offset.im * scale;
+        for (int i = 0; i < count; i++) {
+            const uint8_t* s = &in[i * 3];
+            uint32_t word = (uint32_t)s[0] | ((uint32_t)s[1] << 8) | ((uint32_t)s[2] << 16);
+
+            // Move each value to the top of a 32bit word and shift back to sign extend
+            int32_t re = (int32_t)(word << 20) >> 20;
+            int32_t im = (int32_t)(word << 8) >> 20;
+            fout[2 * i] = (float)re * scale + biasRe;
+            fout[(2 * i) + 1] = (float)im * scale + biasIm;
+        }
+    }
+
+    /**
+     * Convert little endian signed 24bit IQ to complex.
+     * @param count Number of complex samples.
+     * @param in Input of count * 6 bytes.
+     * @param out Output complex samples.
+     * @param scale Scale applied after removing the offset.
+     * @param offset Offset removed from the I and Q values, in raw sample units.
+     */
+    inline void s24ToComplex(int count, const uint8_t* in, complex_t* out, float scale = 1.0f / 8388608.0f, complex_t offset = { 0.0f, 0.0f }) {
+        float* fout = (float*)out;
+        const float biasRe = -offset.re * scale;
+        const float biasIm = -offset.im * scale;
+        for (int i = 0; i < count; i++) {
+            const uint8_t* s = &in[i * 6];
+            int32_t re = (int32_t)(((uint32_t)s[0] << 8) | ((uint32_t)s[1] << 16) | ((uint32_t)s[2] << 24)) >> 8;
+            int32_t im = (int32_t)(((uint32_t)s[3] << 8) | ((uint32_t)s[4] << 16) | ((uint32_t)s[5] << 24)) >> 8;
+            fout[2 * i] = (float)re * scale + biasRe;
+            fout[(2 * i) + 1] = (float)im * scale + biasIm;
+        }
+    }
+}
@@ -1,5 +1,8 @@
 #pragma once
 #include "../processor.h"
+#include "../math/one_pole_scan.h"
+
+#define DC_BLOCKER_CHUNK_SIZE   512
 
 namespace dsp::correction {
     template<class T>
@@ -14,6 +17,7 @@ namespace dsp::correction {
 
         void init(stream<T>* in, double rate) {
             _rate = rate;
+            scan.setCoefficients(1.0 - (double)_rate, _rate);
             if constexpr (std::is_same_v<T, float>) {
                 offset = 0.0f;
             }
@@ -30,7 +34,10 @@ namespace dsp::correction {
         void setRate(double rate) {
             assert(base_type::_block_init);
             std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+            base_type::tempStop();
             _rate = rate;
+            scan.setCoefficients(1.0 - (double)_rate, _rate);
+            base_type::tempStart();
         }
 
         void setRate(double rate, double samplerate)  {
@@ -52,9 +59,18 @@ namespace dsp::correction {
 
         // TODO: Add back the const
         int process(int count, T* in, T* out) {
-            for (int i = 0; i < count; i++) {
-                out[i] = in[i] - offset;
-                offset += out[i] * _rate;
+            // The offset is a one-pole low pass of the input. It's computed for a chunk at a time
+            // so that the block still works in place
+            float* state = (float*)&offset;
+            for (int i = 0; i < count; i += DC_BLOCKER_CHUNK_SIZE) {
+                int n = std::min<int>(count - i, DC_BLOCKER_CHUNK_SIZE);
+                float offsets[DC_BLOCKER_CHUNK_SIZE * CHANNELS];
+                const float* cin = (const float*)&in[i];
+                float* cout = (float*)&out[i];
+                scan.process(n, cin, state, offsets);
+                for (int j = 0; j < n * CHANNELS; j++) {
+                    cout[j] = cin[j] - offsets[j];
+                }
             }
             return count;
         }
@@ -71,7 +87,10 @@ namespace dsp::correction {
         }
 
     protected:
+        static constexpr int CHANNELS = sizeof(T) / sizeof(float);
+
         float _rate;
         T offset;
+        math::OnePoleScan<CHANNELS> scan;
     };
 }
\ No newline at end of file
@@ -63,6 +63,7 @@ namespace dsp::demod {
             rdsResamp.out.free();
 
             base_type::init(in);
+            base_type::registerOutput(&this->rdsOut);
         }
 
         void setDeviation(double deviation) {
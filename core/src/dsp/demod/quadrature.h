@@ -3,11 +3,22 @@
 #include "../math/fast_atan2.h"
 #include "../math/hz_to_rads.h"
 #include "../math/normalize_phase.h"
+#include <volk/volk.h>
+
+#define QUADRATURE_CHUNK_SIZE   1024
 
 namespace dsp::demod {
     class Quadrature : public Processor<complex_t, float> {
         using base_type = Processor<complex_t, float>;
     public:
+        // The fast and high tiers take the argument of each sample multiplied by the conjugate of the previous one,
+        // the exact tier differentiates the phase of each sample like the original implementation
+        enum Accuracy {
+            ACCURACY_FAST,      // Branch-free polynomial vectorized by the compiler, error around 1e-5 rad
+            ACCURACY_HIGH,      // VOLK atan2
+            ACCURACY_EXACT      // Scalar atan2 of each sample
+        };
+
         Quadrature() {}
 
         Quadrature(stream<complex_t>* in, double deviation) { init(in, deviation); }
@@ -36,11 +47,42 @@ namespace dsp::demod {
             _invDeviation = 1.0 / math::hzToRads(deviation, samplerate);
         }
 
+        void setAccuracy(Accuracy accuracy) {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+            _accuracy = accuracy;
+        }
+
         inline int process(int count, complex_t* in, float* out) {
-            for (int i = 0; i < count; i++) {
-                float cphase = in[i].phase();
-                out[i] = math::normalizePhase(cphase - phase) * _invDeviation;
-                phase = cphase;
+            if (!count) { return 0; }
+
+            if (_accuracy == ACCURACY_EXACT) {
+                float phase = last.phase();
+                for (int i = 0; i < count; i++) {
+                    float cphase = in[i].phase();
+                    out[i] = math::normalizePhase(cphase - phase) * _invDeviation;
+                    phase = cphase;
+                }
+                last = in[count - 1];
+                return count;
+            }
+
+            // Work in chunks so that the products stay in cache
+            for (int i = 0; i < count; i += QUADRATURE_CHUNK_SIZE) {
+                int n = std::min<int>(count - i, QUADRATURE_CHUNK_SIZE);
+                complex_t diff[QUADRATURE_CHUNK_SIZE];
+                diff[0] = in[i] * last.conj();
+                volk_32fc_x2_multiply_conjugate_32fc((lv_32fc_t*)&diff[1], (lv_32fc_t*)&in[i + 1], (lv_32fc_t*)&in[i], n - 1);
+                last = in[i + n - 1];
+
+                if (_accuracy == ACCURACY_HIGH) {
+                    volk_32fc_s32f_atan2_32f(&out[i], (lv_32fc_t*)diff, 1.0f / _invDeviation, n);
+                    continue;
+                }
+                float* cout = &out[i];
+                for (int j = 0; j < n; j++) {
+                    cout[j] = math::polyAtan2(diff[j].re, diff[j].im) * _invDeviation;
+                }
             }
             return count;
         }
@@ -48,7 +90,7 @@ namespace dsp::demod {
         void reset() {
             assert(base_type::_block_init);
             std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
-            phase = 0.0f;
+            last = { 1.0f, 0.0f };
         }
 
         int run() {
@@ -64,6 +106,7 @@ namespace dsp::demod {
 
     protected:
         float _invDeviation;
-        float phase = 0.0f;
+        Accuracy _accuracy = ACCURACY_FAST;
+        complex_t last = { 1.0f, 0.0f };
     };
 }
\ No newline at end of file
@@ -0,0 +1,110 @@
+#pragma once
+#include <vector>
+#include <complex>
+#include <algorithm>
+#include "../types.h"
+
+namespace dsp::fft {
+    // Plain radix-2 FFT, using Bluestein's algorithm for other sizes. It needs no planning so it's used by plans
+    // that couldn't get an FFTW plan without waiting for the background planner. Same conventions as FFTW:
+    // the backward transform is unnormalized.
+    class FallbackFFT {
+    public:
+        using cplx = std::complex<float>;
+
+        void init(int size, bool forward) {
+            n = size;
+            sign = forward ? -1.0 : 1.0;
+
+            // Use the radix-2 transform directly for powers of two
+            m = 1;
+            while (m < n) { m <<= 1; }
+            if (m == n) {
+                twiddles = genTwiddles(n, sign);
+                return;
+            }
+
+            // Otherwise the transform becomes a convolution with a chirp, done with radix-2 FFTs of at least 2n - 1 points
+            m = 1;
+            while (m < 2 * n - 1) { m <<= 1; }
+            twiddles = genTwiddles(m, -1.0);
+            chirp.resize(n);
+            for (int k = 0; k < n; k++) {
+                // k^2 is reduced modulo 2n first to keep the angle accurate for large sizes
+                int64_t k2 = ((int64_t)k * (int64_t)k) % (2 * (int64_t)n);
+                double angle = sign * DB_M_PI * (double)k2 / (double)n;
+                chirp[k] = cplx((float)cos(angle), (float)sin(angle));
+            }
+            chirpFFT.assign(m, cplx(0.0f, 0.0f));
+            chirpFFT[0] = std::conj(chirp[0]);
+            for (int k = 1; k < n; k++) {
+                chirpFFT[k] = std::conj(chirp[k]);
+                chirpFFT[m - k] = std::conj(chirp[k]);
+            }
+            radix2(chirpFFT.data(), m, twiddles.data());
+        }
+
+        // Compute the FFT, in and out may be the same buffer. Safe to call from multiple threads at once.
+        void execute(const complex_t* in, complex_t* out) const {
+            const cplx* cin = (const cplx*)in;
+            cplx* cout = (cplx*)out;
+
+            if (chirp.empty()) {
+                if (cout != cin) { std::copy(cin, cin + n, cout); }
+                radix2(cout, n, twiddles.data());
+                return;
+            }
+
+            // Multiply by the chirp, convolve with its conjugate and multiply by the chirp again
+            thread_local std::vector<cplx> work;
+            work.assign(m, cplx(0.0f, 0.0f));
+            for (int k = 0; k < n; k++) { work[k] = cin[k] * chirp[k]; }
+            radix2(work.data(), m, twiddles.data());
+            for (int k = 0; k < m; k++) { work[k] = std::conj(work[k] * chirpFFT[k]); }
+            radix2(work.data(), m, twiddles.data());
+            float scale = 1.0f / (float)m;
+            for (int k = 0; k < n; k++) { cout[k] = std::conj(work[k]) * scale * chirp[k]; }
+        }
+
+    private:
+        static std::vector<cplx> genTwiddles(int size, double sign) {
+            std::vector<cplx> tw(size / 2);
+            for (int k = 0; k < size / 2; k++) {
+                double angle = sign * 2.0 * DB_M_PI * (double)k / (double)size;
+                tw[k] = cplx((float)cos(angle), (float)sin(angle));
+            }
+            return tw;
+        }
+
+        // In-place iterative radix-2 FFT, size must be a power of two
+        static void radix2(cplx* data, int size, const cplx* tw) {
+            // Bit reversal permutation
+            for (int i = 1, j = 0; i < size; i++) {
+                int bit = size >> 1;
+                for (; j & bit; bit >>= 1) { j ^= bit; }
+                j ^= bit;
+                if (i < j) { std::swap(data[i], data[j]); }
+            }
+
+            // Butterflies, the twiddles of a stage are every (size / len)th one of the full size table
+            for (int len = 2; len <= size; len <<= 1) {
+                int half = len >> 1;
+                int step = size / len;
+                for (int i = 0; i < size; i += len) {
+                    for (int k = 0; k < half; k++) {
+                        cplx t = data[i + k + half] * tw[k * step];
+                        data[i + k + half] = data[i + k] - t;
+                        data[i + k] += t;
+                    }
+                }
+            }
+        }
+
+        int n = 0;
+        int m = 0;
+        double sign = -1.0;
+        std::vector<cplx> twiddles;
+        std::vector<cplx> chirp;
+        std::vector<cplx> chirpFFT;
+    };
+}
@@ -0,0 +1,313 @@
+#include "plan.h"
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <map>
+#include <deque>
+#include <vector>
+#include <tuple>
+#include <filesystem>
+#include <assert.h>
+#include <stdexcept>
+#include <utils/flog.h>
+
+// Maximum time spent measuring a single plan in the background. Plans requested meanwhile
+// use the fallback FFT, so this only bounds how long they run on it
+#define FFT_MEASURE_TIME_LIMIT  2.0
+
+namespace dsp::fft {
+    class PlanCache {
+    public:
+        std::shared_ptr<Plan> get(int size, bool forward, bool inPlace) {
+            std::shared_ptr<Plan> plan;
+            {
+                std::lock_guard<std::mutex> lck(cacheMtx);
+
+                // Return the cached plan if it's still in use
+                auto key = std::make_tuple(size, forward, inPlace);
+                auto it = plans.find(key);
+                if (it != plans.end()) {
+                    plan = it->second.lock();
+                    if (plan) { return plan; }
+                }
+
+                // Until it gets an FFTW plan, the new plan runs on the fallback FFT
+                plan = std::shared_ptr<Plan>(new Plan(size, forward, inPlace, threadCount));
+                plans[key] = plan;
+            }
+
+            // Plan outside of the cache lock and without waiting for a measurement in progress. The background
+            // planner takes care of it first thing once it's done if the planner is busy.
+            if (!tryLockPlanner()) {
+                enqueue(plan, true);
+                return plan;
+            }
+            bool ok = quickPlan(plan.get());
+            unlockPlanner();
+            if (!ok) { throw std::runtime_error("[FFT] Could not create plan"); }
+            if (!plan->measured) { enqueue(plan, false); }
+            return plan;
+        }
+
+        void loadWisdom(std::string path) {
+            std::lock_guard<std::mutex> lck(plannerMtx);
+            wisdomPath = path;
+            if (!std::filesystem::exists(path)) { return; }
+            if (!fftwf_import_wisdom_from_filename(path.c_str())) {
+                flog::warn("Could not load FFTW wisdom from '{}'", path);
+                return;
+            }
+            flog::info("Loaded FFTW wisdom from '{}'", path);
+        }
+
+        void saveWisdom() {
+            std::lock_guard<std::mutex> lck(plannerMtx);
+            if (wisdomPath.empty()) { return; }
+            if (!fftwf_export_wisdom_to_filename(wisdomPath.c_str())) {
+                flog::error("Could not save FFTW wisdom to '{}'", wisdomPath);
+            }
+        }
+
+        void setThreadCount(int count) {
+            std::lock_guard<std::mutex> lck(cacheMtx);
+            threadCount = std::max<int>(count, 1);
+
+            // Forget the existing plans so that the new ones get the new thread count
+            plans.clear();
+        }
+
+        int getThreadCount() {
+            std::lock_guard<std::mutex> lck(cacheMtx);
+            return threadCount;
+        }
+
+        void stop() {
+            {
+                std::lock_guard<std::mutex> lck(queueMtx);
+                if (!workerThread.joinable()) { return; }
+                stopWorker = true;
+            }
+            queueCnd.notify_all();
+            workerThread.join();
+            stopWorker = false;
+
+            // Destroy the plans that were dropped during the last measurement
+            plannerMtx.lock();
+            unlockPlanner();
+            saveWisdom();
+        }
+
+    private:
+        void initThreads() {
+#ifdef SDRPP_FFTW_THREADS
+            if (threadsInit) { return; }
+            threadsInit = fftwf_init_threads();
+            if (!threadsInit) { flog::error("Could not initialize FFTW threads"); }
+#endif
+        }
+
+        // Lock the planner, only waiting for other short planner calls. Fails if a measurement is in progress.
+        bool tryLockPlanner() {
+            while (!plannerMtx.try_lock()) {
+                if (measuring) { return false; }
+                std::this_thread::yield();
+            }
+            return true;
+        }
+
+        // Destroy the plans dropped while the planner was busy, then unlock it
+        void unlockPlanner() {
+            std::vector<fftwf_plan> dead;
+            {
+                std::lock_guard<std::mutex> lck(deadMtx);
+                dead.swap(deadPlans);
+            }
+            for (auto p : dead) { fftwf_destroy_plan(p); }
+            plannerMtx.unlock();
+        }
+
+        // Must be called with the planner locked
+        std::shared_ptr<fftwf_plan_s> create(int size, bool forward, bool inPlace, int threads, unsigned int flags, double timeLimit = FFTW_NO_TIMELIMIT) {
+            initThreads();
+            fftwf_set_timelimit(timeLimit);
+
+            // Plan on temporary buffers since measuring overwrites them
+            complex_t* in = (complex_t*)fftwf_malloc(size * sizeof(complex_t));
+            complex_t* out = inPlace ? in : (complex_t*)fftwf_malloc(size * sizeof(complex_t));
+#ifdef SDRPP_FFTW_THREADS
+            fftwf_plan_with_nthreads((size >= FFT_THREADED_MIN_SIZE) ? threads : 1);
+#endif
+            fftwf_plan p = fftwf_plan_dft_1d(size, (fftwf_complex*)in, (fftwf_complex*)out, forward ? FFTW_FORWARD : FFTW_BACKWARD, flags);
+            if (!inPlace) { fftwf_free(out); }
+            fftwf_free(in);
+            if (!p) { return NULL; }
+
+            // Plans have to be destroyed with the planner locked as well. If a measurement holds it, the plan is
+            // destroyed once it's done instead of making the owner wait.
+            return std::shared_ptr<fftwf_plan_s>(p, [this](fftwf_plan p) {
+                if (tryLockPlanner()) {
+                    fftwf_destroy_plan(p);
+                    unlockPlanner();
+                    return;
+                }
+                std::lock_guard<std::mutex> lck(deadMtx);
+                deadPlans.push_back(p);
+            });
+        }
+
+        // Give a plan the measured plan if the wisdom has it, otherwise an estimated one. Must be called with the planner locked.
+        bool quickPlan(Plan* plan) {
+            plan->measuredPlan = create(plan->_size, plan->_forward, plan->_inPlace, plan->_threads, FFTW_MEASURE | FFTW_WISDOM_ONLY);
+            if (plan->measuredPlan) {
+                plan->current = plan->measuredPlan.get();
+                plan->measured = true;
+                return true;
+            }
+            plan->estimatedPlan = create(plan->_size, plan->_forward, plan->_inPlace, plan->_threads, FFTW_ESTIMATE);
+            if (!plan->estimatedPlan) { return false; }
+            plan->current = plan->estimatedPlan.get();
+            return true;
+        }
+
+        void enqueue(std::shared_ptr<Plan> plan, bool urgent) {
+            {
+                std::lock_guard<std::mutex> lck(queueMtx);
+                if (urgent) {
+                    queue.push_front(plan);
+                }
+                else {
+                    queue.push_back(plan);
+                }
+                if (!workerThread.joinable()) { workerThread = std::thread(&PlanCache::worker, this); }
+            }
+            queueCnd.notify_all();
+        }
+
+        void worker() {
+            while (true) {
+                // Wait for a plan to measure
+                std::shared_ptr<Plan> plan;
+                {
+                    std::unique_lock<std::mutex> lck(queueMtx);
+                    queueCnd.wait(lck, [this]() { return !queue.empty() || stopWorker; });
+                    if (stopWorker) { return; }
+                    plan = queue.front().lock();
+                    queue.pop_front();
+                }
+
+                // Skip plans nobody uses anymore
+                if (!plan) { continue; }
+
+                // Plans still on the fallback FFT first get a quick one, then go to the back of the queue to be measured
+                if (!plan->current) {
+                    plannerMtx.lock();
+                    bool ok = quickPlan(plan.get());
+                    unlockPlanner();
+                    if (!ok) {
+                        flog::error("Could not create a {} point FFT plan, using the fallback FFT", plan->_size);
+                        continue;
+                    }
+                    if (!plan->measured) { enqueue(plan, false); }
+                    continue;
+                }
+
+                // Measure the plan and swap it in. Whoever needs the planner meanwhile doesn't wait for it.
+                measuring = true;
+                plannerMtx.lock();
+                plan->measuredPlan = create(plan->_size, plan->_forward, plan->_inPlace, plan->_threads, FFTW_MEASURE, FFT_MEASURE_TIME_LIMIT);
+                unlockPlanner();
+                measuring = false;
+                if (!plan->measuredPlan) {
+                    flog::warn("Could not measure a {} point FFT plan", plan->_size);
+                    continue;
+                }
+                plan->current = plan->measuredPlan.get();
+                plan->measured = true;
+                flog::info("Measured {} point FFT plan", plan->_size);
+
+                // Save the wisdom right away once all pending plans are done in case SDR++ doesn't exit cleanly
+                bool empty;
+                {
+                    std::lock_guard<std::mutex> lck(queueMtx);
+                    empty = queue.empty();
+                }
+                if (empty) { saveWisdom(); }
+            }
+        }
+
+        // The FFTW planner isn't thread safe, only the execution of plans is
+        std::mutex plannerMtx;
+        std::atomic<bool> measuring = false;
+        std::string wisdomPath;
+        bool threadsInit = false;
+
+        // Plans dropped while a measurement held the planner
+        std::mutex deadMtx;
+        std::vector<fftwf_plan> deadPlans;
+
+        std::mutex cacheMtx;
+        std::map<std::tuple<int, bool, bool>, std::weak_ptr<Plan>> plans;
+        int threadCount = 1;
+
+        std::mutex queueMtx;
+        std::condition_variable queueCnd;
+        std::deque<std::weak_ptr<Plan>> queue;
+        std::thread workerThread;
+        bool stopWorker = false;
+    };
+
+    // Never destroyed since plans held by other static objects may outlive it
+    PlanCache& cache = *new PlanCache();
+
+    Plan::Plan(int size, bool forward, bool inPlace, int threads) {
+        _size = size;
+        _forward = forward;
+        _inPlace = inPlace;
+        _threads = threads;
+
+        // The FFTW plans are created by the cache, the fallback needs no planner
+        fallback.init(size, forward);
+    }
+
+    void Plan::execute(complex_t* in, complex_t* out) {
+        assert(!_inPlace || in == out);
+        fftwf_plan p = current;
+        if (!p) {
+            fallback.execute(in, out);
+            return;
+        }
+        fftwf_execute_dft(p, (fftwf_complex*)in, (fftwf_complex*)out);
+    }
+
+    std::shared_ptr<Plan> getPlan(int size, bool forward, bool inPlace) {
+        return cache.get(size, forward, inPlace);
+    }
+
+    void loadWisdom(std::string path) {
+        cache.loadWisdom(path);
+    }
+
+    void saveWisdom() {
+        cache.saveWisdom();
+    }
+
+    void setThreadCount(int count) {
+        cache.setThreadCount(count);
+    }
+
+    int getThreadCount() {
+        return cache.getThreadCount();
+    }
+
+    bool threadingSupported() {
+#ifdef SDRPP_FFTW_THREADS
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    void stop() {
+        cache.stop();
+    }
+}
@@ -0,0 +1,80 @@
+#pragma once
+#include <memory>
+#include <atomic>
+#include <string>
+#include <fftw3.h>
+#include "../types.h"
+#include "fallback.h"
+
+// FFTs of this size or larger are planned with the configured number of threads
+#define FFT_THREADED_MIN_SIZE   65536
+
+namespace dsp::fft {
+    /**
+     * Complex FFT plan shared between all users of the same size and direction.
+     * It starts out as a quickly estimated plan and is replaced by a measured one once the background
+     * planner is done with it. Measured plans are saved as FFTW wisdom so they're available immediately next time.
+     * Since FFTW can only plan one thing at a time, a plan requested while a measurement is in progress runs on a
+     * built-in FFT until the planner is free, so that nobody ever waits on a measurement.
+     */
+    class Plan {
+    public:
+        /**
+         * Compute the FFT. Safe to call from multiple threads at once.
+         * @param in Input buffer, must be allocated with fftwf_malloc() or buffer::alloc().
+         * @param out Output buffer, must be allocated with fftwf_malloc() or buffer::alloc(). Must be the input buffer if the plan is in-place.
+         */
+        void execute(complex_t* in, complex_t* out);
+
+        int getSize() { return _size; }
+        bool isMeasured() { return measured; }
+
+    private:
+        friend class PlanCache;
+
+        Plan(int size, bool forward, bool inPlace, int threads);
+
+        int _size;
+        bool _forward;
+        bool _inPlace;
+        int _threads;
+        std::atomic<bool> measured = false;
+
+        // Both plans are kept alive until the end so that swapping doesn't need to synchronize with execute()
+        std::atomic<fftwf_plan> current = NULL;
+        FallbackFFT fallback;
+        std::shared_ptr<fftwf_plan_s> estimatedPlan;
+        std::shared_ptr<fftwf_plan_s> measuredPlan;
+    };
+
+    /**
+     * Get a plan from the cache, creating it if needed.
+     * @param size Size of the FFT.
+     * @param forward True for a forward FFT, false for a backward (unnormalized inverse) one.
+     * @param inPlace True if the input and output buffers will be the same.
+     * @return The shared plan.
+     */
+    std::shared_ptr<Plan> getPlan(int size, bool forward = true, bool inPlace = false);
+
+    /**
+     * Load FFTW wisdom from a file and remember the path to save new wisdom to.
+     * @param path Path of the wisdom file.
+     */
+    void loadWisdom(std::string path);
+
+    // Save the wisdom gathered so far to the file given to loadWisdom()
+    void saveWisdom();
+
+    /**
+     * Set the number of threads used by large FFTs. Only applies to plans created afterwards.
+     * @param count Number of threads.
+     */
+    void setThreadCount(int count);
+    int getThreadCount();
+
+    // Check if the core was built with FFTW's threaded planner
+    bool threadingSupported();
+
+    // Stop the background planner and save the wisdom
+    void stop();
+}
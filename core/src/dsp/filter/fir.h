@@ -1,6 +1,12 @@
 #pragma once
 #include "../processor.h"
 #include "../taps/tap.h"
+#include "../fft/plan.h"
+#include "../autotune.h"
+
+// Above this number of taps, filters are computed using overlap-save FFT convolution. Kernel tuning replaces it with
+// the crossover measured on this machine.
+#define FIR_FFT_MIN_TAPS 256
 
 namespace dsp::filter {
     template <class D, class T>
@@ -15,6 +21,7 @@ namespace dsp::filter {
             if (!base_type::_block_init) { return; }
             base_type::stop();
             buffer::free(buffer);
+            freeFFT();
         }
 
         virtual void init(stream<D>* in, tap<T>& taps) {
@@ -25,6 +32,9 @@ namespace dsp::filter {
             bufStart = &buffer[_taps.size - 1];
             buffer::clear<D>(buffer, _taps.size - 1);
 
+            // Prepare fast convolution if the filter is long enough
+            updateFFT();
+
             base_type::init(in);
         }
 
@@ -47,6 +57,9 @@ namespace dsp::filter {
                 memmove(&buffer[_taps.size - oldTC], buffer, (oldTC - 1) * sizeof(D));
                 buffer::clear<D>(buffer, _taps.size - oldTC);
             }
+
+            // Update the fast convolution kernel
+            updateFFT();
             
             base_type::tempStart();
         }
@@ -62,17 +75,23 @@ namespace dsp::filter {
         inline int process(int count, const D* in, D* out) {
             // Copy data to work buffer
             memcpy(bufStart, in, count * sizeof(D));
-            
+
             // Do convolution
-            for (int i = 0; i < count; i++) {
-                if constexpr (std::is_same_v<D, float> && std::is_same_v<T, float>) {
-                    volk_32f_x2_dot_prod_32f(&out[i], &buffer[i], _taps.taps, _taps.size);
-                }
-                if constexpr ((std::is_same_v<D, complex_t> || std::is_same_v<D, stereo_t>) && std::is_same_v<T, float>) {
-                    volk_32fc_32f_dot_prod_32fc((lv_32fc_t*)&out[i], (lv_32fc_t*)&buffer[i], _taps.taps, _taps.size);
-                }
-                if constexpr ((std::is_same_v<D, complex_t> || std::is_same_v<D, stereo_t>) && std::is_same_v<T, complex_t>) {
-                    volk_32fc_x2_dot_prod_32fc((lv_32fc_t*)&out[i], (lv_32fc_t*)&buffer[i], (lv_32fc_t*)_taps.taps, _taps.size);
+            if (fftMode) {
+                int offset = 0;
+                fftConvolve(count, out, 1, offset);
+            }
+            else {
+                for (int i = 0; i < count; i++) {
+                    if constexpr (std::is_same_v<D, float> && std::is_same_v<T, float>) {
+                        volk_32f_x2_dot_prod_32f(&out[i], &buffer[i], _taps.taps, _taps.size);
+                    }
+                    if constexpr ((std::is_same_v<D, complex_t> || std::is_same_v<D, stereo_t>) && std::is_same_v<T, float>) {
+                        volk_32fc_32f_dot_prod_32fc((lv_32fc_t*)&out[i], (lv_32fc_t*)&buffer[i], _taps.taps, _taps.size);
+                    }
+                    if constexpr ((std::is_same_v<D, complex_t> || std::is_same_v<D, stereo_t>) && std::is_same_v<T, complex_t>) {
+                        volk_32fc_x2_dot_prod_32fc((lv_32fc_t*)&out[i], (lv_32fc_t*)&buffer[i], (lv_32fc_t*)_taps.taps, _taps.size);
+                    }
                 }
             }
 
@@ -94,8 +113,100 @@ namespace dsp::filter {
         }
 
     protected:
+        // Only combinations also supported by the direct convolution are handled
+        static constexpr bool fftCapable = (std::is_same_v<D, float> && std::is_same_v<T, float>) ||
+                                           ((std::is_same_v<D, complex_t> || std::is_same_v<D, stereo_t>) && (std::is_same_v<T, float> || std::is_same_v<T, complex_t>));
+
+        void updateFFT() {
+            freeFFT();
+            fftMode = fftCapable && _taps.size >= autotune::getFFTMinTaps();
+            if (!fftMode) { return; }
+
+            // Use an FFT about four times the length of the filter so that most of each block is usable output
+            fftSize = 1;
+            while (fftSize < 4 * _taps.size) { fftSize <<= 1; }
+            fftBuf = (complex_t*)fftwf_malloc(fftSize * sizeof(complex_t));
+            specBuf = (complex_t*)fftwf_malloc(fftSize * sizeof(complex_t));
+            kernel = (complex_t*)fftwf_malloc(fftSize * sizeof(complex_t));
+            forwardPlan = fft::getPlan(fftSize, true);
+            backwardPlan = fft::getPlan(fftSize, false);
+
+            // The direct convolution correlates the taps with the input, so the kernel is the reversed taps, scaled to compensate the unnormalized inverse FFT
+            float scale = 1.0f / (float)fftSize;
+            buffer::clear(fftBuf, fftSize);
+            for (int i = 0; i < _taps.size; i++) {
+                if constexpr (std::is_same_v<T, float>) {
+                    fftBuf[i] = { _taps.taps[_taps.size - 1 - i] * scale, 0.0f };
+                }
+                if constexpr (std::is_same_v<T, complex_t>) {
+                    fftBuf[i] = _taps.taps[_taps.size - 1 - i] * scale;
+                }
+            }
+            forwardPlan->execute(fftBuf, specBuf);
+            memcpy(kernel, specBuf, fftSize * sizeof(complex_t));
+        }
+
+        void freeFFT() {
+            if (!fftBuf) { return; }
+            forwardPlan.reset();
+            backwardPlan.reset();
+            fftwf_free(fftBuf);
+            fftwf_free(specBuf);
+            fftwf_free(kernel);
+            fftBuf = NULL;
+        }
+
+        // Overlap-save convolution of the data in the work buffer. Only the outputs at `offset`, `offset + decimation`, ... are kept
+        // and `offset` is left on the next output to compute
+        int fftConvolve(int count, D* out, int decimation, int& offset) {
+            int step = fftSize - _taps.size + 1;
+            int avail = _taps.size - 1 + count;
+            int outCount = 0;
+            for (int p = 0; p < count; p += step) {
+                // Skip blocks that don't contain any output sample
+                int blockEnd = std::min<int>(p + step, count);
+                if (offset >= blockEnd) { continue; }
+
+                // Load block, clearing past the end of the available data
+                int n = std::min<int>(fftSize, avail - p);
+                if constexpr (std::is_same_v<D, float>) {
+                    for (int i = 0; i < n; i++) { fftBuf[i] = { buffer[p + i], 0.0f }; }
+                }
+                else {
+                    memcpy(fftBuf, &buffer[p], n * sizeof(complex_t));
+                }
+                if (n < fftSize) { buffer::clear(fftBuf, fftSize - n, n); }
+
+                // Multiply in the frequency domain
+                forwardPlan->execute(fftBuf, specBuf);
+                volk_32fc_x2_multiply_32fc((lv_32fc_t*)specBuf, (lv_32fc_t*)specBuf, (lv_32fc_t*)kernel, fftSize);
+                backwardPlan->execute(specBuf, fftBuf);
+
+                // The first taps - 1 samples of the block are wrapped around and discarded
+                for (; offset < blockEnd; offset += decimation) {
+                    complex_t val = fftBuf[_taps.size - 1 + offset - p];
+                    if constexpr (std::is_same_v<D, float>) {
+                        out[outCount++] = val.re;
+                    }
+                    else {
+                        out[outCount++] = *(D*)&val;
+                    }
+                }
+            }
+            return outCount;
+        }
+
         tap<T> _taps;
         D* buffer;
         D* bufStart;
+
+        // Fast convolution
+        bool fftMode = false;
+        int fftSize;
+        complex_t* fftBuf = NULL;
+        complex_t* specBuf;
+        complex_t* kernel;
+        std::shared_ptr<fft::Plan> forwardPlan;
+        std::shared_ptr<fft::Plan> backwardPlan;
     };
 }
\ No newline at end of file
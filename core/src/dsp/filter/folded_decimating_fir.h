@@ -0,0 +1,166 @@
+#pragma once
+#include "../processor.h"
+#include "../taps/tap.h"
+#include <vector>
+
+// Number of input samples deinterleaved into polyphase branches at a time
+#define FOLDED_DECIMATING_FIR_CHUNK_SIZE 8192
+
+namespace dsp::filter {
+    // Decimating FIR with real taps that only computes the outputs it keeps. The input is split into one branch per
+    // phase of the decimation so that every tap becomes a multiply-accumulate over consecutive outputs, which the
+    // compiler vectorizes. Pairs of equal taps (linear phase filters) share one multiply and zero taps (half-band
+    // filters) are skipped entirely.
+    template <class D>
+    class FoldedDecimatingFIR : public Processor<D, D> {
+        using base_type = Processor<D, D>;
+        static_assert(std::is_same_v<D, float> || std::is_same_v<D, complex_t> || std::is_same_v<D, stereo_t>);
+    public:
+        FoldedDecimatingFIR() {}
+
+        FoldedDecimatingFIR(stream<D>* in, tap<float>& taps, int decimation) { init(in, taps, decimation); }
+
+        ~FoldedDecimatingFIR() {
+            if (!base_type::_block_init) { return; }
+            base_type::stop();
+            buffer::free(buffer);
+            buffer::free(branches);
+        }
+
+        void init(stream<D>* in, tap<float>& taps, int decimation) {
+            _taps = taps;
+            _decimation = decimation;
+
+            // Allocate and clear buffer, with room for the last branch reading up to one decimation past the data
+            buffer = buffer::alloc<D>(STREAM_BUFFER_SIZE + 64000);
+            bufStart = &buffer[_taps.size - 1];
+            buffer::clear<D>(buffer, _taps.size - 1);
+
+            // Allocate the branches for one chunk
+            maxOutputs = std::max<int>(1, FOLDED_DECIMATING_FIR_CHUNK_SIZE / _decimation);
+            branchLen = maxOutputs + (_taps.size - 1) / _decimation + 1;
+            branches = buffer::alloc<D>(branchLen * _decimation);
+
+            generateTerms();
+
+            base_type::init(in);
+        }
+
+        void reset() {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+            base_type::tempStop();
+            offset = 0;
+            buffer::clear<D>(buffer, _taps.size - 1);
+            base_type::tempStart();
+        }
+
+        inline int process(int count, const D* in, D* out) {
+            // Copy data to work buffer
+            memcpy(bufStart, in, count * sizeof(D));
+
+            // Do convolution one chunk of outputs at a time
+            int outCount = 0;
+            while (offset < count) {
+                int n = std::min<int>((count - offset + _decimation - 1) / _decimation, maxOutputs);
+                processChunk(&buffer[offset], n, &out[outCount]);
+                outCount += n;
+                offset += n * _decimation;
+            }
+            offset -= count;
+
+            // Move unused data
+            memmove(buffer, &buffer[count], (_taps.size - 1) * sizeof(D));
+
+            return outCount;
+        }
+
+        int run() {
+            int count = base_type::_in->read();
+            if (count < 0) { return -1; }
+
+            int outCount = process(count, base_type::_in->readBuf, base_type::out.writeBuf);
+
+            // Swap if some data was generated
+            base_type::_in->flush();
+            if (outCount) {
+                if (!base_type::out.swap(outCount)) { return -1; }
+            }
+            return outCount;
+        }
+
+    protected:
+        // A tap applied to one sample, or to the sum of two samples when folded. The positions point into the branches.
+        struct Term {
+            float tap;
+            int a;
+            int b;
+        };
+
+        void generateTerms() {
+            folded.clear();
+            single.clear();
+            int last = _taps.size - 1;
+            for (int i = 0; i <= last / 2; i++) {
+                int j = last - i;
+                float t = _taps.taps[i];
+                if (i == j) {
+                    if (t != 0.0f) { single.push_back({ t, branchPos(i), 0 }); }
+                }
+                else if (t == _taps.taps[j]) {
+                    if (t != 0.0f) { folded.push_back({ t, branchPos(i), branchPos(j) }); }
+                }
+                else {
+                    if (t != 0.0f) { single.push_back({ t, branchPos(i), 0 }); }
+                    if (_taps.taps[j] != 0.0f) { single.push_back({ _taps.taps[j], branchPos(j), 0 }); }
+                }
+            }
+        }
+
+        // Output m reads sample m * decimation + k, which is element m + k / decimation of branch k % decimation
+        inline int branchPos(int k) {
+            return (k % _decimation) * branchLen + (k / _decimation);
+        }
+
+        inline void processChunk(const D* data, int n, D* out) {
+            // Split the input into its polyphase branches. This can read up to one decimation past the last sample,
+            // those values are never used.
+            int len = n + (_taps.size - 1) / _decimation + 1;
+            for (int p = 0; p < _decimation; p++) {
+                D* branch = &branches[p * branchLen];
+                const D* src = &data[p];
+                for (int m = 0; m < len; m++) { branch[m] = src[m * _decimation]; }
+            }
+
+            // Accumulate every term into the outputs, the samples are handled as plain floats since the taps are real
+            constexpr int comps = sizeof(D) / sizeof(float);
+            const float* br = (const float*)branches;
+            float* ac = (float*)out;
+            int fn = n * comps;
+            buffer::clear<D>(out, n);
+            for (const auto& term : folded) {
+                const float* a = &br[term.a * comps];
+                const float* b = &br[term.b * comps];
+                float t = term.tap;
+                for (int i = 0; i < fn; i++) { ac[i] += t * (a[i] + b[i]); }
+            }
+            for (const auto& term : single) {
+                const float* a = &br[term.a * comps];
+                float t = term.tap;
+                for (int i = 0; i < fn; i++) { ac[i] += t * a[i]; }
+            }
+        }
+
+        tap<float> _taps;
+        int _decimation;
+        int offset = 0;
+        D* buffer;
+        D* bufStart;
+
+        int maxOutputs;
+        int branchLen;
+        D* branches;
+        std::vector<Term> folded;
+        std::vector<Term> single;
+    };
+}
@@ -0,0 +1,285 @@
+#pragma once
+#include <vector>
+#include <functional>
+#include "processor.h"
+
+// 2048 samples per tile keeps the intermediate data of a few stages in L1/L2
+#define FUSED_CHAIN_TILE_SIZE 2048
+
+namespace dsp {
+    // Drop-in replacement for chain that runs all enabled blocks back to back in a single thread.
+    // Instead of going through a stream between each block, their process() functions are called
+    // directly on tiles of the input buffer, only the input and output of the chain are streams.
+    // Blocks added to a fused chain must not be started on their own.
+    template<class T>
+    class fused_chain {
+    public:
+        fused_chain() {}
+
+        fused_chain(stream<T>* in, int tileSize = FUSED_CHAIN_TILE_SIZE) { init(in, tileSize); }
+
+        void init(stream<T>* in, int tileSize = FUSED_CHAIN_TILE_SIZE) {
+            _in = in;
+            out = _in;
+            worker.init(_in, this, tileSize);
+        }
+
+        template<typename Func>
+        void setInput(stream<T>* in, Func onOutputChange) {
+            _in = in;
+            if (enabledCount()) {
+                worker.setInput(_in);
+                return;
+            }
+            out = _in;
+            onOutputChange(out);
+        }
+
+        // Set the number of samples processed at once by each block, 0 to process whole buffers
+        void setTileSize(int tileSize) {
+            worker.setTileSize(tileSize);
+        }
+
+        template<class B>
+        void addBlock(B* block, bool enabled) {
+            // Check if block is already part of the chain
+            if (blockExists(block)) {
+                throw std::runtime_error("[fused_chain] Tried to add a block that is already part of the chain");
+            }
+
+            // Add to the list
+            Stage stage;
+            stage.blk = block;
+            stage.process = [block](int count, T* in, T* out) { return block->process(count, in, out); };
+            stage.enabled = false;
+            worker.tempStop();
+            stages.push_back(stage);
+            worker.tempStart();
+
+            // Enable if needed
+            if (enabled) { enableBlock(block, [](stream<T>* out){}); }
+        }
+
+        template<typename Func>
+        void removeBlock(block* block, Func onOutputChange) {
+            // Check if block is part of the chain
+            if (!blockExists(block)) {
+                throw std::runtime_error("[fused_chain] Tried to remove a block that is not part of the chain");
+            }
+
+            // Disable the block
+            disableBlock(block, onOutputChange);
+
+            // Remove block from the list
+            worker.tempStop();
+            stages.erase(findStage(block));
+            worker.tempStart();
+        }
+
+        template<typename Func>
+        void enableBlock(block* block, Func onOutputChange) {
+            // Check that the block is part of the chain
+            if (!blockExists(block)) {
+                throw std::runtime_error("[fused_chain] Tried to enable a block that isn't part of the chain");
+            }
+
+            // If already enable, don't do anything
+            auto stage = findStage(block);
+            if (stage->enabled) { return; }
+
+            // Enable the stage
+            bool wasEmpty = !enabledCount();
+            worker.tempStop();
+            stage->enabled = true;
+            worker.tempStart();
+
+            // If this is the first enabled block, the worker now produces the output
+            if (wasEmpty) {
+                worker.setInput(_in);
+                out = &worker.out;
+                onOutputChange(out);
+                if (running) { worker.start(); }
+            }
+        }
+
+        template<typename Func>
+        void disableBlock(block* block, Func onOutputChange) {
+            // Check that the block is part of the chain
+            if (!blockExists(block)) {
+                throw std::runtime_error("[fused_chain] Tried to disable a block that isn't part of the chain");
+            }
+
+            // If already disabled, don't do anything
+            auto stage = findStage(block);
+            if (!stage->enabled) { return; }
+
+            // Disable the stage
+            worker.tempStop();
+            stage->enabled = false;
+            worker.tempStart();
+
+            // If no block is enabled anymore, bypass the worker
+            if (!enabledCount()) {
+                worker.stop();
+                out = _in;
+                onOutputChange(out);
+            }
+        }
+
+        template<typename Func>
+        void setBlockEnabled(block* block, bool enabled, Func onOutputChange) {
+            if (enabled) {
+                enableBlock(block, onOutputChange);
+            }
+            else {
+                disableBlock(block, onOutputChange);
+            }
+        }
+
+        template<typename Func>
+        void enableAllBlocks(Func onOutputChange) {
+            for (auto& stage : stages) {
+                enableBlock(stage.blk, onOutputChange);
+            }
+        }
+
+        template<typename Func>
+        void disableAllBlocks(Func onOutputChange) {
+            for (auto& stage : stages) {
+                disableBlock(stage.blk, onOutputChange);
+            }
+        }
+
+        void start() {
+            if (running) { return; }
+            if (enabledCount()) { worker.start(); }
+            running = true;
+        }
+
+        void stop() {
+            if (!running) { return; }
+            worker.stop();
+            running = false;
+        }
+
+        stream<T>* out;
+
+    private:
+        struct Stage {
+            block* blk;
+            std::function<int(int, T*, T*)> process;
+            bool enabled;
+        };
+
+        class Worker : public Processor<T, T> {
+            using base_type = Processor<T, T>;
+        public:
+            ~Worker() {
+                if (!base_type::_block_init) { return; }
+                base_type::stop();
+                buffer::free(bufA);
+                buffer::free(bufB);
+            }
+
+            void init(stream<T>* in, fused_chain<T>* chain, int tileSize) {
+                _chain = chain;
+                _tileSize = tileSize;
+                bufA = buffer::alloc<T>(STREAM_BUFFER_SIZE);
+                bufB = buffer::alloc<T>(STREAM_BUFFER_SIZE);
+                base_type::init(in);
+            }
+
+            void setTileSize(int tileSize) {
+                assert(base_type::_block_init);
+                std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+                base_type::tempStop();
+                _tileSize = tileSize;
+                base_type::tempStart();
+            }
+
+            inline int process(int count, T* in, T* out) {
+                // Pass through if all stages were just disabled
+                if (enabledStages.empty()) {
+                    memcpy(out, in, count * sizeof(T));
+                    return count;
+                }
+
+                // Process each tile through all enabled stages
+                int tileSize = _tileSize ? _tileSize : count;
+                int outCount = 0;
+                for (int i = 0; i < count; i += tileSize) {
+                    int tileCount = std::min<int>(tileSize, count - i);
+                    T* data = &in[i];
+                    T* scratch = bufA;
+                    int left = enabledStages.size();
+                    for (auto& stage : enabledStages) {
+                        // The last stage writes directly to the output
+                        T* dst = (--left) ? scratch : &out[outCount];
+
+                        // Keep the block from being reconfigured while in use
+                        stage->blk->acquire();
+                        tileCount = stage->process(tileCount, data, dst);
+                        stage->blk->release();
+
+                        data = dst;
+                        scratch = (scratch == bufA) ? bufB : bufA;
+                        if (!tileCount) { break; }
+                    }
+                    if (!left) { outCount += tileCount; }
+                }
+                return outCount;
+            }
+
+            int run() {
+                int count = base_type::_in->read();
+                if (count < 0) { return -1; }
+
+                int outCount = process(count, base_type::_in->readBuf, base_type::out.writeBuf);
+
+                // Swap if some data was generated
+                base_type::_in->flush();
+                if (outCount) {
+                    if (!base_type::out.swap(outCount)) { return -1; }
+                }
+                return outCount;
+            }
+
+        private:
+            void doStart() override {
+                // Take a snapshot of the enabled stages
+                enabledStages.clear();
+                for (auto& stage : _chain->stages) {
+                    if (stage.enabled) { enabledStages.push_back(&stage); }
+                }
+                base_type::doStart();
+            }
+
+            fused_chain<T>* _chain;
+            std::vector<Stage*> enabledStages;
+            int _tileSize;
+            T* bufA;
+            T* bufB;
+        };
+
+        typename std::vector<Stage>::iterator findStage(block* block) {
+            return std::find_if(stages.begin(), stages.end(), [block](const Stage& s) { return s.blk == block; });
+        }
+
+        bool blockExists(block* block) {
+            return findStage(block) != stages.end();
+        }
+
+        int enabledCount() {
+            int count = 0;
+            for (auto& stage : stages) {
+                if (stage.enabled) { count++; }
+            }
+            return count;
+        }
+
+        stream<T>* _in;
+        std::vector<Stage> stages;
+        Worker worker;
+        bool running = false;
+    };
+}
@@ -10,6 +10,13 @@ namespace dsp::loop {
 
         FastAGC(stream<T>* in, double setPoint, double maxGain, double rate, double initGain = 1.0) { init(in, setPoint, maxGain, rate, initGain); }
 
+        ~FastAGC() {
+            if (!base_type::_block_init) { return; }
+            base_type::stop();
+            buffer::free(ampBuf);
+            buffer::free(gainBuf);
+        }
+
         void init(stream<T>* in, double setPoint, double maxGain, double rate, double initGain = 1.0) {
             _setPoint = setPoint;
             _maxGain = maxGain;
@@ -18,6 +25,9 @@ namespace dsp::loop {
 
             _gain = _initGain;
 
+            ampBuf = buffer::alloc<float>(STREAM_BUFFER_SIZE);
+            gainBuf = buffer::alloc<float>(STREAM_BUFFER_SIZE);
+
             base_type::init(in);
         }
 
@@ -58,23 +68,29 @@ namespace dsp::loop {
         }
 
         inline int process(int count, T* in, T* out) {
+            // Calculate input amplitude ahead of the gain loop since it doesn't depend on the gain
+            if constexpr (std::is_same_v<T, float>) {
+                for (int i = 0; i < count; i++) { ampBuf[i] = fabsf(in[i]); }
+            }
+            if constexpr (std::is_same_v<T, complex_t>) {
+                volk_32fc_magnitude_32f(ampBuf, (lv_32fc_t*)in, count);
+            }
+
+            // Update and clamp gain, the output amplitude is the input amplitude scaled by the gain
             for (int i = 0; i < count; i++) {
-                // Output scaled input
-                out[i] = in[i] * _gain;
-
-                // Calculate output amplitude
-                float amp;
-                if constexpr (std::is_same_v<T, float>) {
-                    amp = fabsf(out[i]);
-                }
-                if constexpr (std::is_same_v<T, complex_t>) {
-                    amp = out[i].amplitude();
-                }
-
-                // Update and clamp gain
+                gainBuf[i] = _gain;
+                float amp = fabsf(_gain) * ampBuf[i];
                 _gain += (_setPoint - amp) * _rate;
                 if (_gain > _maxGain) { _gain = _maxGain; }
             }
+
+            // Output scaled input
+            if constexpr (std::is_same_v<T, float>) {
+                volk_32f_x2_multiply_32f(out, in, gainBuf, count);
+            }
+            if constexpr (std::is_same_v<T, complex_t>) {
+                volk_32fc_32f_multiply_32fc((lv_32fc_t*)out, (lv_32fc_t*)in, gainBuf, count);
+            }
             return count;
         }
 
@@ -96,5 +112,8 @@ namespace dsp::loop {
         float _maxGain;
         float _initGain;
 
+        float* ampBuf;
+        float* gainBuf;
+
     };
 }
\ No newline at end of file
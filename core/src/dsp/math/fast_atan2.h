@@ -1,5 +1,6 @@
 #pragma once
 #include <math.h>
+#include <algorithm>
 #include "constants.h"
 
 #define FAST_ATAN2_COEF1 FL_M_PI / 4.0f
@@ -23,4 +24,19 @@ namespace dsp::math {
         }
         return angle;
     }
+
+    // Branch-free atan2 with a maximum error of about 1e-5 rad. Unlike fastAtan2 it has no branches so that loops
+    // calling it can be vectorized by the compiler.
+    inline float polyAtan2(float x, float y) {
+        float ax = fabsf(x);
+        float ay = fabsf(y);
+        float mx = std::max<float>(ax, ay);
+        float mn = std::min<float>(ax, ay);
+        float a = mn / (mx + 1e-30f);
+        float s = a * a;
+        float r = ((((0.0208351f * s - 0.0851330f) * s + 0.1801410f) * s - 0.3302995f) * s + 0.9998660f) * a;
+        r = (ay > ax) ? (FL_M_PI / 2.0f) - r : r;
+        r = (x < 0.0f) ? FL_M_PI - r : r;
+        return (y < 0.0f) ? -r : r;
+    }
 }
\ No newline at end of file
@@ -0,0 +1,81 @@
+#pragma once
+#include <math.h>
+#include <algorithm>
+
+namespace dsp::math {
+    /**
+     * Lookahead form of the one-pole recurrence `state = state * pole + in * gain` on CH interleaved channels.
+     * The recurrence is unrolled LOOKAHEAD samples ahead, so that each state is computed from the one LOOKAHEAD
+     * samples earlier and a short FIR over the input. The loop-carried dependency is then LOOKAHEAD samples long
+     * instead of one, which lets the compiler vectorize the loop.
+     */
+    template <int CH>
+    class OnePoleScan {
+    public:
+        static constexpr int LOOKAHEAD = 8;
+
+        /**
+         * Set the coefficients of the recurrence.
+         * @param pole Pole of the filter, the state is multiplied by it each sample.
+         * @param gain Gain applied to the input before it's added to the state.
+         */
+        void setCoefficients(double pole, double gain) {
+            // The pole is often extremely close to one, so the state is updated as `state - state * (1 - pole)`
+            // to avoid rounding it to single precision
+            leak = (float)(1.0 - pole);
+            _gain = (float)gain;
+            aheadLeak = (float)(1.0 - pow(pole, LOOKAHEAD));
+            for (int j = 0; j < LOOKAHEAD; j++) {
+                aheadTaps[j] = (float)(gain * pow(pole, LOOKAHEAD - 1 - j));
+            }
+        }
+
+        /**
+         * Run the recurrence over a buffer.
+         * @param count Number of samples.
+         * @param in Input of count * CH values.
+         * @param state State of each channel, updated to the state after the last sample.
+         * @param states Output of the count * CH states, must not alias the input.
+         * @param after If true, give the states after each sample was added, otherwise before.
+         */
+        inline void process(int count, const float* in, float* state, float* states, bool after = false) {
+            // Compute the first states directly
+            int head = std::min<int>(count, LOOKAHEAD);
+            for (int c = 0; c < CH; c++) {
+                float s = state[c];
+                for (int i = 0; i < head; i++) {
+                    states[i * CH + c] = s;
+                    s += in[i * CH + c] * _gain - s * leak;
+                }
+            }
+
+            // Compute the rest from the states LOOKAHEAD samples earlier
+            constexpr int dist = LOOKAHEAD * CH;
+            int n = (count - head) * CH;
+            for (int f = 0; f < n; f++) {
+                float acc = states[f] - aheadLeak * states[f];
+                for (int j = 0; j < LOOKAHEAD; j++) {
+                    acc += aheadTaps[j] * in[f + j * CH];
+                }
+                states[f + dist] = acc;
+            }
+
+            // Update the state and convert to the states after each sample if needed
+            const float* last = &in[(count - 1) * CH];
+            for (int c = 0; c < CH; c++) {
+                if (count) { state[c] = states[(count - 1) * CH + c] + last[c] * _gain - states[(count - 1) * CH + c] * leak; }
+            }
+            if (after) {
+                for (int f = 0; f < count * CH; f++) {
+                    states[f] += in[f] * _gain - states[f] * leak;
+                }
+            }
+        }
+
+    private:
+        float leak;
+        float _gain;
+        float aheadLeak;
+        float aheadTaps[LOOKAHEAD];
+    };
+}
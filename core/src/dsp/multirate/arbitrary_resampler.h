@@ -0,0 +1,164 @@
+#pragma once
+#include "../processor.h"
+#include "../taps/tap.h"
+#include "polyphase_bank.h"
+
+// Number of phases of the filter bank, the output is linearly interpolated between two neighbouring phases
+#define ARBITRARY_RESAMPLER_PHASES  64
+
+namespace dsp::multirate {
+    // Resampler for any ratio, including irrational or drifting ones. It uses a fixed size polyphase bank and
+    // interpolates between the two phases closest to each output instant, so memory and CPU don't depend on the ratio.
+    template<class T>
+    class ArbitraryResampler : public Processor<T, T> {
+        using base_type = Processor<T, T>;
+    public:
+        ArbitraryResampler() {}
+
+        /**
+         * Create an arbitrary resampler.
+         * @param in Input stream.
+         * @param ratio Number of input samples per output sample.
+         * @param taps Prototype low-pass filter designed at ARBITRARY_RESAMPLER_PHASES times the input samplerate.
+         */
+        ArbitraryResampler(stream<T>* in, double ratio, tap<float>& taps) { init(in, ratio, taps); }
+
+        ~ArbitraryResampler() {
+            if (!base_type::_block_init) { return; }
+            base_type::stop();
+            buffer::free(buffer);
+            freePolyphaseBank(phases);
+        }
+
+        void init(stream<T>* in, double ratio, tap<float>& taps) {
+            _ratio = ratio;
+
+            // Build filter bank
+            phases = buildBank(taps);
+
+            // Allocate delay buffer
+            buffer = buffer::alloc<T>(STREAM_BUFFER_SIZE + 64000);
+            bufStart = &buffer[phases.tapsPerPhase - 1];
+            buffer::clear<T>(buffer, phases.tapsPerPhase - 1);
+
+            base_type::init(in);
+        }
+
+        void setTaps(double ratio, tap<float>& taps) {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+            base_type::tempStop();
+
+            // Re-generate polyphase bank
+            _ratio = ratio;
+            freePolyphaseBank(phases);
+            phases = buildBank(taps);
+
+            // Reset buffer
+            bufStart = &buffer[phases.tapsPerPhase - 1];
+            reset();
+
+            base_type::tempStart();
+        }
+
+        // Change the ratio without disturbing the stream, meant for small corrections like clock drift compensation.
+        // The filter is not redesigned so the ratio must stay close to the one the taps were designed for.
+        void setRatio(double ratio) {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+            _ratio = ratio;
+        }
+
+        double getRatio() {
+            return _ratio;
+        }
+
+        void reset() {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+            base_type::tempStop();
+            buffer::clear<T>(buffer, phases.tapsPerPhase - 1);
+            frac = 0.0;
+            offset = 0;
+            base_type::tempStart();
+        }
+
+        inline int process(int count, const T* in, T* out) {
+            int outCount = 0;
+
+            // Copy input to buffer
+            memcpy(bufStart, in, count * sizeof(T));
+
+            while (offset < count) {
+                // Find the two phases surrounding the output instant. The phase count is a power of two so this is exact.
+                double pos = frac * (double)ARBITRARY_RESAMPLER_PHASES;
+                int phase = (int)pos;
+                float mu = (float)(pos - (double)phase);
+
+                // Do convolution with both phases
+                T a, b;
+                if constexpr (std::is_same_v<T, float>) {
+                    volk_32f_x2_dot_prod_32f(&a, &buffer[offset], phases.phases[phase], phases.tapsPerPhase);
+                    volk_32f_x2_dot_prod_32f(&b, &buffer[offset], phases.phases[phase + 1], phases.tapsPerPhase);
+                }
+                if constexpr (std::is_same_v<T, complex_t> || std::is_same_v<T, stereo_t>) {
+                    volk_32fc_32f_dot_prod_32fc((lv_32fc_t*)&a, (lv_32fc_t*)&buffer[offset], phases.phases[phase], phases.tapsPerPhase);
+                    volk_32fc_32f_dot_prod_32fc((lv_32fc_t*)&b, (lv_32fc_t*)&buffer[offset], phases.phases[phase + 1], phases.tapsPerPhase);
+                }
+                out[outCount++] = a + (b - a) * mu;
+
+                // Advance by the ratio, keeping the fractional part
+                frac += _ratio;
+                int adv = (int)frac;
+                offset += adv;
+                frac -= (double)adv;
+            }
+            offset -= count;
+
+            // Move delay
+            memmove(buffer, &buffer[count], (phases.tapsPerPhase - 1) * sizeof(T));
+
+            return outCount;
+        }
+
+        int run() {
+            int count = base_type::_in->read();
+            if (count < 0) { return -1; }
+
+            int outCount = process(count, base_type::_in->readBuf, base_type::out.writeBuf);
+
+            // Swap if some data was generated
+            base_type::_in->flush();
+            if (outCount) {
+                if (!base_type::out.swap(outCount)) { return -1; }
+            }
+            return outCount;
+        }
+
+    protected:
+        // Same layout as buildPolyphaseBank() with one extra phase, equal to the first one delayed by one sample,
+        // so that the interpolation never needs to wrap around to the next input sample
+        PolyphaseBank<float> buildBank(tap<float>& taps) {
+            const int phaseCount = ARBITRARY_RESAMPLER_PHASES;
+            PolyphaseBank<float> pb;
+            pb.phaseCount = phaseCount + 1;
+            pb.tapsPerPhase = (taps.size / phaseCount) + 1;
+            pb.phases = buffer::alloc<float*>(pb.phaseCount);
+            for (int p = 0; p < pb.phaseCount; p++) {
+                pb.phases[p] = buffer::alloc<float>(pb.tapsPerPhase);
+                for (int i = 0; i < pb.tapsPerPhase; i++) {
+                    int id = i * phaseCount + (phaseCount - 1) - p;
+                    pb.phases[p][i] = (id >= 0 && id < taps.size) ? taps.taps[id] : 0.0f;
+                }
+            }
+            return pb;
+        }
+
+        double _ratio;
+        PolyphaseBank<float> phases;
+        double frac = 0.0;
+        int offset = 0;
+        T* buffer;
+        T* bufStart;
+    };
+}
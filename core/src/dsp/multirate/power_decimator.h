@@ -1,5 +1,5 @@
 #pragma once
-#include "../filter/decimating_fir.h"
+#include "../filter/folded_decimating_fir.h"
 #include "../taps/from_array.h"
 #include "decim/plans.h"
 
@@ -99,7 +99,8 @@ namespace dsp::multirate {
                 stageCount = plan.stageCount;
                 for (int i = 0; i < stageCount; i++) {
                     tap<float> taps = taps::fromArray<float>(plan.stages[i].tapcount, plan.stages[i].taps);
-                    auto fir = new filter::DecimatingFIR<T, float>(NULL, taps, plan.stages[i].decimation);
+                    // The plan taps are linear phase, the folded FIR halves the multiplies and only computes kept outputs
+                    auto fir = new filter::FoldedDecimatingFIR<T>(NULL, taps, plan.stages[i].decimation);
                     fir->out.free();
                     decimTaps.push_back(taps);
                     decimFirs.push_back(fir);
@@ -112,7 +113,7 @@ namespace dsp::multirate {
             return ((ratio & (ratio - 1)) == 0) && ratio && ratio <= getMaxRatio();
         }
 
-        std::vector<filter::DecimatingFIR<T, float>*> decimFirs;
+        std::vector<filter::FoldedDecimatingFIR<T>*> decimFirs;
         std::vector<tap<float>> decimTaps;
         unsigned int _ratio;
         int stageCount;
@@ -5,10 +5,14 @@
 #include "../filter/decimating_fir.h"
 #include "../taps/from_array.h"
 #include "polyphase_resampler.h"
+#include "arbitrary_resampler.h"
 #include "power_decimator.h"
 #include "../taps/low_pass.h"
 #include "../window/nuttall.h"
 
+// Largest polyphase filter the resampler will build for an exact rational ratio, above this the arbitrary resampler is used
+#define RATIONAL_RESAMPLER_MAX_TAPS 16384
+
 namespace dsp::multirate {
     template<class T>
     class RationalResampler : public Processor<T, T> {
@@ -32,9 +36,11 @@ namespace dsp::multirate {
             rtaps = taps::lowPass(0.25, 0.1, 1.0);
             decim.init(NULL, 2);
             resamp.init(NULL, 1, 1, rtaps);
+            arbResamp.init(NULL, 1.0, rtaps);
 
             decim.out.free();
             resamp.out.free();
+            arbResamp.out.free();
 
             // Proper configuration
             reconfigure();
@@ -48,6 +54,7 @@ namespace dsp::multirate {
             base_type::tempStop();
             decim.reset();
             resamp.reset();
+            arbResamp.reset();
             base_type::tempStart();
         }
 
@@ -83,11 +90,11 @@ namespace dsp::multirate {
             switch(mode) {
                 case Mode::BOTH:
                     count = decim.process(count, in, out);
-                    return resamp.process(count, out, out);
+                    return resample(count, out, out);
                 case Mode::DECIM_ONLY:
                     return decim.process(count, in, out);
                 case Mode::RESAMP_ONLY:
-                    return resamp.process(count, in, out);
+                    return resample(count, in, out);
                 case Mode::NONE:
                     memcpy(out, in, count * sizeof(T));
                     return count;
@@ -110,6 +117,10 @@ namespace dsp::multirate {
         }
 
     protected:
+        inline int resample(int count, const T* in, T* out) {
+            return arbitrary ? arbResamp.process(count, in, out) : resamp.process(count, in, out);
+        }
+
         enum Mode {
             BOTH,
             DECIM_ONLY,
@@ -140,20 +151,31 @@ namespace dsp::multirate {
             // Check for excessive error
             double actualOutSR = (double)IntSR * (double)interp / (double)decim;
             double error = abs((actualOutSR - _outSamplerate) / _outSamplerate) * 100.0;
-            if (error > 0.01) {
-                fprintf(stderr, "Warning: resampling error is over 0.01%%: %lf\n", error);
-            }
             
             // If the power decimator already did all the work, don't use the resampler
-            if (interp == decim) {
+            if (interp == decim && error <= 0.01) {
                 mode = useDecim ? Mode::DECIM_ONLY : Mode::NONE;
                 return;
             }
 
-            // Configure the polyphase resampler
-            double tapSamplerate = intSamplerate * (double)interp;
+            // When the exact ratio is inaccurate or needs a huge filter, use the arbitrary resampler instead
             double tapBandwidth = std::min<double>(_inSamplerate, _outSamplerate) / 2.0;
             double tapTransWidth = tapBandwidth * 0.1;
+            arbitrary = (error > 0.01 || taps::estimateTapCount(tapTransWidth, intSamplerate * (double)interp) > RATIONAL_RESAMPLER_MAX_TAPS);
+            if (arbitrary) {
+                taps::free(rtaps);
+                rtaps = taps::lowPass(tapBandwidth, tapTransWidth, intSamplerate * (double)ARBITRARY_RESAMPLER_PHASES);
+                for (int i = 0; i < rtaps.size; i++) { rtaps.taps[i] *= (float)ARBITRARY_RESAMPLER_PHASES; }
+                arbResamp.setTaps(intSamplerate / _outSamplerate, rtaps);
+
+                printf("[Resamp] predec: %d, arbitrary ratio: %lf, taps: %d\n", predecRatio, intSamplerate / _outSamplerate, rtaps.size);
+
+                mode = useDecim ? Mode::BOTH : Mode::RESAMP_ONLY;
+                return;
+            }
+
+            // Configure the polyphase resampler
+            double tapSamplerate = intSamplerate * (double)interp;
             taps::free(rtaps);
             rtaps = taps::lowPass(tapBandwidth, tapTransWidth, tapSamplerate);
             for (int i = 0; i < rtaps.size; i++) { rtaps.taps[i] *= (float)interp; }
@@ -166,6 +188,8 @@ namespace dsp::multirate {
         
         PowerDecimator<T> decim;
         PolyphaseResampler<T> resamp;
+        ArbitraryResampler<T> arbResamp;
+        bool arbitrary = false;
         tap<float> rtaps;
         double _inSamplerate;
         double _outSamplerate;
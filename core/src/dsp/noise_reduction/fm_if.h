@@ -1,7 +1,7 @@
 #pragma once
 #include "../processor.h"
 #include "../window/nuttall.h"
-#include <fftw3.h>
+#include "../fft/plan.h"
 
 namespace dsp::noise_reduction {
     class FMIF : public Processor<complex_t, complex_t> {
@@ -52,7 +52,7 @@ namespace dsp::noise_reduction {
                 volk_32fc_32f_multiply_32fc((lv_32fc_t*)forwFFTIn, (lv_32fc_t*)&buffer[i], fftWin, _bins);
 
                 // Do forward FFT
-                fftwf_execute(forwardPlan);
+                forwardPlan->execute(forwFFTIn, forwFFTOut);
 
                 // Process bins here
                 uint32_t idx;
@@ -63,7 +63,7 @@ namespace dsp::noise_reduction {
                 backFFTIn[idx] = forwFFTOut[idx];
 
                 // Do reverse FFT and get first element
-                fftwf_execute(backwardPlan);
+                backwardPlan->execute(backFFTIn, backFFTOut);
                 out[i] = backFFTOut[_bins / 2];
 
                 // Reset the input buffer
@@ -111,14 +111,14 @@ namespace dsp::noise_reduction {
             fftWin = buffer::alloc<float>(_bins);
             for (int i = 0; i < _bins; i++) { fftWin[i] = window::nuttall(i, _bins - 1); }
 
-            // Plan FFTs
-            forwardPlan = fftwf_plan_dft_1d(_bins, (fftwf_complex*)forwFFTIn, (fftwf_complex*)forwFFTOut, FFTW_FORWARD, FFTW_ESTIMATE);
-            backwardPlan = fftwf_plan_dft_1d(_bins, (fftwf_complex*)backFFTIn, (fftwf_complex*)backFFTOut, FFTW_BACKWARD, FFTW_ESTIMATE);
+            // Get FFT plans
+            forwardPlan = fft::getPlan(_bins, true);
+            backwardPlan = fft::getPlan(_bins, false);
         }
 
         void destroyBuffers() {
-            fftwf_destroy_plan(forwardPlan);
-            fftwf_destroy_plan(backwardPlan);
+            forwardPlan.reset();
+            backwardPlan.reset();
             fftwf_free(forwFFTIn);
             fftwf_free(forwFFTOut);
             fftwf_free(backFFTIn);
@@ -133,8 +133,8 @@ namespace dsp::noise_reduction {
         complex_t* backFFTIn;
         complex_t* backFFTOut;
 
-        fftwf_plan forwardPlan;
-        fftwf_plan backwardPlan;
+        std::shared_ptr<fft::Plan> forwardPlan;
+        std::shared_ptr<fft::Plan> backwardPlan;
 
         complex_t* buffer;
         complex_t* bufferStart;
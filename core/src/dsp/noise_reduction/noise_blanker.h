@@ -1,5 +1,8 @@
 #pragma once
 #include "../processor.h"
+#include "../math/one_pole_scan.h"
+
+#define NOISE_BLANKER_CHUNK_SIZE    1024
 
 namespace dsp::noise_reduction {
     class NoiseBlanker : public Processor<complex_t, complex_t> {
@@ -9,18 +12,31 @@ namespace dsp::noise_reduction {
 
         NoiseBlanker(stream<complex_t>* in, double rate, double level) { init(in, rate, level); }
 
+        ~NoiseBlanker() {
+            if (!base_type::_block_init) { return; }
+            base_type::stop();
+            buffer::free(ampBuf);
+            buffer::free(gainBuf);
+        }
+
         void init(stream<complex_t>* in, double rate, double level) {
             _rate = rate;
             _invRate = 1.0f - _rate;
             _level = level;
+            scan.setCoefficients(1.0 - (double)_rate, _rate);
+            ampBuf = buffer::alloc<float>(STREAM_BUFFER_SIZE);
+            gainBuf = buffer::alloc<float>(STREAM_BUFFER_SIZE);
             base_type::init(in);
         }
 
         void setRate(double rate) {
             assert(base_type::_block_init);
             std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+            base_type::tempStop();
             _rate = rate;
             _invRate = 1.0f - _rate;
+            scan.setCoefficients(1.0 - (double)_rate, _rate);
+            base_type::tempStart();
         }
 
         void setLevel(double level) {
@@ -36,23 +52,34 @@ namespace dsp::noise_reduction {
         }
 
         inline int process(int count, complex_t* in, complex_t* out) {
-            for (int i = 0; i < count; i++) {
-                // Get signal amplitude
-                float inAmp = in[i].amplitude();
-
-                // Update average amplitude
-                float gain = 1.0f;
-                if (inAmp != 0.0f) {
-                    amp = (amp * _invRate) + (inAmp * _rate);
-                    float excess = inAmp / amp;
-                    if (excess > _level) {
-                        gain = 1.0f / excess;
-                    }
+            // Get signal amplitude
+            volk_32fc_magnitude_32f(ampBuf, (lv_32fc_t*)in, count);
+
+            // Update average amplitude. Zero amplitude samples don't update it, so chunks containing any are done one sample at a time
+            for (int i = 0; i < count; i += NOISE_BLANKER_CHUNK_SIZE) {
+                int n = std::min<int>(count - i, NOISE_BLANKER_CHUNK_SIZE);
+                bool hasZero = false;
+                for (int j = i; j < i + n; j++) {
+                    hasZero |= (ampBuf[j] == 0.0f);
+                }
+                if (!hasZero) {
+                    scan.process(n, &ampBuf[i], &amp, &gainBuf[i], true);
+                    continue;
                 }
-                
-                // Scale output by gain
-                out[i] = in[i] * gain;
+                for (int j = i; j < i + n; j++) {
+                    if (ampBuf[j] != 0.0f) { amp = (amp * _invRate) + (ampBuf[j] * _rate); }
+                    gainBuf[j] = amp;
+                }
+            }
+
+            // Compute the gain from how much the amplitude exceeds the average
+            for (int i = 0; i < count; i++) {
+                float excess = ampBuf[i] / gainBuf[i];
+                gainBuf[i] = (ampBuf[i] != 0.0f && excess > _level) ? (1.0f / excess) : 1.0f;
             }
+
+            // Scale output by gain
+            volk_32fc_32f_multiply_32fc((lv_32fc_t*)out, (lv_32fc_t*)in, gainBuf, count);
             return count;
         }
 
@@ -73,6 +100,10 @@ namespace dsp::noise_reduction {
         float _level;
 
         float amp = 1.0;
+        math::OnePoleScan<1> scan;
+
+        float* ampBuf;
+        float* gainBuf;
 
     };
 }
\ No newline at end of file
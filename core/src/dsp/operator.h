@@ -18,6 +18,7 @@ namespace dsp {
             base_type::registerInput(_a);
             base_type::registerInput(_b);
             base_type::registerOutput(&out);
+            base_type::_block_schedulable = true;
             base_type::_block_init = true;
         }
 
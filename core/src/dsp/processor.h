@@ -51,6 +51,7 @@ namespace dsp {
             _in = in;
             registerInput(_in);
             registerOutput(&out);
+            _block_schedulable = true;
             _block_init = true;
         }
 
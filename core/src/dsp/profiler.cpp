@@ -0,0 +1,167 @@
+#include "profiler.h"
+#include "block.h"
+#include <mutex>
+#include <map>
+#include <typeinfo>
+#include <json.hpp>
+#if defined(__GNUC__) || defined(__clang__)
+#include <cxxabi.h>
+#endif
+
+using nlohmann::json;
+
+namespace dsp::profiler {
+    struct Entry {
+        std::string name;
+        BlockStats* stats;
+
+        // Counters at the last update
+        uint64_t calls = 0;
+        uint64_t samples = 0;
+        uint64_t runTime = 0;
+        uint64_t inputWaitTime = 0;
+        uint64_t outputWaitTime = 0;
+        uint64_t occupancySum = 0;
+        uint64_t occupancyCount = 0;
+        std::chrono::steady_clock::time_point lastUpdate;
+
+        BlockReport report;
+    };
+
+    std::atomic<bool> enabled = false;
+    thread_local BlockStats* currentStats = NULL;
+
+    std::mutex entriesMtx;
+    std::map<block*, Entry> entries;
+    std::chrono::steady_clock::time_point lastReport;
+
+    std::string demangle(const char* name) {
+#if defined(__GNUC__) || defined(__clang__)
+        int status;
+        char* dem = abi::__cxa_demangle(name, NULL, NULL, &status);
+        if (!status && dem) {
+            std::string str = dem;
+            free(dem);
+            return str;
+        }
+#endif
+        return name;
+    }
+
+    void setEnabled(bool enable) {
+        enabled = enable;
+    }
+
+    bool isEnabled() {
+        return enabled;
+    }
+
+    void registerBlock(block* blk, BlockStats* stats) {
+        std::lock_guard<std::mutex> lck(entriesMtx);
+        Entry& e = entries[blk];
+        e.name = demangle(typeid(*blk).name());
+        e.stats = stats;
+        e.calls = stats->calls;
+        e.samples = stats->samples;
+        e.runTime = stats->runTime;
+        e.inputWaitTime = stats->inputWaitTime;
+        e.outputWaitTime = stats->outputWaitTime;
+        e.occupancySum = stats->occupancySum;
+        e.occupancyCount = stats->occupancyCount;
+        e.lastUpdate = std::chrono::steady_clock::now();
+        e.report = {};
+        e.report.id = blk;
+        e.report.name = e.name;
+    }
+
+    void unregisterBlock(block* blk) {
+        std::lock_guard<std::mutex> lck(entriesMtx);
+        entries.erase(blk);
+    }
+
+    BlockStats* getCurrentStats() {
+        return currentStats;
+    }
+
+    void setCurrentStats(BlockStats* stats) {
+        currentStats = stats;
+    }
+
+    void update(Entry& e, std::chrono::steady_clock::time_point now) {
+        // Compute the difference since the last update
+        double dt = std::chrono::duration_cast<std::chrono::nanoseconds>(now - e.lastUpdate).count();
+        uint64_t calls = e.stats->calls;
+        uint64_t samples = e.stats->samples;
+        uint64_t runTime = e.stats->runTime;
+        uint64_t inputWaitTime = e.stats->inputWaitTime;
+        uint64_t outputWaitTime = e.stats->outputWaitTime;
+        uint64_t occupancySum = e.stats->occupancySum;
+        uint64_t occupancyCount = e.stats->occupancyCount;
+        double dCalls = calls - e.calls;
+        double dInWait = inputWaitTime - e.inputWaitTime;
+        double dOutWait = outputWaitTime - e.outputWaitTime;
+        double dProc = std::max<double>(0.0, (double)(runTime - e.runTime) - dInWait - dOutWait);
+        double dOccCount = occupancyCount - e.occupancyCount;
+
+        // Update report
+        if (dt > 0) {
+            e.report.callRate = dCalls * 1e9 / dt;
+            e.report.sampleRate = (double)(samples - e.samples) * 1e9 / dt;
+            e.report.procTimePerCall = dCalls ? (dProc / dCalls) / 1e3 : 0.0;
+            e.report.cpuLoad = dProc / dt;
+            e.report.inputWait = dInWait / dt;
+            e.report.outputWait = dOutWait / dt;
+            e.report.occupancy = dOccCount ? ((double)(occupancySum - e.occupancySum) / dOccCount) / 1000.0 : 0.0;
+        }
+
+        // Save counters
+        e.calls = calls;
+        e.samples = samples;
+        e.runTime = runTime;
+        e.inputWaitTime = inputWaitTime;
+        e.outputWaitTime = outputWaitTime;
+        e.occupancySum = occupancySum;
+        e.occupancyCount = occupancyCount;
+        e.lastUpdate = now;
+    }
+
+    std::vector<BlockReport> getReport() {
+        std::lock_guard<std::mutex> lck(entriesMtx);
+
+        // Only update about once a second to get meaningful averages
+        auto now = std::chrono::steady_clock::now();
+        if (now - lastReport >= std::chrono::seconds(1)) {
+            for (auto& [blk, e] : entries) {
+                update(e, now);
+            }
+            lastReport = now;
+        }
+
+        std::vector<BlockReport> reports;
+        for (auto& [blk, e] : entries) {
+            reports.push_back(e.report);
+        }
+        return reports;
+    }
+
+    std::string dumpJSON() {
+        json blocks = json::array();
+        for (auto& r : getReport()) {
+            json b;
+            b["id"] = (uintptr_t)r.id;
+            b["name"] = r.name;
+            b["callRate"] = r.callRate;
+            b["sampleRate"] = r.sampleRate;
+            b["procTimePerCall"] = r.procTimePerCall;
+            b["cpuLoad"] = r.cpuLoad;
+            b["inputWait"] = r.inputWait;
+            b["outputWait"] = r.outputWait;
+            b["occupancy"] = r.occupancy;
+            blocks.push_back(b);
+        }
+        json doc;
+        doc["enabled"] = isEnabled();
+        doc["blocks"] = blocks;
+        return doc.dump(4);
+    }
+}
@@ -0,0 +1,99 @@
+#pragma once
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace dsp {
+    class block;
+
+    // Low overhead instrumentation of the blocks' worker loops and stream handoffs.
+    // When disabled, the only cost is one check per run(), read() and swap().
+    namespace profiler {
+        // Counters accumulated by a block while it runs, all times are in nanoseconds
+        struct BlockStats {
+            std::atomic<uint64_t> calls = 0;
+            std::atomic<uint64_t> samples = 0;
+            std::atomic<uint64_t> runTime = 0;
+            std::atomic<uint64_t> inputWaitTime = 0;
+            std::atomic<uint64_t> outputWaitTime = 0;
+            std::atomic<uint64_t> occupancySum = 0;
+            std::atomic<uint64_t> occupancyCount = 0;
+        };
+
+        struct BlockReport {
+            const block* id;
+            std::string name;
+            double callRate;        // Calls to run() per second
+            double sampleRate;      // Samples per second as returned by run()
+            double procTimePerCall; // Microseconds spent processing per call, waits excluded
+            double cpuLoad;         // Fraction of the time spent processing
+            double inputWait;       // Fraction of the time spent waiting for input data
+            double outputWait;      // Fraction of the time spent waiting for the outputs to be read
+            double occupancy;       // Average fill ratio of the input streams when read
+        };
+
+        enum WaitType {
+            WAIT_INPUT,
+            WAIT_OUTPUT
+        };
+
+        void setEnabled(bool enabled);
+        bool isEnabled();
+
+        void registerBlock(block* blk, BlockStats* stats);
+        void unregisterBlock(block* blk);
+
+        // Statistics of the block running on the calling thread, NULL if none
+        BlockStats* getCurrentStats();
+        void setCurrentStats(BlockStats* stats);
+
+        /**
+         * Get the statistics of all running blocks, averaged over about the last second.
+         * @return One report per running block.
+         */
+        std::vector<BlockReport> getReport();
+
+        /**
+         * Get the statistics of all running blocks as a JSON document.
+         * @return JSON string.
+         */
+        std::string dumpJSON();
+
+        // Measures the time spent blocked in a stream for the block running on the calling thread
+        class WaitTimer {
+        public:
+            WaitTimer(WaitType type) {
+                if (!isEnabled()) { return; }
+                stats = getCurrentStats();
+                if (!stats) { return; }
+                _type = type;
+                start = std::chrono::steady_clock::now();
+            }
+
+            ~WaitTimer() {
+                if (!stats) { return; }
+                uint64_t dt = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+                if (_type == WAIT_INPUT) {
+                    stats->inputWaitTime += dt;
+                }
+                else {
+                    stats->outputWaitTime += dt;
+                }
+            }
+
+            // Record how full the stream was, in thousandths, before waiting
+            inline void occupancy(int filled) {
+                if (!stats) { return; }
+                stats->occupancySum += filled;
+                stats->occupancyCount++;
+            }
+
+        private:
+            BlockStats* stats = NULL;
+            WaitType _type;
+            std::chrono::steady_clock::time_point start;
+        };
+    }
+}
@@ -8,7 +8,12 @@ namespace dsp::routing {
     public:
         Splitter() {}
 
-        Splitter(stream<T>* in) { base_type::init(in); }
+        Splitter(stream<T>* in) { init(in); }
+
+        void init(stream<T>* in) {
+            base_type::init(in);
+            base_type::_block_schedulable = true;
+        }
 
         void bindStream(stream<T>* stream) {
             assert(base_type::_block_init);
@@ -47,6 +52,16 @@ namespace dsp::routing {
             int count = base_type::_in->read();
             if (count < 0) { return -1; }
 
+            // If any output accepts shared buffers, hand out references to the input buffer instead of copying it
+            bool shared = false;
+            for (const auto& stream : streams) {
+                if (stream->acceptsShared()) {
+                    shared = true;
+                    break;
+                }
+            }
+            if (shared) { return runShared(count); }
+
             for (const auto& stream : streams) {
                 memcpy(stream->writeBuf, base_type::_in->readBuf, count * sizeof(T));
                 if (!stream->swap(count)) {
@@ -61,7 +76,54 @@ namespace dsp::routing {
         }
 
     protected:
+        // Buffers taken from the input stream, recycled once every reader has flushed them
+        struct BufferPool {
+            ~BufferPool() {
+                for (auto& buf : bufs) { buffer::free(buf); }
+            }
+
+            T* get() {
+                std::lock_guard<std::mutex> lck(mtx);
+                if (bufs.empty()) { return buffer::alloc<T>(size); }
+                T* buf = bufs.back();
+                bufs.pop_back();
+                return buf;
+            }
+
+            void put(T* buf) {
+                std::lock_guard<std::mutex> lck(mtx);
+                bufs.push_back(buf);
+            }
+
+            int size;
+            std::mutex mtx;
+            std::vector<T*> bufs;
+        };
+
+        int runShared(int count) {
+            // Take the input buffer unless it's already shared, in which case the reference is simply passed on
+            std::shared_ptr<T> buf = base_type::_in->getSharedReadBuf();
+            if (!buf) {
+                // Buffers are swapped with the input stream so they must have the same size
+                if (!pool || pool->size != base_type::_in->getBufferSize()) {
+                    pool = std::make_shared<BufferPool>();
+                    pool->size = base_type::_in->getBufferSize();
+                }
+                std::shared_ptr<BufferPool> p = pool;
+                buf = std::shared_ptr<T>(base_type::_in->exchangeReadBuf(p->get()), [p](T* b) { p->put(b); });
+            }
+            base_type::_in->flush();
+
+            // Outputs that don't accept shared buffers get a copy
+            for (const auto& stream : streams) {
+                if (!stream->swapShared(buf, count)) { return -1; }
+            }
+
+            return count;
+        }
+
         std::vector<stream<T>*> streams;
+        std::shared_ptr<BufferPool> pool;
 
     };
 }
\ No newline at end of file
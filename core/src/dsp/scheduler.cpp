@@ -0,0 +1,233 @@
+#include "scheduler.h"
+#include "block.h"
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
+#include <unordered_map>
+#include <utils/flog.h>
+
+namespace dsp::scheduler {
+    enum TaskState {
+        TASK_IDLE,
+        TASK_QUEUED,
+        TASK_RUNNING,
+        TASK_RUNNING_NOTIFIED
+    };
+
+    struct Task {
+        block* blk;
+        std::atomic<int> state = TASK_IDLE;
+        std::atomic<bool> finished = false;
+        std::atomic<bool> removing = false;
+    };
+
+    struct Worker {
+        std::thread thread;
+        std::mutex queueMtx;
+        std::deque<Task*> queue;
+    };
+
+    std::vector<Worker*> workers;
+    std::atomic<bool> running = false;
+    std::atomic<int> nextWorker = 0;
+    thread_local int currentWorker = -1;
+
+    std::shared_mutex tasksMtx;
+    std::unordered_map<block*, Task*> tasks;
+
+    std::mutex idleMtx;
+    std::condition_variable idleCV;
+    std::atomic<int> pending = 0;
+    std::atomic<int> sleeping = 0;
+
+    std::mutex removeMtx;
+    std::condition_variable removeCV;
+
+    void push(Task* task) {
+        // Queue on the current worker if called from one, otherwise distribute round-robin
+        int id = (currentWorker >= 0) ? currentWorker : (nextWorker++ % (int)workers.size());
+        {
+            std::lock_guard<std::mutex> lck(workers[id]->queueMtx);
+            workers[id]->queue.push_back(task);
+        }
+        pending++;
+
+        // Wake up a worker only if one is sleeping
+        if (sleeping) {
+            { std::lock_guard<std::mutex> lck(idleMtx); }
+            idleCV.notify_one();
+        }
+    }
+
+    Task* pop(int id) {
+        // Take the oldest task from our own queue first
+        int count = workers.size();
+        for (int i = 0; i < count; i++) {
+            Worker* w = workers[(id + i) % count];
+            std::lock_guard<std::mutex> lck(w->queueMtx);
+            if (w->queue.empty()) { continue; }
+
+            // Steal from the back of other workers' queues
+            Task* task;
+            if (!i) {
+                task = w->queue.front();
+                w->queue.pop_front();
+            }
+            else {
+                task = w->queue.back();
+                w->queue.pop_back();
+            }
+            pending--;
+            return task;
+        }
+        return NULL;
+    }
+
+    void execute(Task* task) {
+        task->state = TASK_RUNNING;
+
+        // Run the block once if it can do so without blocking
+        if (!task->finished && task->blk->isReady()) {
+            if (task->blk->profiledRun() < 0) { task->finished = true; }
+        }
+
+        // Go idle unless there is more work or the task was notified while running
+        bool again = !task->finished && task->blk->isReady();
+        bool removing = task->removing;
+        int expected = TASK_RUNNING;
+        if (!again && task->state.compare_exchange_strong(expected, TASK_IDLE)) {
+            // The task must not be accessed anymore since it can now be deleted by remove()
+            if (removing) {
+                { std::lock_guard<std::mutex> lck(removeMtx); }
+                removeCV.notify_all();
+            }
+            return;
+        }
+        task->state = TASK_QUEUED;
+        push(task);
+    }
+
+    void worker(int id) {
+        currentWorker = id;
+        while (running) {
+            // Get a task or sleep until one is available
+            Task* task = pop(id);
+            if (!task) {
+                std::unique_lock<std::mutex> lck(idleMtx);
+                sleeping++;
+                idleCV.wait(lck, []() { return pending > 0 || !running; });
+                sleeping--;
+                continue;
+            }
+
+            execute(task);
+        }
+    }
+
+    void start(int workerCount) {
+        if (running) { return; }
+        assert(workerCount > 0);
+        flog::info("Starting DSP scheduler with {0} worker threads", workerCount);
+
+        running = true;
+        for (int i = 0; i < workerCount; i++) {
+            workers.push_back(new Worker);
+        }
+        for (int i = 0; i < workerCount; i++) {
+            workers[i]->thread = std::thread(worker, i);
+        }
+    }
+
+    void stop() {
+        if (!running) { return; }
+
+        // Wake up and join all workers
+        {
+            std::lock_guard<std::mutex> lck(idleMtx);
+            running = false;
+        }
+        idleCV.notify_all();
+        for (auto& w : workers) {
+            if (w->thread.joinable()) { w->thread.join(); }
+        }
+
+        // Free the workers
+        for (auto& w : workers) { delete w; }
+        workers.clear();
+        pending = 0;
+    }
+
+    bool isRunning() {
+        return running;
+    }
+
+    int getWorkerCount() {
+        return workers.size();
+    }
+
+    void add(block* blk) {
+        Task* task = new Task;
+        task->blk = blk;
+        {
+            std::unique_lock<std::shared_mutex> lck(tasksMtx);
+            tasks[blk] = task;
+        }
+
+        // Run it once in case data is already waiting
+        notify(blk);
+    }
+
+    void remove(block* blk) {
+        Task* task;
+        {
+            std::shared_lock<std::shared_mutex> lck(tasksMtx);
+            auto it = tasks.find(blk);
+            if (it == tasks.end()) { return; }
+            task = it->second;
+        }
+
+        // Wait for the task to be neither queued nor running, then remove it while no notification can queue it again
+        task->removing = true;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lck(removeMtx);
+                removeCV.wait_for(lck, std::chrono::milliseconds(10), [=]() { return task->state == TASK_IDLE; });
+            }
+            std::unique_lock<std::shared_mutex> lck(tasksMtx);
+            if (task->state != TASK_IDLE) { continue; }
+            tasks.erase(blk);
+            break;
+        }
+        delete task;
+    }
+
+    void notify(block* blk) {
+        std::shared_lock<std::shared_mutex> lck(tasksMtx);
+        auto it = tasks.find(blk);
+        if (it == tasks.end()) { return; }
+        Task* task = it->second;
+        if (task->finished) { return; }
+
+        int state = task->state;
+        while (true) {
+            if (state == TASK_IDLE) {
+                // Queue the task
+                if (task->state.compare_exchange_weak(state, TASK_QUEUED)) {
+                    push(task);
+                    return;
+                }
+            }
+            else if (state == TASK_RUNNING) {
+                // Have the worker check the task again once done
+                if (task->state.compare_exchange_weak(state, TASK_RUNNING_NOTIFIED)) { return; }
+            }
+            else {
+                // Already queued or going to be checked again
+                return;
+            }
+        }
+    }
+}
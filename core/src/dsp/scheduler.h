@@ -0,0 +1,28 @@
+#pragma once
+
+namespace dsp {
+    class block;
+
+    // Optional fixed-size work-stealing pool running blocks as tasks instead of one thread per block.
+    // A task is woken whenever one of its streams changes state and is only run once all of
+    // its inputs have data and all of its outputs can accept a new buffer, so run() never blocks.
+    namespace scheduler {
+        /**
+         * Start the worker pool. Only blocks started after this call will be scheduled on it.
+         * @param workerCount Number of worker threads.
+         */
+        void start(int workerCount);
+
+        /**
+         * Stop the worker pool. All scheduled blocks must be stopped first.
+         */
+        void stop();
+
+        bool isRunning();
+        int getWorkerCount();
+
+        void add(block* blk);
+        void remove(block* blk);
+        void notify(block* blk);
+    }
+}
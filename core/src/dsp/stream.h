@@ -1,9 +1,16 @@
 #pragma once
+#include <assert.h>
 #include <string.h>
+#include <stdint.h>
+#include <atomic>
+#include <vector>
+#include <memory>
 #include <mutex>
 #include <condition_variable>
 #include <volk/volk.h>
 #include "buffer/buffer.h"
+#include "scheduler.h"
+#include "profiler.h"
 
 // 1MSample buffer
 #define STREAM_BUFFER_SIZE 1000000
@@ -19,14 +26,35 @@ namespace dsp {
         virtual void clearWriteStop() {}
         virtual void stopReader() {}
         virtual void clearReadStop() {}
+
+        // Check if read() or swap() would return without blocking
+        virtual bool readable() { return true; }
+        virtual bool writable() { return true; }
+
+        // Blocks running on the scheduler get notified when the stream changes state
+        void setReaderBlock(block* blk) { readerBlock = blk; }
+        void setWriterBlock(block* blk) { writerBlock = blk; }
+
+    protected:
+        inline void notifyReader() {
+            block* blk = readerBlock;
+            if (blk) { scheduler::notify(blk); }
+        }
+
+        inline void notifyWriter() {
+            block* blk = writerBlock;
+            if (blk) { scheduler::notify(blk); }
+        }
+
+        std::atomic<block*> readerBlock = NULL;
+        std::atomic<block*> writerBlock = NULL;
     };
 
     template <class T>
     class stream : public untyped_stream {
     public:
         stream() {
-            writeBuf = buffer::alloc<T>(STREAM_BUFFER_SIZE);
-            readBuf = buffer::alloc<T>(STREAM_BUFFER_SIZE);
+            allocBuffers();
         }
 
         virtual ~stream() {
@@ -34,13 +62,42 @@ namespace dsp {
         }
 
         virtual void setBufferSize(int samples) {
-            buffer::free(writeBuf);
-            buffer::free(readBuf);
-            writeBuf = buffer::alloc<T>(samples);
-            readBuf = buffer::alloc<T>(samples);
+            freeBuffers();
+            bufferSize = samples;
+            allocBuffers();
+        }
+
+        /**
+         * Switch between the double-buffer handoff and a lock-free single-producer/single-consumer ring.
+         * In ring mode the writer can run up to `slots - 1` blocks ahead of the reader and threads only
+         * sleep when the ring is full or empty. A slot count of 0 restores the double-buffer handoff.
+         * Must only be called while neither the reader nor the writer are running.
+         * @param slots Number of pre-allocated buffers in the ring (0 or at least 2).
+         */
+        virtual void setRingSize(int slots) {
+            assert(slots == 0 || slots >= 2);
+            freeBuffers();
+            ringSlots = slots;
+            allocBuffers();
         }
 
+        inline int getRingSize() { return ringSlots; }
+
+        inline int getBufferSize() { return bufferSize; }
+
+        /**
+         * Allow the writer to hand over read-only references to buffers shared with other streams using swapShared()
+         * instead of copying the data into writeBuf. Only enable if the reader never modifies readBuf.
+         * @param accept True to receive references to shared buffers, false to always receive a copy.
+         */
+        void setAcceptShared(bool accept) { _acceptShared = accept; }
+
+        inline bool acceptsShared() { return _acceptShared; }
+
         virtual inline bool swap(int size) {
+            profiler::WaitTimer timer(profiler::WAIT_OUTPUT);
+            if (ringSlots) { return ringSwap(size); }
+
             {
                 // Wait to either swap or stop
                 std::unique_lock<std::mutex> lck(swapMtx);
@@ -52,8 +109,50 @@ namespace dsp {
                 // Swap buffers
                 dataSize = size;
                 T* temp = writeBuf;
-                writeBuf = readBuf;
+                writeBuf = ownedReadBuf;
                 readBuf = temp;
+                ownedReadBuf = temp;
+                canSwap = false;
+            }
+
+            // Notify reader that some data is ready
+            {
+                std::lock_guard<std::mutex> lck(rdyMtx);
+                dataReady = true;
+            }
+            rdyCV.notify_all();
+            notifyReader();
+
+            return true;
+        }
+
+        /**
+         * Same as swap() but the reader gets a reference to a shared buffer instead of writeBuf. The buffer is released
+         * once the reader flushes it. If the stream doesn't accept shared buffers, the data is copied to writeBuf instead.
+         * @param buf Shared buffer containing the data.
+         * @param size Number of samples in the buffer.
+         * @return False if the writer was stopped, true otherwise.
+         */
+        inline bool swapShared(const std::shared_ptr<T>& buf, int size) {
+            if (!_acceptShared) {
+                memcpy(writeBuf, buf.get(), size * sizeof(T));
+                return swap(size);
+            }
+            profiler::WaitTimer timer(profiler::WAIT_OUTPUT);
+            if (ringSlots) { return ringSwap(size, &buf); }
+
+            {
+                // Wait to either swap or stop
+                std::unique_lock<std::mutex> lck(swapMtx);
+                swapCV.wait(lck, [this] { return (canSwap || writerStop); });
+
+                // If writer was stopped, abandon operation
+                if (writerStop) { return false; }
+
+                // Lend the shared buffer to the reader, its own buffer is restored on flush
+                dataSize = size;
+                sharedReadBuf = buf;
+                readBuf = buf.get();
                 canSwap = false;
             }
 
@@ -63,25 +162,65 @@ namespace dsp {
                 dataReady = true;
             }
             rdyCV.notify_all();
+            notifyReader();
 
             return true;
         }
 
+        /**
+         * Get a reference to the buffer being read if it is shared. Must only be called by the reader between read() and flush().
+         * @return Reference to the shared buffer or an empty pointer if the read buffer belongs to the stream.
+         */
+        inline std::shared_ptr<T> getSharedReadBuf() {
+            if (ringSlots) { return ringShared[ringReadIdx.load(std::memory_order_relaxed) % ringSlots]; }
+            return sharedReadBuf;
+        }
+
+        /**
+         * Replace the buffer being read by another one of the same size and take ownership of it. Must only be called
+         * by the reader between read() and flush() and only if the read buffer isn't shared.
+         * @param buf Buffer allocated with buffer::alloc() of getBufferSize() samples that the stream takes ownership of.
+         * @return Buffer that was being read, now owned by the caller.
+         */
+        inline T* exchangeReadBuf(T* buf) {
+            T* old = readBuf;
+            if (ringSlots) {
+                ringBufs[ringReadIdx.load(std::memory_order_relaxed) % ringSlots] = buf;
+            }
+            else {
+                ownedReadBuf = buf;
+            }
+            readBuf = buf;
+            return old;
+        }
+
         virtual inline int read() {
+            profiler::WaitTimer timer(profiler::WAIT_INPUT);
+            if (ringSlots) { return ringRead(timer); }
+
             // Wait for data to be ready or to be stopped
             std::unique_lock<std::mutex> lck(rdyMtx);
+            timer.occupancy(dataReady ? 1000 : 0);
             rdyCV.wait(lck, [this] { return (dataReady || readerStop); });
 
             return (readerStop ? -1 : dataSize);
         }
 
         virtual inline void flush() {
+            if (ringSlots) { ringFlush(); return; }
+
             // Clear data ready
             {
                 std::lock_guard<std::mutex> lck(rdyMtx);
                 dataReady = false;
             }
 
+            // Release the shared buffer if one was lent
+            if (sharedReadBuf) {
+                sharedReadBuf.reset();
+                readBuf = ownedReadBuf;
+            }
+
             // Notify writer that buffers can be swapped
             {
                 std::lock_guard<std::mutex> lck(swapMtx);
@@ -89,6 +228,7 @@ namespace dsp {
             }
 
             swapCV.notify_all();
+            notifyWriter();
         }
 
         virtual void stopWriter() {
@@ -97,6 +237,7 @@ namespace dsp {
                 writerStop = true;
             }
             swapCV.notify_all();
+            notifyWriter();
         }
 
         virtual void clearWriteStop() {
@@ -109,23 +250,137 @@ namespace dsp {
                 readerStop = true;
             }
             rdyCV.notify_all();
+            notifyReader();
         }
 
         virtual void clearReadStop() {
             readerStop = false;
         }
 
+        virtual bool readable() {
+            if (ringSlots) { return (ringReadIdx.load() != ringWriteIdx.load()) || readerStop; }
+            std::lock_guard<std::mutex> lck(rdyMtx);
+            return dataReady || readerStop;
+        }
+
+        virtual bool writable() {
+            if (ringSlots) { return (ringWriteIdx.load() + 1 - ringReadIdx.load() < (uint64_t)ringSlots) || writerStop; }
+            std::lock_guard<std::mutex> lck(swapMtx);
+            return canSwap || writerStop;
+        }
+
         void free() {
-            if (writeBuf) { buffer::free(writeBuf); }
-            if (readBuf) { buffer::free(readBuf); }
+            freeBuffers();
+        }
+
+        T* writeBuf = NULL;
+        T* readBuf = NULL;
+
+    private:
+        void allocBuffers() {
+            if (!ringSlots) {
+                writeBuf = buffer::alloc<T>(bufferSize);
+                readBuf = buffer::alloc<T>(bufferSize);
+                ownedReadBuf = readBuf;
+                return;
+            }
+
+            // Allocate all slots and reset the ring to empty
+            ringBufs.resize(ringSlots);
+            ringSizes.resize(ringSlots);
+            ringShared.resize(ringSlots);
+            for (int i = 0; i < ringSlots; i++) {
+                ringBufs[i] = buffer::alloc<T>(bufferSize);
+                ringSizes[i] = 0;
+            }
+            ringWriteIdx = 0;
+            ringReadIdx = 0;
+            writeBuf = ringBufs[0];
+            readBuf = ringBufs[0];
+        }
+
+        void freeBuffers() {
+            if (ringSlots) {
+                for (auto& buf : ringBufs) {
+                    if (buf) { buffer::free(buf); }
+                }
+                ringBufs.clear();
+                ringSizes.clear();
+                ringShared.clear();
+            }
+            else {
+                if (writeBuf) { buffer::free(writeBuf); }
+                if (ownedReadBuf) { buffer::free(ownedReadBuf); }
+                sharedReadBuf.reset();
+            }
             writeBuf = NULL;
             readBuf = NULL;
+            ownedReadBuf = NULL;
         }
 
-        T* writeBuf;
-        T* readBuf;
+        inline bool ringSwap(int size, const std::shared_ptr<T>* shared = NULL) {
+            // If writer was stopped, abandon operation
+            if (writerStop) { return false; }
+
+            // Make sure the slot following the one being published is free before publishing anything, sleeping only if
+            // the ring is full. If the writer is stopped meanwhile nothing was published and it keeps owning its slot.
+            uint64_t widx = ringWriteIdx.load(std::memory_order_relaxed);
+            if (widx + 1 - ringReadIdx.load() >= (uint64_t)ringSlots) {
+                std::unique_lock<std::mutex> lck(swapMtx);
+                writerWaiting = true;
+                swapCV.wait(lck, [this, widx] { return (widx + 1 - ringReadIdx.load() < (uint64_t)ringSlots) || writerStop; });
+                writerWaiting = false;
+                if (writerStop) { return false; }
+            }
+
+            // Publish the slot currently owned by the writer, optionally lending it a shared buffer instead
+            ringSizes[widx % ringSlots] = size;
+            if (shared) { ringShared[widx % ringSlots] = *shared; }
+            writeBuf = ringBufs[(widx + 1) % ringSlots];
+            ringWriteIdx.store(widx + 1);
+
+            // Only wake up the reader if it went to sleep on an empty ring
+            if (readerWaiting) {
+                { std::lock_guard<std::mutex> lck(rdyMtx); }
+                rdyCV.notify_all();
+            }
+            notifyReader();
+
+            return true;
+        }
+
+        inline int ringRead(profiler::WaitTimer& timer) {
+            // Sleep only if the ring is empty
+            uint64_t ridx = ringReadIdx.load(std::memory_order_relaxed);
+            timer.occupancy((int)(((ringWriteIdx.load() - ridx) * 1000) / ringSlots));
+            if (ridx == ringWriteIdx.load() && !readerStop) {
+                std::unique_lock<std::mutex> lck(rdyMtx);
+                readerWaiting = true;
+                rdyCV.wait(lck, [this, ridx] { return (ridx != ringWriteIdx.load()) || readerStop; });
+                readerWaiting = false;
+            }
+            if (readerStop) { return -1; }
+
+            int slot = ridx % ringSlots;
+            readBuf = ringShared[slot] ? ringShared[slot].get() : ringBufs[slot];
+            return ringSizes[slot];
+        }
+
+        inline void ringFlush() {
+            // Nothing to release if no data was published
+            uint64_t ridx = ringReadIdx.load(std::memory_order_relaxed);
+            if (ridx == ringWriteIdx.load()) { return; }
+            ringShared[ridx % ringSlots].reset();
+            ringReadIdx.store(ridx + 1);
+
+            // Only wake up the writer if it went to sleep on a full ring
+            if (writerWaiting) {
+                { std::lock_guard<std::mutex> lck(swapMtx); }
+                swapCV.notify_all();
+            }
+            notifyWriter();
+        }
 
-    private:
         std::mutex swapMtx;
         std::condition_variable swapCV;
         bool canSwap = true;
@@ -134,9 +389,25 @@ namespace dsp {
         std::condition_variable rdyCV;
         bool dataReady = false;
 
-        bool readerStop = false;
-        bool writerStop = false;
+        std::atomic<bool> readerStop = false;
+        std::atomic<bool> writerStop = false;
 
         int dataSize = 0;
+        int bufferSize = STREAM_BUFFER_SIZE;
+
+        // Shared buffers
+        bool _acceptShared = false;
+        T* ownedReadBuf = NULL;
+        std::shared_ptr<T> sharedReadBuf;
+
+        // Ring mode
+        int ringSlots = 0;
+        std::vector<T*> ringBufs;
+        std::vector<int> ringSizes;
+        std::vector<std::shared_ptr<T>> ringShared;
+        std::atomic<uint64_t> ringWriteIdx = 0;
+        std::atomic<uint64_t> ringReadIdx = 0;
+        std::atomic<bool> readerWaiting = false;
+        std::atomic<bool> writerWaiting = false;
     };
-}
\ No newline at end of file
+}
@@ -0,0 +1,68 @@
+#include <gui/dialogs/dsp_profiler.h>
+#include <imgui.h>
+#include <gui/style.h>
+#include <dsp/profiler.h>
+
+namespace dsp_profiler {
+    void show(bool* open) {
+        ImGui::SetNextWindowSize(ImVec2(900.0f * style::uiScale, 400.0f * style::uiScale), ImGuiCond_FirstUseEver);
+        if (!ImGui::Begin("DSP Profiler", open)) {
+            ImGui::End();
+            return;
+        }
+
+        auto report = dsp::profiler::getReport();
+        ImGui::Text("Running blocks: %d", (int)report.size());
+
+        if (ImGui::BeginTable("DSP Profiler Table", 8, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_ScrollY | ImGuiTableFlags_Resizable)) {
+            ImGui::TableSetupColumn("Block");
+            ImGui::TableSetupColumn("MS/s");
+            ImGui::TableSetupColumn("Calls/s");
+            ImGui::TableSetupColumn("us/call");
+            ImGui::TableSetupColumn("CPU");
+            ImGui::TableSetupColumn("In wait");
+            ImGui::TableSetupColumn("Out wait");
+            ImGui::TableSetupColumn("Queue");
+            ImGui::TableSetupScrollFreeze(1, 1);
+            ImGui::TableHeadersRow();
+
+            for (const auto& r : report) {
+                ImGui::TableNextRow();
+
+                ImGui::TableSetColumnIndex(0);
+                ImGui::Text("%s (%p)", r.name.c_str(), r.id);
+
+                ImGui::TableSetColumnIndex(1);
+                ImGui::Text("%.3f", r.sampleRate / 1e6);
+
+                ImGui::TableSetColumnIndex(2);
+                ImGui::Text("%.1f", r.callRate);
+
+                ImGui::TableSetColumnIndex(3);
+                ImGui::Text("%.1f", r.procTimePerCall);
+
+                // Highlight blocks that are close to saturating their thread
+                ImGui::TableSetColumnIndex(4);
+                if (r.cpuLoad > 0.8) {
+                    ImGui::TextColored(ImVec4(1.0f, 0.3f, 0.3f, 1.0f), "%.1f%%", r.cpuLoad * 100.0);
+                }
+                else {
+                    ImGui::Text("%.1f%%", r.cpuLoad * 100.0);
+                }
+
+                ImGui::TableSetColumnIndex(5);
+                ImGui::Text("%.1f%%", r.inputWait * 100.0);
+
+                ImGui::TableSetColumnIndex(6);
+                ImGui::Text("%.1f%%", r.outputWait * 100.0);
+
+                ImGui::TableSetColumnIndex(7);
+                ImGui::Text("%.0f%%", r.occupancy * 100.0);
+            }
+
+            ImGui::EndTable();
+        }
+
+        ImGui::End();
+    }
+}
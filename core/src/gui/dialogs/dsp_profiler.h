@@ -0,0 +1,5 @@
+#pragma once
+
+namespace dsp_profiler {
+    void show(bool* open);
+}
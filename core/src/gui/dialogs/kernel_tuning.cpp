@@ -0,0 +1,95 @@
+#include <gui/dialogs/kernel_tuning.h>
+#include <imgui.h>
+#include <gui/style.h>
+#include <dsp/autotune.h>
+
+namespace kernel_tuning {
+    void show(bool* open) {
+        ImGui::SetNextWindowSize(ImVec2(900.0f * style::uiScale, 500.0f * style::uiScale), ImGuiCond_FirstUseEver);
+        if (!ImGui::Begin("Kernel Tuning", open)) {
+            ImGui::End();
+            return;
+        }
+
+        ImGui::Text("VOLK machine: %s", dsp::autotune::getMachine().c_str());
+        if (dsp::autotune::isVolkConfigured()) {
+            ImGui::TextUnformatted("VOLK is using the tuned implementations");
+        }
+        else {
+            ImGui::TextColored(ImVec4(1.0f, 1.0f, 0.3f, 1.0f), "VOLK is using its default implementations");
+        }
+        ImGui::Text("FIR filters use FFT convolution from %d taps", dsp::autotune::getFFTMinTaps());
+
+        bool running = dsp::autotune::isRunning();
+        if (running) { style::beginDisabled(); }
+        if (ImGui::Button(running ? "Tuning..." : "Run tuning")) {
+            dsp::autotune::runAsync();
+        }
+        if (running) { style::endDisabled(); }
+        if (!running && dsp::autotune::restartNeeded()) {
+            ImGui::SameLine();
+            ImGui::TextColored(ImVec4(1.0f, 1.0f, 0.3f, 1.0f), "Restart to use the new VOLK implementations");
+        }
+
+        // One row per kernel with the score of every implementation, the winners are highlighted
+        auto kernels = dsp::autotune::getKernelResults();
+        if (ImGui::BeginTable("Kernel Tuning Table", 4, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_ScrollY | ImGuiTableFlags_Resizable, ImVec2(0, 300.0f * style::uiScale))) {
+            ImGui::TableSetupColumn("Kernel");
+            ImGui::TableSetupColumn("Sizes");
+            ImGui::TableSetupColumn("Implementations (ns/sample)");
+            ImGui::TableSetupColumn("Selected (aligned/unaligned)");
+            ImGui::TableSetupScrollFreeze(1, 1);
+            ImGui::TableHeadersRow();
+
+            for (const auto& k : kernels) {
+                ImGui::TableNextRow();
+
+                ImGui::TableSetColumnIndex(0);
+                ImGui::TextUnformatted(k.kernel.c_str());
+
+                ImGui::TableSetColumnIndex(1);
+                std::string sizes;
+                for (int s : k.sizes) { sizes += (sizes.empty() ? "" : ", ") + std::to_string(s); }
+                ImGui::TextUnformatted(sizes.c_str());
+
+                ImGui::TableSetColumnIndex(2);
+                for (const auto& c : k.candidates) {
+                    bool winner = (c.name == k.alignedWinner || c.name == k.unalignedWinner);
+                    if (winner) {
+                        ImGui::TextColored(ImVec4(0.3f, 1.0f, 0.3f, 1.0f), "%s: %.3f", c.name.c_str(), c.nsPerSample);
+                    }
+                    else {
+                        ImGui::Text("%s: %.3f", c.name.c_str(), c.nsPerSample);
+                    }
+                }
+
+                ImGui::TableSetColumnIndex(3);
+                ImGui::Text("%s / %s", k.alignedWinner.c_str(), k.unalignedWinner.c_str());
+            }
+
+            ImGui::EndTable();
+        }
+
+        auto fir = dsp::autotune::getFIRResults();
+        if (!fir.empty() && ImGui::BeginTable("FIR Tuning Table", 3, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+            ImGui::TableSetupColumn("FIR taps");
+            ImGui::TableSetupColumn("Direct (ns/sample)");
+            ImGui::TableSetupColumn("FFT (ns/sample)");
+            ImGui::TableHeadersRow();
+
+            for (const auto& f : fir) {
+                ImGui::TableNextRow();
+                ImGui::TableSetColumnIndex(0);
+                ImGui::Text("%d", f.taps);
+                ImGui::TableSetColumnIndex(1);
+                ImGui::Text("%.2f", f.directNs);
+                ImGui::TableSetColumnIndex(2);
+                ImGui::Text("%.2f", f.fftNs);
+            }
+
+            ImGui::EndTable();
+        }
+
+        ImGui::End();
+    }
+}
@@ -0,0 +1,5 @@
+#pragma once
+
+namespace kernel_tuning {
+    void show(bool* open);
+}
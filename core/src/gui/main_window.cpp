@@ -21,6 +21,9 @@
 #include <gui/menus/module_manager.h>
 #include <gui/menus/theme.h>
 #include <gui/dialogs/credits.h>
+#include <gui/dialogs/dsp_profiler.h>
+#include <gui/dialogs/kernel_tuning.h>
+#include <dsp/profiler.h>
 #include <filesystem>
 #include <signal_path/source.h>
 #include <gui/dialogs/loading_screen.h>
@@ -39,6 +42,7 @@ void MainWindow::init() {
     json menuElements = core::configManager.conf["menuElements"];
     std::string modulesDir = core::configManager.conf["modulesDirectory"];
     std::string resourcesDir = core::configManager.conf["resourcesDirectory"];
+    int streamRingSize = core::configManager.conf["streamRingSize"];
     core::configManager.release();
 
     // Assert that directories are absolute
@@ -84,11 +88,8 @@ void MainWindow::init() {
     gui::waterfall.setBandwidth(8000000);
     gui::waterfall.setViewBandwidth(8000000);
 
-    fft_in = (fftwf_complex*)fftwf_malloc(sizeof(fftwf_complex) * fftSize);
-    fft_out = (fftwf_complex*)fftwf_malloc(sizeof(fftwf_complex) * fftSize);
-    fftwPlan = fftwf_plan_dft_1d(fftSize, fft_in, fft_out, FFTW_FORWARD, FFTW_ESTIMATE);
-
     sigpath::iqFrontEnd.init(&dummyStream, 8000000, true, 1, false, 1024, 20.0, IQFrontEnd::FFTWindow::NUTTALL, acquireFFTBuffer, releaseFFTBuffer, this);
+    sigpath::iqFrontEnd.setVFOStreamRingSize(streamRingSize);
     sigpath::iqFrontEnd.start();
 
     vfoCreatedHandler.handler = vfoAddedHandler;
@@ -507,6 +508,10 @@ void MainWindow::draw() {
             ImGui::Text("Center Frequency: %.0f Hz", gui::waterfall.getCenterFrequency());
             ImGui::Text("Source name: %s", sourceName.c_str());
             ImGui::Checkbox("Show demo window", &demoWindow);
+            if (ImGui::Checkbox("Show DSP profiler", &profilerWindow)) {
+                dsp::profiler::setEnabled(profilerWindow);
+            }
+            ImGui::Checkbox("Show kernel tuning", &kernelTuningWindow);
             ImGui::Text("ImGui version: %s", ImGui::GetVersion());
 
             // ImGui::Checkbox("Bypass buffering", &sigpath::iqFrontEnd.inputBuffer.bypass);
@@ -671,6 +676,17 @@ void MainWindow::draw() {
     if (demoWindow) {
         ImGui::ShowDemoWindow();
     }
+
+    if (profilerWindow) {
+        dsp_profiler::show(&profilerWindow);
+
+        // Stop profiling if the window was closed
+        if (!profilerWindow) { dsp::profiler::setEnabled(false); }
+    }
+
+    if (kernelTuningWindow) {
+        kernel_tuning::show(&kernelTuningWindow);
+    }
 }
 
 void MainWindow::setPlayState(bool _playing) {
@@ -8,6 +8,7 @@
 #include <signal_path/signal_path.h>
 #include <gui/style.h>
 #include <utils/optionlist.h>
+#include <dsp/fft/plan.h>
 #include <algorithm>
 
 namespace displaymenu {
@@ -20,6 +21,7 @@ namespace displaymenu {
     int selectedWindow = 0;
     int fftRate = 20;
     int fftSizeId = 0;
+    int fftThreads = 1;
     int uiScaleId = 0;
     bool restartRequired = false;
     bool fftHold = false;
@@ -85,6 +87,8 @@ namespace displaymenu {
         }
         sigpath::iqFrontEnd.setFFTSize(fftSizes.value(fftSizeId));
 
+        fftThreads = dsp::fft::getThreadCount();
+
         fftRate = core::configManager.conf["fftRate"];
         sigpath::iqFrontEnd.setFFTRate(fftRate);
 
@@ -221,6 +225,21 @@ namespace displaymenu {
             core::configManager.release(true);
         }
 
+        if (dsp::fft::threadingSupported()) {
+            ImGui::LeftLabel("FFT Threads");
+            ImGui::SetNextItemWidth(menuWidth - ImGui::GetCursorPosX());
+            if (ImGui::InputInt("##sdrpp_fft_threads", &fftThreads, 1, 1)) {
+                fftThreads = std::clamp<int>(fftThreads, 1, 64);
+                dsp::fft::setThreadCount(fftThreads);
+
+                // Re-plan the FFT so that the new thread count is used
+                sigpath::iqFrontEnd.setFFTSize(fftSizes.value(fftSizeId));
+                core::configManager.acquire();
+                core::configManager.conf["fftThreads"] = fftThreads;
+                core::configManager.release(true);
+            }
+        }
+
         ImGui::LeftLabel("FFT Window");
         ImGui::SetNextItemWidth(menuWidth - ImGui::GetCursorPosX());
         if (ImGui::Combo("##sdrpp_fft_window", &selectedWindow, "Rectangular\0Blackman\0Nuttall\0")) {
@@ -17,6 +17,8 @@ namespace sourcemenu {
 
     int decimId = 0;
     OptionList<int, int> decimations;
+    int channelizerId = 0;
+    OptionList<int, int> channelizers;
 
     bool iqCorrection = false;
     bool invertIQ = false;
@@ -167,6 +169,14 @@ namespace sourcemenu {
         decimations.define(32, "32x", 32);
         decimations.define(64, "64x", 64);
 
+        // Define channelizer channel counts
+        channelizers.define(0, "Disabled", 0);
+        channelizers.define(16, "16 channels", 16);
+        channelizers.define(32, "32 channels", 32);
+        channelizers.define(64, "64 channels", 64);
+        channelizers.define(128, "128 channels", 128);
+        channelizers.define(256, "256 channels", 256);
+
         // Acquire the config file
         core::configManager.acquire();
 
@@ -180,6 +190,10 @@ namespace sourcemenu {
         if (decimations.keyExists(decimation)) {
             decimId = decimations.keyId(decimation);
         }
+        int channelizer = core::configManager.conf["channelizer"];
+        if (channelizers.keyExists(channelizer)) {
+            channelizerId = channelizers.keyId(channelizer);
+        }
 
         // Release the config file
         core::configManager.release();
@@ -192,6 +206,7 @@ namespace sourcemenu {
         sigpath::iqFrontEnd.setDCBlocking(iqCorrection);
         sigpath::iqFrontEnd.setInvertIQ(invertIQ);
         sigpath::iqFrontEnd.setDecimation(decimations.value(decimId));
+        sigpath::iqFrontEnd.setChannelizer(channelizers.value(channelizerId));
         selectOffsetByName(selectedOffset);
 
         // Register handlers
@@ -374,5 +389,14 @@ namespace sourcemenu {
             core::configManager.release(true);
         }
         if (running) { style::endDisabled(); }
+
+        ImGui::LeftLabel("VFO Channelizer");
+        ImGui::FillWidth();
+        if (ImGui::Combo("##source_channelizer", &channelizerId, channelizers.txt)) {
+            sigpath::iqFrontEnd.setChannelizer(channelizers.value(channelizerId));
+            core::configManager.acquire();
+            core::configManager.conf["channelizer"] = channelizers.key(channelizerId);
+            core::configManager.release(true);
+        }
     }
 }
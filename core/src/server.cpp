@@ -1,4 +1,5 @@
 #include "server.h"
+#include "server_session.h"
 #include "core.h"
 #include <utils/flog.h>
 #include <version.h>
@@ -11,69 +12,85 @@
 #include "dsp/compression/sample_stream_compressor.h"
 #include "dsp/sink/handler_sink.h"
 #include <zstd.h>
+#include <utils/parallel_zstd.h>
+#include <atomic>
+#include <map>
+#include <fstream>
+#include <dsp/profiler.h>
+
+// Amount of stream data queued for a client before its packets get dropped
+#define SERVER_CLIENT_QUEUE_SIZE        (32 * 1024 * 1024)
+
+// Clients that haven't read anything for this long get disconnected
+#define SERVER_CLIENT_STALL_TIMEOUT     10.0
 
 namespace server {
     dsp::stream<dsp::complex_t> dummyInput;
-    dsp::compression::SampleStreamCompressor comp;
-    dsp::sink::Handler<uint8_t> hnd;
-    net::Conn client;
-    uint8_t* rbuf = NULL;
-    uint8_t* sbuf = NULL;
-    uint8_t* bbuf = NULL;
-
-    PacketHeader* r_pkt_hdr = NULL;
-    uint8_t* r_pkt_data = NULL;
-    CommandHeader* r_cmd_hdr = NULL;
-    uint8_t* r_cmd_data = NULL;
-
-    PacketHeader* s_pkt_hdr = NULL;
-    uint8_t* s_pkt_data = NULL;
-    CommandHeader* s_cmd_hdr = NULL;
-    uint8_t* s_cmd_data = NULL;
-
-    PacketHeader* bb_pkt_hdr = NULL;
-    uint8_t* bb_pkt_data = NULL;
-
     SmGui::DrawListElem dummyElem;
 
     ZSTD_CCtx* cctx;
+    pzstd::Compressor* pcomp = NULL;
 
     net::Listener listener;
 
     OptionList<std::string, std::string> sourceList;
     int sourceId = 0;
     bool running = false;
-    bool compression = false;
     double sampleRate = 1000000.0;
 
+    // Connected clients. Commands of all clients are serialized by the control mutex since they share the source
+    std::vector<std::shared_ptr<Session>> sessions;
+    std::mutex sessionsMtx;
+    std::recursive_mutex ctrlMtx;
+    int nextSessionId = 0;
+    int maxClients = 8;
+
+    // Adaptive bitrate state
+    const int compressionLevels[] = { 0, 1, 3, 6 };
+    const int compressionLevelCount = sizeof(compressionLevels) / sizeof(int);
+    std::atomic<uint64_t> compressTime = 0;
+    std::chrono::steady_clock::time_point lastAdapt;
+
+    // The full baseband is only bound to the frontend while at least one client wants it. Every encoding of
+    // a block is only done once no matter how many clients ask for it.
+    std::recursive_mutex streamMtx;
+    dsp::stream<dsp::complex_t> basebandStream;
+    dsp::sink::Handler<dsp::complex_t> basebandSink;
+    bool basebandEnabled = false;
+    uint8_t* pcmBufs[3];
+
+    std::mutex fftMtx;
+    bool fftEnabled = false;
+    int fftSize = 1024;
+    float fftRate = 1.0f;
+    int fftWindow = IQFrontEnd::FFTWindow::NUTTALL;
+    float* fftBuf = NULL;
+
+    std::vector<std::shared_ptr<Session>> getSessions() {
+        std::lock_guard<std::mutex> lck(sessionsMtx);
+        return sessions;
+    }
+
     int main() {
         flog::info("=====| SERVER MODE |=====");
 
         // Init DSP
-        comp.init(&dummyInput, dsp::compression::PCM_TYPE_I8);
-        hnd.init(&comp.out, _testServerHandler, NULL);
-        rbuf = new uint8_t[SERVER_MAX_PACKET_SIZE];
-        sbuf = new uint8_t[SERVER_MAX_PACKET_SIZE];
-        bbuf = new uint8_t[SERVER_MAX_PACKET_SIZE];
-        comp.start();
-        hnd.start();
-
-        // Initialize headers
-        r_pkt_hdr = (PacketHeader*)rbuf;
-        r_pkt_data = &rbuf[sizeof(PacketHeader)];
-        r_cmd_hdr = (CommandHeader*)r_pkt_data;
-        r_cmd_data = &rbuf[sizeof(PacketHeader) + sizeof(CommandHeader)];
-
-        s_pkt_hdr = (PacketHeader*)sbuf;
-        s_pkt_data = &sbuf[sizeof(PacketHeader)];
-        s_cmd_hdr = (CommandHeader*)s_pkt_data;
-        s_cmd_data = &sbuf[sizeof(PacketHeader) + sizeof(CommandHeader)];
-
-        bb_pkt_hdr = (PacketHeader*)bbuf;
-        bb_pkt_data = &bbuf[sizeof(PacketHeader)];
+        for (int i = 0; i < 3; i++) {
+            pcmBufs[i] = new uint8_t[STREAM_BUFFER_SIZE * sizeof(dsp::complex_t) + 8];
+        }
+        fftBuf = new float[SERVER_MAX_FFT_SIZE];
+        basebandSink.init(&basebandStream, _basebandHandler, NULL);
+        basebandSink.start();
+        maxClients = std::max<int>((int)core::args["clients"], 1);
+
+        // The frontend feeds the full baseband, the VFOs and the FFT. The FFT runs slowly until a client asks for it
+        sigpath::iqFrontEnd.init(&dummyInput, sampleRate, false, 1, false, fftSize, 1.0, IQFrontEnd::FFTWindow::NUTTALL, acquireFFTBuffer, releaseFFTBuffer, NULL);
+        sigpath::iqFrontEnd.start();
 
         // Initialize compressor
         cctx = ZSTD_createCCtx();
+        pcomp = new pzstd::Compressor();
+        flog::info("Using {0} baseband compression threads", pcomp->getThreads());
 
         // Load config
         core::configManager.acquire();
@@ -148,22 +165,49 @@ namespace server {
         if (sourceList.keyExists(sourceName)) { sourceId = sourceList.keyId(sourceName); }
         sigpath::sourceManager.selectSource(sourceList[sourceId]);
 
-        // TODO: Use command line option
         std::string host = (std::string)core::args["addr"];
         int port = (int)core::args["port"];
         listener = net::listen(host, port);
         listener->acceptAsync(_clientHandler, NULL);
 
-        flog::info("Ready, listening on {0}:{1}", host, port);
-        while(1) { std::this_thread::sleep_for(std::chrono::milliseconds(100)); }
+        // Enable the DSP profiler if a dump file was given
+        std::string profilePath = (std::string)core::args["profile"];
+        if (!profilePath.empty()) {
+            flog::info("Dumping DSP profiler statistics to {0}", profilePath);
+            dsp::profiler::setEnabled(true);
+        }
+
+        flog::info("Ready, listening on {0}:{1} for up to {2} clients", host, port, maxClients);
+        lastAdapt = std::chrono::steady_clock::now();
+        while(1) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+
+            // Release the clients that went away or stopped reading
+            reapSessions();
+
+            // Adjust the bitrate of each client to its link and the CPU load
+            adaptBitrate();
+
+            // Dump the profiler statistics
+            if (profilePath.empty()) { continue; }
+            std::ofstream file(profilePath, std::ios::out | std::ios::trunc);
+            if (!file.is_open()) {
+                flog::error("Could not open {0} to dump the DSP profiler statistics", profilePath);
+                continue;
+            }
+            file << dsp::profiler::dumpJSON();
+        }
 
         return 0;
     }
 
     void _clientHandler(net::Conn conn, void* ctx) {
-        // Reject if someone else is already connected
-        if (client && client->isOpen()) {
-            flog::info("REJECTED Connection from {0}:{1}, another client is already connected.", "TODO", "TODO");
+        std::unique_lock<std::mutex> lck(sessionsMtx);
+
+        // Reject if the server is full
+        if (sessions.size() >= maxClients) {
+            lck.unlock();
+            flog::info("REJECTED Connection from {0}:{1}, the maximum number of clients is already connected.", "TODO", "TODO");
             
             // Issue a disconnect command to the client
             uint8_t buf[sizeof(PacketHeader) + sizeof(CommandHeader)];
@@ -184,71 +228,436 @@ namespace server {
             return;
         }
 
-        flog::info("Connection from {0}:{1}", "TODO", "TODO");
-        client = std::move(conn);
-        client->readAsync(sizeof(PacketHeader), rbuf, _packetHandler, NULL);
+        // Create the session, it starts with the full baseband like older clients expect
+        std::shared_ptr<Session> session = std::make_shared<Session>(std::move(conn), nextSessionId++, SERVER_CLIENT_QUEUE_SIZE);
+        sessions.push_back(session);
+        int count = sessions.size();
+        lck.unlock();
+        flog::info("Connection from {0}:{1}, client {2} ({3}/{4})", "TODO", "TODO", session->id, count, maxClients);
+
+        session->sendCommand(COMMAND_SET_SAMPLERATE, &sampleRate, sizeof(double));
+        session->conn->readAsync(sizeof(PacketHeader), session->rbuf, _packetHandler, session.get());
+        {
+            std::lock_guard<std::recursive_mutex> lck2(ctrlMtx);
+            updateBaseband();
+        }
 
-        // Perform settings reset
-        sigpath::sourceManager.stop();
-        comp.setPCMType(dsp::compression::PCM_TYPE_I16);
-        compression = false;
+        listener->acceptAsync(_clientHandler, NULL);
+    }
 
-        sendSampleRate(sampleRate);
+    void reapSessions() {
+        // Pick out the sessions that are closed or stalled
+        std::vector<std::shared_ptr<Session>> dead;
+        {
+            std::lock_guard<std::mutex> lck(sessionsMtx);
+            for (auto it = sessions.begin(); it != sessions.end();) {
+                double stalled = (*it)->stalledSeconds();
+                if ((*it)->isOpen() && stalled < SERVER_CLIENT_STALL_TIMEOUT) {
+                    it++;
+                    continue;
+                }
+                if (stalled >= SERVER_CLIENT_STALL_TIMEOUT) {
+                    flog::warn("Client {0} stopped reading for {1}s, disconnecting it", (*it)->id, (int)stalled);
+                }
+                dead.push_back(*it);
+                it = sessions.erase(it);
+            }
+        }
+        if (dead.empty()) { return; }
 
-        // TODO: Wait otherwise someone else could connect
+        // Close them without the control lock since the event loop might be waiting for it in one of their handlers
+        for (auto& session : dead) {
+            session->close();
+        }
 
-        listener->acceptAsync(_clientHandler, NULL);
+        // Release their streams and the source if nobody else is using it
+        std::lock_guard<std::recursive_mutex> lck(ctrlMtx);
+        for (auto& session : dead) {
+            while (!session->vfos.empty()) { removeVFO(session.get(), session->vfos.begin()->first); }
+            session->fftSize = 0;
+            session->started = false;
+            flog::info("Client {0} disconnected", session->id);
+        }
+        updateSource();
+        updateBaseband();
+        updateFFT();
     }
 
     void _packetHandler(int count, uint8_t* buf, void* ctx) {
+        Session* session = (Session*)ctx;
         PacketHeader* hdr = (PacketHeader*)buf;
 
-        // Read the rest of the data (TODO: CHECK SIZE OR SHIT WILL BE FUCKED + ADD TIMEOUT)
-        int len = 0;
-        int read = 0;
-        int goal = hdr->size - sizeof(PacketHeader);
-        while (len < goal) {
-            read = client->read(goal - len, &buf[sizeof(PacketHeader) + len]);
-            if (read < 0) { return; };
-            len += read;
+        // Read the rest of the data without holding up the event loop
+        if (hdr->size < sizeof(PacketHeader) || hdr->size > SERVER_MAX_PACKET_SIZE) {
+            flog::error("Client {0} sent a packet with an invalid size, closing", session->id);
+            session->conn->close();
+            return;
         }
+        if (hdr->size > sizeof(PacketHeader)) {
+            session->conn->readAsync(hdr->size - sizeof(PacketHeader), &buf[sizeof(PacketHeader)], _packetBodyHandler, session);
+            return;
+        }
+        _packetBodyHandler(0, &buf[sizeof(PacketHeader)], ctx);
+    }
+
+    void _packetBodyHandler(int count, uint8_t* buf, void* ctx) {
+        Session* session = (Session*)ctx;
+        PacketHeader* hdr = (PacketHeader*)session->rbuf;
 
         // Parse and process
         if (hdr->type == PACKET_TYPE_COMMAND && hdr->size >= sizeof(PacketHeader) + sizeof(CommandHeader)) {
-            CommandHeader* chdr = (CommandHeader*)&buf[sizeof(PacketHeader)];
-            commandHandler((Command)chdr->cmd, &buf[sizeof(PacketHeader) + sizeof(CommandHeader)], hdr->size - sizeof(PacketHeader) - sizeof(CommandHeader));
+            CommandHeader* chdr = (CommandHeader*)&session->rbuf[sizeof(PacketHeader)];
+            std::lock_guard<std::recursive_mutex> lck(ctrlMtx);
+            commandHandler(session, (Command)chdr->cmd, &session->rbuf[sizeof(PacketHeader) + sizeof(CommandHeader)], hdr->size - sizeof(PacketHeader) - sizeof(CommandHeader));
         }
         else {
-            sendError(ERROR_INVALID_PACKET);
+            session->sendError(ERROR_INVALID_PACKET);
         }
 
         // Start another async read
-        client->readAsync(sizeof(PacketHeader), rbuf, _packetHandler, NULL);
+        session->conn->readAsync(sizeof(PacketHeader), session->rbuf, _packetHandler, session);
+    }
+
+    // Must be called with the control mutex locked after changing any of the stream settings of a session
+    static void updateEncoding(Session* session) {
+        int level = session->adaptive ? compressionLevels[session->levelId] : (session->compression ? 1 : 0);
+        bool parallel = level && session->parallel;
+        session->encoding = (session->pcmType << 8) | (level << 1) | parallel;
+    }
+
+    void _basebandHandler(dsp::complex_t* data, int count, void* ctx) {
+        auto start = std::chrono::steady_clock::now();
+        auto list = getSessions();
+
+        // Encode the block once for each combination of sample type and compression in use
+        std::map<int, PacketRef> encoded;
+        int pcmLen[3] = { -1, -1, -1 };
+        for (auto& session : list) {
+            if (!session->baseband) { continue; }
+            int key = session->encoding;
+            dsp::compression::PCMType type = (dsp::compression::PCMType)(key >> 8);
+            int level = (key >> 1) & 0x7F;
+            bool parallel = key & 1;
+
+            auto it = encoded.find(key);
+            if (it == encoded.end()) {
+                PacketRef pkt;
+                if (level) {
+                    // Convert to PCM once per type, then compress
+                    if (pcmLen[type] < 0) { pcmLen[type] = dsp::compression::SampleStreamCompressor::process(count, type, data, pcmBufs[type]); }
+                    pkt = allocPacket(parallel ? PACKET_TYPE_BASEBAND_COMPRESSED_MT : PACKET_TYPE_BASEBAND_COMPRESSED, SERVER_MAX_PACKET_SIZE - sizeof(PacketHeader), true);
+                    size_t compSize;
+                    if (parallel) {
+                        compSize = pcomp->compress(pcmBufs[type], pcmLen[type], pkt->data(), SERVER_MAX_PACKET_SIZE - sizeof(PacketHeader), level);
+                    }
+                    else {
+                        compSize = ZSTD_compressCCtx(cctx, pkt->data(), SERVER_MAX_PACKET_SIZE - sizeof(PacketHeader), pcmBufs[type], pcmLen[type], level);
+                        if (ZSTD_isError(compSize)) { compSize = 0; }
+                    }
+
+                    // Fall back to sending it uncompressed
+                    if (!compSize) {
+                        pkt->header()->type = PACKET_TYPE_BASEBAND;
+                        memcpy(pkt->data(), pcmBufs[type], pcmLen[type]);
+                        compSize = pcmLen[type];
+                    }
+                    setPacketSize(pkt, compSize);
+                }
+                else {
+                    // Convert straight into the packet
+                    pkt = allocPacket(PACKET_TYPE_BASEBAND, count * sizeof(dsp::complex_t) + 8, true);
+                    setPacketSize(pkt, dsp::compression::SampleStreamCompressor::process(count, type, data, pkt->data()));
+                }
+                it = encoded.emplace(key, pkt).first;
+            }
+
+            // Queue it, the session drops it if the client is too slow
+            session->rawBytes += (pcmLen[type] >= 0) ? pcmLen[type] : (it->second->size - sizeof(PacketHeader));
+            session->encodedBytes += it->second->size;
+            session->send(it->second);
+        }
+
+        compressTime += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    void adaptBitrate() {
+        // Get the time since the last call and the load of the baseband encoder
+        auto now = std::chrono::steady_clock::now();
+        double elapsed = std::chrono::duration_cast<std::chrono::microseconds>(now - lastAdapt).count();
+        lastAdapt = now;
+        double cpuLoad = (double)compressTime.exchange(0) / elapsed;
+
+        std::lock_guard<std::recursive_mutex> lck(ctrlMtx);
+        for (auto& session : getSessions()) {
+            // The link load is the time spent writing, or how full the queue is if the client is falling behind
+            uint64_t writeTime, bytes, dropped;
+            double queueFill;
+            session->getStats(writeTime, bytes, dropped, queueFill);
+            double linkLoad = std::max<double>((double)writeTime / elapsed, queueFill);
+            if (dropped) { linkLoad = 1.0; }
+            uint64_t raw = session->rawBytes.exchange(0);
+            uint64_t sent = session->encodedBytes.exchange(0);
+            if (!raw || !running || !session->baseband) { continue; }
+
+            // Let the stream settle after a change before measuring again
+            dsp::compression::PCMType currentType = session->pcmType;
+            if (session->holdoff > 0) {
+                session->holdoff--;
+            }
+            else if (session->adaptive) {
+                int levelId = session->levelId;
+                dsp::compression::PCMType lastType = currentType;
+                if (linkLoad > 0.6) {
+                    // The link is the bottleneck, compress harder if the CPU allows it otherwise drop precision
+                    if (levelId < compressionLevelCount - 1 && cpuLoad < 0.3) {
+                        levelId++;
+                    }
+                    else if (currentType == dsp::compression::PCM_TYPE_F32) {
+                        currentType = dsp::compression::PCM_TYPE_I16;
+                    }
+                    else if (currentType == dsp::compression::PCM_TYPE_I16) {
+                        currentType = dsp::compression::PCM_TYPE_I8;
+                    }
+                }
+                else if (cpuLoad > 0.6 && levelId > 1) {
+                    // The CPU is the bottleneck, compress less
+                    levelId--;
+                }
+                else if (cpuLoad > 0.6 && linkLoad * ((double)raw / (double)sent) < 0.4) {
+                    // Sending uncompressed fits in the link
+                    levelId = 0;
+                }
+                else if (currentType != session->requestedType && (linkLoad + cpuLoad) * 2.0 < 0.6) {
+                    // Enough headroom to double the sample size back towards what the client asked for
+                    currentType = (currentType == dsp::compression::PCM_TYPE_I8) ? dsp::compression::PCM_TYPE_I16 : dsp::compression::PCM_TYPE_F32;
+                }
+
+                if (levelId != session->levelId || currentType != lastType) {
+                    session->levelId = levelId;
+                    session->pcmType = currentType;
+                    updateEncoding(session.get());
+                    flog::info("Adaptive bitrate for client {0}: sample type {1}, compression level {2} (link load {3}%, CPU load {4}%)", session->id, (int)currentType, compressionLevels[levelId], (int)(linkLoad * 100.0), (int)(cpuLoad * 100.0));
+                    session->holdoff = 2;
+                }
+            }
+
+            // Report the stream state to the client
+            StreamStatus status;
+            status.pcmType = currentType;
+            status.level = (session->encoding >> 1) & 0x7F;
+            status.linkLoad = linkLoad;
+            status.cpuLoad = cpuLoad;
+            status.ratio = (double)raw / (double)sent;
+            session->sendCommand(COMMAND_SET_STREAM_STATUS, &status, sizeof(StreamStatus));
+        }
+    }
+
+    void setInput(dsp::stream<dsp::complex_t>* stream) {
+        sigpath::iqFrontEnd.setInput(stream);
+    }
+
+    void updateSource() {
+        // The source runs as long as one client wants it to
+        bool wanted = false;
+        for (auto& session : getSessions()) {
+            if (session->started) {
+                wanted = true;
+                break;
+            }
+        }
+        if (wanted == running) { return; }
+        if (wanted) {
+            sigpath::sourceManager.start();
+        }
+        else {
+            sigpath::sourceManager.stop();
+        }
+        running = wanted;
     }
 
-    void _testServerHandler(uint8_t* data, int count, void* ctx) {
-        // Compress data if needed and fill out header fields
-        if (compression) {
-            bb_pkt_hdr->type = PACKET_TYPE_BASEBAND_COMPRESSED;
-            bb_pkt_hdr->size = sizeof(PacketHeader) + (uint32_t)ZSTD_compressCCtx(cctx, &bbuf[sizeof(PacketHeader)], SERVER_MAX_PACKET_SIZE-sizeof(PacketHeader), data, count, 1);
+    void updateBaseband() {
+        std::lock_guard<std::recursive_mutex> lck(streamMtx);
+        bool enabled = false;
+        for (auto& session : getSessions()) {
+            if (session->baseband) {
+                enabled = true;
+                break;
+            }
+        }
+        if (enabled == basebandEnabled) { return; }
+        if (enabled) {
+            sigpath::iqFrontEnd.bindIQStream(&basebandStream);
         }
         else {
-            bb_pkt_hdr->type = PACKET_TYPE_BASEBAND;
-            bb_pkt_hdr->size = sizeof(PacketHeader) + count;
-            memcpy(&bbuf[sizeof(PacketHeader)], data, count);
+            sigpath::iqFrontEnd.unbindIQStream(&basebandStream);
         }
+        basebandEnabled = enabled;
+    }
 
-        // Write to network
-        if (client && client->isOpen()) { client->write(bb_pkt_hdr->size, bbuf); }
+    static std::string vfoName(Session* session, uint32_t id) {
+        return "server_vfo_" + std::to_string(session->id) + "_" + std::to_string(id);
     }
 
-    void setInput(dsp::stream<dsp::complex_t>* stream) {
-        comp.setInput(stream);
+    static bool vfoConfigValid(const VFOConfig& cfg) {
+        double maxOffset = sampleRate / 2.0;
+        return cfg.sampleRate > 0 && cfg.sampleRate <= sampleRate && cfg.bandwidth > 0 && cfg.bandwidth <= cfg.sampleRate && fabs(cfg.offset) <= maxOffset;
+    }
+
+    bool addVFO(Session* session, const VFOConfig& cfg) {
+        std::lock_guard<std::recursive_mutex> lck(streamMtx);
+        if (session->vfos.find(cfg.id) != session->vfos.end() || session->vfos.size() >= SERVER_MAX_VFOS || !vfoConfigValid(cfg)) { return false; }
+
+        // Create the VFO in the frontend and compress its output the same way as the baseband
+        dsp::channel::RxVFO* vfo = sigpath::iqFrontEnd.addVFO(vfoName(session, cfg.id), cfg.sampleRate, cfg.bandwidth, cfg.offset);
+        if (!vfo) { return false; }
+        SessionVFO* svfo = new SessionVFO;
+        svfo->session = session;
+        svfo->config = cfg;
+        svfo->vfo = vfo;
+        svfo->comp.init(&vfo->out, session->requestedType);
+        svfo->sink.init(&svfo->comp.out, _vfoHandler, svfo);
+        svfo->comp.start();
+        svfo->sink.start();
+        session->vfos[cfg.id] = svfo;
+
+        flog::info("Client {0} added VFO {1} ({2} S/s at {3} Hz)", session->id, cfg.id, cfg.sampleRate, cfg.offset);
+        return true;
+    }
+
+    bool updateVFO(Session* session, const VFOConfig& cfg) {
+        std::lock_guard<std::recursive_mutex> lck(streamMtx);
+        auto it = session->vfos.find(cfg.id);
+        if (it == session->vfos.end() || !vfoConfigValid(cfg)) { return false; }
+        SessionVFO* svfo = it->second;
+        std::string name = vfoName(session, cfg.id);
+        if (cfg.sampleRate != svfo->config.sampleRate) {
+            sigpath::iqFrontEnd.setVFOOutSamplerate(name, cfg.sampleRate, cfg.bandwidth);
+        }
+        else if (cfg.bandwidth != svfo->config.bandwidth) {
+            sigpath::iqFrontEnd.setVFOBandwidth(name, cfg.bandwidth);
+        }
+        if (cfg.offset != svfo->config.offset) {
+            sigpath::iqFrontEnd.setVFOOffset(name, cfg.offset);
+        }
+        svfo->config = cfg;
+        return true;
+    }
+
+    bool removeVFO(Session* session, uint32_t id) {
+        std::lock_guard<std::recursive_mutex> lck(streamMtx);
+        auto it = session->vfos.find(id);
+        if (it == session->vfos.end()) { return false; }
+        SessionVFO* svfo = it->second;
+        svfo->sink.stop();
+        svfo->comp.stop();
+        sigpath::iqFrontEnd.removeVFO(vfoName(session, id));
+        delete svfo;
+        session->vfos.erase(it);
+
+        flog::info("Client {0} removed VFO {1}", session->id, id);
+        return true;
     }
 
-    void commandHandler(Command cmd, uint8_t* data, int len) {
+    void _vfoHandler(uint8_t* data, int count, void* ctx) {
+        SessionVFO* svfo = (SessionVFO*)ctx;
+        PacketRef pkt = allocPacket(PACKET_TYPE_VFO, sizeof(VFOHeader) + count, true);
+        ((VFOHeader*)pkt->data())->id = svfo->config.id;
+        memcpy(&pkt->data()[sizeof(VFOHeader)], data, count);
+        svfo->session->send(pkt);
+    }
+
+    void updateFFT() {
+        std::lock_guard<std::recursive_mutex> lck(streamMtx);
+
+        // The FFT is computed once at the largest size and rate asked for, each client gets frames resized to its own settings
+        int size = 0;
+        float rate = 0.0f;
+        for (auto& session : getSessions()) {
+            size = std::max<int>(size, session->fftSize);
+            rate = std::max<float>(rate, session->fftRate);
+        }
+
+        // Stop sending frames first, the frontend waits for the FFT thread while reconfiguring
+        bool wasEnabled;
+        {
+            std::lock_guard<std::mutex> lck2(fftMtx);
+            wasEnabled = fftEnabled;
+            fftEnabled = false;
+        }
+        if (!size) {
+            if (wasEnabled) { sigpath::iqFrontEnd.setFFTRate(1.0); }
+            return;
+        }
+        if (size != fftSize) { sigpath::iqFrontEnd.setFFTSize(size); }
+        if (!wasEnabled || rate != fftRate) { sigpath::iqFrontEnd.setFFTRate(rate); }
+        sigpath::iqFrontEnd.setFFTWindow((IQFrontEnd::FFTWindow)fftWindow);
+
+        std::lock_guard<std::mutex> lck2(fftMtx);
+        fftSize = size;
+        fftRate = rate;
+        fftEnabled = true;
+    }
+
+    float* acquireFFTBuffer(void* ctx) {
+        fftMtx.lock();
+        return fftEnabled ? fftBuf : NULL;
+    }
+
+    void releaseFFTBuffer(void* ctx) {
+        if (!fftEnabled) {
+            fftMtx.unlock();
+            return;
+        }
+
+        // Build one frame per size in use, for the clients whose next frame is due
+        auto now = std::chrono::steady_clock::now();
+        std::map<int, PacketRef> frames;
+        for (auto& session : getSessions()) {
+            int size = session->fftSize;
+            if (!size) { continue; }
+            double interval = 1.0 / session->fftRate;
+            if (std::chrono::duration<double>(now - session->lastFFT).count() < interval * 0.9) { continue; }
+            session->lastFFT = now;
+
+            auto it = frames.find(size);
+            if (it == frames.end()) {
+                // Keep the peak of the bins merged into each output bin
+                std::vector<float> bins(size);
+                for (int i = 0; i < size; i++) {
+                    int first = (int64_t)i * fftSize / size;
+                    int last = std::max<int>((int64_t)(i + 1) * fftSize / size, first + 1);
+                    float val = fftBuf[first];
+                    for (int j = first + 1; j < last; j++) { val = std::max<float>(val, fftBuf[j]); }
+                    bins[i] = val;
+                }
+
+                // Quantize the frame to 8 bits over its own range
+                float min = bins[0];
+                float max = bins[0];
+                for (int i = 1; i < size; i++) {
+                    min = std::min<float>(min, bins[i]);
+                    max = std::max<float>(max, bins[i]);
+                }
+                float scale = (max > min) ? (255.0f / (max - min)) : 0.0f;
+                PacketRef pkt = allocPacket(PACKET_TYPE_FFT, sizeof(FFTHeader) + size, true);
+                FFTHeader* fhdr = (FFTHeader*)pkt->data();
+                uint8_t* out = &pkt->data()[sizeof(FFTHeader)];
+                fhdr->size = size;
+                fhdr->min = min;
+                fhdr->max = max;
+                for (int i = 0; i < size; i++) {
+                    out[i] = (uint8_t)(((bins[i] - min) * scale) + 0.5f);
+                }
+                it = frames.emplace(size, pkt).first;
+            }
+            session->send(it->second);
+        }
+        fftMtx.unlock();
+    }
+
+    void commandHandler(Session* session, Command cmd, uint8_t* data, int len) {
         if (cmd == COMMAND_GET_UI) {
-            sendUI(COMMAND_GET_UI, "", dummyElem);
+            sendUI(session, COMMAND_GET_UI, "", dummyElem);
         }
         else if (cmd == COMMAND_UI_ACTION && len >= 3) {
             // Check if sending back data is needed
@@ -259,48 +668,99 @@ namespace server {
             // Load id
             SmGui::DrawListElem diffId;
             int count = SmGui::DrawList::loadItem(diffId, &data[i], len);
-            if (count < 0) { sendError(ERROR_INVALID_ARGUMENT); return; }
-            if (diffId.type != SmGui::DRAW_LIST_ELEM_TYPE_STRING) { sendError(ERROR_INVALID_ARGUMENT); return; } 
+            if (count < 0) { session->sendError(ERROR_INVALID_ARGUMENT); return; }
+            if (diffId.type != SmGui::DRAW_LIST_ELEM_TYPE_STRING) { session->sendError(ERROR_INVALID_ARGUMENT); return; } 
             i += count;
             len -= count;
 
             // Load value
             SmGui::DrawListElem diffValue;
             count = SmGui::DrawList::loadItem(diffValue, &data[i], len);
-            if (count < 0) { sendError(ERROR_INVALID_ARGUMENT); return; }
+            if (count < 0) { session->sendError(ERROR_INVALID_ARGUMENT); return; }
             i += count;
             len -= count;
 
             // Render and send back
             if (sendback) {
-                sendUI(COMMAND_UI_ACTION, diffId.str, diffValue);
+                sendUI(session, COMMAND_UI_ACTION, diffId.str, diffValue);
             }
             else {
                 renderUI(NULL, diffId.str, diffValue);
             }
         }
         else if (cmd == COMMAND_START) {
-            sigpath::sourceManager.start();
-            running = true;
+            session->started = true;
+            updateSource();
         }
         else if (cmd == COMMAND_STOP) {
-            sigpath::sourceManager.stop();
-            running = false;
+            session->started = false;
+            updateSource();
         }
         else if (cmd == COMMAND_SET_FREQUENCY && len == 8) {
             sigpath::sourceManager.tune(*(double*)data);
-            sendCommandAck(COMMAND_SET_FREQUENCY, 0);
+            session->sendCommandAck(COMMAND_SET_FREQUENCY, NULL, 0);
         }
         else if (cmd == COMMAND_SET_SAMPLE_TYPE && len == 1) {
-            dsp::compression::PCMType type = (dsp::compression::PCMType)*(uint8_t*)data;
-            comp.setPCMType(type);
+            // The type is used to index the encoded variants, never trust it
+            uint8_t rawType = *(uint8_t*)data;
+            if (rawType > dsp::compression::PCM_TYPE_F32) {
+                session->sendError(ERROR_INVALID_ARGUMENT);
+                return;
+            }
+            dsp::compression::PCMType type = (dsp::compression::PCMType)rawType;
+            session->requestedType = type;
+            session->pcmType = type;
+            updateEncoding(session);
+            std::lock_guard<std::recursive_mutex> lck(streamMtx);
+            for (auto& [id, svfo] : session->vfos) { svfo->comp.setPCMType(type); }
         }
         else if (cmd == COMMAND_SET_COMPRESSION && len == 1) {
-            compression = *(uint8_t*)data;
+            session->compression = *(uint8_t*)data;
+            if (!session->adaptive) { session->levelId = session->compression ? 1 : 0; }
+            updateEncoding(session);
+        }
+        else if (cmd == COMMAND_SET_COMPRESSION_OPTIONS && len == sizeof(CompressionOptions)) {
+            CompressionOptions* opts = (CompressionOptions*)data;
+            session->parallel = opts->parallel;
+            session->adaptive = opts->adaptive;
+            session->holdoff = 0;
+
+            // Go back to what the client asked for when leaving adaptive mode
+            if (!session->adaptive) {
+                session->pcmType = session->requestedType;
+                session->levelId = session->compression ? 1 : 0;
+            }
+            updateEncoding(session);
+        }
+        else if (cmd == COMMAND_SET_BASEBAND && len == 1) {
+            session->baseband = *(uint8_t*)data;
+            updateBaseband();
+        }
+        else if (cmd == COMMAND_ADD_VFO && len == sizeof(VFOConfig)) {
+            if (!addVFO(session, *(VFOConfig*)data)) { session->sendError(ERROR_INVALID_ARGUMENT); }
+        }
+        else if (cmd == COMMAND_UPDATE_VFO && len == sizeof(VFOConfig)) {
+            if (!updateVFO(session, *(VFOConfig*)data)) { session->sendError(ERROR_INVALID_ARGUMENT); }
+        }
+        else if (cmd == COMMAND_REMOVE_VFO && len == sizeof(uint32_t)) {
+            if (!removeVFO(session, *(uint32_t*)data)) { session->sendError(ERROR_INVALID_ARGUMENT); }
+        }
+        else if (cmd == COMMAND_SET_FFT && len == sizeof(FFTConfig)) {
+            FFTConfig* cfg = (FFTConfig*)data;
+            bool valid = !cfg->size || (cfg->size >= SERVER_MIN_FFT_SIZE && cfg->size <= SERVER_MAX_FFT_SIZE && cfg->rate > 0.0f && cfg->rate <= SERVER_MAX_FFT_RATE && cfg->window <= IQFrontEnd::FFTWindow::NUTTALL);
+            if (valid) {
+                session->fftSize = cfg->size;
+                session->fftRate = cfg->rate;
+                if (cfg->size) { fftWindow = cfg->window; }
+                updateFFT();
+            }
+            else {
+                session->sendError(ERROR_INVALID_ARGUMENT);
+            }
         }
         else {
             flog::error("Invalid Command: {0} (len = {1})", (int)cmd, len);
-            sendError(ERROR_INVALID_COMMAND);
+            session->sendError(ERROR_INVALID_COMMAND);
         }
     }
 
@@ -339,49 +799,25 @@ namespace server {
         }
     }
 
-    void sendUI(Command originCmd, std::string diffId, SmGui::DrawListElem diffValue) {
+    void sendUI(Session* session, Command originCmd, std::string diffId, SmGui::DrawListElem diffValue) {
         // Render UI
         SmGui::DrawList dl;
         renderUI(&dl, diffId, diffValue);
 
         // Create response
         int size = dl.getSize();
-        dl.store(s_cmd_data, size);
+        std::vector<uint8_t> buf(size);
+        dl.store(buf.data(), size);
 
         // Send to network
-        sendCommandAck(originCmd, size);
-    }
-
-    void sendError(Error err) {
-        PacketHeader* hdr = (PacketHeader*)sbuf;
-        s_pkt_data[0] = err;
-        sendPacket(PACKET_TYPE_ERROR, 1);
-    }
-
-    void sendSampleRate(double sampleRate) {
-        *(double*)s_cmd_data = sampleRate;
-        sendCommand(COMMAND_SET_SAMPLERATE, sizeof(double));
+        session->sendCommandAck(originCmd, buf.data(), size);
     }
 
     void setInputSampleRate(double samplerate) {
         sampleRate = samplerate;
-        if (!client || !client->isOpen()) { return; }
-        sendSampleRate(sampleRate);
-    }
-
-    void sendPacket(PacketType type, int len) {
-        s_pkt_hdr->type = type;
-        s_pkt_hdr->size = sizeof(PacketHeader) + len;
-        client->write(s_pkt_hdr->size, sbuf);
-    }
-
-    void sendCommand(Command cmd, int len) {
-        s_cmd_hdr->cmd = cmd;
-        sendPacket(PACKET_TYPE_COMMAND, sizeof(CommandHeader) + len);
-    }
-
-    void sendCommandAck(Command cmd, int len) {
-        s_cmd_hdr->cmd = cmd;
-        sendPacket(PACKET_TYPE_COMMAND_ACK, sizeof(CommandHeader) + len);
+        sigpath::iqFrontEnd.setSampleRate(sampleRate);
+        for (auto& session : getSessions()) {
+            session->sendCommand(COMMAND_SET_SAMPLERATE, &sampleRate, sizeof(double));
+        }
     }
 }
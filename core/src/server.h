@@ -5,23 +5,33 @@
 #include <server_protocol.h>
 
 namespace server {
+    class Session;
+
     void setInput(dsp::stream<dsp::complex_t>* stream);
     int main();
 
     void _clientHandler(net::Conn conn, void* ctx);
     void _packetHandler(int count, uint8_t* buf, void* ctx);
-    void _testServerHandler(uint8_t* data, int count, void* ctx);
+    void _packetBodyHandler(int count, uint8_t* buf, void* ctx);
+    void _basebandHandler(dsp::complex_t* data, int count, void* ctx);
+    void _vfoHandler(uint8_t* data, int count, void* ctx);
+    float* acquireFFTBuffer(void* ctx);
+    void releaseFFTBuffer(void* ctx);
+
+    void reapSessions();
+    void adaptBitrate();
+
+    void updateSource();
+    void updateBaseband();
+    void updateFFT();
+    bool addVFO(Session* session, const VFOConfig& cfg);
+    bool updateVFO(Session* session, const VFOConfig& cfg);
+    bool removeVFO(Session* session, uint32_t id);
 
     void drawMenu();
 
-    void commandHandler(Command cmd, uint8_t* data, int len);
+    void commandHandler(Session* session, Command cmd, uint8_t* data, int len);
     void renderUI(SmGui::DrawList* dl, std::string diffId, SmGui::DrawListElem diffValue);
-    void sendUI(Command originCmd, std::string diffId, SmGui::DrawListElem diffValue);
-    void sendError(Error err);
-    void sendSampleRate(double sampleRate);
+    void sendUI(Session* session, Command originCmd, std::string diffId, SmGui::DrawListElem diffValue);
     void setInputSampleRate(double samplerate);
-
-    void sendPacket(PacketType type, int len);
-    void sendCommand(Command cmd, int len);
-    void sendCommandAck(Command cmd, int len);
 }
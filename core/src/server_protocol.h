@@ -4,6 +4,10 @@
 #include <dsp/types.h>
 
 #define SERVER_MAX_PACKET_SIZE  (STREAM_BUFFER_SIZE * sizeof(dsp::complex_t) * 2)
+#define SERVER_MAX_VFOS         32
+#define SERVER_MIN_FFT_SIZE     64
+#define SERVER_MAX_FFT_SIZE     65536
+#define SERVER_MAX_FFT_RATE     60.0f
 
 namespace server {
     enum PacketType {
@@ -14,7 +18,8 @@ namespace server {
         PACKET_TYPE_BASEBAND_COMPRESSED,
         PACKET_TYPE_VFO,
         PACKET_TYPE_FFT,
-        PACKET_TYPE_ERROR
+        PACKET_TYPE_ERROR,
+        PACKET_TYPE_BASEBAND_COMPRESSED_MT
     };
 
     enum Command {
@@ -27,10 +32,17 @@ namespace server {
         COMMAND_GET_SAMPLERATE,
         COMMAND_SET_SAMPLE_TYPE,
         COMMAND_SET_COMPRESSION,
+        COMMAND_SET_COMPRESSION_OPTIONS,
+        COMMAND_SET_BASEBAND,
+        COMMAND_ADD_VFO,
+        COMMAND_UPDATE_VFO,
+        COMMAND_REMOVE_VFO,
+        COMMAND_SET_FFT,
 
         // Server to client
         COMMAND_SET_SAMPLERATE = 0x80,
-        COMMAND_DISCONNECT
+        COMMAND_DISCONNECT,
+        COMMAND_SET_STREAM_STATUS
     };
 
     enum Error {
@@ -49,5 +61,50 @@ namespace server {
     struct CommandHeader {
         uint32_t cmd;
     };
+
+    struct CompressionOptions {
+        // Send compressed baseband as independent frames that can be decompressed in parallel
+        uint8_t parallel;
+        // Let the server pick the sample type and compression level from the link and CPU load
+        uint8_t adaptive;
+    };
+
+    struct StreamStatus {
+        uint8_t pcmType;
+        // Zstd compression level, zero if uncompressed
+        uint8_t level;
+        // Fraction of the time the server spent sending and compressing
+        float linkLoad;
+        float cpuLoad;
+        // Average compression ratio
+        float ratio;
+    };
+
+    struct VFOConfig {
+        uint32_t id;
+        double sampleRate;
+        double bandwidth;
+        // Offset from the center frequency
+        double offset;
+    };
+
+    // Followed by the samples in the sample stream compressor format
+    struct VFOHeader {
+        uint32_t id;
+    };
+
+    struct FFTConfig {
+        // Number of bins, zero to stop sending FFT frames
+        uint32_t size;
+        float rate;
+        uint8_t window;
+    };
+
+    // Followed by one byte per bin, linearly mapping 0-255 to min-max in dB
+    struct FFTHeader {
+        uint32_t size;
+        float min;
+        float max;
+    };
 #pragma pack(pop)
 }
\ No newline at end of file
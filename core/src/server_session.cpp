@@ -0,0 +1,163 @@
+#include "server_session.h"
+#include <utils/flog.h>
+#include <string.h>
+
+namespace server {
+    // Keep a handful of buffers around, baseband packets are large and allocated for every block
+    const size_t PACKET_POOL_SIZE = 64;
+    std::mutex poolMtx;
+    std::vector<Packet*> pool;
+
+    static void releasePacket(Packet* pkt) {
+        std::lock_guard<std::mutex> lck(poolMtx);
+        if (pool.size() >= PACKET_POOL_SIZE) {
+            delete pkt;
+            return;
+        }
+        pool.push_back(pkt);
+    }
+
+    PacketRef allocPacket(PacketType type, int dataSize, bool droppable) {
+        Packet* pkt = NULL;
+        {
+            std::lock_guard<std::mutex> lck(poolMtx);
+            if (!pool.empty()) {
+                pkt = pool.back();
+                pool.pop_back();
+            }
+        }
+        if (!pkt) { pkt = new Packet; }
+
+        // Only ever grow the buffer so that recycled packets don't need to be reallocated
+        int size = sizeof(PacketHeader) + dataSize;
+        if (pkt->buf.size() < size) { pkt->buf.resize(size); }
+        pkt->size = size;
+        pkt->droppable = droppable;
+        pkt->header()->type = type;
+        pkt->header()->size = size;
+        return PacketRef(pkt, releasePacket);
+    }
+
+    void setPacketSize(const PacketRef& pkt, int dataSize) {
+        pkt->size = sizeof(PacketHeader) + dataSize;
+        pkt->header()->size = pkt->size;
+    }
+
+    static int64_t nowMicros() {
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    Session::Session(net::Conn conn, int id, size_t maxQueueSize) : id(id) {
+        this->conn = std::move(conn);
+        maxQueued = maxQueueSize;
+        rbuf = new uint8_t[SERVER_MAX_PACKET_SIZE];
+        lastProgress = nowMicros();
+    }
+
+    Session::~Session() {
+        close();
+        delete[] rbuf;
+    }
+
+    bool Session::send(const PacketRef& pkt) {
+        {
+            std::lock_guard<std::mutex> lck(queueMtx);
+            if (!running) { return false; }
+
+            // Drop stream data rather than letting the queue grow, the DSP path must never wait on a client
+            if (pkt->droppable && queuedBytes + pkt->size > maxQueued) {
+                dropped++;
+                if (!dropping) {
+                    flog::warn("Client {0} can't keep up, dropping data", id);
+                    dropping = true;
+                }
+                return false;
+            }
+            dropping = false;
+
+            // Nothing is waiting on an empty queue so the stall timer and the busy period start now
+            if (!queuedBytes) {
+                busyStart = nowMicros();
+                lastProgress = busyStart;
+            }
+            queuedBytes += pkt->size;
+        }
+
+        // The connection keeps a reference to the packet until the event loop has written it
+        conn->writeAsync(pkt->size, pkt->buf.data(), pkt, writeHandler, this);
+        return true;
+    }
+
+    void Session::sendCommand(Command cmd, const void* data, int len) {
+        PacketRef pkt = allocPacket(PACKET_TYPE_COMMAND, sizeof(CommandHeader) + len, false);
+        ((CommandHeader*)pkt->data())->cmd = cmd;
+        if (len) { memcpy(&pkt->data()[sizeof(CommandHeader)], data, len); }
+        send(pkt);
+    }
+
+    void Session::sendCommandAck(Command cmd, const void* data, int len) {
+        PacketRef pkt = allocPacket(PACKET_TYPE_COMMAND_ACK, sizeof(CommandHeader) + len, false);
+        ((CommandHeader*)pkt->data())->cmd = cmd;
+        if (len) { memcpy(&pkt->data()[sizeof(CommandHeader)], data, len); }
+        send(pkt);
+    }
+
+    void Session::sendError(Error err) {
+        PacketRef pkt = allocPacket(PACKET_TYPE_ERROR, 1, false);
+        pkt->data()[0] = err;
+        send(pkt);
+    }
+
+    bool Session::isOpen() {
+        std::lock_guard<std::mutex> lck(queueMtx);
+        return running && conn && conn->isOpen();
+    }
+
+    void Session::close() {
+        {
+            std::lock_guard<std::mutex> lck(queueMtx);
+            running = false;
+            queuedBytes = 0;
+        }
+
+        // Closing drops the queued writes and waits for a write handler in progress to return
+        if (conn) { conn->close(); }
+    }
+
+    void Session::getStats(uint64_t& writeTime, uint64_t& bytes, uint64_t& dropped, double& queueFill) {
+        std::lock_guard<std::mutex> lck(queueMtx);
+
+        // Account for the busy period still going on
+        if (queuedBytes) {
+            int64_t now = nowMicros();
+            this->writeTime += now - busyStart;
+            busyStart = now;
+        }
+
+        writeTime = this->writeTime.exchange(0);
+        bytes = bytesWritten.exchange(0);
+        dropped = this->dropped.exchange(0);
+        queueFill = (double)queuedBytes / (double)maxQueued;
+    }
+
+    double Session::stalledSeconds() {
+        {
+            std::lock_guard<std::mutex> lck(queueMtx);
+            if (!queuedBytes) { return 0.0; }
+        }
+        return (double)(nowMicros() - lastProgress) / 1e6;
+    }
+
+    void Session::writeHandler(int count, void* ctx) {
+        Session* _this = (Session*)ctx;
+        int64_t now = nowMicros();
+        std::lock_guard<std::mutex> lck(_this->queueMtx);
+        if (!_this->running) { return; }
+        _this->bytesWritten += count;
+        _this->lastProgress = now;
+
+        // The link was busy for as long as data was waiting to be written
+        _this->queuedBytes -= std::min<size_t>(count, _this->queuedBytes);
+        if (!_this->queuedBytes) { _this->writeTime += now - _this->busyStart; }
+    }
+}
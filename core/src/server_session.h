@@ -0,0 +1,133 @@
+#pragma once
+#include <utils/networking.h>
+#include <server_protocol.h>
+#include <dsp/compression/sample_stream_compressor.h>
+#include <dsp/channel/rx_vfo.h>
+#include <dsp/sink/handler_sink.h>
+#include <memory>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+
+namespace server {
+    // Packets are reference counted so that one encoded block can be queued to many clients without copies
+    struct Packet {
+        std::vector<uint8_t> buf;
+        int size = 0;
+
+        // Stream data can be dropped when a client falls behind, replies to commands never are
+        bool droppable = false;
+
+        inline PacketHeader* header() { return (PacketHeader*)buf.data(); }
+        inline uint8_t* data() { return &buf[sizeof(PacketHeader)]; }
+    };
+    typedef std::shared_ptr<Packet> PacketRef;
+
+    /**
+     * Get a packet from the pool. The buffers are recycled once no queue references them anymore.
+     * @param type Type of the packet.
+     * @param dataSize Size of the data following the packet header, can be reduced later with setPacketSize().
+     * @param droppable True if the packet is stream data that can be dropped for slow clients.
+     * @return The packet with its header filled out.
+     */
+    PacketRef allocPacket(PacketType type, int dataSize, bool droppable);
+    void setPacketSize(const PacketRef& pkt, int dataSize);
+
+    class Session;
+
+    struct SessionVFO {
+        Session* session;
+        VFOConfig config;
+        dsp::channel::RxVFO* vfo;
+        dsp::compression::SampleStreamCompressor comp;
+        dsp::sink::Handler<uint8_t> sink;
+    };
+
+    // State of one connected client. Its packets are written by the event loop as the socket accepts them, so a
+    // slow link only ever delays that client.
+    class Session {
+    public:
+        Session(net::Conn conn, int id, size_t maxQueueSize);
+        ~Session();
+
+        /**
+         * Queue a packet to be sent.
+         * @param pkt Packet to send.
+         * @return True if the packet was queued, false if it was dropped or the session is closed.
+         */
+        bool send(const PacketRef& pkt);
+
+        void sendCommand(Command cmd, const void* data, int len);
+        void sendCommandAck(Command cmd, const void* data, int len);
+        void sendError(Error err);
+
+        bool isOpen();
+
+        // Close the connection and drop the packets still queued
+        void close();
+
+        /**
+         * Get the link statistics since the last call.
+         * @param writeTime Time data spent waiting to be written to the socket in microseconds.
+         * @param bytes Bytes written.
+         * @param dropped Packets dropped because the queue was full.
+         * @param queueFill Current fraction of the queue in use.
+         */
+        void getStats(uint64_t& writeTime, uint64_t& bytes, uint64_t& dropped, double& queueFill);
+
+        // Time since the socket last accepted data while some was waiting, used to kick clients that stopped reading
+        double stalledSeconds();
+
+        const int id;
+        net::Conn conn;
+        uint8_t* rbuf;
+
+        // Whether the client receives the full baseband, also read by the DSP thread
+        std::atomic<bool> baseband = true;
+
+        // Stream settings, only accessed with the control mutex locked
+        bool compression = false;
+        bool parallel = false;
+        bool adaptive = false;
+        dsp::compression::PCMType pcmType = dsp::compression::PCM_TYPE_I16;
+        int levelId = 1;
+        dsp::compression::PCMType requestedType = dsp::compression::PCM_TYPE_I16;
+        int holdoff = 0;
+        bool started = false;
+
+        // Sample type, compression level and parallel flag the baseband is encoded with, packed in a single value so
+        // that the DSP thread always reads a consistent set. Derived from the stream settings by the control thread.
+        std::atomic<int> encoding = dsp::compression::PCM_TYPE_I16 << 8;
+
+        // Baseband bytes before and after encoding since the last bitrate adaptation
+        std::atomic<uint64_t> rawBytes = 0;
+        std::atomic<uint64_t> encodedBytes = 0;
+
+        // FFT subscription, a size of zero means none
+        std::atomic<int> fftSize = 0;
+        std::atomic<float> fftRate = 0.0f;
+        std::chrono::steady_clock::time_point lastFFT;
+
+        std::map<uint32_t, SessionVFO*> vfos;
+
+    private:
+        static void writeHandler(int count, void* ctx);
+
+        // Bytes handed to the connection that it hasn't written yet
+        std::mutex queueMtx;
+        size_t queuedBytes = 0;
+        size_t maxQueued;
+        bool running = true;
+
+        // Start of the current period during which data was waiting to be written
+        int64_t busyStart = 0;
+
+        std::atomic<uint64_t> writeTime = 0;
+        std::atomic<uint64_t> bytesWritten = 0;
+        std::atomic<uint64_t> dropped = 0;
+        bool dropping = false;
+        std::atomic<int64_t> lastProgress;
+    };
+}
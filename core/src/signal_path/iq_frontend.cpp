@@ -9,7 +9,6 @@ IQFrontEnd::~IQFrontEnd() {
     if (!_init) { return; }
     stop();
     dsp::buffer::free(fftWindowBuf);
-    fftwf_destroy_plan(fftwPlan);
     fftwf_free(fftInBuf);
     fftwf_free(fftOutBuf);
 }
@@ -33,6 +32,11 @@ void IQFrontEnd::init(dsp::stream<dsp::complex_t>* in, double sampleRate, bool b
     dcBlock.init(NULL, genDCBlockRate(effectiveSr));
     conjugate.init(NULL);
 
+    // The pre-processing blocks run inside the fused chain and don't need their output streams
+    decim.out.free();
+    dcBlock.out.free();
+    conjugate.out.free();
+
     preproc.init(&inBuf.out);
     preproc.addBlock(&decim, _decimRatio > 1);
     preproc.addBlock(&dcBlock, dcBlocking);
@@ -59,13 +63,19 @@ void IQFrontEnd::init(dsp::stream<dsp::complex_t>* in, double sampleRate, bool b
 
     fftInBuf = (fftwf_complex*)fftwf_malloc(_fftSize * sizeof(fftwf_complex));
     fftOutBuf = (fftwf_complex*)fftwf_malloc(_fftSize * sizeof(fftwf_complex));
-    fftwPlan = fftwf_plan_dft_1d(_fftSize, fftInBuf, fftOutBuf, FFTW_FORWARD, FFTW_ESTIMATE);
+    fftPlan = dsp::fft::getPlan(_fftSize);
 
     // Clear the rest of the FFT input buffer
     dsp::buffer::clear(fftInBuf, _fftSize - _nzFFTSize, _nzFFTSize);
 
+    // The FFT path, channelizer and VFOs only read their input so the splitter can share its buffers with them
+    fftIn.setAcceptShared(true);
+    channelizerIn.setAcceptShared(true);
     split.bindStream(&fftIn);
 
+    // The channelizer only gets bound to the splitter once a VFO uses it
+    channelizer.init(&channelizerIn, 16);
+
     _init = true;
 }
 
@@ -84,8 +94,10 @@ void IQFrontEnd::setSampleRate(double sampleRate) {
     _sampleRate = sampleRate;
     effectiveSr = _sampleRate / _decimRatio;
     dcBlock.setRate(genDCBlockRate(effectiveSr));
+
+    // The channel spacing depends on the samplerate so the VFOs all need to be rerouted
     for (auto& [name, vfo] : vfos) {
-        vfo->setInSamplerate(effectiveSr);
+        routeVFO(name, true);
     }
 
     // Reconfigure the FFT
@@ -129,6 +141,47 @@ void IQFrontEnd::setInvertIQ(bool enabled) {
     preproc.setBlockEnabled(&conjugate, enabled, [=](dsp::stream<dsp::complex_t>* out){ split.setInput(out); });
 }
 
+void IQFrontEnd::setVFOStreamRingSize(int slots) {
+    // Stop the splitter, channelizer and the VFOs since the stream buffers will be reallocated
+    split.tempStop();
+    channelizer.tempStop();
+    for (auto& [name, vfo] : vfos) {
+        vfo->tempStop();
+    }
+
+    // Update the mode of all VFO input streams
+    _vfoRingSize = (slots >= 2) ? slots : 0;
+    for (auto& [name, vfoIn] : vfoStreams) {
+        vfoIn->setRingSize(_vfoRingSize);
+    }
+
+    // Restart blocks
+    for (auto& [name, vfo] : vfos) {
+        vfo->tempStart();
+    }
+    channelizer.tempStart();
+    split.tempStart();
+}
+
+void IQFrontEnd::setChannelizer(int channels) {
+    if (channels < 2 || channels % 2) { channels = 0; }
+    if (channels == _channelizerChannels) { return; }
+
+    // Move all VFOs back to the full rate stream
+    _channelizerChannels = 0;
+    for (auto& [name, vfo] : vfos) {
+        routeVFO(name);
+    }
+    if (!channels) { return; }
+
+    // Reconfigure the channelizer and move every VFO that fits in a channel to it
+    channelizer.setChannelCount(channels);
+    _channelizerChannels = channels;
+    for (auto& [name, vfo] : vfos) {
+        routeVFO(name);
+    }
+}
+
 void IQFrontEnd::bindIQStream(dsp::stream<dsp::complex_t>* stream) {
     split.bindStream(stream);
 }
@@ -146,16 +199,23 @@ dsp::channel::RxVFO* IQFrontEnd::addVFO(std::string name, double sampleRate, dou
 
     // Create VFO and its input stream
     dsp::stream<dsp::complex_t>* vfoIn = new dsp::stream<dsp::complex_t>;
+    if (_vfoRingSize) { vfoIn->setRingSize(_vfoRingSize); }
+    vfoIn->setAcceptShared(true);
     dsp::channel::RxVFO* vfo = new dsp::channel::RxVFO(vfoIn, effectiveSr, sampleRate, bandwidth, offset);
 
     // Register them
     vfoStreams[name] = vfoIn;
     vfos[name] = vfo;
+    vfoInfo[name] = { sampleRate, bandwidth, offset, -1 };
     bindIQStream(vfoIn);
 
+    // Move it to a channel of the channelizer if possible
+    routeVFO(name);
+
     // Start VFO
     vfo->start();
 
+    onVFOChanged.emit(name);
     return vfo;
 }
 
@@ -165,6 +225,7 @@ void IQFrontEnd::removeVFO(std::string name) {
         flog::error("[IQFrontEnd] Tried to remove a VFO that doesn't exist.");
         return;
     }
+    onVFORemove.emit(name);
 
     // Remove the VFO and stream from registry
     dsp::stream<dsp::complex_t>* vfoIn = vfoStreams[name];
@@ -173,15 +234,81 @@ void IQFrontEnd::removeVFO(std::string name) {
     // Stop the VFO
     vfo->stop();
 
-    unbindIQStream(vfoIn);
+    if (vfoInfo[name].channel < 0) {
+        unbindIQStream(vfoIn);
+    }
+    else {
+        channelizer.unbindStream(vfoIn);
+    }
     vfoStreams.erase(name);
     vfos.erase(name);
+    vfoInfo.erase(name);
+    updateChannelizerInput();
 
     // Delete the VFO and its input stream
     delete vfo;
     delete vfoIn;
 }
 
+void IQFrontEnd::setVFOOffset(std::string name, double offset) {
+    // Make sure that a VFO with that name exists
+    if (vfos.find(name) == vfos.end()) {
+        flog::error("[IQFrontEnd] Tried to set the offset of a VFO that doesn't exist.");
+        return;
+    }
+
+    vfoInfo[name].offset = offset;
+    routeVFO(name);
+    onVFOChanged.emit(name);
+}
+
+void IQFrontEnd::setVFOBandwidth(std::string name, double bandwidth) {
+    // Make sure that a VFO with that name exists
+    if (vfos.find(name) == vfos.end()) {
+        flog::error("[IQFrontEnd] Tried to set the bandwidth of a VFO that doesn't exist.");
+        return;
+    }
+
+    vfoInfo[name].bandwidth = bandwidth;
+    vfos[name]->setBandwidth(bandwidth);
+    routeVFO(name);
+    onVFOChanged.emit(name);
+}
+
+void IQFrontEnd::setVFOOutSamplerate(std::string name, double sampleRate, double bandwidth) {
+    // Make sure that a VFO with that name exists
+    if (vfos.find(name) == vfos.end()) {
+        flog::error("[IQFrontEnd] Tried to set the samplerate of a VFO that doesn't exist.");
+        return;
+    }
+
+    vfoInfo[name].sampleRate = sampleRate;
+    vfoInfo[name].bandwidth = bandwidth;
+    vfos[name]->setOutSamplerate(sampleRate, bandwidth);
+    routeVFO(name);
+    onVFOChanged.emit(name);
+}
+
+std::vector<std::string> IQFrontEnd::getVFONames() {
+    std::vector<std::string> names;
+    for (auto& [name, vfo] : vfos) { names.push_back(name); }
+    return names;
+}
+
+dsp::channel::RxVFO* IQFrontEnd::getVFO(std::string name) {
+    auto it = vfos.find(name);
+    return (it != vfos.end()) ? it->second : NULL;
+}
+
+bool IQFrontEnd::getVFOParams(std::string name, double& sampleRate, double& bandwidth, double& offset) {
+    auto it = vfoInfo.find(name);
+    if (it == vfoInfo.end()) { return false; }
+    sampleRate = it->second.sampleRate;
+    bandwidth = it->second.bandwidth;
+    offset = it->second.offset;
+    return true;
+}
+
 void IQFrontEnd::setFFTSize(int size) {
     _fftSize = size;
     updateFFTPath(true);
@@ -197,6 +324,19 @@ void IQFrontEnd::setFFTWindow(FFTWindow fftWindow) {
     updateFFTPath();
 }
 
+void IQFrontEnd::setFFTEnabled(bool enabled) {
+    if (enabled == _fftEnabled) { return; }
+    _fftEnabled = enabled;
+
+    // Without its input the FFT chain never runs
+    if (enabled) {
+        split.bindStream(&fftIn);
+    }
+    else {
+        split.unbindStream(&fftIn);
+    }
+}
+
 void IQFrontEnd::flushInputBuffer() {
     inBuf.flush();
 }
@@ -211,14 +351,19 @@ void IQFrontEnd::start() {
     // Start IQ splitter
     split.start();
 
+    // Start channelizer
+    channelizer.start();
+
     // Start all VFOs
     for (auto& [name, vfo] : vfos) {
         vfo->start();
     }
 
     // Start FFT chain
-    reshape.start();
-    fftSink.start();
+    if (_fftEnabled) {
+        reshape.start();
+        fftSink.start();
+    }
 }
 
 void IQFrontEnd::stop() {
@@ -231,6 +376,9 @@ void IQFrontEnd::stop() {
     // Stop IQ splitter
     split.stop();
 
+    // Stop channelizer
+    channelizer.stop();
+
     // Stop all VFOs
     for (auto& [name, vfo] : vfos) {
         vfo->stop();
@@ -245,6 +393,82 @@ double IQFrontEnd::getEffectiveSamplerate() {
     return effectiveSr;
 }
 
+int IQFrontEnd::selectVFOChannel(const VFOInfo& info, double& residual) {
+    residual = info.offset;
+    if (!_channelizerChannels) { return -1; }
+
+    // Find the closest channel
+    double spacing = effectiveSr / _channelizerChannels;
+    int channel = round(info.offset / spacing);
+    double chanResidual = info.offset - (double)channel * spacing;
+
+    // Only use it if the whole VFO fits in the passband of the channel (+-0.75 channel spacing)
+    double width = std::max<double>(info.bandwidth, info.sampleRate);
+    if (fabs(chanResidual) + (width / 2.0) > 0.75 * spacing) { return -1; }
+
+    residual = chanResidual;
+    return ((channel % _channelizerChannels) + _channelizerChannels) % _channelizerChannels;
+}
+
+void IQFrontEnd::routeVFO(std::string name, bool force) {
+    VFOInfo& info = vfoInfo[name];
+    dsp::channel::RxVFO* vfo = vfos[name];
+    dsp::stream<dsp::complex_t>* vfoIn = vfoStreams[name];
+
+    // If the VFO stays on the same stream, only the offset needs to be updated
+    double residual;
+    int channel = selectVFOChannel(info, residual);
+    if (channel == info.channel && !force) {
+        vfo->setOffset(residual);
+        return;
+    }
+
+    // Move the VFO input to the new stream
+    vfo->tempStop();
+    if (channel != info.channel) {
+        if (info.channel < 0) {
+            unbindIQStream(vfoIn);
+        }
+        else {
+            channelizer.unbindStream(vfoIn);
+        }
+        if (channel < 0) {
+            bindIQStream(vfoIn);
+        }
+        else {
+            channelizer.bindStream(channel, vfoIn);
+        }
+        info.channel = channel;
+        vfo->reset();
+    }
+    vfo->setInSamplerate((channel < 0) ? effectiveSr : (2.0 * effectiveSr / _channelizerChannels));
+    vfo->setOffset(residual);
+    vfo->tempStart();
+
+    updateChannelizerInput();
+}
+
+void IQFrontEnd::updateChannelizerInput() {
+    // Only feed the channelizer if at least one VFO uses it
+    bool used = false;
+    for (auto& [name, info] : vfoInfo) {
+        if (info.channel >= 0) {
+            used = true;
+            break;
+        }
+    }
+    if (used == channelizerBound) { return; }
+
+    if (used) {
+        channelizer.reset();
+        split.bindStream(&channelizerIn);
+    }
+    else {
+        split.unbindStream(&channelizerIn);
+    }
+    channelizerBound = used;
+}
+
 void IQFrontEnd::handler(dsp::complex_t* data, int count, void* ctx) {
     IQFrontEnd* _this = (IQFrontEnd*)ctx;
 
@@ -252,7 +476,7 @@ void IQFrontEnd::handler(dsp::complex_t* data, int count, void* ctx) {
     volk_32fc_32f_multiply_32fc((lv_32fc_t*)_this->fftInBuf, (lv_32fc_t*)data, _this->fftWindowBuf, _this->_nzFFTSize);
 
     // Execute FFT
-    fftwf_execute(_this->fftwPlan);
+    _this->fftPlan->execute((dsp::complex_t*)_this->fftInBuf, (dsp::complex_t*)_this->fftOutBuf);
 
     // Aquire buffer
     float* fftBuf = _this->_acquireFFTBuffer(_this->_fftCtx);
@@ -295,13 +519,13 @@ void IQFrontEnd::updateFFTPath(bool updateWaterfall) {
     fftwf_free(fftOutBuf);
     fftInBuf = (fftwf_complex*)fftwf_malloc(_fftSize * sizeof(fftwf_complex));
     fftOutBuf = (fftwf_complex*)fftwf_malloc(_fftSize * sizeof(fftwf_complex));
-    fftwPlan = fftwf_plan_dft_1d(_fftSize, fftInBuf, fftOutBuf, FFTW_FORWARD, FFTW_ESTIMATE);
+    fftPlan = dsp::fft::getPlan(_fftSize);
 
     // Clear the rest of the FFT input buffer
     dsp::buffer::clear(fftInBuf, _fftSize - _nzFFTSize, _nzFFTSize);
 
     // Update waterfall (TODO: This is annoying, it makes this module non testable and will constantly clear the waterfall for any reason)
-    if (updateWaterfall) { gui::waterfall.setRawFFTSize(_fftSize); }
+    if (updateWaterfall && !core::args["server"].b()) { gui::waterfall.setRawFFTSize(_fftSize); }
 
     // Restart branch
     reshape.tempStart();
@@ -3,11 +3,16 @@
 #include "../dsp/buffer/reshaper.h"
 #include "../dsp/multirate/power_decimator.h"
 #include "../dsp/correction/dc_blocker.h"
-#include "../dsp/chain.h"
+#include "../dsp/fused_chain.h"
 #include "../dsp/routing/splitter.h"
 #include "../dsp/channel/rx_vfo.h"
+#include "../dsp/channel/polyphase_channelizer.h"
 #include "../dsp/sink/handler_sink.h"
 #include "../dsp/math/conjugate.h"
+#include "../dsp/fft/plan.h"
+#include <map>
+#include <vector>
+#include <utils/event.h>
 #include <fftw3.h>
 
 class IQFrontEnd {
@@ -30,17 +35,28 @@ public:
     void setDecimation(int ratio);
     void setInvertIQ(bool enabled);
     void setDCBlocking(bool enabled);
+    void setVFOStreamRingSize(int slots);
+    void setChannelizer(int channels);
 
     void bindIQStream(dsp::stream<dsp::complex_t>* stream);
     void unbindIQStream(dsp::stream<dsp::complex_t>* stream);
 
     dsp::channel::RxVFO* addVFO(std::string name, double sampleRate, double bandwidth, double offset);
     void removeVFO(std::string name);
+    void setVFOOffset(std::string name, double offset);
+    void setVFOBandwidth(std::string name, double bandwidth);
+    void setVFOOutSamplerate(std::string name, double sampleRate, double bandwidth);
+    std::vector<std::string> getVFONames();
+    dsp::channel::RxVFO* getVFO(std::string name);
+    bool getVFOParams(std::string name, double& sampleRate, double& bandwidth, double& offset);
 
     void setFFTSize(int size);
     void setFFTRate(double rate);
     void setFFTWindow(FFTWindow fftWindow);
 
+    // Disable the FFT path when nothing displays it, must be called while the front end is stopped
+    void setFFTEnabled(bool enabled);
+
     void flushInputBuffer();
 
     void start();
@@ -48,10 +64,25 @@ public:
 
     double getEffectiveSamplerate();
 
+    // Emitted with the name of a VFO when it's added or its parameters change, and before it's removed
+    Event<std::string> onVFOChanged;
+    Event<std::string> onVFORemove;
+
 protected:
     static void handler(dsp::complex_t* data, int count, void* ctx);
     void updateFFTPath(bool updateWaterfall = false);
 
+    struct VFOInfo {
+        double sampleRate;
+        double bandwidth;
+        double offset;
+        int channel; // -1 if the VFO is fed with the full rate stream
+    };
+
+    int selectVFOChannel(const VFOInfo& info, double& residual);
+    void routeVFO(std::string name, bool force = false);
+    void updateChannelizerInput();
+
     static inline double genDCBlockRate(double sampleRate) {
         return 50.0 / sampleRate;
     }
@@ -69,7 +100,7 @@ protected:
     dsp::multirate::PowerDecimator<dsp::complex_t> decim;
     dsp::math::Conjugate conjugate;
     dsp::correction::DCBlocker<dsp::complex_t> dcBlock;
-    dsp::chain<dsp::complex_t> preproc;
+    dsp::fused_chain<dsp::complex_t> preproc;
 
     // Splitting
     dsp::routing::Splitter<dsp::complex_t> split;
@@ -82,6 +113,14 @@ protected:
     // VFOs
     std::map<std::string, dsp::stream<dsp::complex_t>*> vfoStreams;
     std::map<std::string, dsp::channel::RxVFO*> vfos;
+    std::map<std::string, VFOInfo> vfoInfo;
+    int _vfoRingSize = 0;
+
+    // Channelizer
+    dsp::stream<dsp::complex_t> channelizerIn;
+    dsp::channel::PolyphaseChannelizer channelizer;
+    int _channelizerChannels = 0;
+    bool channelizerBound = false;
 
     // Parameters
     double _sampleRate;
@@ -89,6 +128,7 @@ protected:
     int _fftSize;
     double _fftRate;
     FFTWindow _fftWindow;
+    bool _fftEnabled = true;
     float* (*_acquireFFTBuffer)(void* ctx);
     void (*_releaseFFTBuffer)(void* ctx);
     void* _fftCtx;
@@ -97,7 +137,7 @@ protected:
     int _nzFFTSize;
     float* fftWindowBuf;
     fftwf_complex *fftInBuf, *fftOutBuf;
-    fftwf_plan fftwPlan;
+    std::shared_ptr<dsp::fft::Plan> fftPlan;
     float* fftDbOut;
 
     double effectiveSr;
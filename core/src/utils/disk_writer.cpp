@@ -0,0 +1,415 @@
+#include "disk_writer.h"
+#include <utils/flog.h>
+#include <string.h>
+#include <chrono>
+#include <algorithm>
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <malloc.h>
+#else
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/uio.h>
+#include <limits.h>
+#include <stdlib.h>
+#endif
+
+#ifdef SDRPP_IO_URING
+#include <liburing.h>
+#endif
+
+// Alignment required by direct I/O, also used for the buffers of the buffered backend
+#define DISK_DIRECT_ALIGNMENT   4096
+
+namespace disk {
+    bool backendSupported(Backend backend) {
+        switch (backend) {
+        case BACKEND_BUFFERED:
+            return true;
+        case BACKEND_DIRECT:
+#ifdef __linux__
+            return true;
+#else
+            return false;
+#endif
+        case BACKEND_IO_URING:
+#if defined(__linux__) && defined(SDRPP_IO_URING)
+            return true;
+#else
+            return false;
+#endif
+        }
+        return false;
+    }
+
+    static uint8_t* allocAligned(size_t size) {
+#ifdef _WIN32
+        return (uint8_t*)_aligned_malloc(size, DISK_DIRECT_ALIGNMENT);
+#else
+        void* ptr = NULL;
+        if (posix_memalign(&ptr, DISK_DIRECT_ALIGNMENT, size)) { return NULL; }
+        return (uint8_t*)ptr;
+#endif
+    }
+
+    static void freeAligned(uint8_t* ptr) {
+#ifdef _WIN32
+        _aligned_free(ptr);
+#else
+        free(ptr);
+#endif
+    }
+
+    // Write a whole block at a given offset, retrying on short writes
+    static bool writeAll(int fd, const uint8_t* data, size_t len, uint64_t offset) {
+#ifdef _WIN32
+        if (_lseeki64(fd, offset, SEEK_SET) < 0) { return false; }
+        while (len) {
+            int n = _write(fd, data, (unsigned int)std::min<size_t>(len, 1 << 30));
+            if (n <= 0) { return false; }
+            data += n;
+            len -= n;
+        }
+#else
+        while (len) {
+            ssize_t n = pwrite(fd, data, len, offset);
+            if (n < 0 && errno == EINTR) { continue; }
+            if (n <= 0) { return false; }
+            data += n;
+            len -= n;
+            offset += n;
+        }
+#endif
+        return true;
+    }
+
+    Writer::~Writer() {
+        close();
+    }
+
+    bool Writer::open(const std::string& path, const Options& options) {
+        close();
+        opts = options;
+
+        // Fall back to buffered writes when the backend isn't available
+        if (!backendSupported(opts.backend)) {
+            flog::warn("Disk backend not supported, using buffered writes instead");
+            opts.backend = BACKEND_BUFFERED;
+        }
+
+        // Open the file
+#ifdef _WIN32
+        fd = _open(path.c_str(), _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+        int flags = O_WRONLY | O_CREAT | O_TRUNC;
+#ifdef __linux__
+        if (opts.backend != BACKEND_BUFFERED) { flags |= O_DIRECT; }
+#endif
+        fd = ::open(path.c_str(), flags, 0644);
+
+        // Some filesystems (tmpfs for example) refuse direct I/O
+        if (fd < 0 && opts.backend != BACKEND_BUFFERED) {
+            flog::warn("Could not open '{}' for direct I/O, using buffered writes instead", path);
+            opts.backend = BACKEND_BUFFERED;
+            fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        }
+#endif
+        if (fd < 0) { return false; }
+
+#ifdef SDRPP_IO_URING
+        if (opts.backend == BACKEND_IO_URING) {
+            io_uring* r = new io_uring;
+            if (io_uring_queue_init(std::max<int>(opts.bufferCount, 2), r, 0) < 0) {
+                flog::warn("Could not create an io_uring, using direct writes instead");
+                delete r;
+                opts.backend = BACKEND_DIRECT;
+            }
+            else {
+                ring = r;
+            }
+        }
+#endif
+
+        // Direct writes must be aligned in size and offset, so buffer sizes are rounded up to keep every full buffer aligned
+        opts.bufferSize = ((std::max<size_t>(opts.bufferSize, DISK_DIRECT_ALIGNMENT) + DISK_DIRECT_ALIGNMENT - 1) / DISK_DIRECT_ALIGNMENT) * DISK_DIRECT_ALIGNMENT;
+        opts.bufferCount = std::max<int>(opts.bufferCount, 2);
+
+        // Allocate buffers
+        buffers.resize(opts.bufferCount);
+        for (auto& buf : buffers) {
+            buf.data = allocAligned(opts.bufferSize);
+            buf.used = 0;
+            buf.offset = 0;
+            freeBuffers.push_back(&buf);
+        }
+
+        // Reset state
+        position = 0;
+        allocated = 0;
+        current = NULL;
+        failed = false;
+        overruns = 0;
+        droppedBytes = 0;
+        avgLatency = 0.0;
+        maxLatency = 0.0;
+        queued = 0;
+
+        // Start the writer thread
+        running = true;
+        workerThread = std::thread(&Writer::worker, this);
+
+        return true;
+    }
+
+    bool Writer::isOpen() {
+        std::lock_guard<std::mutex> lck(mtx);
+        return fd >= 0;
+    }
+
+    void Writer::close() {
+        // Let the worker write out the queue and exit
+        {
+            std::lock_guard<std::mutex> lck(mtx);
+            if (fd < 0) { return; }
+            running = false;
+        }
+        cnd.notify_all();
+        if (workerThread.joinable()) { workerThread.join(); }
+
+#ifdef __linux__
+        // The tail isn't a multiple of the alignment, so it's written through the page cache
+        if (opts.backend != BACKEND_BUFFERED) {
+            int flags = fcntl(fd, F_GETFL);
+            fcntl(fd, F_SETFL, flags & ~O_DIRECT);
+        }
+#endif
+
+        // Write the partially filled buffer and the patches that didn't fit in memory
+        if (current && current->used && !writeAll(fd, current->data, current->used, current->offset)) {
+            flog::error("Failed to write the end of the file");
+        }
+        for (const auto& p : patches) {
+            if (!writeAll(fd, p.data.data(), p.data.size(), p.pos)) {
+                flog::error("Failed to write file header");
+            }
+        }
+        patches.clear();
+
+#ifdef __linux__
+        // Release the space preallocated past the end of the data
+        if (allocated > position && ftruncate(fd, position)) {
+            flog::warn("Could not release the preallocated space of the file");
+        }
+#endif
+
+#ifdef SDRPP_IO_URING
+        if (ring) {
+            io_uring_queue_exit((io_uring*)ring);
+            delete (io_uring*)ring;
+            ring = NULL;
+        }
+#endif
+
+        // Close the file
+#ifdef _WIN32
+        _close(fd);
+#else
+        ::close(fd);
+#endif
+
+        // Free buffers
+        std::lock_guard<std::mutex> lck(mtx);
+        fd = -1;
+        current = NULL;
+        queue.clear();
+        freeBuffers.clear();
+        for (auto& buf : buffers) { freeAligned(buf.data); }
+        buffers.clear();
+    }
+
+    bool Writer::write(const void* data, size_t len, bool wait) {
+        std::unique_lock<std::mutex> lck(mtx);
+        if (fd < 0) { return false; }
+
+        // Drop the whole write if it doesn't fit in the free space, the caller must never wait on the disk
+        size_t space = current ? (opts.bufferSize - current->used) : 0;
+        space += freeBuffers.size() * opts.bufferSize;
+        if (!wait && len > space) {
+            overruns++;
+            droppedBytes += len;
+            return false;
+        }
+
+        // Copy into the buffers, queuing those that fill up
+        const uint8_t* in = (const uint8_t*)data;
+        bool notify = false;
+        while (len) {
+            if (!current) {
+                if (freeBuffers.empty()) {
+                    // Only reached when waiting, hand over what was filled so far and wait for a buffer
+                    cnd.notify_all();
+                    notify = false;
+                    freeCnd.wait(lck, [this]() { return !freeBuffers.empty(); });
+                }
+                current = freeBuffers.back();
+                freeBuffers.pop_back();
+                current->used = 0;
+                current->offset = position;
+            }
+            size_t n = std::min<size_t>(len, opts.bufferSize - current->used);
+            memcpy(&current->data[current->used], in, n);
+            current->used += n;
+            position += n;
+            in += n;
+            len -= n;
+            if (current->used == opts.bufferSize) {
+                queue.push_back(current);
+                queued++;
+                current = NULL;
+                notify = true;
+            }
+        }
+        if (notify) { cnd.notify_all(); }
+        return true;
+    }
+
+    void Writer::patch(uint64_t pos, const void* data, size_t len) {
+        std::lock_guard<std::mutex> lck(mtx);
+        if (fd < 0) { return; }
+
+        // Patch in memory if the region wasn't handed to the writer thread yet
+        if (current && pos >= current->offset && pos + len <= current->offset + current->used) {
+            memcpy(&current->data[pos - current->offset], data, len);
+            return;
+        }
+
+        Patch p;
+        p.pos = pos;
+        p.data.assign((const uint8_t*)data, (const uint8_t*)data + len);
+        patches.push_back(std::move(p));
+    }
+
+    uint64_t Writer::tell() {
+        std::lock_guard<std::mutex> lck(mtx);
+        return position;
+    }
+
+    Stats Writer::getStats() {
+        Stats stats;
+        stats.overruns = overruns;
+        stats.droppedBytes = droppedBytes;
+        stats.avgLatency = avgLatency;
+        stats.maxLatency = maxLatency;
+        stats.queued = queued;
+        stats.bufferCount = opts.bufferCount;
+        return stats;
+    }
+
+    void Writer::worker() {
+        std::vector<Buffer*> batch;
+        while (true) {
+            // Take everything that was queued since the last write
+            {
+                std::unique_lock<std::mutex> lck(mtx);
+                cnd.wait(lck, [this]() { return !queue.empty() || !running; });
+                if (queue.empty()) { break; }
+                batch.assign(queue.begin(), queue.end());
+                queue.clear();
+            }
+
+            // Write the batch and keep track of how long it took
+            auto start = std::chrono::high_resolution_clock::now();
+            preallocate(batch.back()->offset + batch.back()->used);
+            if (!failed && !writeBuffers(batch)) {
+                flog::error("Failed to write to disk, the rest of the recording is lost");
+                failed = true;
+            }
+            double latency = std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - start).count();
+            avgLatency = (avgLatency == 0.0) ? latency : (0.9 * avgLatency + 0.1 * latency);
+            if (latency > maxLatency) { maxLatency = latency; }
+
+            // Give the buffers back
+            std::lock_guard<std::mutex> lck(mtx);
+            for (auto buf : batch) { freeBuffers.push_back(buf); }
+            queued -= batch.size();
+            freeCnd.notify_all();
+        }
+    }
+
+    bool Writer::writeBuffers(std::vector<Buffer*>& bufs) {
+#ifdef SDRPP_IO_URING
+        if (ring) {
+            // Put all buffers in flight at once and wait for them to complete
+            io_uring* r = (io_uring*)ring;
+            for (auto buf : bufs) {
+                io_uring_sqe* sqe = io_uring_get_sqe(r);
+                io_uring_prep_write(sqe, fd, buf->data, buf->used, buf->offset);
+                io_uring_sqe_set_data(sqe, buf);
+            }
+            io_uring_submit(r);
+            bool ok = true;
+            for (int i = 0; i < bufs.size(); i++) {
+                io_uring_cqe* cqe;
+                if (io_uring_wait_cqe(r, &cqe) < 0) { return false; }
+                Buffer* buf = (Buffer*)io_uring_cqe_get_data(cqe);
+                int res = cqe->res;
+                io_uring_cqe_seen(r, cqe);
+
+                // Finish short writes synchronously
+                if (res < 0) { ok = false; continue; }
+                if (res < buf->used && !writeAll(fd, &buf->data[res], buf->used - res, buf->offset + res)) { ok = false; }
+            }
+            return ok;
+        }
+#endif
+
+#ifdef _WIN32
+        for (auto buf : bufs) {
+            if (!writeAll(fd, buf->data, buf->used, buf->offset)) { return false; }
+        }
+        return true;
+#else
+        // The queued buffers are contiguous in the file so they go out in a single call
+        std::vector<iovec> iov(bufs.size());
+        size_t total = 0;
+        for (int i = 0; i < bufs.size(); i++) {
+            iov[i].iov_base = bufs[i]->data;
+            iov[i].iov_len = bufs[i]->used;
+            total += bufs[i]->used;
+        }
+        ssize_t n = pwritev(fd, iov.data(), std::min<int>(iov.size(), IOV_MAX), bufs[0]->offset);
+        if (n < 0 && errno != EINTR) { return false; }
+        if (n == total) { return true; }
+
+        // Finish whatever wasn't written one buffer at a time
+        size_t done = std::max<ssize_t>(n, 0);
+        for (auto buf : bufs) {
+            if (done >= buf->used) {
+                done -= buf->used;
+                continue;
+            }
+            if (!writeAll(fd, &buf->data[done], buf->used - done, buf->offset + done)) { return false; }
+            done = 0;
+        }
+        return true;
+#endif
+    }
+
+    void Writer::preallocate(uint64_t end) {
+#ifdef __linux__
+        // Reserve space in large steps ahead of the data so the filesystem doesn't fragment the file
+        if (!opts.preallocate || end <= allocated) { return; }
+        uint64_t target = end + opts.preallocate;
+        if (fallocate(fd, FALLOC_FL_KEEP_SIZE, allocated, target - allocated)) {
+            // Not supported by all filesystems, don't try again
+            opts.preallocate = 0;
+            return;
+        }
+        allocated = target;
+#endif
+    }
+}
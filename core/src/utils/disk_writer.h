@@ -0,0 +1,161 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+
+namespace disk {
+    enum Backend {
+        // Regular writes going through the OS page cache
+        BACKEND_BUFFERED,
+        // Writes bypassing the page cache (O_DIRECT), Linux only
+        BACKEND_DIRECT,
+        // Like direct but with all queued buffers in flight at once through io_uring, Linux only
+        BACKEND_IO_URING
+    };
+
+    struct Options {
+        Backend backend = BACKEND_BUFFERED;
+
+        // Size of each buffer in bytes, rounded up to a multiple of the alignment
+        size_t bufferSize = 4 * 1024 * 1024;
+
+        // Number of buffers, this is how much data can pile up while the disk stalls
+        int bufferCount = 16;
+
+        // Size of the space reserved ahead of the data as the file grows, zero to disable
+        size_t preallocate = 256 * 1024 * 1024;
+    };
+
+    struct Stats {
+        // Number of writes dropped because all buffers were full
+        uint64_t overruns;
+        uint64_t droppedBytes;
+
+        // Time taken by the writes of a batch of buffers, in microseconds
+        double avgLatency;
+        double maxLatency;
+
+        // Number of buffers waiting to be written
+        int queued;
+        int bufferCount;
+    };
+
+    /**
+     * Check if a backend is available on this platform and build.
+     * @param backend Backend to check.
+     * @return True if it can be used, false otherwise.
+     */
+    bool backendSupported(Backend backend);
+
+    // Sequential file writer that never blocks the caller on the disk. Data is copied into a pool of large aligned
+    // buffers and full buffers are written by a background thread, batching whatever accumulated while the previous
+    // write was running. If the pool runs out, writes are dropped and counted instead of stalling the caller.
+    class Writer {
+    public:
+        Writer() {}
+        ~Writer();
+
+        // Not copyable since it owns the file and the buffers
+        Writer(const Writer&) = delete;
+        Writer& operator=(const Writer&) = delete;
+
+        /**
+         * Create or truncate a file and start the writer thread.
+         * @param path Path to the file.
+         * @param options Buffering and backend options.
+         * @return True on success, false otherwise.
+         */
+        bool open(const std::string& path, const Options& options = Options());
+
+        /**
+         * Check if a file is open.
+         * @return True if open, false otherwise.
+         */
+        bool isOpen();
+
+        /**
+         * Write out everything still buffered, apply the pending patches and close the file.
+         */
+        void close();
+
+        /**
+         * Append data to the file. The data is either taken whole or dropped whole.
+         * @param data Data to write.
+         * @param len Number of bytes.
+         * @param wait Wait for buffers to free up instead of dropping the data. Must not be used from DSP threads.
+         * @return True if the data was taken, false if it was dropped due to an overrun.
+         */
+        bool write(const void* data, size_t len, bool wait = false);
+
+        /**
+         * Overwrite data that was already appended, used to fill in headers. Patches are applied in memory if the
+         * data is still in the buffer being filled and otherwise when the file is closed.
+         * @param pos Offset in the file in bytes.
+         * @param data Data to write.
+         * @param len Number of bytes.
+         */
+        void patch(uint64_t pos, const void* data, size_t len);
+
+        /**
+         * Get the size of the file once all buffered data is written.
+         * @return Size in bytes.
+         */
+        uint64_t tell();
+
+        /**
+         * Get the write statistics. Can be called from any thread.
+         * @return Statistics since the file was opened.
+         */
+        Stats getStats();
+
+    private:
+        struct Buffer {
+            uint8_t* data;
+            size_t used;
+            uint64_t offset;
+        };
+
+        struct Patch {
+            uint64_t pos;
+            std::vector<uint8_t> data;
+        };
+
+        void worker();
+        bool writeBuffers(std::vector<Buffer*>& bufs);
+        void preallocate(uint64_t end);
+
+        std::mutex mtx;
+        std::condition_variable cnd;
+        std::condition_variable freeCnd;
+        std::thread workerThread;
+        bool running = false;
+        bool failed = false;
+
+        Options opts;
+        int fd = -1;
+        uint64_t position = 0;
+        uint64_t allocated = 0;
+
+        std::vector<Buffer> buffers;
+        std::vector<Buffer*> freeBuffers;
+        std::deque<Buffer*> queue;
+        Buffer* current = NULL;
+        std::vector<Patch> patches;
+
+        std::atomic<uint64_t> overruns = 0;
+        std::atomic<uint64_t> droppedBytes = 0;
+        std::atomic<double> avgLatency = 0.0;
+        std::atomic<double> maxLatency = 0.0;
+        std::atomic<int> queued = 0;
+
+#ifdef SDRPP_IO_URING
+        void* ring = NULL;
+#endif
+    };
+}
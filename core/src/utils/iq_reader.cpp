@@ -0,0 +1,295 @@
+#include <utils/iq_reader.h>
+#include <utils/iqz.h>
+#include <dsp/convert/iq_to_complex.h>
+#include <utils/flog.h>
+#include <json.hpp>
+#include <filesystem>
+#include <fstream>
+#include <algorithm>
+#include <stdexcept>
+#include <string.h>
+#include <map>
+
+using nlohmann::json;
+
+#define WAV_CODEC_PCM           1
+#define WAV_CODEC_FLOAT         3
+#define WAV_CODEC_EXTENSIBLE    0xFFFE
+
+MappedIQReader::MappedIQReader(std::shared_ptr<MappedFile> file, size_t offset, size_t size, const IQFileInfo& info) {
+    this->file = file;
+    this->info = info;
+    samples = file->data() + offset;
+    bytesPerSample = sampleFormatSize(info.format);
+    sampleCount = size / bytesPerSample;
+    file->adviseSequential();
+}
+
+int MappedIQReader::read(dsp::complex_t* out, int count) {
+    int64_t pos = position;
+    count = std::min<int64_t>(count, sampleCount - pos);
+    if (count <= 0) { return 0; }
+
+    // Convert straight from the mapping into the output
+    const uint8_t* in = &samples[pos * bytesPerSample];
+    switch (info.format) {
+    case SAMPLE_FORMAT_U8:
+        dsp::convert::u8ToComplex(count, in, out, 1.0f / 128.0f, { 128.0f, 128.0f });
+        break;
+    case SAMPLE_FORMAT_S8:
+        dsp::convert::s8ToComplex(count, (const int8_t*)in, out);
+        break;
+    case SAMPLE_FORMAT_S16:
+        dsp::convert::s16ToComplex(count, (const int16_t*)in, out);
+        break;
+    case SAMPLE_FORMAT_S24:
+        dsp::convert::s24ToComplex(count, in, out);
+        break;
+    case SAMPLE_FORMAT_S32:
+        dsp::convert::s32ToComplex(count, (const int32_t*)in, out);
+        break;
+    case SAMPLE_FORMAT_F32:
+        memcpy(out, in, count * sizeof(dsp::complex_t));
+        break;
+    }
+
+    position = pos + count;
+    return count;
+}
+
+void MappedIQReader::seek(int64_t sample) {
+    position = std::clamp<int64_t>(sample, 0, sampleCount);
+}
+
+int sampleFormatSize(SampleFormat format) {
+    switch (format) {
+    case SAMPLE_FORMAT_U8:
+    case SAMPLE_FORMAT_S8:
+        return 2;
+    case SAMPLE_FORMAT_S16:
+        return 4;
+    case SAMPLE_FORMAT_S24:
+        return 6;
+    case SAMPLE_FORMAT_S32:
+    case SAMPLE_FORMAT_F32:
+        return 8;
+    }
+    return 0;
+}
+
+static uint16_t readU16(const uint8_t* p) {
+    return (uint16_t)p[0] | ((uint16_t)p[1] << 8);
+}
+
+static uint32_t readU32(const uint8_t* p) {
+    return (uint32_t)readU16(p) | ((uint32_t)readU16(&p[2]) << 16);
+}
+
+static uint64_t readU64(const uint8_t* p) {
+    return (uint64_t)readU32(p) | ((uint64_t)readU32(&p[4]) << 32);
+}
+
+static bool isWav(std::shared_ptr<MappedFile> file) {
+    if (file->size() < 12) { return false; }
+    const char* d = (const char*)file->data();
+    bool riff = !memcmp(d, "RIFF", 4) || !memcmp(d, "RF64", 4) || !memcmp(d, "BW64", 4);
+    return riff && !memcmp(&d[8], "WAVE", 4);
+}
+
+static std::unique_ptr<IQReader> openWav(std::shared_ptr<MappedFile> file) {
+    const uint8_t* d = file->data();
+    size_t size = file->size();
+    IQFileInfo info;
+    info.container = memcmp(d, "RIFF", 4) ? std::string((const char*)d, 4) : "WAV";
+
+    // Go through all chunks
+    uint64_t ds64DataSize = 0;
+    uint16_t codec = 0, channels = 0, bitDepth = 0;
+    uint32_t sampleRate = 0;
+    size_t dataOffset = 0, dataSize = 0;
+    bool hasFormat = false, hasData = false;
+    size_t pos = 12;
+    while (pos + 8 <= size) {
+        const char* id = (const char*)&d[pos];
+        uint64_t chunkSize = readU32(&d[pos + 4]);
+        size_t body = pos + 8;
+        size_t left = size - body;
+
+        if (!memcmp(id, "ds64", 4) && chunkSize >= 16 && left >= 16) {
+            // 64bit sizes of RF64 files
+            ds64DataSize = readU64(&d[body + 8]);
+        }
+        else if (!memcmp(id, "fmt ", 4) && chunkSize >= 16 && left >= 16) {
+            codec = readU16(&d[body]);
+            channels = readU16(&d[body + 2]);
+            sampleRate = readU32(&d[body + 4]);
+            bitDepth = readU16(&d[body + 14]);
+
+            // The actual codec is at the start of the sub-format GUID
+            if (codec == WAV_CODEC_EXTENSIBLE && chunkSize >= 26 && left >= 26) {
+                codec = readU16(&d[body + 24]);
+            }
+            hasFormat = true;
+        }
+        else if (!memcmp(id, "auxi", 4) && chunkSize >= 36 && left >= 36) {
+            // SpectraVue style metadata, the center frequency follows the start and stop times
+            uint32_t freq = readU32(&d[body + 32]);
+            if (freq) {
+                info.frequency = freq;
+                info.frequencyKnown = true;
+            }
+        }
+        else if (!memcmp(id, "data", 4)) {
+            // RF64 files have the real size in the ds64 chunk. Also use the rest of the file if the size was never written.
+            if (chunkSize == 0xFFFFFFFF) { chunkSize = ds64DataSize ? ds64DataSize : left; }
+            if (!chunkSize) { chunkSize = left; }
+            dataOffset = body;
+            dataSize = std::min<uint64_t>(chunkSize, left);
+            hasData = true;
+        }
+
+        // Chunks are padded to an even size
+        if (chunkSize >= left) { break; }
+        pos = body + chunkSize + (chunkSize & 1);
+    }
+
+    // Check that the file is usable
+    if (!hasFormat) { throw std::runtime_error("WAV file has no format chunk"); }
+    if (!hasData) { throw std::runtime_error("WAV file has no data chunk"); }
+    if (channels != 2) { throw std::runtime_error("WAV file isn't IQ, it must have two channels"); }
+    if (!sampleRate) { throw std::runtime_error("Sample rate may not be zero"); }
+    if (codec == WAV_CODEC_PCM && bitDepth == 8) {
+        info.format = SAMPLE_FORMAT_U8;
+    }
+    else if (codec == WAV_CODEC_PCM && bitDepth == 16) {
+        info.format = SAMPLE_FORMAT_S16;
+    }
+    else if (codec == WAV_CODEC_PCM && bitDepth == 24) {
+        info.format = SAMPLE_FORMAT_S24;
+    }
+    else if (codec == WAV_CODEC_PCM && bitDepth == 32) {
+        info.format = SAMPLE_FORMAT_S32;
+    }
+    else if (codec == WAV_CODEC_FLOAT && bitDepth == 32) {
+        info.format = SAMPLE_FORMAT_F32;
+    }
+    else {
+        throw std::runtime_error("Unsupported WAV sample format");
+    }
+    info.sampleRate = sampleRate;
+
+    return std::make_unique<MappedIQReader>(file, dataOffset, dataSize, info);
+}
+
+static std::unique_ptr<IQReader> openSigMF(const std::string& metaPath, const std::string& dataPath) {
+    // Load metadata
+    json meta;
+    try {
+        std::ifstream file(metaPath);
+        file >> meta;
+    }
+    catch (const std::exception& e) {
+        throw std::runtime_error("Could not parse SigMF metadata: " + std::string(e.what()));
+    }
+    if (!meta.contains("global") || !meta["global"].contains("core:datatype") || !meta["global"].contains("core:sample_rate")) {
+        throw std::runtime_error("SigMF metadata is missing the datatype or sample rate");
+    }
+
+    // Decode the datatype, only complex little endian formats are supported
+    const std::map<std::string, SampleFormat> datatypes = {
+        { "cu8", SAMPLE_FORMAT_U8 },
+        { "cu8_le", SAMPLE_FORMAT_U8 },
+        { "ci8", SAMPLE_FORMAT_S8 },
+        { "ci8_le", SAMPLE_FORMAT_S8 },
+        { "ci16_le", SAMPLE_FORMAT_S16 },
+        { "ci32_le", SAMPLE_FORMAT_S32 },
+        { "cf32_le", SAMPLE_FORMAT_F32 }
+    };
+    std::string datatype = meta["global"]["core:datatype"];
+    auto it = datatypes.find(datatype);
+    if (it == datatypes.end()) { throw std::runtime_error("Unsupported SigMF datatype: " + datatype); }
+
+    IQFileInfo info;
+    info.container = "SigMF";
+    info.format = it->second;
+    info.sampleRate = meta["global"]["core:sample_rate"];
+    if (info.sampleRate <= 0.0) { throw std::runtime_error("Sample rate may not be zero"); }
+
+    // Get the frequency and header size from the first capture
+    size_t headerBytes = 0;
+    if (meta.contains("captures") && meta["captures"].is_array() && !meta["captures"].empty()) {
+        json& cap = meta["captures"][0];
+        if (cap.contains("core:frequency")) {
+            info.frequency = cap["core:frequency"];
+            info.frequencyKnown = true;
+        }
+        if (cap.contains("core:header_bytes")) {
+            headerBytes = cap["core:header_bytes"];
+        }
+    }
+
+    // Map the data
+    auto file = std::make_shared<MappedFile>(dataPath);
+    if (headerBytes > file->size()) { throw std::runtime_error("SigMF header is larger than the data file"); }
+    return std::make_unique<MappedIQReader>(file, headerBytes, file->size() - headerBytes, info);
+}
+
+static std::unique_ptr<IQReader> openRaw(std::shared_ptr<MappedFile> file, const std::string& ext, SampleFormat rawFormat, double rawSamplerate) {
+    const std::map<std::string, SampleFormat> extensions = {
+        { ".cu8", SAMPLE_FORMAT_U8 },
+        { ".cs8", SAMPLE_FORMAT_S8 },
+        { ".cs16", SAMPLE_FORMAT_S16 },
+        { ".cs32", SAMPLE_FORMAT_S32 },
+        { ".cf32", SAMPLE_FORMAT_F32 },
+        { ".fc32", SAMPLE_FORMAT_F32 },
+        { ".cfile", SAMPLE_FORMAT_F32 }
+    };
+
+    IQFileInfo info;
+    info.container = "Raw";
+    auto it = extensions.find(ext);
+    if (it != extensions.end()) {
+        info.format = it->second;
+    }
+    else {
+        info.format = rawFormat;
+        info.userFormat = true;
+    }
+    info.sampleRate = rawSamplerate;
+    info.userSampleRate = true;
+    if (info.sampleRate <= 0.0) { throw std::runtime_error("Sample rate may not be zero"); }
+
+    return std::make_unique<MappedIQReader>(file, 0, file->size(), info);
+}
+
+std::unique_ptr<IQReader> openIQFile(const std::string& path, SampleFormat rawFormat, double rawSamplerate) {
+    std::filesystem::path fpath = std::filesystem::path(path);
+    std::string ext = fpath.extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+
+    // SigMF recordings can be opened with either of their files
+    if (ext == ".sigmf-meta") {
+        return openSigMF(path, std::filesystem::path(fpath).replace_extension(".sigmf-data").string());
+    }
+    if (ext == ".sigmf-data") {
+        return openSigMF(std::filesystem::path(fpath).replace_extension(".sigmf-meta").string(), path);
+    }
+
+    // WAV and IQZ files are recognized by their header
+    auto file = std::make_shared<MappedFile>(path);
+    if (isWav(file)) {
+        return openWav(file);
+    }
+    if (iqz::isIQZ(file->data(), file->size())) {
+        return std::make_unique<iqz::Reader>(file);
+    }
+
+    // Raw files may have a SigMF sidecar with their metadata
+    std::filesystem::path sidecar = std::filesystem::path(fpath).replace_extension(".sigmf-meta");
+    if (std::filesystem::exists(sidecar)) {
+        flog::info("Using SigMF metadata from '{}'", sidecar.string());
+        return openSigMF(sidecar.string(), path);
+    }
+
+    return openRaw(file, ext, rawFormat, rawSamplerate);
+}
@@ -0,0 +1,112 @@
+#pragma once
+#include <dsp/types.h>
+#include <stdint.h>
+#include <string>
+#include <memory>
+#include <atomic>
+#include <utils/mapped_file.h>
+
+enum SampleFormat {
+    SAMPLE_FORMAT_U8,
+    SAMPLE_FORMAT_S8,
+    SAMPLE_FORMAT_S16,
+    SAMPLE_FORMAT_S24,
+    SAMPLE_FORMAT_S32,
+    SAMPLE_FORMAT_F32
+};
+
+struct IQFileInfo {
+    // Container name shown to the user
+    std::string container;
+
+    SampleFormat format = SAMPLE_FORMAT_S16;
+    double sampleRate = 0.0;
+    double frequency = 0.0;
+    bool frequencyKnown = false;
+
+    // Set when the file has no metadata and the user provided settings were used instead
+    bool userFormat = false;
+    bool userSampleRate = false;
+};
+
+class IQReader {
+public:
+    virtual ~IQReader() {}
+
+    /**
+     * Read samples from the current position.
+     * @param out Output buffer.
+     * @param count Maximum number of samples to read.
+     * @return Number of samples read, zero if the end of the file was reached.
+     */
+    virtual int read(dsp::complex_t* out, int count) = 0;
+
+    /**
+     * Move the read position.
+     * @param sample Index of the next sample to read. Clamped to the file.
+     */
+    virtual void seek(int64_t sample) = 0;
+
+    /**
+     * Get the read position. Can be called from any thread.
+     * @return Index of the next sample to be read.
+     */
+    int64_t tell() { return position; }
+
+    /**
+     * Get the total number of samples in the file.
+     * @return Number of samples.
+     */
+    int64_t getSampleCount() { return sampleCount; }
+
+    /**
+     * Get the information about the file.
+     * @return File information.
+     */
+    const IQFileInfo& getInfo() { return info; }
+
+protected:
+    IQFileInfo info;
+    int64_t sampleCount = 0;
+    std::atomic<int64_t> position = 0;
+};
+
+// Reader for files that store uncompressed samples in a single contiguous region
+class MappedIQReader : public IQReader {
+public:
+    /**
+     * Create a reader.
+     * @param file Mapped file.
+     * @param offset Offset of the first sample in bytes.
+     * @param size Size of the sample data in bytes.
+     * @param info Information about the file.
+     */
+    MappedIQReader(std::shared_ptr<MappedFile> file, size_t offset, size_t size, const IQFileInfo& info);
+
+    int read(dsp::complex_t* out, int count);
+    void seek(int64_t sample);
+
+private:
+    std::shared_ptr<MappedFile> file;
+    const uint8_t* samples;
+    int bytesPerSample;
+};
+
+/**
+ * Get the size of a complex sample in a given format.
+ * @param format Sample format.
+ * @return Size in bytes.
+ */
+int sampleFormatSize(SampleFormat format);
+
+/**
+ * Open an IQ file. Supported are WAV (including RF64 and BW64), IQZ, SigMF recordings and raw files. Raw files use the
+ * metadata from a SigMF sidecar file of the same name if there is one, otherwise their format is guessed from the
+ * extension (.cu8, .cs8, .cs16, .cf32) or given by the user along with the samplerate.
+ * Throws an std::runtime_error if the file can't be opened.
+ * @param path Path to the file.
+ * @param rawFormat Sample format for raw files with no metadata and no known extension.
+ * @param rawSamplerate Samplerate for raw files with no metadata.
+ * @return Reader for the file.
+ */
+std::unique_ptr<IQReader> openIQFile(const std::string& path, SampleFormat rawFormat, double rawSamplerate);
@@ -0,0 +1,734 @@
+#include "iqz.h"
+#include <utils/flog.h>
+#include <zstd.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <stdexcept>
+
+#define IQZ_VERSION             1
+#define IQZ_LPC_MAX_ORDER       3
+#define IQZ_RICE_PARTITION      4096
+#define IQZ_RICE_PARAM_BITS     5
+#define IQZ_RICE_ESCAPE         24
+#define IQZ_MAX_BLOCK_SIZE      (1 << 20)
+
+namespace iqz {
+    const char FILE_MAGIC[4]    = { 'S', 'I', 'Q', 'Z' };
+    const char BLOCK_MAGIC[4]   = { 'I', 'Q', 'Z', 'B' };
+    const char INDEX_MAGIC[4]   = { 'S', 'I', 'Q', 'X' };
+
+    // MSB first bit packer used by the Rice coder
+    class BitWriter {
+    public:
+        BitWriter(std::vector<uint8_t>& out) : out(out) {}
+
+        inline void put(uint32_t bits, int n) {
+            acc = (acc << n) | bits;
+            nbits += n;
+            while (nbits >= 8) {
+                nbits -= 8;
+                out.push_back(acc >> nbits);
+            }
+            acc &= (1ull << nbits) - 1;
+        }
+
+        void flush() {
+            if (nbits) { out.push_back(acc << (8 - nbits)); }
+            acc = 0;
+            nbits = 0;
+        }
+
+    private:
+        std::vector<uint8_t>& out;
+        uint64_t acc = 0;
+        int nbits = 0;
+    };
+
+    class BitReader {
+    public:
+        BitReader(const uint8_t* data, size_t size) : data(data), end(data + size) {}
+
+        inline uint32_t get(int n) {
+            if (!n) { return 0; }
+            refill();
+            nbits -= n;
+            return (acc >> nbits) & ((1ull << n) - 1);
+        }
+
+        // Count zero bits up to a limit and consume them
+        inline int zeros(int limit) {
+            refill();
+            int count = 0;
+            while (count < limit && nbits && !((acc >> (nbits - 1)) & 1)) {
+                nbits--;
+                count++;
+                if (!nbits) { refill(); }
+            }
+            return count;
+        }
+
+        // True if more bits were read than there were in the data, the zero padding sits at the bottom of the accumulator
+        bool overrun() { return nbits < padding * 8; }
+
+    private:
+        inline void refill() {
+            while (nbits <= 56) {
+                if (data < end) {
+                    acc = (acc << 8) | *data++;
+                }
+                else {
+                    // Pad with zeros past the end, tracked so that corrupt blocks can be detected
+                    acc <<= 8;
+                    padding++;
+                }
+                nbits += 8;
+            }
+        }
+
+        const uint8_t* data;
+        const uint8_t* end;
+        uint64_t acc = 0;
+        int nbits = 0;
+        int padding = 0;
+    };
+
+    static inline uint32_t zigzag(int32_t v) {
+        return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+    }
+
+    static inline int32_t unzigzag(uint32_t u) {
+        return (int32_t)(u >> 1) ^ -(int32_t)(u & 1);
+    }
+
+    // Fixed polynomial predictors as used by FLAC, the first samples use a lower order since they lack history
+    static inline int32_t predict(const int32_t* x, int n, int order) {
+        switch (std::min<int>(n, order)) {
+        case 1: return x[n - 1];
+        case 2: return 2 * x[n - 1] - x[n - 2];
+        case 3: return 3 * x[n - 1] - 3 * x[n - 2] + x[n - 3];
+        default: return 0;
+        }
+    }
+
+    static int bestOrder(const int32_t* x, int count) {
+        uint64_t err[IQZ_LPC_MAX_ORDER + 1] = { 0 };
+        for (int n = IQZ_LPC_MAX_ORDER; n < count; n++) {
+            int32_t d0 = x[n];
+            int32_t d1 = d0 - x[n - 1];
+            int32_t d2 = d1 - (x[n - 1] - x[n - 2]);
+            int32_t d3 = d2 - ((x[n - 1] - x[n - 2]) - (x[n - 2] - x[n - 3]));
+            err[0] += abs(d0);
+            err[1] += abs(d1);
+            err[2] += abs(d2);
+            err[3] += abs(d3);
+        }
+        return std::min_element(err, err + IQZ_LPC_MAX_ORDER + 1) - err;
+    }
+
+    static void encodeResiduals(const int32_t* x, int count, int order, BitWriter& bw, std::vector<uint32_t>& res) {
+        // Compute all residuals first since the Rice parameter depends on their mean
+        res.resize(count);
+        for (int n = 0; n < count; n++) {
+            res[n] = zigzag(x[n] - predict(x, n, order));
+        }
+
+        for (int p = 0; p < count; p += IQZ_RICE_PARTITION) {
+            int len = std::min<int>(IQZ_RICE_PARTITION, count - p);
+            const uint32_t* u = &res[p];
+
+            // Pick the parameter closest to the log2 of the mean
+            uint64_t sum = 0;
+            for (int i = 0; i < len; i++) { sum += u[i]; }
+            int k = 0;
+            while (k < 30 && ((uint64_t)len << (k + 1)) <= sum) { k++; }
+            bw.put(k, IQZ_RICE_PARAM_BITS);
+
+            for (int i = 0; i < len; i++) {
+                uint32_t q = u[i] >> k;
+                if (q < IQZ_RICE_ESCAPE) {
+                    bw.put(1, q + 1);
+                    bw.put(u[i] & ((1u << k) - 1), k);
+                }
+                else {
+                    // Values far from the mean are stored verbatim
+                    bw.put(0, IQZ_RICE_ESCAPE);
+                    bw.put(u[i], 32);
+                }
+            }
+        }
+    }
+
+    static void decodeResiduals(int32_t* x, int count, int order, BitReader& br) {
+        for (int p = 0; p < count; p += IQZ_RICE_PARTITION) {
+            int len = std::min<int>(IQZ_RICE_PARTITION, count - p);
+            int k = br.get(IQZ_RICE_PARAM_BITS);
+            for (int i = p; i < p + len; i++) {
+                uint32_t u;
+                int q = br.zeros(IQZ_RICE_ESCAPE);
+                if (q < IQZ_RICE_ESCAPE) {
+                    br.get(1);
+                    u = ((uint32_t)q << k) | br.get(k);
+                }
+                else {
+                    u = br.get(32);
+                }
+                x[i] = unzigzag(u) + predict(x, i, order);
+            }
+        }
+    }
+
+    static int pcmSize(dsp::compression::PCMType pcmType) {
+        switch (pcmType) {
+        case dsp::compression::PCM_TYPE_I8: return sizeof(int8_t);
+        case dsp::compression::PCM_TYPE_I16: return sizeof(int16_t);
+        case dsp::compression::PCM_TYPE_F32: return sizeof(float);
+        }
+        return 0;
+    }
+
+    template <class T>
+    static void quantize(const float* in, int count, float scale, T* out) {
+        float inv = 1.0f / scale;
+        for (int i = 0; i < count; i++) {
+            float v = in[i] * inv;
+            out[i] = (T)(v + ((v >= 0.0f) ? 0.5f : -0.5f));
+        }
+    }
+
+    template <class T>
+    static void dequantize(const T* in, int count, float scale, float* out) {
+        for (int i = 0; i < count; i++) {
+            out[i] = (float)in[i] * scale;
+        }
+    }
+
+    bool isIQZ(const uint8_t* data, size_t size) {
+        return size >= sizeof(FileHeader) && !memcmp(data, FILE_MAGIC, sizeof(FILE_MAGIC));
+    }
+
+    void encodeBlock(const dsp::complex_t* in, int count, dsp::compression::PCMType pcmType, Entropy entropy, int zstdLevel, std::vector<uint8_t>& out) {
+        const float* fin = (const float*)in;
+        int values = count * 2;
+
+        // Float samples can't go through the integer predictor
+        if (pcmType == dsp::compression::PCM_TYPE_F32 && entropy == ENTROPY_LPC) { entropy = ENTROPY_ZSTD; }
+
+        BlockHeader hdr;
+        memcpy(hdr.magic, BLOCK_MAGIC, sizeof(hdr.magic));
+        hdr.sampleCount = count;
+        hdr.pcmType = pcmType;
+        hdr.entropy = entropy;
+        hdr.orderI = 0;
+        hdr.orderQ = 0;
+        hdr.scale = 1.0f;
+
+        // Scale the block so that its peak uses the full range of the integer type
+        if (pcmType != dsp::compression::PCM_TYPE_F32) {
+            float peak = 0.0f;
+            for (int i = 0; i < values; i++) { peak = std::max<float>(peak, fabsf(fin[i])); }
+            float maxVal = (pcmType == dsp::compression::PCM_TYPE_I8) ? 127.0f : 32767.0f;
+            if (peak > 0.0f) { hdr.scale = peak / maxVal; }
+        }
+
+        out.resize(sizeof(BlockHeader));
+        if (entropy == ENTROPY_LPC) {
+            // Quantize each channel separately so that the predictor sees a continuous signal
+            std::vector<int32_t> ch(values);
+            int32_t* chI = ch.data();
+            int32_t* chQ = &ch[count];
+            float inv = 1.0f / hdr.scale;
+            for (int i = 0; i < count; i++) {
+                float vi = in[i].re * inv;
+                float vq = in[i].im * inv;
+                chI[i] = (int32_t)(vi + ((vi >= 0.0f) ? 0.5f : -0.5f));
+                chQ[i] = (int32_t)(vq + ((vq >= 0.0f) ? 0.5f : -0.5f));
+            }
+            hdr.orderI = bestOrder(chI, count);
+            hdr.orderQ = bestOrder(chQ, count);
+
+            BitWriter bw(out);
+            std::vector<uint32_t> res;
+            encodeResiduals(chI, count, hdr.orderI, bw, res);
+            encodeResiduals(chQ, count, hdr.orderQ, bw, res);
+            bw.flush();
+        }
+        else {
+            // Quantize into the output directly
+            size_t rawSize = values * pcmSize(pcmType);
+            std::vector<uint8_t> raw;
+            uint8_t* dst;
+            if (entropy == ENTROPY_ZSTD) {
+                raw.resize(rawSize);
+                dst = raw.data();
+            }
+            else {
+                out.resize(sizeof(BlockHeader) + rawSize);
+                dst = &out[sizeof(BlockHeader)];
+            }
+            switch (pcmType) {
+            case dsp::compression::PCM_TYPE_I8:
+                quantize<int8_t>(fin, values, hdr.scale, (int8_t*)dst);
+                break;
+            case dsp::compression::PCM_TYPE_I16:
+                quantize<int16_t>(fin, values, hdr.scale, (int16_t*)dst);
+                break;
+            case dsp::compression::PCM_TYPE_F32:
+                memcpy(dst, fin, rawSize);
+                break;
+            }
+
+            if (entropy == ENTROPY_ZSTD) {
+                out.resize(sizeof(BlockHeader) + ZSTD_compressBound(rawSize));
+                size_t size = ZSTD_compress(&out[sizeof(BlockHeader)], out.size() - sizeof(BlockHeader), raw.data(), rawSize, zstdLevel);
+                if (ZSTD_isError(size)) { throw std::runtime_error("Failed to compress block"); }
+                out.resize(sizeof(BlockHeader) + size);
+            }
+        }
+
+        hdr.payloadSize = out.size() - sizeof(BlockHeader);
+        memcpy(out.data(), &hdr, sizeof(BlockHeader));
+    }
+
+    int decodeBlock(const uint8_t* block, size_t size, dsp::complex_t* out) {
+        if (size < sizeof(BlockHeader)) { throw std::runtime_error("Truncated block"); }
+        BlockHeader hdr;
+        memcpy(&hdr, block, sizeof(BlockHeader));
+        if (memcmp(hdr.magic, BLOCK_MAGIC, sizeof(hdr.magic))) { throw std::runtime_error("Invalid block"); }
+        if (hdr.payloadSize > size - sizeof(BlockHeader)) { throw std::runtime_error("Truncated block"); }
+        if (hdr.pcmType > dsp::compression::PCM_TYPE_F32 || hdr.entropy > ENTROPY_LPC) { throw std::runtime_error("Unknown block encoding"); }
+        if (hdr.orderI > IQZ_LPC_MAX_ORDER || hdr.orderQ > IQZ_LPC_MAX_ORDER) { throw std::runtime_error("Invalid predictor order"); }
+        if (hdr.sampleCount > IQZ_MAX_BLOCK_SIZE) { throw std::runtime_error("Invalid block size"); }
+        const uint8_t* payload = &block[sizeof(BlockHeader)];
+        int count = hdr.sampleCount;
+        int values = count * 2;
+        float* fout = (float*)out;
+        dsp::compression::PCMType pcmType = (dsp::compression::PCMType)hdr.pcmType;
+
+        if (hdr.entropy == ENTROPY_LPC) {
+            std::vector<int32_t> ch(values);
+            int32_t* chI = ch.data();
+            int32_t* chQ = &ch[count];
+            BitReader br(payload, hdr.payloadSize);
+            decodeResiduals(chI, count, hdr.orderI, br);
+            decodeResiduals(chQ, count, hdr.orderQ, br);
+            if (br.overrun()) { throw std::runtime_error("Corrupt block"); }
+            for (int i = 0; i < count; i++) {
+                out[i].re = (float)chI[i] * hdr.scale;
+                out[i].im = (float)chQ[i] * hdr.scale;
+            }
+            return count;
+        }
+
+        // Undo zstd if needed
+        size_t rawSize = values * pcmSize(pcmType);
+        std::vector<uint8_t> raw;
+        const uint8_t* src = payload;
+        if (hdr.entropy == ENTROPY_ZSTD) {
+            raw.resize(rawSize);
+            size_t dsize = ZSTD_decompress(raw.data(), rawSize, payload, hdr.payloadSize);
+            if (ZSTD_isError(dsize) || dsize != rawSize) { throw std::runtime_error("Corrupt block"); }
+            src = raw.data();
+        }
+        else if (hdr.payloadSize != rawSize) {
+            throw std::runtime_error("Corrupt block");
+        }
+
+        switch (pcmType) {
+        case dsp::compression::PCM_TYPE_I8:
+            dequantize<int8_t>((const int8_t*)src, values, hdr.scale, fout);
+            break;
+        case dsp::compression::PCM_TYPE_I16:
+            dequantize<int16_t>((const int16_t*)src, values, hdr.scale, fout);
+            break;
+        case dsp::compression::PCM_TYPE_F32:
+            memcpy(fout, src, rawSize);
+            break;
+        }
+        return count;
+    }
+
+    Writer::~Writer() {
+        close();
+    }
+
+    bool Writer::open(const std::string& path, double sampleRate, double frequency, const Options& options, const disk::Options& diskOptions) {
+        close();
+        opts = options;
+        opts.blockSize = std::clamp<int>(opts.blockSize, 1024, IQZ_MAX_BLOCK_SIZE);
+        opts.queueSize = std::max<int>(opts.queueSize, 2);
+        if (opts.threads <= 0) { opts.threads = std::max<int>(std::thread::hardware_concurrency() / 2, 1); }
+
+        if (!file.open(path, diskOptions)) { return false; }
+
+        // Write the file header
+        FileHeader hdr;
+        memset(&hdr, 0, sizeof(FileHeader));
+        memcpy(hdr.magic, FILE_MAGIC, sizeof(hdr.magic));
+        hdr.version = IQZ_VERSION;
+        hdr.headerSize = sizeof(FileHeader);
+        hdr.sampleRate = sampleRate;
+        hdr.frequency = frequency;
+        hdr.blockSize = opts.blockSize;
+        hdr.pcmType = opts.pcmType;
+        hdr.entropy = opts.entropy;
+        file.write(&hdr, sizeof(FileHeader), true);
+
+        // Allocate the blocks
+        jobs.clear();
+        freeJobs.clear();
+        for (int i = 0; i < opts.queueSize; i++) {
+            jobs.push_back(std::make_unique<Job>());
+            jobs.back()->samples.reserve(opts.blockSize);
+            freeJobs.push_back(jobs.back().get());
+        }
+
+        // Reset state
+        current = NULL;
+        index.clear();
+        fileSamples = 0;
+        samplesWritten = 0;
+        overruns = 0;
+        inputBytes = 0;
+        outputBytes = sizeof(FileHeader);
+
+        // Start encoders
+        running = true;
+        for (int i = 0; i < opts.threads; i++) {
+            workers.push_back(std::thread(&Writer::worker, this));
+        }
+
+        return true;
+    }
+
+    bool Writer::isOpen() {
+        return file.isOpen();
+    }
+
+    void Writer::close() {
+        // Queue the last partial block and let the encoders finish
+        {
+            std::lock_guard<std::mutex> lck(mtx);
+            if (!running) { return; }
+            if (current && !current->samples.empty()) { submit(); }
+            running = false;
+        }
+        cnd.notify_all();
+        for (auto& w : workers) { w.join(); }
+        workers.clear();
+        writeCompleted();
+
+        // Write the seek index and the footer pointing to it
+        Footer footer;
+        footer.indexOffset = file.tell();
+        footer.blockCount = index.size();
+        footer.sampleCount = fileSamples;
+        memcpy(footer.magic, INDEX_MAGIC, sizeof(footer.magic));
+        footer.reserved = 0;
+        file.write(index.data(), index.size() * sizeof(IndexEntry), true);
+        file.write(&footer, sizeof(Footer), true);
+        file.close();
+
+        std::lock_guard<std::mutex> lck(mtx);
+        current = NULL;
+        pending.clear();
+        inFlight.clear();
+        freeJobs.clear();
+        jobs.clear();
+    }
+
+    bool Writer::write(const dsp::complex_t* data, int count) {
+        std::lock_guard<std::mutex> lck(mtx);
+        if (!running) { return false; }
+
+        // Drop the samples if they don't fit in the free blocks, the caller must never wait on the encoders
+        size_t space = current ? (opts.blockSize - current->samples.size()) : 0;
+        space += freeJobs.size() * opts.blockSize;
+        if (count > space) {
+            overruns++;
+            return false;
+        }
+
+        while (count) {
+            if (!current) {
+                current = freeJobs.back();
+                freeJobs.pop_back();
+                current->samples.clear();
+            }
+            int n = std::min<int>(count, opts.blockSize - current->samples.size());
+            current->samples.insert(current->samples.end(), data, data + n);
+            data += n;
+            count -= n;
+            samplesWritten += n;
+            inputBytes += n * sizeof(dsp::complex_t);
+            if (current->samples.size() == opts.blockSize) { submit(); }
+        }
+        return true;
+    }
+
+    Stats Writer::getStats() {
+        Stats stats;
+        stats.overruns = overruns;
+        stats.inputBytes = inputBytes;
+        stats.outputBytes = outputBytes;
+        stats.disk = file.getStats();
+        return stats;
+    }
+
+    void Writer::submit() {
+        // Must be called with the mutex locked
+        current->done = false;
+        pending.push_back(current);
+        inFlight.push_back(current);
+        current = NULL;
+        cnd.notify_one();
+    }
+
+    void Writer::worker() {
+        while (true) {
+            Job* job;
+            {
+                std::unique_lock<std::mutex> lck(mtx);
+                cnd.wait(lck, [this]() { return !pending.empty() || !running; });
+                if (pending.empty()) { return; }
+                job = pending.front();
+                pending.pop_front();
+            }
+
+            try {
+                encodeBlock(job->samples.data(), job->samples.size(), opts.pcmType, opts.entropy, opts.zstdLevel, job->encoded);
+            }
+            catch (const std::exception& e) {
+                flog::error("Could not encode IQZ block: {}", e.what());
+                job->encoded.clear();
+            }
+
+            {
+                std::lock_guard<std::mutex> lck(mtx);
+                job->done = true;
+            }
+            writeCompleted();
+        }
+    }
+
+    void Writer::writeCompleted() {
+        // Blocks can finish out of order, only the oldest ones that are done get written
+        std::lock_guard<std::mutex> outLck(outMtx);
+        while (true) {
+            Job* job;
+            {
+                std::lock_guard<std::mutex> lck(mtx);
+                if (inFlight.empty() || !inFlight.front()->done) { return; }
+                job = inFlight.front();
+                inFlight.pop_front();
+            }
+
+            // Encoder threads may wait on the disk, the samples pile up in the blocks instead
+            if (!job->encoded.empty()) {
+                IndexEntry entry;
+                entry.offset = file.tell();
+                entry.firstSample = fileSamples;
+                file.write(job->encoded.data(), job->encoded.size(), true);
+                index.push_back(entry);
+                fileSamples += job->samples.size();
+                outputBytes += job->encoded.size();
+            }
+
+            std::lock_guard<std::mutex> lck(mtx);
+            freeJobs.push_back(job);
+        }
+    }
+
+    Reader::Reader(std::shared_ptr<MappedFile> file) {
+        this->file = file;
+        const uint8_t* data = file->data();
+        size_t size = file->size();
+        if (!isIQZ(data, size)) { throw std::runtime_error("Not an IQZ file"); }
+
+        FileHeader hdr;
+        memcpy(&hdr, data, sizeof(FileHeader));
+        if (hdr.version != IQZ_VERSION) { throw std::runtime_error("Unsupported IQZ version"); }
+        if (hdr.headerSize < sizeof(FileHeader) || hdr.headerSize > size) { throw std::runtime_error("Invalid IQZ header"); }
+        if (hdr.sampleRate <= 0.0) { throw std::runtime_error("Sample rate may not be zero"); }
+
+        info.container = "IQZ";
+        info.sampleRate = hdr.sampleRate;
+        info.frequency = hdr.frequency;
+        info.frequencyKnown = (hdr.frequency != 0.0);
+        switch (hdr.pcmType) {
+        case dsp::compression::PCM_TYPE_I8: info.format = SAMPLE_FORMAT_S8; break;
+        case dsp::compression::PCM_TYPE_I16: info.format = SAMPLE_FORMAT_S16; break;
+        default: info.format = SAMPLE_FORMAT_F32; break;
+        }
+
+        // Use the index if the file was closed properly, otherwise scan the blocks
+        Footer footer;
+        bool hasIndex = false;
+        if (size >= hdr.headerSize + sizeof(Footer)) {
+            memcpy(&footer, &data[size - sizeof(Footer)], sizeof(Footer));
+            hasIndex = !memcmp(footer.magic, INDEX_MAGIC, sizeof(footer.magic)) && footer.indexOffset >= hdr.headerSize &&
+                       footer.indexOffset <= size - sizeof(Footer) &&
+                       footer.blockCount == (size - sizeof(Footer) - footer.indexOffset) / sizeof(IndexEntry) &&
+                       footer.indexOffset + footer.blockCount * sizeof(IndexEntry) + sizeof(Footer) == size;
+        }
+        if (hasIndex) {
+            index.resize(footer.blockCount);
+            memcpy(index.data(), &data[footer.indexOffset], footer.blockCount * sizeof(IndexEntry));
+
+            // The workers trust the index, so every block it points to must lie within the file before the index
+            uint64_t samples = 0;
+            for (const auto& entry : index) {
+                if (entry.offset < hdr.headerSize || entry.offset > footer.indexOffset || footer.indexOffset - entry.offset < sizeof(BlockHeader)) {
+                    throw std::runtime_error("Invalid IQZ index");
+                }
+                BlockHeader bhdr;
+                memcpy(&bhdr, &data[entry.offset], sizeof(BlockHeader));
+                if (memcmp(bhdr.magic, BLOCK_MAGIC, sizeof(bhdr.magic)) || bhdr.payloadSize > footer.indexOffset - entry.offset - sizeof(BlockHeader) ||
+                    bhdr.sampleCount > IQZ_MAX_BLOCK_SIZE || entry.firstSample != samples) {
+                    throw std::runtime_error("Invalid IQZ index");
+                }
+                samples += bhdr.sampleCount;
+            }
+            if (samples != footer.sampleCount) { throw std::runtime_error("Invalid IQZ index"); }
+            sampleCount = footer.sampleCount;
+        }
+        else {
+            flog::warn("IQZ file has no index, it was probably not closed properly. Scanning blocks instead");
+            buildIndex();
+        }
+        if (index.empty()) { throw std::runtime_error("IQZ file contains no samples"); }
+
+        // Start decoders, each keeps about two blocks ahead of the reader
+        int threads = std::clamp<int>(std::thread::hardware_concurrency(), 1, 4);
+        lookahead = threads * 2;
+        for (int i = 0; i < threads; i++) {
+            workers.push_back(std::thread(&Reader::worker, this));
+        }
+    }
+
+    Reader::~Reader() {
+        {
+            std::lock_guard<std::mutex> lck(mtx);
+            running = false;
+        }
+        jobCnd.notify_all();
+        for (auto& w : workers) { w.join(); }
+    }
+
+    int Reader::read(dsp::complex_t* out, int count) {
+        int64_t pos = position;
+        int total = 0;
+        while (total < count && pos < sampleCount) {
+            int b = findBlock(pos);
+            std::shared_ptr<Decoded> dec;
+            {
+                std::unique_lock<std::mutex> lck(mtx);
+
+                // Drop blocks that are no longer needed and queue the ones coming up
+                for (auto it = cache.begin(); it != cache.end();) {
+                    if (it->first < b || it->first > b + lookahead) {
+                        it = cache.erase(it);
+                    }
+                    else {
+                        it++;
+                    }
+                }
+                for (int i = b; i <= b + lookahead && i < index.size(); i++) { request(i); }
+
+                dec = cache[b];
+                doneCnd.wait(lck, [&dec]() { return dec->ready; });
+            }
+
+            // Copy what's needed from the block
+            int64_t offset = pos - index[b].firstSample;
+            int n = std::min<int64_t>(count - total, (int64_t)dec->samples.size() - offset);
+            if (n <= 0) { break; }
+            memcpy(&out[total], &dec->samples[offset], n * sizeof(dsp::complex_t));
+            total += n;
+            pos += n;
+        }
+        position = pos;
+        return total;
+    }
+
+    void Reader::seek(int64_t sample) {
+        position = std::clamp<int64_t>(sample, 0, sampleCount);
+    }
+
+    void Reader::buildIndex() {
+        const uint8_t* data = file->data();
+        size_t size = file->size();
+        FileHeader hdr;
+        memcpy(&hdr, data, sizeof(FileHeader));
+
+        // Walk the blocks until the first one that is incomplete or invalid
+        size_t pos = hdr.headerSize;
+        uint64_t samples = 0;
+        while (pos + sizeof(BlockHeader) <= size) {
+            BlockHeader bhdr;
+            memcpy(&bhdr, &data[pos], sizeof(BlockHeader));
+            if (memcmp(bhdr.magic, BLOCK_MAGIC, sizeof(bhdr.magic))) { break; }
+            if (bhdr.payloadSize > size - pos - sizeof(BlockHeader) || bhdr.sampleCount > IQZ_MAX_BLOCK_SIZE) { break; }
+            IndexEntry entry;
+            entry.offset = pos;
+            entry.firstSample = samples;
+            index.push_back(entry);
+            samples += bhdr.sampleCount;
+            pos += sizeof(BlockHeader) + bhdr.payloadSize;
+        }
+        sampleCount = samples;
+    }
+
+    void Reader::worker() {
+        const uint8_t* data = file->data();
+        size_t size = file->size();
+        while (true) {
+            int b;
+            std::shared_ptr<Decoded> dec;
+            {
+                std::unique_lock<std::mutex> lck(mtx);
+                jobCnd.wait(lck, [this]() { return !jobs.empty() || !running; });
+                if (!running) { return; }
+                b = jobs.front();
+                jobs.pop_front();
+
+                // Skip blocks that were dropped after a seek
+                auto it = cache.find(b);
+                if (it == cache.end()) { continue; }
+                dec = it->second;
+            }
+
+            // Decode the block, a corrupt block is replaced with silence
+            BlockHeader bhdr;
+            memcpy(&bhdr, &data[index[b].offset], sizeof(BlockHeader));
+            std::vector<dsp::complex_t> samples(bhdr.sampleCount);
+            try {
+                decodeBlock(&data[index[b].offset], size - index[b].offset, samples.data());
+            }
+            catch (const std::exception& e) {
+                flog::error("Could not decode IQZ block {}: {}", b, e.what());
+                memset(samples.data(), 0, samples.size() * sizeof(dsp::complex_t));
+            }
+
+            {
+                std::lock_guard<std::mutex> lck(mtx);
+                dec->samples = std::move(samples);
+                dec->ready = true;
+            }
+            doneCnd.notify_all();
+        }
+    }
+
+    int Reader::findBlock(int64_t sample) {
+        auto it = std::upper_bound(index.begin(), index.end(), sample, [](int64_t s, const IndexEntry& e) { return s < (int64_t)e.firstSample; });
+        return std::max<int>((it - index.begin()) - 1, 0);
+    }
+
+    void Reader::request(int block) {
+        // Must be called with the mutex locked
+        if (cache.find(block) != cache.end()) { return; }
+        cache[block] = std::make_shared<Decoded>();
+        jobs.push_back(block);
+        jobCnd.notify_one();
+    }
+}
@@ -0,0 +1,233 @@
+#pragma once
+#include <dsp/types.h>
+#include <dsp/compression/pcm_type.h>
+#include <utils/disk_writer.h>
+#include <utils/iq_reader.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <memory>
+
+// Compressed IQ recording container. The samples are cut into blocks that are each quantized with their own scale
+// and then optionally entropy coded, either with zstd or with a FLAC style fixed linear predictor and Rice coder.
+// Blocks are independent so they can be encoded and decoded in parallel, and an index at the end of the file allows
+// seeking. Files that weren't closed properly have no index, it's then rebuilt by scanning the blocks.
+namespace iqz {
+    enum Entropy {
+        ENTROPY_NONE,
+        ENTROPY_ZSTD,
+        ENTROPY_LPC
+    };
+
+#pragma pack(push, 1)
+    struct FileHeader {
+        char magic[4];
+        uint16_t version;
+        uint16_t headerSize;
+        double sampleRate;
+        // Zero if unknown
+        double frequency;
+        uint32_t blockSize;
+        uint8_t pcmType;
+        uint8_t entropy;
+        uint8_t reserved[10];
+    };
+
+    struct BlockHeader {
+        char magic[4];
+        uint32_t payloadSize;
+        uint32_t sampleCount;
+        float scale;
+        uint8_t pcmType;
+        uint8_t entropy;
+        // Linear predictor order of the I and Q channels
+        uint8_t orderI;
+        uint8_t orderQ;
+    };
+
+    struct IndexEntry {
+        uint64_t offset;
+        uint64_t firstSample;
+    };
+
+    struct Footer {
+        uint64_t indexOffset;
+        uint64_t blockCount;
+        uint64_t sampleCount;
+        char magic[4];
+        uint32_t reserved;
+    };
+#pragma pack(pop)
+
+    struct Options {
+        dsp::compression::PCMType pcmType = dsp::compression::PCM_TYPE_I16;
+        Entropy entropy = ENTROPY_LPC;
+        int zstdLevel = 1;
+
+        // Number of samples per block
+        int blockSize = 65536;
+
+        // Number of encoder threads, zero to use half of the CPU cores
+        int threads = 0;
+
+        // Number of blocks that can wait for an encoder before samples are dropped
+        int queueSize = 64;
+    };
+
+    struct Stats {
+        // Number of writes dropped because the encoders couldn't keep up
+        uint64_t overruns;
+
+        // Bytes given to the writer as float samples and bytes written to the file
+        uint64_t inputBytes;
+        uint64_t outputBytes;
+
+        disk::Stats disk;
+    };
+
+    /**
+     * Check if the data at the start of a file is an IQZ header.
+     * @param data File data.
+     * @param size Size of the data in bytes.
+     * @return True if it's an IQZ file, false otherwise.
+     */
+    bool isIQZ(const uint8_t* data, size_t size);
+
+    /**
+     * Encode a block of samples.
+     * @param in Input samples.
+     * @param count Number of samples.
+     * @param pcmType Quantization of the samples.
+     * @param entropy Entropy coder.
+     * @param zstdLevel Compression level when using zstd.
+     * @param out Encoded block including its header. Previous content is replaced.
+     */
+    void encodeBlock(const dsp::complex_t* in, int count, dsp::compression::PCMType pcmType, Entropy entropy, int zstdLevel, std::vector<uint8_t>& out);
+
+    /**
+     * Decode a block of samples. Throws an std::runtime_error if the block is corrupt.
+     * @param block Encoded block including its header.
+     * @param size Size of the encoded block in bytes.
+     * @param out Output samples, must be large enough for the sample count of the block header.
+     * @return Number of samples decoded.
+     */
+    int decodeBlock(const uint8_t* block, size_t size, dsp::complex_t* out);
+
+    class Writer {
+    public:
+        Writer() {}
+        ~Writer();
+
+        /**
+         * Create a file and start the encoder threads.
+         * @param path Path to the file.
+         * @param sampleRate Samplerate of the recording.
+         * @param frequency Center frequency of the recording, zero if unknown.
+         * @param options Encoding options.
+         * @param diskOptions Options of the disk writer.
+         * @return True on success, false otherwise.
+         */
+        bool open(const std::string& path, double sampleRate, double frequency, const Options& options = Options(), const disk::Options& diskOptions = disk::Options());
+
+        bool isOpen();
+
+        /**
+         * Encode the remaining samples, write the index and close the file.
+         */
+        void close();
+
+        /**
+         * Append samples. Never waits for the encoders, if they fall behind the samples are dropped instead.
+         * @param data Samples to write.
+         * @param count Number of samples.
+         * @return True if the samples were taken, false if they were dropped.
+         */
+        bool write(const dsp::complex_t* data, int count);
+
+        size_t getSamplesWritten() { return samplesWritten; }
+
+        /**
+         * Get the write statistics. Can be called from any thread.
+         * @return Statistics since the file was opened.
+         */
+        Stats getStats();
+
+    private:
+        struct Job {
+            std::vector<dsp::complex_t> samples;
+            std::vector<uint8_t> encoded;
+            bool done;
+        };
+
+        void worker();
+        void submit();
+        void writeCompleted();
+
+        std::mutex mtx;
+        std::condition_variable cnd;
+        std::vector<std::thread> workers;
+        bool running = false;
+
+        Options opts;
+        disk::Writer file;
+
+        // Blocks waiting for an encoder and blocks being encoded or waiting to be written, in order
+        std::deque<Job*> pending;
+        std::deque<Job*> inFlight;
+        std::vector<Job*> freeJobs;
+        std::vector<std::unique_ptr<Job>> jobs;
+        Job* current = NULL;
+
+        std::mutex outMtx;
+        std::vector<IndexEntry> index;
+        uint64_t fileSamples = 0;
+
+        std::atomic<size_t> samplesWritten = 0;
+        std::atomic<uint64_t> overruns = 0;
+        std::atomic<uint64_t> inputBytes = 0;
+        std::atomic<uint64_t> outputBytes = 0;
+    };
+
+    // Reader decoding the blocks ahead of the read position on a pool of threads
+    class Reader : public IQReader {
+    public:
+        /**
+         * Open an IQZ file. Throws an std::runtime_error if the file is invalid.
+         * @param file Mapped file.
+         */
+        Reader(std::shared_ptr<MappedFile> file);
+        ~Reader();
+
+        int read(dsp::complex_t* out, int count);
+        void seek(int64_t sample);
+
+    private:
+        struct Decoded {
+            std::vector<dsp::complex_t> samples;
+            bool ready = false;
+        };
+
+        void buildIndex();
+        void worker();
+        int findBlock(int64_t sample);
+        void request(int block);
+
+        std::shared_ptr<MappedFile> file;
+        std::vector<IndexEntry> index;
+
+        std::mutex mtx;
+        std::condition_variable jobCnd;
+        std::condition_variable doneCnd;
+        std::vector<std::thread> workers;
+        bool running = true;
+        std::deque<int> jobs;
+        std::map<int, std::shared_ptr<Decoded>> cache;
+        int lookahead;
+    };
+}
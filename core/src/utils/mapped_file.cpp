@@ -0,0 +1,102 @@
+#include <utils/mapped_file.h>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(const std::string& path) {
+    open(path);
+}
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+void MappedFile::open(const std::string& path) {
+    close();
+
+#ifdef _WIN32
+    // Open file
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        throw std::runtime_error("Could not open file");
+    }
+
+    // Get its size
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || !size.QuadPart) {
+        CloseHandle(file);
+        throw std::runtime_error("File is empty");
+    }
+
+    // Map it
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!mapping) {
+        CloseHandle(file);
+        throw std::runtime_error("Could not map file");
+    }
+    void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!data) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        throw std::runtime_error("Could not map file");
+    }
+
+    fileHandle = file;
+    mappingHandle = mapping;
+    _data = (const uint8_t*)data;
+    _size = size.QuadPart;
+#else
+    // Open file
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Could not open file");
+    }
+
+    // Get its size
+    struct stat st;
+    if (fstat(fd, &st) || !st.st_size) {
+        ::close(fd);
+        throw std::runtime_error("File is empty");
+    }
+
+    // Map it, the mapping stays valid after the file is closed
+    void* data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        throw std::runtime_error("Could not map file");
+    }
+
+    _data = (const uint8_t*)data;
+    _size = st.st_size;
+#endif
+}
+
+void MappedFile::close() {
+    if (!_data) { return; }
+#ifdef _WIN32
+    UnmapViewOfFile(_data);
+    CloseHandle(mappingHandle);
+    CloseHandle(fileHandle);
+    mappingHandle = NULL;
+    fileHandle = NULL;
+#else
+    munmap((void*)_data, _size);
+#endif
+    _data = NULL;
+    _size = 0;
+}
+
+void MappedFile::adviseSequential() {
+    if (!_data) { return; }
+#ifndef _WIN32
+    madvise((void*)_data, _size, MADV_SEQUENTIAL);
+#endif
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+
+// Read-only memory mapping of a whole file
+class MappedFile {
+public:
+    MappedFile() {}
+
+    /**
+     * Map a file.
+     * @param path Path to the file.
+     */
+    MappedFile(const std::string& path);
+
+    ~MappedFile();
+
+    // Not copyable since it owns the mapping
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    /**
+     * Map a file. Throws if the file can't be opened or mapped.
+     * @param path Path to the file.
+     */
+    void open(const std::string& path);
+
+    /**
+     * Unmap the file. The data pointer can no longer be used after this.
+     */
+    void close();
+
+    /**
+     * Check if a file is mapped.
+     * @return True if mapped, false otherwise.
+     */
+    bool isOpen() { return _data != NULL; }
+
+    /**
+     * Get a pointer to the start of the file.
+     * @return Pointer to the mapped data.
+     */
+    const uint8_t* data() { return _data; }
+
+    /**
+     * Get the size of the file.
+     * @return Size in bytes.
+     */
+    size_t size() { return _size; }
+
+    /**
+     * Tell the OS that the file will be read sequentially so that it reads ahead more aggressively.
+     */
+    void adviseSequential();
+
+private:
+    const uint8_t* _data = NULL;
+    size_t _size = 0;
+#ifdef _WIN32
+    void* fileHandle = NULL;
+    void* mappingHandle = NULL;
+#endif
+};
@@ -2,6 +2,12 @@
 #include <string.h>
 #include <codecvt>
 #include <stdexcept>
+#include <algorithm>
+#include <chrono>
+
+#if defined(__linux__) && !defined(UDP_SEGMENT)
+#define UDP_SEGMENT 103
+#endif
 
 #ifdef _WIN32
 #define WOULD_BLOCK (WSAGetLastError() == WSAEWOULDBLOCK)
@@ -47,6 +53,10 @@ namespace net {
 #endif
     }
 
+    uint64_t wallclockMicros() {
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
     void setNonblocking(SockHandle_t sock) {
 #ifdef _WIN32
         u_long enabled = 1;
@@ -150,6 +160,111 @@ namespace net {
         return err;
     }
 
+    int Socket::sendBatch(const uint8_t* const* packets, const int* sizes, int count, const Address* dest) {
+        const sockaddr_in* addr = dest ? &dest->addr : (raddr ? &raddr->addr : NULL);
+#ifdef __linux__
+        // Hand all datagrams to the kernel at once
+        const int MAX_BATCH = 64;
+        struct mmsghdr msgs[MAX_BATCH];
+        struct iovec iovs[MAX_BATCH];
+        int sent = 0;
+        while (sent < count) {
+            int batch = std::min<int>(count - sent, MAX_BATCH);
+            for (int i = 0; i < batch; i++) {
+                iovs[i].iov_base = (void*)packets[sent + i];
+                iovs[i].iov_len = sizes[sent + i];
+                memset(&msgs[i].msg_hdr, 0, sizeof(msgs[i].msg_hdr));
+                msgs[i].msg_hdr.msg_name = (void*)addr;
+                msgs[i].msg_hdr.msg_namelen = addr ? sizeof(sockaddr_in) : 0;
+                msgs[i].msg_hdr.msg_iov = &iovs[i];
+                msgs[i].msg_hdr.msg_iovlen = 1;
+            }
+            int err = sendmmsg(sock, msgs, batch, 0);
+            if (err <= 0) {
+                if (WOULD_BLOCK) { return sent; }
+                close();
+                return -1;
+            }
+            sent += err;
+        }
+        return sent;
+#else
+        for (int i = 0; i < count; i++) {
+            int err = sendto(sock, (const char*)packets[i], sizes[i], 0, (sockaddr*)addr, sizeof(sockaddr_in));
+            if (err <= 0) {
+                if (WOULD_BLOCK) { return i; }
+                close();
+                return -1;
+            }
+        }
+        return count;
+#endif
+    }
+
+    int Socket::sendSegments(const uint8_t* data, size_t len, int segmentSize, const Address* dest) {
+        size_t sent = 0;
+#ifdef __linux__
+        // Let the kernel split the datagrams, at most 64 at a time within the maximum UDP payload
+        const sockaddr_in* addr = dest ? &dest->addr : (raddr ? &raddr->addr : NULL);
+        const int MAX_GSO_SEGMENTS = 64;
+        const int MAX_GSO_SIZE = 65000;
+        int perCall = std::min<int>(MAX_GSO_SIZE / std::max<int>(segmentSize, 1), MAX_GSO_SEGMENTS);
+        while (segmentOffload && perCall > 1 && sent < len) {
+            size_t chunk = std::min<size_t>(len - sent, (size_t)perCall * segmentSize);
+            struct iovec iov;
+            iov.iov_base = (void*)&data[sent];
+            iov.iov_len = chunk;
+            char control[CMSG_SPACE(sizeof(uint16_t))] = {};
+            struct msghdr msg = {};
+            msg.msg_name = (void*)addr;
+            msg.msg_namelen = addr ? sizeof(sockaddr_in) : 0;
+            msg.msg_iov = &iov;
+            msg.msg_iovlen = 1;
+            msg.msg_control = control;
+            msg.msg_controllen = sizeof(control);
+            struct cmsghdr* cm = CMSG_FIRSTHDR(&msg);
+            cm->cmsg_level = SOL_UDP;
+            cm->cmsg_type = UDP_SEGMENT;
+            cm->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+            *(uint16_t*)CMSG_DATA(cm) = segmentSize;
+
+            int err = sendmsg(sock, &msg, 0);
+            if (err < 0) {
+                if (WOULD_BLOCK) { return sent; }
+
+                // Not supported by the kernel or the interface, send the datagrams one by one from now on
+                if (!sent && (errno == EIO || errno == EINVAL || errno == ENOPROTOOPT || errno == EOPNOTSUPP)) {
+                    segmentOffload = false;
+                    break;
+                }
+                close();
+                return -1;
+            }
+            sent += err;
+        }
+        if (sent >= len) { return sent; }
+#endif
+
+        // Fall back to sending the datagrams individually
+        const int MAX_BATCH = 64;
+        const uint8_t* packets[MAX_BATCH];
+        int sizes[MAX_BATCH];
+        while (sent < len) {
+            int count = 0;
+            size_t pos = sent;
+            while (count < MAX_BATCH && pos < len) {
+                packets[count] = &data[pos];
+                sizes[count] = std::min<size_t>(segmentSize, len - pos);
+                pos += sizes[count++];
+            }
+            int err = sendBatch(packets, sizes, count, dest);
+            if (err < 0) { return -1; }
+            for (int i = 0; i < err; i++) { sent += sizes[i]; }
+            if (err < count) { break; }
+        }
+        return sent;
+    }
+
     int Socket::sendstr(const std::string& str, const Address* dest) {
         return send((const uint8_t*)str.c_str(), str.length(), dest);
     }
@@ -190,6 +305,90 @@ namespace net {
         return read;
     }
 
+    int Socket::recvBatch(uint8_t* const* buffers, int maxLen, int* sizes, int count, int timeout, uint64_t* arrivals) {
+        // Wait for the first datagram
+        if (timeout != NONBLOCKING) {
+            fd_set set;
+            FD_ZERO(&set);
+            FD_SET(sock, &set);
+            timeval tv;
+            tv.tv_sec = timeout / 1000;
+            tv.tv_usec = (timeout - tv.tv_sec*1000) * 1000;
+            int err = select(sock+1, &set, NULL, &set, (timeout > 0) ? &tv : NULL);
+            if (err <= 0) { return err; }
+        }
+
+#ifdef __linux__
+        // Have the kernel stamp each datagram as it arrives, the time we get to read them says nothing about the link
+        if (arrivals && !timestamping) {
+            int enable = 1;
+            setsockopt(sock, SOL_SOCKET, SO_TIMESTAMPNS, &enable, sizeof(int));
+            timestamping = true;
+        }
+
+        // Take everything that's already queued in one call
+        const int MAX_BATCH = 64;
+        struct mmsghdr msgs[MAX_BATCH];
+        struct iovec iovs[MAX_BATCH];
+        char controls[MAX_BATCH][CMSG_SPACE(sizeof(struct timespec))];
+        count = std::min<int>(count, MAX_BATCH);
+        for (int i = 0; i < count; i++) {
+            iovs[i].iov_base = buffers[i];
+            iovs[i].iov_len = maxLen;
+            memset(&msgs[i].msg_hdr, 0, sizeof(msgs[i].msg_hdr));
+            msgs[i].msg_hdr.msg_iov = &iovs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+            if (arrivals) {
+                msgs[i].msg_hdr.msg_control = controls[i];
+                msgs[i].msg_hdr.msg_controllen = sizeof(controls[i]);
+            }
+        }
+        int err = recvmmsg(sock, msgs, count, MSG_DONTWAIT, NULL);
+        if (err <= 0) {
+            if (WOULD_BLOCK) { return -1; }
+            close();
+            return err;
+        }
+        uint64_t now = arrivals ? wallclockMicros() : 0;
+        for (int i = 0; i < err; i++) {
+            sizes[i] = msgs[i].msg_len;
+            if (!arrivals) { continue; }
+
+            // Fall back to the time of the call if the datagram wasn't stamped
+            arrivals[i] = now;
+            for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msgs[i].msg_hdr); cmsg; cmsg = CMSG_NXTHDR(&msgs[i].msg_hdr, cmsg)) {
+                if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_TIMESTAMPNS) { continue; }
+                struct timespec ts;
+                memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+                arrivals[i] = (uint64_t)ts.tv_sec * 1000000ull + (uint64_t)ts.tv_nsec / 1000ull;
+            }
+        }
+        return err;
+#else
+        // Keep reading as long as there is data available without waiting
+        int read = 0;
+        while (read < count) {
+            if (read) {
+                fd_set set;
+                FD_ZERO(&set);
+                FD_SET(sock, &set);
+                timeval tv = { 0, 0 };
+                if (select(sock+1, &set, NULL, NULL, &tv) <= 0) { break; }
+            }
+            int err = ::recvfrom(sock, (char*)buffers[read], maxLen, 0, NULL, NULL);
+            if (err <= 0) {
+                if (read) { break; }
+                if (WOULD_BLOCK) { return -1; }
+                close();
+                return err;
+            }
+            if (arrivals) { arrivals[read] = wallclockMicros(); }
+            sizes[read++] = err;
+        }
+        return read;
+#endif
+    }
+
     int Socket::recvline(std::string& str, int maxLen, int timeout, Address* dest) {
         // Disallow nonblocking mode
         if (!timeout) { return -1; }
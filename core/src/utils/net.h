@@ -22,6 +22,10 @@
 #include <ifaddrs.h>
 #endif
 
+#ifdef __linux__
+#include <netinet/udp.h>
+#endif
+
 namespace net {
 #ifdef _WIN32
     typedef SOCKET SockHandle_t;
@@ -148,6 +152,26 @@ namespace net {
          */
         int sendstr(const std::string& str, const Address* dest = NULL);
 
+        /**
+         * Send several datagrams using as few system calls as possible (sendmmsg on Linux).
+         * @param packets Datagrams to be sent.
+         * @param sizes Size of each datagram in bytes.
+         * @param count Number of datagrams.
+         * @param dest Destination address. NULL to use the default remote address.
+         * @return Number of datagrams sent. -1 means error.
+         */
+        int sendBatch(const uint8_t* const* packets, const int* sizes, int count, const Address* dest = NULL);
+
+        /**
+         * Send consecutive datagrams stored back to back, using UDP segmentation offload when available (Linux).
+         * @param data Datagrams stored back to back.
+         * @param len Total number of bytes. The last datagram can be shorter than the others.
+         * @param segmentSize Size of each datagram in bytes.
+         * @param dest Destination address. NULL to use the default remote address.
+         * @return Number of bytes sent. -1 means error.
+         */
+        int sendSegments(const uint8_t* data, size_t len, int segmentSize, const Address* dest = NULL);
+
         /**
          * Receive data from socket.
          * @param data Buffer to read the data into.
@@ -159,6 +183,18 @@ namespace net {
          */
         int recv(uint8_t* data, size_t maxLen, bool forceLen = false, int timeout = NO_TIMEOUT, Address* dest = NULL);
 
+        /**
+         * Receive several datagrams using as few system calls as possible (recvmmsg on Linux).
+         * @param buffers Buffers to read each datagram into.
+         * @param maxLen Size of each buffer in bytes.
+         * @param sizes Size of each received datagram in bytes.
+         * @param count Maximum number of datagrams.
+         * @param timeout Timeout in milliseconds for the first datagram, the others are only taken if already available. Use NO_TIMEOUT or NONBLOCKING here if needed.
+         * @param arrivals Arrival time of each datagram in microseconds since the epoch, taken by the kernel when possible (Linux). NULL if not used.
+         * @return Number of datagrams read. 0 means timed out or closed. -1 means would block or error.
+         */
+        int recvBatch(uint8_t* const* buffers, int maxLen, int* sizes, int count, int timeout = NO_TIMEOUT, uint64_t* arrivals = NULL);
+
         /**
          * Receive line from socket.
          * @param str String to read the data into.
@@ -173,6 +209,8 @@ namespace net {
         Address* raddr = NULL;
         SockHandle_t sock;
         bool open = true;
+        bool segmentOffload = true;
+        bool timestamping = false;
 
     };
 
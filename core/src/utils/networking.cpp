@@ -2,6 +2,12 @@
 #include <assert.h>
 #include <utils/flog.h>
 #include <stdexcept>
+#include <string.h>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#endif
 
 namespace net {
 
@@ -9,13 +15,264 @@ namespace net {
     extern bool winsock_init = false;
 #endif
 
+    // Write buffers for writeAsync, larger writes get their own allocation
+    BufferPool writePool(64 * 1024, 256);
+
+    static void setNonblocking(Socket sock) {
+#ifdef _WIN32
+        u_long enabled = 1;
+        ioctlsocket(sock, FIONBIO, &enabled);
+#else
+        fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK);
+#endif
+    }
+
+    static bool wouldBlock() {
+#ifdef _WIN32
+        return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+        return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+#endif
+    }
+
+    static int pollSockets(struct pollfd* fds, int count, int timeout) {
+#ifdef _WIN32
+        return WSAPoll(fds, count, timeout);
+#else
+        return poll(fds, count, timeout);
+#endif
+    }
+
+    static short toPollEvents(int events) {
+        short pev = 0;
+        if (events & EVENT_READ) { pev |= POLLIN; }
+        if (events & EVENT_WRITE) { pev |= POLLOUT; }
+        return pev;
+    }
+
+    static int fromPollEvents(short pev) {
+        int events = 0;
+        if (pev & POLLIN) { events |= EVENT_READ; }
+        if (pev & POLLOUT) { events |= EVENT_WRITE; }
+        if (pev & (POLLHUP | POLLERR | POLLNVAL)) { events |= EVENT_HANGUP; }
+        return events;
+    }
+
+    EventLoop::EventLoop() {
+#ifdef __linux__
+        epollFd = epoll_create1(EPOLL_CLOEXEC);
+        wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (epollFd < 0 || wakeFd < 0) {
+            throw std::runtime_error("Could not create the network event loop");
+        }
+        struct epoll_event ev = {};
+        ev.events = EPOLLIN;
+        ev.data.fd = wakeFd;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &ev);
+#else
+        // Wake up the poll with a datagram sent to a loopback socket, it works the same way on Windows
+        wakeSock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+        memset(&wakeAddr, 0, sizeof(wakeAddr));
+        wakeAddr.sin_family = AF_INET;
+        wakeAddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        wakeAddr.sin_port = 0;
+        socklen_t addrLen = sizeof(wakeAddr);
+        if (bind(wakeSock, (struct sockaddr*)&wakeAddr, sizeof(wakeAddr)) < 0 || getsockname(wakeSock, (struct sockaddr*)&wakeAddr, &addrLen) < 0) {
+            throw std::runtime_error("Could not create the network event loop");
+        }
+        setNonblocking(wakeSock);
+#endif
+        workerThread = std::thread(&EventLoop::worker, this);
+    }
+
+    EventLoop::~EventLoop() {
+        {
+            std::lock_guard lck(watchMtx);
+            running = false;
+        }
+        wake();
+        if (workerThread.joinable()) { workerThread.join(); }
+#ifdef __linux__
+        ::close(epollFd);
+        ::close(wakeFd);
+#elif defined(_WIN32)
+        closesocket(wakeSock);
+#else
+        ::close(wakeSock);
+#endif
+    }
+
+    EventLoop& EventLoop::get() {
+        static EventLoop loop;
+        return loop;
+    }
+
+    void EventLoop::add(Socket sock, EventHandler* handler, int events) {
+        std::lock_guard lck(watchMtx);
+        watches[sock] = { handler, events };
+#ifdef __linux__
+        struct epoll_event ev = {};
+        ev.events = ((events & EVENT_READ) ? EPOLLIN : 0) | ((events & EVENT_WRITE) ? EPOLLOUT : 0);
+        ev.data.fd = sock;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, sock, &ev);
+#else
+        wake();
+#endif
+    }
+
+    void EventLoop::modify(Socket sock, int events) {
+        std::lock_guard lck(watchMtx);
+        auto it = watches.find(sock);
+        if (it == watches.end() || it->second.events == events) { return; }
+        it->second.events = events;
+#ifdef __linux__
+        struct epoll_event ev = {};
+        ev.events = ((events & EVENT_READ) ? EPOLLIN : 0) | ((events & EVENT_WRITE) ? EPOLLOUT : 0);
+        ev.data.fd = sock;
+        epoll_ctl(epollFd, EPOLL_CTL_MOD, sock, &ev);
+#else
+        if (!inLoopThread()) { wake(); }
+#endif
+    }
+
+    void EventLoop::remove(Socket sock) {
+        std::unique_lock lck(watchMtx);
+        auto it = watches.find(sock);
+        if (it == watches.end()) { return; }
+        EventHandler* handler = it->second.handler;
+        watches.erase(it);
+#ifdef __linux__
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, sock, NULL);
+#else
+        wake();
+#endif
+
+        // Wait for the handler to return unless it's the one calling
+        if (inLoopThread()) { return; }
+        dispatchCnd.wait(lck, [=]() { return dispatching != handler; });
+    }
+
+    bool EventLoop::inLoopThread() {
+        return std::this_thread::get_id() == workerThread.get_id();
+    }
+
+    void EventLoop::wake() {
+#ifdef __linux__
+        uint64_t val = 1;
+        ::write(wakeFd, &val, sizeof(val));
+#else
+        char val = 0;
+        sendto(wakeSock, &val, 1, 0, (struct sockaddr*)&wakeAddr, sizeof(wakeAddr));
+#endif
+    }
+
+    void EventLoop::worker() {
+#ifdef __linux__
+        const int MAX_EVENTS = 64;
+        struct epoll_event evs[MAX_EVENTS];
+#else
+        std::vector<struct pollfd> fds;
+#endif
+        std::vector<std::pair<Socket, int>> ready;
+
+        while (true) {
+            // Wait for events
+            ready.clear();
+#ifdef __linux__
+            int count = epoll_wait(epollFd, evs, MAX_EVENTS, -1);
+            for (int i = 0; i < count; i++) {
+                if (evs[i].data.fd == wakeFd) {
+                    uint64_t val;
+                    ::read(wakeFd, &val, sizeof(val));
+                    continue;
+                }
+                int events = 0;
+                if (evs[i].events & EPOLLIN) { events |= EVENT_READ; }
+                if (evs[i].events & EPOLLOUT) { events |= EVENT_WRITE; }
+                if (evs[i].events & (EPOLLHUP | EPOLLERR)) { events |= EVENT_HANGUP; }
+                Socket sock = evs[i].data.fd;
+                ready.push_back({ sock, events });
+            }
+#else
+            {
+                std::lock_guard lck(watchMtx);
+                fds.resize(watches.size() + 1);
+                fds[0] = { wakeSock, POLLIN, 0 };
+                int i = 1;
+                for (auto& [sock, watch] : watches) {
+                    fds[i++] = { sock, toPollEvents(watch.events), 0 };
+                }
+            }
+            pollSockets(fds.data(), fds.size(), -1);
+            if (fds[0].revents & POLLIN) {
+                char buf[64];
+                while (recv(wakeSock, buf, sizeof(buf), 0) > 0);
+            }
+            for (int i = 1; i < fds.size(); i++) {
+                if (fds[i].revents) { ready.push_back({ fds[i].fd, fromPollEvents(fds[i].revents) }); }
+            }
+#endif
+            {
+                std::lock_guard lck(watchMtx);
+                if (!running) { return; }
+            }
+
+            // Dispatch, skipping sockets removed since the wait returned
+            for (auto& [sock, events] : ready) {
+                EventHandler* handler;
+                {
+                    std::lock_guard lck(watchMtx);
+                    auto it = watches.find(sock);
+                    if (it == watches.end()) { continue; }
+                    handler = it->second.handler;
+                    dispatching = handler;
+                }
+                handler->handleEvents(events);
+                {
+                    std::lock_guard lck(watchMtx);
+                    dispatching = NULL;
+                }
+                dispatchCnd.notify_all();
+            }
+        }
+    }
+
+    BufferPool::BufferPool(int bufferSize, int maxFree) {
+        this->bufferSize = bufferSize;
+        this->maxFree = maxFree;
+    }
+
+    BufferPool::~BufferPool() {
+        for (auto& buf : freeList) { delete[] buf; }
+    }
+
+    uint8_t* BufferPool::alloc() {
+        std::lock_guard lck(mtx);
+        if (freeList.empty()) { return new uint8_t[bufferSize]; }
+        uint8_t* buf = freeList.back();
+        freeList.pop_back();
+        return buf;
+    }
+
+    void BufferPool::free(uint8_t* buf) {
+        std::lock_guard lck(mtx);
+        if (freeList.size() >= maxFree) {
+            delete[] buf;
+            return;
+        }
+        freeList.push_back(buf);
+    }
+
     ConnClass::ConnClass(Socket sock, struct sockaddr_in raddr, bool udp) {
         _sock = sock;
         _udp = udp;
         remoteAddr = raddr;
         connectionOpen = true;
-        readWorkerThread = std::thread(&ConnClass::readWorker, this);
-        writeWorkerThread = std::thread(&ConnClass::writeWorker, this);
+
+        // All IO is non-blocking, synchronous calls wait for the socket themselves
+        setNonblocking(_sock);
+        registered = true;
+        EventLoop::get().add(_sock, this, 0);
     }
 
     ConnClass::~ConnClass() {
@@ -24,29 +281,40 @@ namespace net {
 
     void ConnClass::close() {
         std::lock_guard lck(closeMtx);
-        // Set stopWorkers to true
+        bool wasOpen;
         {
-            std::lock_guard lck1(readQueueMtx);
-            std::lock_guard lck2(writeQueueMtx);
-            stopWorkers = true;
+            std::lock_guard lck1(queueMtx);
+            wasOpen = registered;
+            registered = false;
         }
+        if (!wasOpen) { return; }
 
-        // Notify the workers of the change
-        readQueueCnd.notify_all();
-        writeQueueCnd.notify_all();
+        // Shutting down wakes up synchronous calls waiting on the socket
+#ifdef _WIN32
+        shutdown(_sock, SD_BOTH);
+#else
+        ::shutdown(_sock, SHUT_RDWR);
+#endif
 
-        if (connectionOpen) {
+        // Make sure no handler is running before releasing the socket
+        EventLoop::get().remove(_sock);
+        {
+            std::lock_guard lck1(readMtx);
+            std::lock_guard lck2(writeMtx);
 #ifdef _WIN32
             closesocket(_sock);
 #else
-            ::shutdown(_sock, SHUT_RDWR);
             ::close(_sock);
 #endif
         }
 
-        // Wait for the theads to terminate
-        if (readWorkerThread.joinable()) { readWorkerThread.join(); }
-        if (writeWorkerThread.joinable()) { writeWorkerThread.join(); }
+        // Drop what's still queued
+        {
+            std::lock_guard lck1(queueMtx);
+            readQueue.clear();
+            for (auto& entry : writeQueue) { releaseWrite(entry); }
+            writeQueue.clear();
+        }
 
         {
             std::lock_guard lck(connectionOpenMtx);
@@ -60,39 +328,52 @@ namespace net {
     }
 
     void ConnClass::waitForEnd() {
-        std::unique_lock lck(readQueueMtx);
+        std::unique_lock lck(connectionOpenMtx);
         connectionOpenCnd.wait(lck, [this]() { return !connectionOpen; });
     }
 
+    void ConnClass::closed() {
+        {
+            std::lock_guard lck(connectionOpenMtx);
+            if (!connectionOpen) { return; }
+            connectionOpen = false;
+        }
+        connectionOpenCnd.notify_all();
+    }
+
+    bool ConnClass::waitReady(int events) {
+        struct pollfd fd = { _sock, toPollEvents(events), 0 };
+        while (true) {
+            int ret = pollSockets(&fd, 1, -1);
+            if (ret > 0) { return !(fd.revents & (POLLHUP | POLLERR | POLLNVAL)) || (fd.revents & POLLIN); }
+            if (ret < 0 && !wouldBlock()) { return false; }
+        }
+    }
+
     int ConnClass::read(int count, uint8_t* buf, bool enforceSize) {
         if (!connectionOpen) { return -1; }
         std::lock_guard lck(readMtx);
         int ret;
 
         if (_udp) {
-            socklen_t fromLen = sizeof(remoteAddr);
-            ret = recvfrom(_sock, (char*)buf, count, 0, (struct sockaddr*)&remoteAddr, &fromLen);
-            if (ret <= 0) {
-                {
-                    std::lock_guard lck(connectionOpenMtx);
-                    connectionOpen = false;
-                }
-                connectionOpenCnd.notify_all();
+            while (true) {
+                socklen_t fromLen = sizeof(remoteAddr);
+                ret = recvfrom(_sock, (char*)buf, count, 0, (struct sockaddr*)&remoteAddr, &fromLen);
+                if (ret > 0) { return count; }
+                if (ret < 0 && wouldBlock() && waitReady(EVENT_READ)) { continue; }
+                closed();
                 return -1;
             }
-            return count;
         }
 
         int beenRead = 0;
         while (beenRead < count) {
             ret = recv(_sock, (char*)&buf[beenRead], count - beenRead, 0);
-
+            if (ret < 0 && wouldBlock()) {
+                if (waitReady(EVENT_READ)) { continue; }
+            }
             if (ret <= 0) {
-                {
-                    std::lock_guard lck(connectionOpenMtx);
-                    connectionOpen = false;
-                }
-                connectionOpenCnd.notify_all();
+                closed();
                 return -1;
             }
 
@@ -106,30 +387,38 @@ namespace net {
 
     bool ConnClass::write(int count, uint8_t* buf) {
         if (!connectionOpen) { return false; }
-        std::lock_guard lck(writeMtx);
+        bool ok;
+        {
+            std::lock_guard lck(writeMtx);
+            ok = writeLocked(count, buf);
+        }
+
+        // Queued asynchronous writes are held back while a synchronous one is in progress
+        updateEvents();
+        return ok;
+    }
+
+    bool ConnClass::writeLocked(int count, uint8_t* buf) {
         int ret;
 
         if (_udp) {
-            ret = sendto(_sock, (char*)buf, count, 0, (struct sockaddr*)&remoteAddr, sizeof(remoteAddr));
-            if (ret <= 0) {
-                {
-                    std::lock_guard lck(connectionOpenMtx);
-                    connectionOpen = false;
-                }
-                connectionOpenCnd.notify_all();
+            while (true) {
+                ret = sendto(_sock, (char*)buf, count, 0, (struct sockaddr*)&remoteAddr, sizeof(remoteAddr));
+                if (ret > 0) { return true; }
+                if (ret < 0 && wouldBlock() && waitReady(EVENT_WRITE)) { continue; }
+                closed();
+                return false;
             }
-            return (ret > 0);
         }
 
         int beenWritten = 0;
         while (beenWritten < count) {
-            ret = send(_sock, (char*)buf, count, 0);
+            ret = send(_sock, (char*)&buf[beenWritten], count - beenWritten, 0);
+            if (ret < 0 && wouldBlock()) {
+                if (waitReady(EVENT_WRITE)) { continue; }
+            }
             if (ret <= 0) {
-                {
-                    std::lock_guard lck(connectionOpenMtx);
-                    connectionOpen = false;
-                }
-                connectionOpenCnd.notify_all();
+                closed();
                 return false;
             }
             beenWritten += ret;
@@ -150,86 +439,199 @@ namespace net {
 
         // Add entry to queue
         {
-            std::lock_guard lck(readQueueMtx);
+            std::lock_guard lck(queueMtx);
+            if (!registered) { return; }
             readQueue.push_back(entry);
         }
 
-        // Notify read worker
-        readQueueCnd.notify_all();
+        // Start waiting for data
+        updateEvents();
     }
 
     void ConnClass::writeAsync(int count, uint8_t* buf) {
         if (!connectionOpen) { return; }
-        // Create entry
+        // Copy the data since the write happens later
         ConnWriteEntry entry;
         entry.count = count;
-        entry.buf = buf;
+        entry.pooled = (count <= writePool.getBufferSize());
+        entry.buf = entry.pooled ? writePool.alloc() : new uint8_t[count];
+        entry.handler = NULL;
+        entry.ctx = NULL;
+        memcpy(entry.buf, buf, count);
+        queueWrite(entry);
+    }
+
+    void ConnClass::writeAsync(int count, const uint8_t* buf, std::shared_ptr<const void> owner, void (*handler)(int count, void* ctx), void* ctx) {
+        if (!connectionOpen) { return; }
+        ConnWriteEntry entry;
+        entry.count = count;
+        entry.buf = (uint8_t*)buf;
+        entry.pooled = false;
+        entry.owner = std::move(owner);
+        entry.handler = handler;
+        entry.ctx = ctx;
+        queueWrite(entry);
+    }
 
+    void ConnClass::queueWrite(ConnWriteEntry& entry) {
         // Add entry to queue
         {
-            std::lock_guard lck(writeQueueMtx);
-            writeQueue.push_back(entry);
+            std::lock_guard lck(queueMtx);
+            if (!registered) {
+                releaseWrite(entry);
+                return;
+            }
+            writeQueue.push_back(std::move(entry));
         }
 
-        // Notify write worker
-        writeQueueCnd.notify_all();
+        // Start waiting for the socket to be writable
+        updateEvents();
     }
 
-    void ConnClass::readWorker() {
-        while (true) {
-            // Wait for wakeup and exit if it's for terminating the thread
-            std::unique_lock lck(readQueueMtx);
-            readQueueCnd.wait(lck, [this]() { return (readQueue.size() > 0 || stopWorkers); });
-            if (stopWorkers || !connectionOpen) { return; }
-
-            // Pop first element off the list
-            ConnReadEntry entry = readQueue[0];
-            readQueue.erase(readQueue.begin());
-            lck.unlock();
-
-            // Read from socket and send data to the handler
-            int ret = read(entry.count, entry.buf, entry.enforceSize);
-            if (ret <= 0) {
-                {
-                    std::lock_guard lck(connectionOpenMtx);
-                    connectionOpen = false;
-                }
-                connectionOpenCnd.notify_all();
-                return;
-            }
-            entry.handler(ret, entry.buf, entry.ctx);
+    void ConnClass::releaseWrite(ConnWriteEntry& entry) {
+        if (entry.owner) {
+            entry.owner.reset();
         }
+        else if (entry.pooled) {
+            writePool.free(entry.buf);
+        }
+        else {
+            delete[] entry.buf;
+        }
+    }
+
+    void ConnClass::setCloseHandler(void (*handler)(void* ctx), void* ctx) {
+        std::lock_guard lck(queueMtx);
+        closeHandler = handler;
+        closeCtx = ctx;
+    }
+
+    void ConnClass::updateEvents() {
+        std::lock_guard lck(queueMtx);
+        if (!registered) { return; }
+        int events = 0;
+        if (!readQueue.empty()) { events |= EVENT_READ; }
+        if (!writeQueue.empty()) { events |= EVENT_WRITE; }
+        EventLoop::get().modify(_sock, events);
     }
 
-    void ConnClass::writeWorker() {
+    bool ConnClass::handleRead() {
+        ConnReadEntry entry;
+        {
+            std::lock_guard lck(queueMtx);
+            if (readQueue.empty()) { return true; }
+            entry = readQueue.front();
+        }
+
+        // Read as much of the entry as is available
+        int ret;
+        if (_udp) {
+            socklen_t fromLen = sizeof(remoteAddr);
+            ret = recvfrom(_sock, (char*)entry.buf, entry.count, 0, (struct sockaddr*)&remoteAddr, &fromLen);
+            if (ret > 0) { ret = entry.count - readProgress; }
+        }
+        else {
+            ret = recv(_sock, (char*)&entry.buf[readProgress], entry.count - readProgress, 0);
+        }
+        if (ret < 0 && wouldBlock()) { return true; }
+        if (ret <= 0) { return false; }
+        readProgress += ret;
+        if (entry.enforceSize && readProgress < entry.count) { return true; }
+
+        // Complete, pop it before calling the handler so that it can queue the next read
+        int count = readProgress;
+        readProgress = 0;
+        {
+            std::lock_guard lck(queueMtx);
+            readQueue.pop_front();
+        }
+        updateEvents();
+        entry.handler(count, entry.buf, entry.ctx);
+        return true;
+    }
+
+    bool ConnClass::handleWrite() {
+        // A synchronous write is in progress, it re-arms the event once done
+        std::unique_lock wlck(writeMtx, std::try_to_lock);
+        if (!wlck.owns_lock()) {
+            std::lock_guard lck(queueMtx);
+            EventLoop::get().modify(_sock, readQueue.empty() ? 0 : EVENT_READ);
+            return true;
+        }
+
         while (true) {
-            // Wait for wakeup and exit if it's for terminating the thread
-            std::unique_lock lck(writeQueueMtx);
-            writeQueueCnd.wait(lck, [this]() { return (writeQueue.size() > 0 || stopWorkers); });
-            if (stopWorkers || !connectionOpen) { return; }
-
-            // Pop first element off the list
-            ConnWriteEntry entry = writeQueue[0];
-            writeQueue.erase(writeQueue.begin());
-            lck.unlock();
-
-            // Write to socket
-            if (!write(entry.count, entry.buf)) {
-                {
-                    std::lock_guard lck(connectionOpenMtx);
-                    connectionOpen = false;
-                }
-                connectionOpenCnd.notify_all();
-                return;
+            ConnWriteEntry entry;
+            {
+                std::lock_guard lck(queueMtx);
+                if (writeQueue.empty()) { break; }
+                entry = writeQueue.front();
+            }
+
+            // Send as much as the socket takes
+            int ret;
+            if (_udp) {
+                ret = sendto(_sock, (char*)entry.buf, entry.count, 0, (struct sockaddr*)&remoteAddr, sizeof(remoteAddr));
+                if (ret > 0) { ret = entry.count - writeProgress; }
             }
+            else {
+                ret = send(_sock, (char*)&entry.buf[writeProgress], entry.count - writeProgress, 0);
+            }
+            if (ret < 0 && wouldBlock()) { return true; }
+            if (ret <= 0) { return false; }
+            writeProgress += ret;
+            if (writeProgress < entry.count) { return true; }
+
+            // Done with this entry
+            writeProgress = 0;
+            {
+                std::lock_guard lck(queueMtx);
+                writeQueue.pop_front();
+            }
+            releaseWrite(entry);
+            if (entry.handler) { entry.handler(entry.count, entry.ctx); }
         }
+        wlck.unlock();
+        updateEvents();
+        return true;
+    }
+
+    void ConnClass::handleEvents(int events) {
+        bool ok = true;
+        if (events & (EVENT_READ | EVENT_HANGUP)) { ok = handleRead(); }
+
+        // The read handler may have closed the connection
+        {
+            std::lock_guard lck(queueMtx);
+            if (!registered) { return; }
+        }
+        if (ok && (events & EVENT_WRITE)) { ok = handleWrite(); }
+
+        // With nothing queued, a hangup would be reported again on every wait
+        if (ok && (events & EVENT_HANGUP)) {
+            std::lock_guard lck(queueMtx);
+            ok = !readQueue.empty();
+        }
+        if (ok) { return; }
+
+        // The connection dropped, stop watching it. The socket itself is released by close()
+        EventLoop::get().remove(_sock);
+        closed();
+        void (*handler)(void* ctx);
+        void* ctx;
+        {
+            std::lock_guard lck(queueMtx);
+            handler = closeHandler;
+            ctx = closeCtx;
+        }
+        if (handler) { handler(ctx); }
     }
 
 
     ListenerClass::ListenerClass(Socket listenSock) {
         sock = listenSock;
         listening = true;
-        acceptWorkerThread = std::thread(&ListenerClass::worker, this);
+        setNonblocking(sock);
+        EventLoop::get().add(sock, this, 0);
     }
 
     ListenerClass::~ListenerClass() {
@@ -241,13 +643,19 @@ namespace net {
         std::lock_guard lck(acceptMtx);
         Socket _sock;
 
-        // Accept socket
-        _sock = ::accept(sock, NULL, NULL);
+        // Accept socket, waiting for a connection
+        while (true) {
+            _sock = ::accept(sock, NULL, NULL);
 #ifdef _WIN32
-        if (_sock < 0 || _sock == SOCKET_ERROR) {
+            if (_sock != INVALID_SOCKET) { break; }
 #else
-        if (_sock < 0) {
+            if (_sock >= 0) { break; }
 #endif
+            if (wouldBlock() && listening) {
+                struct pollfd fd = { sock, POLLIN, 0 };
+                pollSockets(&fd, 1, -1);
+                if (!(fd.revents & (POLLHUP | POLLERR | POLLNVAL))) { continue; }
+            }
             listening = false;
             throw std::runtime_error("Could not bind socket");
             return NULL;
@@ -263,68 +671,78 @@ namespace net {
         entry.handler = handler;
         entry.ctx = ctx;
 
-        // Add entry to queue
+        // Add entry to queue and wait for connections
         {
             std::lock_guard lck(acceptQueueMtx);
             acceptQueue.push_back(entry);
         }
-
-        // Notify write worker
-        acceptQueueCnd.notify_all();
+        EventLoop::get().modify(sock, EVENT_READ);
     }
 
     void ListenerClass::close() {
-        {
-            std::lock_guard lck(acceptQueueMtx);
-            stopWorker = true;
-        }
-        acceptQueueCnd.notify_all();
+        if (!listening) { return; }
+        listening = false;
 
-        if (listening) {
+        // Make sure the accept handler isn't running anymore
+#ifdef _WIN32
+        shutdown(sock, SD_BOTH);
+#else
+        ::shutdown(sock, SHUT_RDWR);
+#endif
+        EventLoop::get().remove(sock);
+        {
+            std::lock_guard lck(acceptMtx);
 #ifdef _WIN32
             closesocket(sock);
 #else
-            ::shutdown(sock, SHUT_RDWR);
             ::close(sock);
 #endif
         }
 
-        if (acceptWorkerThread.joinable()) { acceptWorkerThread.join(); }
-
-
-        listening = false;
+        std::lock_guard lck(acceptQueueMtx);
+        acceptQueue.clear();
     }
 
     bool ListenerClass::isListening() {
         return listening;
     }
 
-    void ListenerClass::worker() {
-        while (true) {
-            // Wait for wakeup and exit if it's for terminating the thread
-            std::unique_lock lck(acceptQueueMtx);
-            acceptQueueCnd.wait(lck, [this]() { return (acceptQueue.size() > 0 || stopWorker); });
-            if (stopWorker || !listening) { return; }
-
-            // Pop first element off the list
-            ListenerAcceptEntry entry = acceptQueue[0];
-            acceptQueue.erase(acceptQueue.begin());
-            lck.unlock();
-
-            // Read from socket and send data to the handler
-            try {
-                Conn client = accept();
-                if (!client) {
-                    listening = false;
-                    return;
-                }
-                entry.handler(std::move(client), entry.ctx);
-            }
-            catch (const std::exception& e) {
-                listening = false;
+    void ListenerClass::handleEvents(int events) {
+        // Get the next handler
+        ListenerAcceptEntry entry;
+        {
+            std::lock_guard lck(acceptQueueMtx);
+            if (acceptQueue.empty()) {
+                EventLoop::get().modify(sock, 0);
                 return;
             }
+            entry = acceptQueue.front();
+        }
+
+        // Accept without waiting, the event may have been for a connection that was already reset
+        Socket _sock;
+        {
+            std::lock_guard lck(acceptMtx);
+            _sock = ::accept(sock, NULL, NULL);
+        }
+#ifdef _WIN32
+        if (_sock == INVALID_SOCKET) {
+#else
+        if (_sock < 0) {
+#endif
+            if (wouldBlock()) { return; }
+            listening = false;
+            EventLoop::get().remove(sock);
+            return;
+        }
+
+        // Stop waiting for connections until the handler asks for the next one
+        {
+            std::lock_guard lck(acceptQueueMtx);
+            acceptQueue.pop_front();
+            if (acceptQueue.empty()) { EventLoop::get().modify(sock, 0); }
         }
+        entry.handler(Conn(new ConnClass(_sock)), entry.ctx);
     }
 
 
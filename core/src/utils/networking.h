@@ -7,6 +7,8 @@
 #include <memory>
 #include <thread>
 #include <condition_variable>
+#include <deque>
+#include <map>
 
 #ifdef _WIN32
 #include <WinSock2.h>
@@ -19,6 +21,9 @@
 #include <netinet/in.h>
 #include <netdb.h>
 #include <signal.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <errno.h>
 #endif
 
 namespace net {
@@ -28,6 +33,96 @@ namespace net {
     typedef int Socket;
 #endif
 
+    enum {
+        EVENT_READ      = (1 << 0),
+        EVENT_WRITE     = (1 << 1),
+        EVENT_HANGUP    = (1 << 2)
+    };
+
+    class EventHandler {
+    public:
+        virtual void handleEvents(int events) = 0;
+    };
+
+    // Waits on all registered sockets from a single thread (epoll on Linux, poll elsewhere) and dispatches
+    // their readiness to their handler. Handlers run on the loop thread and must not block for long.
+    class EventLoop {
+    public:
+        EventLoop();
+        ~EventLoop();
+
+        /**
+         * Get the loop shared by all connections, it is started on first use.
+         * @return The shared event loop.
+         */
+        static EventLoop& get();
+
+        /**
+         * Register a socket.
+         * @param sock Socket to watch. Must be in non-blocking mode.
+         * @param handler Handler to call with the ready events.
+         * @param events Events to wait for, hangups are always reported.
+         */
+        void add(Socket sock, EventHandler* handler, int events);
+
+        /**
+         * Change the events a socket is waited on for.
+         * @param sock Registered socket.
+         * @param events Events to wait for, hangups are always reported.
+         */
+        void modify(Socket sock, int events);
+
+        /**
+         * Unregister a socket. Once this returns, its handler is not running and won't be called again
+         * unless this was called from the handler itself.
+         * @param sock Registered socket.
+         */
+        void remove(Socket sock);
+
+        bool inLoopThread();
+
+    private:
+        struct Watch {
+            EventHandler* handler;
+            int events;
+        };
+
+        void worker();
+        void wake();
+
+        std::mutex watchMtx;
+        std::condition_variable dispatchCnd;
+        std::map<Socket, Watch> watches;
+        EventHandler* dispatching = NULL;
+        bool running = true;
+        std::thread workerThread;
+
+#ifdef __linux__
+        int epollFd;
+        int wakeFd;
+#else
+        Socket wakeSock;
+        struct sockaddr_in wakeAddr;
+#endif
+    };
+
+    // Fixed size buffers recycled between the writers of all connections
+    class BufferPool {
+    public:
+        BufferPool(int bufferSize, int maxFree);
+        ~BufferPool();
+
+        uint8_t* alloc();
+        void free(uint8_t* buf);
+        int getBufferSize() { return bufferSize; }
+
+    private:
+        std::mutex mtx;
+        std::vector<uint8_t*> freeList;
+        int bufferSize;
+        int maxFree;
+    };
+
     struct ConnReadEntry {
         int count;
         uint8_t* buf;
@@ -39,9 +134,13 @@ namespace net {
     struct ConnWriteEntry {
         int count;
         uint8_t* buf;
+        bool pooled;
+        std::shared_ptr<const void> owner;
+        void (*handler)(int count, void* ctx);
+        void* ctx;
     };
 
-    class ConnClass {
+    class ConnClass : public EventHandler {
     public:
         ConnClass(Socket sock, struct sockaddr_in raddr = {}, bool udp = false);
         ~ConnClass();
@@ -52,29 +151,60 @@ namespace net {
 
         int read(int count, uint8_t* buf, bool enforceSize = true);
         bool write(int count, uint8_t* buf);
+
+        // The handler is called from the event loop thread, it may read synchronously, queue another read or
+        // close the connection but must not destroy it
         void readAsync(int count, uint8_t* buf, void (*handler)(int count, uint8_t* buf, void* ctx), void* ctx, bool enforceSize = true);
+
+        // The data is copied, the buffer can be reused as soon as this returns
         void writeAsync(int count, uint8_t* buf);
 
+        /**
+         * Queue a write without copying the data, the buffer is kept alive by a reference to its owner until it was sent.
+         * @param count Number of bytes to write.
+         * @param buf Data to write.
+         * @param owner Object owning the buffer.
+         * @param handler Optional handler called from the event loop thread once all of the data was handed to the socket.
+         * It isn't called for writes dropped because the connection closed.
+         * @param ctx Context passed to the handler.
+         */
+        void writeAsync(int count, const uint8_t* buf, std::shared_ptr<const void> owner, void (*handler)(int count, void* ctx) = NULL, void* ctx = NULL);
+
+        /**
+         * Set a handler called from the event loop thread once the remote end closes the connection or it fails.
+         * It isn't called when the connection is closed locally.
+         * @param handler Handler to call.
+         * @param ctx Context passed to the handler.
+         */
+        void setCloseHandler(void (*handler)(void* ctx), void* ctx);
+
+        void handleEvents(int events);
+
     private:
-        void readWorker();
-        void writeWorker();
+        bool writeLocked(int count, uint8_t* buf);
+        void queueWrite(ConnWriteEntry& entry);
+        static void releaseWrite(ConnWriteEntry& entry);
+        void updateEvents();
+        bool waitReady(int events);
+        void closed();
+        bool handleRead();
+        bool handleWrite();
 
-        bool stopWorkers = false;
         bool connectionOpen = false;
+        bool registered = false;
 
         std::mutex readMtx;
         std::mutex writeMtx;
-        std::mutex readQueueMtx;
-        std::mutex writeQueueMtx;
+        std::mutex queueMtx;
         std::mutex connectionOpenMtx;
         std::mutex closeMtx;
-        std::condition_variable readQueueCnd;
-        std::condition_variable writeQueueCnd;
         std::condition_variable connectionOpenCnd;
-        std::vector<ConnReadEntry> readQueue;
-        std::vector<ConnWriteEntry> writeQueue;
-        std::thread readWorkerThread;
-        std::thread writeWorkerThread;
+        std::deque<ConnReadEntry> readQueue;
+        std::deque<ConnWriteEntry> writeQueue;
+        int readProgress = 0;
+        int writeProgress = 0;
+        void (*closeHandler)(void* ctx) = NULL;
+        void* closeCtx = NULL;
 
         Socket _sock;
         bool _udp;
@@ -88,28 +218,27 @@ namespace net {
         void* ctx;
     };
 
-    class ListenerClass {
+    class ListenerClass : public EventHandler {
     public:
         ListenerClass(Socket listenSock);
         ~ListenerClass();
 
         Conn accept();
+
+        // The handler is called from the event loop thread
         void acceptAsync(void (*handler)(Conn conn, void* ctx), void* ctx);
 
         void close();
         bool isListening();
 
-    private:
-        void worker();
+        void handleEvents(int events);
 
+    private:
         bool listening = false;
-        bool stopWorker = false;
 
         std::mutex acceptMtx;
         std::mutex acceptQueueMtx;
-        std::condition_variable acceptQueueCnd;
-        std::vector<ListenerAcceptEntry> acceptQueue;
-        std::thread acceptWorkerThread;
+        std::deque<ListenerAcceptEntry> acceptQueue;
 
         Socket sock;
     };
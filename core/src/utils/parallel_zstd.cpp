@@ -0,0 +1,178 @@
+#include "parallel_zstd.h"
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+
+namespace pzstd {
+    size_t compressBound(size_t len, int frames) {
+        frames = std::max<int>(frames, 1);
+        return sizeof(FrameIndexHeader) + (frames * sizeof(FrameIndexEntry)) + ZSTD_compressBound(len) + (frames * ZSTD_compressBound(0));
+    }
+
+    static int defaultThreads(int threads) {
+        if (threads > 0) { return threads; }
+        return std::clamp<int>(std::thread::hardware_concurrency() / 2, 1, 8);
+    }
+
+    void WorkerPool::startWorkers(int count) {
+        threads = std::max<int>(count, 1);
+        running = true;
+        for (int i = 1; i < threads; i++) {
+            workers.push_back(std::thread(&WorkerPool::worker, this, i));
+        }
+    }
+
+    void WorkerPool::stopWorkers() {
+        {
+            std::lock_guard<std::mutex> lck(mtx);
+            running = false;
+        }
+        startCnd.notify_all();
+        for (auto& w : workers) {
+            if (w.joinable()) { w.join(); }
+        }
+        workers.clear();
+    }
+
+    void WorkerPool::parallel(int tasks, const std::function<void(int task, int thread)>& fn) {
+        if (tasks <= 0) { return; }
+
+        // Don't wake up the workers for a single task
+        if (tasks == 1 || workers.empty()) {
+            for (int i = 0; i < tasks; i++) { fn(i, 0); }
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lck(mtx);
+            job = &fn;
+            taskCount = tasks;
+            nextTask = 0;
+            remaining = tasks;
+            generation++;
+        }
+        startCnd.notify_all();
+
+        runTasks(0);
+
+        std::unique_lock<std::mutex> lck(mtx);
+        doneCnd.wait(lck, [=]() { return remaining == 0; });
+        job = NULL;
+    }
+
+    void WorkerPool::worker(int id) {
+        uint64_t lastGen = 0;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lck(mtx);
+                startCnd.wait(lck, [&]() { return generation != lastGen || !running; });
+                if (!running) { return; }
+                lastGen = generation;
+            }
+            runTasks(id);
+        }
+    }
+
+    void WorkerPool::runTasks(int thread) {
+        std::unique_lock<std::mutex> lck(mtx);
+        while (nextTask < taskCount) {
+            int task = nextTask++;
+            const std::function<void(int, int)>* fn = job;
+            lck.unlock();
+            (*fn)(task, thread);
+            lck.lock();
+            if (--remaining == 0) { doneCnd.notify_all(); }
+        }
+    }
+
+    Compressor::Compressor(int threads) {
+        threads = defaultThreads(threads);
+        for (int i = 0; i < threads; i++) {
+            ctxs.push_back(ZSTD_createCCtx());
+        }
+        frames.resize(threads);
+        frameSizes.resize(threads);
+        startWorkers(threads);
+    }
+
+    Compressor::~Compressor() {
+        stopWorkers();
+        for (auto& ctx : ctxs) { ZSTD_freeCCtx(ctx); }
+    }
+
+    size_t Compressor::compress(const void* in, size_t len, void* out, size_t outCap, int level) {
+        // Use as many frames as there are threads unless the buffer is small
+        int frameCount = std::clamp<int>((len + MIN_FRAME_SIZE - 1) / MIN_FRAME_SIZE, 1, getThreads());
+        if (outCap < compressBound(len, frameCount)) { return 0; }
+        size_t frameLen = (len + frameCount - 1) / frameCount;
+
+        // Compress each frame to its own buffer since the compressed sizes aren't known in advance
+        std::atomic<bool> failed = false;
+        parallel(frameCount, [&](int task, int thread) {
+            size_t offset = task * frameLen;
+            size_t rawSize = std::min<size_t>(frameLen, len - offset);
+            std::vector<uint8_t>& buf = frames[task];
+            buf.resize(ZSTD_compressBound(rawSize));
+            size_t res = ZSTD_compressCCtx(ctxs[thread], buf.data(), buf.size(), (const uint8_t*)in + offset, rawSize, level);
+            if (ZSTD_isError(res)) { failed = true; res = 0; }
+            frameSizes[task] = res;
+        });
+        if (failed) { return 0; }
+
+        // Write the index followed by the frames
+        uint8_t* _out = (uint8_t*)out;
+        FrameIndexHeader* hdr = (FrameIndexHeader*)_out;
+        FrameIndexEntry* entries = (FrameIndexEntry*)&_out[sizeof(FrameIndexHeader)];
+        hdr->frameCount = frameCount;
+        size_t pos = sizeof(FrameIndexHeader) + (frameCount * sizeof(FrameIndexEntry));
+        for (int i = 0; i < frameCount; i++) {
+            entries[i].compressedSize = frameSizes[i];
+            entries[i].rawSize = std::min<size_t>(frameLen, len - (i * frameLen));
+            memcpy(&_out[pos], frames[i].data(), frameSizes[i]);
+            pos += frameSizes[i];
+        }
+        return pos;
+    }
+
+    Decompressor::Decompressor(int threads) {
+        threads = defaultThreads(threads);
+        for (int i = 0; i < threads; i++) {
+            ctxs.push_back(ZSTD_createDCtx());
+        }
+        startWorkers(threads);
+    }
+
+    Decompressor::~Decompressor() {
+        stopWorkers();
+        for (auto& ctx : ctxs) { ZSTD_freeDCtx(ctx); }
+    }
+
+    size_t Decompressor::decompress(const void* in, size_t len, void* out, size_t outCap) {
+        const uint8_t* _in = (const uint8_t*)in;
+        if (len < sizeof(FrameIndexHeader)) { return 0; }
+        const FrameIndexHeader* hdr = (const FrameIndexHeader*)_in;
+        if (hdr->frameCount == 0 || (len - sizeof(FrameIndexHeader)) / sizeof(FrameIndexEntry) < hdr->frameCount) { return 0; }
+        const FrameIndexEntry* entries = (const FrameIndexEntry*)&_in[sizeof(FrameIndexHeader)];
+
+        // Locate the frames and check that everything fits
+        int frameCount = hdr->frameCount;
+        std::vector<size_t> inOffsets(frameCount);
+        std::vector<size_t> outOffsets(frameCount);
+        size_t inPos = sizeof(FrameIndexHeader) + (frameCount * sizeof(FrameIndexEntry));
+        size_t outPos = 0;
+        for (int i = 0; i < frameCount; i++) {
+            inOffsets[i] = inPos;
+            outOffsets[i] = outPos;
+            inPos += entries[i].compressedSize;
+            outPos += entries[i].rawSize;
+            if (inPos > len || outPos > outCap) { return 0; }
+        }
+
+        std::atomic<bool> failed = false;
+        parallel(frameCount, [&](int task, int thread) {
+            size_t res = ZSTD_decompressDCtx(ctxs[thread], (uint8_t*)out + outOffsets[task], entries[task].rawSize, &_in[inOffsets[task]], entries[task].compressedSize);
+            if (ZSTD_isError(res) || res != entries[task].rawSize) { failed = true; }
+        });
+        return failed ? 0 : outPos;
+    }
+}
@@ -0,0 +1,112 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <zstd.h>
+
+// Block parallel zstd. A buffer is split into independent frames that are compressed on a pool of threads and
+// prefixed with an index of their sizes, so that the frames can also be decompressed in parallel on the other end.
+namespace pzstd {
+#pragma pack(push, 1)
+    struct FrameIndexHeader {
+        uint32_t frameCount;
+    };
+
+    struct FrameIndexEntry {
+        uint32_t compressedSize;
+        uint32_t rawSize;
+    };
+#pragma pack(pop)
+
+    // Frames are never made smaller than this so that small buffers aren't split for nothing
+    const size_t MIN_FRAME_SIZE = 64 * 1024;
+
+    /**
+     * Get the worst case size of a compressed buffer.
+     * @param len Size of the uncompressed data in bytes.
+     * @param frames Maximum number of frames, usually the thread count.
+     * @return Maximum size of the compressed buffer in bytes, including the index.
+     */
+    size_t compressBound(size_t len, int frames);
+
+    class WorkerPool {
+    public:
+        int getThreads() { return threads; }
+
+    protected:
+        void startWorkers(int count);
+        void stopWorkers();
+
+        // Run tasks on the pool, the calling thread takes part as thread 0
+        void parallel(int tasks, const std::function<void(int task, int thread)>& fn);
+
+    private:
+        void worker(int id);
+        void runTasks(int thread);
+
+        int threads = 1;
+        std::vector<std::thread> workers;
+        std::mutex mtx;
+        std::condition_variable startCnd;
+        std::condition_variable doneCnd;
+        const std::function<void(int, int)>* job = NULL;
+        int taskCount = 0;
+        int nextTask = 0;
+        int remaining = 0;
+        uint64_t generation = 0;
+        bool running = false;
+    };
+
+    class Compressor : public WorkerPool {
+    public:
+        /**
+         * Create a compressor.
+         * @param threads Number of threads, zero to use half of the CPU cores.
+         */
+        Compressor(int threads = 0);
+        ~Compressor();
+
+        /**
+         * Compress a buffer.
+         * @param in Data to compress.
+         * @param len Size of the data in bytes.
+         * @param out Output buffer, see compressBound() for its required size.
+         * @param outCap Size of the output buffer in bytes.
+         * @param level Zstd compression level.
+         * @return Size of the compressed data in bytes, zero on error.
+         */
+        size_t compress(const void* in, size_t len, void* out, size_t outCap, int level);
+
+    private:
+        std::vector<ZSTD_CCtx*> ctxs;
+        std::vector<std::vector<uint8_t>> frames;
+        std::vector<size_t> frameSizes;
+    };
+
+    class Decompressor : public WorkerPool {
+    public:
+        /**
+         * Create a decompressor.
+         * @param threads Number of threads, zero to use half of the CPU cores.
+         */
+        Decompressor(int threads = 0);
+        ~Decompressor();
+
+        /**
+         * Decompress a buffer created by a Compressor.
+         * @param in Compressed data including the index.
+         * @param len Size of the compressed data in bytes.
+         * @param out Output buffer.
+         * @param outCap Size of the output buffer in bytes.
+         * @return Size of the decompressed data in bytes, zero if the data is corrupt or doesn't fit.
+         */
+        size_t decompress(const void* in, size_t len, void* out, size_t outCap);
+
+    private:
+        std::vector<ZSTD_DCtx*> ctxs;
+    };
+}
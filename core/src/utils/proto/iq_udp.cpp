@@ -0,0 +1,86 @@
+#include "iq_udp.h"
+#include <string.h>
+#include <chrono>
+#include <stdlib.h>
+
+namespace net::iq_udp {
+    uint64_t now() {
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    void writeHeader(PacketHeader* hdr, uint32_t sequence, uint64_t timestamp) {
+        hdr->magic = MAGIC;
+        hdr->sequence = sequence;
+        hdr->timestamp = timestamp;
+    }
+
+    Receiver::Receiver() {
+        reset();
+    }
+
+    void Receiver::reset() {
+        std::lock_guard<std::mutex> lck(mtx);
+        started = false;
+        nextSeq = 0;
+        firstSeq = 0;
+        history = 0;
+        memset(&stats, 0, sizeof(ReceiveStats));
+        lastTransit = 0;
+    }
+
+    bool Receiver::process(const PacketHeader* hdr, uint64_t arrival, int& missing) {
+        std::lock_guard<std::mutex> lck(mtx);
+        missing = 0;
+
+        // Jitter as defined in RFC 3550, the clocks don't need to be synchronized since only differences are used
+        int64_t transit = (int64_t)(arrival - hdr->timestamp);
+        if (started) {
+            double d = (double)llabs(transit - lastTransit);
+            stats.jitter += (d - stats.jitter) / 16.0;
+        }
+        lastTransit = transit;
+
+        // First packet or sender restart
+        int32_t delta = (int32_t)(hdr->sequence - nextSeq);
+        if (!started || delta > MAX_GAP || delta < -MAX_GAP) {
+            started = true;
+            firstSeq = hdr->sequence;
+            nextSeq = hdr->sequence + 1;
+            history = 1;
+            stats.received++;
+            return true;
+        }
+
+        // Late packet
+        if (delta < 0) {
+            int age = -delta - 1;
+            if (age >= 64 || (history & (1ull << age))) {
+                stats.duplicates++;
+                return false;
+            }
+            history |= (1ull << age);
+
+            // It was only counted as lost if a gap covering it was seen, not if it predates the first packet
+            if ((int32_t)(hdr->sequence - firstSeq) > 0) { stats.lost--; }
+            stats.reordered++;
+            stats.received++;
+            stats.lossRate = (double)stats.lost / (double)(stats.received + stats.lost);
+            return false;
+        }
+
+        // In order, possibly after a gap
+        missing = delta;
+        stats.lost += delta;
+        stats.received++;
+        stats.lossRate = (double)stats.lost / (double)(stats.received + stats.lost);
+        history = (delta + 1 >= 64) ? 0 : (history << (delta + 1));
+        history |= 1;
+        nextSeq = hdr->sequence + 1;
+        return true;
+    }
+
+    ReceiveStats Receiver::getStats() {
+        std::lock_guard<std::mutex> lck(mtx);
+        return stats;
+    }
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include <stdint.h>
+#include <mutex>
+
+// Optional framing for raw IQ over UDP. Each datagram starts with a header carrying a sequence number and the
+// time it was sent so that the receiver can account for lost and reordered packets and measure the jitter.
+namespace net::iq_udp {
+#pragma pack(push, 1)
+    struct PacketHeader {
+        uint32_t magic;
+        uint32_t sequence;
+        uint64_t timestamp;
+    };
+#pragma pack(pop)
+
+    const uint32_t MAGIC = 0x51495053; // "SPIQ"
+
+    // Gaps larger than this are treated as a restart of the sender instead of lost packets
+    const int MAX_GAP = 1024;
+
+    /**
+     * Get the current time in the unit used for the timestamps.
+     * @return Time in microseconds.
+     */
+    uint64_t now();
+
+    /**
+     * Fill out a header.
+     * @param hdr Header to fill out.
+     * @param sequence Sequence number of the packet.
+     * @param timestamp Send time in microseconds.
+     */
+    void writeHeader(PacketHeader* hdr, uint32_t sequence, uint64_t timestamp);
+
+    struct ReceiveStats {
+        uint64_t received;
+        uint64_t lost;
+        uint64_t reordered;
+        uint64_t duplicates;
+        double jitter;      // Interarrival jitter in microseconds
+        double lossRate;    // Fraction of the expected packets that never arrived
+    };
+
+    class Receiver {
+    public:
+        Receiver();
+
+        void reset();
+
+        /**
+         * Account for a received packet.
+         * @param hdr Header of the packet.
+         * @param arrival Arrival time in microseconds.
+         * @param missing Number of packets missing right before this one, valid if the packet is in order.
+         * @return True if the packet is in order and should be used, false if it arrived late or twice.
+         */
+        bool process(const PacketHeader* hdr, uint64_t arrival, int& missing);
+
+        ReceiveStats getStats();
+
+    private:
+        std::mutex mtx;
+        bool started = false;
+        uint32_t nextSeq = 0;
+
+        // Sequence number of the first packet since the start, packets before it were never counted as lost
+        uint32_t firstSeq = 0;
+
+        // Bit i set means packet nextSeq - 1 - i was received
+        uint64_t history = 0;
+
+        ReceiveStats stats;
+        int64_t lastTransit = 0;
+    };
+}
@@ -15,12 +15,11 @@ namespace riff {
         close();
     }
 
-    bool Writer::open(std::string path, const char form[4]) {
+    bool Writer::open(std::string path, const char form[4], const disk::Options& options) {
         std::lock_guard<std::recursive_mutex> lck(mtx);
 
         // Open file
-        file = std::ofstream(path, std::ios::out | std::ios::binary);
-        if (!file.is_open()) { return false; }
+        if (!file.open(path, options)) { return false; }
 
         // Begin RIFF chunk
         beginRIFF(form);
@@ -30,7 +29,7 @@ namespace riff {
 
     bool Writer::isOpen() {
         std::lock_guard<std::recursive_mutex> lck(mtx);
-        return file.is_open();
+        return file.isOpen();
     }
 
     void Writer::close() {
@@ -71,10 +70,10 @@ namespace riff {
 
         // Create and write header
         ChunkDesc desc;
-        desc.pos = file.tellp();
+        desc.pos = file.tell();
         memcpy(desc.hdr.id, id, sizeof(desc.hdr.id));
         desc.hdr.size = 0;
-        file.write((char*)&desc.hdr, sizeof(ChunkHeader));
+        file.write(&desc.hdr, sizeof(ChunkHeader));
 
         // Save descriptor
         chunks.push(desc);
@@ -91,13 +90,8 @@ namespace riff {
         ChunkDesc desc = chunks.top();
         chunks.pop();
 
-        // Write size
-        auto pos = file.tellp();
-        auto npos = desc.pos;
-        npos += 4;
-        file.seekp(npos);
-        file.write((char*)&desc.hdr.size, sizeof(desc.hdr.size));
-        file.seekp(pos);
+        // Write size, this goes back into data that's possibly already handed to the disk writer
+        file.patch(desc.pos + 4, &desc.hdr.size, sizeof(desc.hdr.size));
 
         // If parent chunk, increment its size by the size of the sub-chunk plus the size of its header)
         if (!chunks.empty()) {
@@ -105,14 +99,21 @@ namespace riff {
         }
     }
 
-    void Writer::write(const uint8_t* data, size_t len) {
+    bool Writer::write(const uint8_t* data, size_t len) {
         std::lock_guard<std::recursive_mutex> lck(mtx);
 
         if (chunks.empty()) {
             throw std::runtime_error("No chunk to write into");
         }
-        file.write((char*)data, len);
+
+        // Data dropped by the disk writer doesn't count towards the chunk size
+        if (!file.write(data, len)) { return false; }
         chunks.top().hdr.size += len;
+        return true;
+    }
+
+    disk::Stats Writer::getStats() {
+        return file.getStats();
     }
 
     void Writer::beginRIFF(const char form[4]) {
@@ -1,9 +1,9 @@
 #pragma once
 #include <mutex>
-#include <fstream>
 #include <string>
 #include <stack>
 #include <stdint.h>
+#include "disk_writer.h"
 
 namespace riff {
 #pragma pack(push, 1)
@@ -15,7 +15,7 @@ namespace riff {
 
     struct ChunkDesc {
         ChunkHeader hdr;
-        std::streampos pos;
+        uint64_t pos;
     };
 
     class Writer {
@@ -24,7 +24,7 @@ namespace riff {
         // Writer(const Writer&& b);
         ~Writer();
 
-        bool open(std::string path, const char form[4]);
+        bool open(std::string path, const char form[4], const disk::Options& options = disk::Options());
         bool isOpen();
         void close();
 
@@ -34,14 +34,16 @@ namespace riff {
         void beginChunk(const char id[4]);
         void endChunk();
 
-        void write(const uint8_t* data, size_t len);
+        bool write(const uint8_t* data, size_t len);
+
+        disk::Stats getStats();
 
     private:
         void beginRIFF(const char form[4]);
         void endRIFF();
 
         std::recursive_mutex mtx;
-        std::ofstream file;
+        disk::Writer file;
         std::stack<ChunkDesc> chunks;
     };
 
@@ -69,7 +69,7 @@ namespace wav {
         }
 
         // Open file
-        if (!rw.open(path, WAVE_FILE_TYPE)) { return false; }
+        if (!rw.open(path, WAVE_FILE_TYPE, _diskOptions)) { return false; }
 
         // Write format chunk
         rw.beginChunk(FORMAT_MARKER);
@@ -147,6 +147,13 @@ namespace wav {
         _type = type;
     }
 
+    void Writer::setDiskOptions(const disk::Options& options) {
+        std::lock_guard<std::recursive_mutex> lck(mtx);
+        // Do not allow settings to change while open
+        if (rw.isOpen()) { throw std::runtime_error("Cannot change parameters while file is open"); }
+        _diskOptions = options;
+    }
+
     void Writer::write(float* samples, int count) {
         std::lock_guard<std::recursive_mutex> lck(mtx);
         if (!rw.isOpen()) { return; }
@@ -154,30 +161,31 @@ namespace wav {
         // Select different writer function depending on the chose depth
         int tcount = count * _channels;
         int tbytes = count * bytesPerSamp;
+        bool written = false;
         switch (_type) {
         case SAMP_TYPE_UINT8:
             // Volk doesn't support unsigned ints yet :/
             for (int i = 0; i < tcount; i++) {
                 bufU8[i] = (samples[i] * 127.0f) + 128.0f;
             }
-            rw.write(bufU8, tbytes);
+            written = rw.write(bufU8, tbytes);
             break;
         case SAMP_TYPE_INT16:
             volk_32f_s32f_convert_16i(bufI16, samples, 32767.0f, tcount);
-            rw.write((uint8_t*)bufI16, tbytes);
+            written = rw.write((uint8_t*)bufI16, tbytes);
             break;
         case SAMP_TYPE_INT32:
             volk_32f_s32f_convert_32i(bufI32, samples, 2147483647.0f, tcount);
-            rw.write((uint8_t*)bufI32, tbytes);
+            written = rw.write((uint8_t*)bufI32, tbytes);
             break;
         case SAMP_TYPE_FLOAT32:
-            rw.write((uint8_t*)samples, tbytes);
+            written = rw.write((uint8_t*)samples, tbytes);
             break;
         default:
             break;
         }
 
-        // Increment sample counter
-        samplesWritten += count;
+        // Increment sample counter, samples dropped by the disk writer are not in the file
+        if (written) { samplesWritten += count; }
     }
 }
@@ -47,6 +47,9 @@ namespace wav {
         void setSamplerate(uint64_t samplerate);
         void setFormat(Format format);
         void setSampleType(SampleType type);
+        void setDiskOptions(const disk::Options& options);
+
+        disk::Stats getDiskStats() { return rw.getStats(); }
 
         size_t getSamplesWritten() { return samplesWritten; }
 
@@ -61,6 +64,7 @@ namespace wav {
         uint64_t _samplerate;
         Format _format;
         SampleType _type;
+        disk::Options _diskOptions;
         size_t bytesPerSamp;
 
         uint8_t* bufU8 = NULL;
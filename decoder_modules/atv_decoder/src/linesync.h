@@ -55,6 +55,9 @@ public:
         minPeriod = (int32_t)(0.9999 * (float)(1 << 30));
     
         base_type::init(in);
+
+        // Can output multiple lines per input buffer
+        base_type::_block_schedulable = false;
     }
 
     void setInterpParams(int interpPhaseCount, int interpTapCount) {
@@ -15,6 +15,7 @@
 #include <m17dsp.h>
 #include <fstream>
 #include <chrono>
+#include <batch.h>
 
 #define CONCAT(a, b) ((std::string(a) + b).c_str())
 
@@ -259,6 +260,19 @@ private:
         M17DecoderModule* _this = (M17DecoderModule*)ctx;
         std::lock_guard lck(_this->lsfMtx);
         _this->lastUpdated = std::chrono::high_resolution_clock::now();
+
+        // When running over a recording, log each transmission once. The LSF repeats during a transmission.
+        if (batch::isActive() && lsf.valid) {
+            double time = batch::getTime(_this->name);
+            bool newCall = !_this->lsf.valid || lsf.src != _this->lsf.src || lsf.dst != _this->lsf.dst;
+            if (newCall || time - _this->lastLsfTime > 1.0) {
+                char buf[256];
+                sprintf(buf, "%s -> %s, %s, %s, CAN %d", lsf.src.c_str(), lsf.dst.c_str(), M17DataTypesTxt[lsf.dataType], M17EncryptionTypesTxt[lsf.encryptionType], lsf.channelAccessNum);
+                batch::writeLine(_this->name, buf);
+            }
+            _this->lastLsfTime = time;
+        }
+
         _this->lsf = lsf;
     }
 
@@ -283,6 +297,7 @@ private:
     bool showLines = false;
 
     M17LSF lsf;
+    double lastLsfTime = 0.0;
     std::mutex lsfMtx;
     std::chrono::time_point<std::chrono::high_resolution_clock> lastUpdated;
 };
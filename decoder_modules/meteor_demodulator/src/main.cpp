@@ -15,6 +15,7 @@
 #include <gui/widgets/constellation_diagram.h>
 
 #include <fstream>
+#include <batch.h>
 
 #define CONCAT(a, b) ((std::string(a) + b).c_str())
 
@@ -96,7 +97,10 @@ public:
         gui::menu.removeEntry(name);
     }
 
-    void postInit() {}
+    void postInit() {
+        // Record the symbols of the whole pass when running over a recording
+        if (batch::isActive()) { startRecording(); }
+    }
 
     void enable() {
         double bw = gui::waterfall.getBandwidth();
@@ -205,7 +209,8 @@ private:
     void startRecording() {
         std::lock_guard<std::mutex> lck(recMtx);
         dataWritten = 0;
-        std::string filename = genFileName(folderSelect.expandString(folderSelect.path) + "/meteor", ".s");
+        std::string dir = batch::isActive() ? batch::getOutputDir() : folderSelect.expandString(folderSelect.path);
+        std::string filename = genFileName(dir + "/meteor", ".s");
         recFile = std::ofstream(filename, std::ios::binary);
         if (recFile.is_open()) {
             flog::info("Recording to '{0}'", filename);
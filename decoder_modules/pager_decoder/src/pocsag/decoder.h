@@ -5,6 +5,7 @@
 #include <gui/widgets/symbol_diagram.h>
 #include <gui/style.h>
 #include <dsp/sink/handler_sink.h>
+#include <batch.h>
 #include "dsp.h"
 #include "pocsag.h"
 
@@ -85,6 +86,9 @@ private:
 
     void messageHandler(pocsag::Address addr, pocsag::MessageType type, const std::string& msg) {
         flog::debug("[{}]: '{}'", (uint32_t)addr, msg);
+
+        // Keep the messages when running over a recording
+        if (batch::isActive()) { batch::writeLine(name, std::to_string((uint32_t)addr) + ": " + msg); }
     }
 
     std::string name;
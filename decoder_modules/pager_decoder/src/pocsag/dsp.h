@@ -34,6 +34,7 @@ public:
 
         // Init base
         base_type::init(in);
+        base_type::registerOutput(&soft);
     }
 
     int process(int count, dsp::complex_t* in, float* softOut, uint8_t* out) {
@@ -5,6 +5,7 @@
 #include <gui/widgets/symbol_diagram.h>
 #include <fstream>
 #include <rds.h>
+#include <batch.h>
 
 namespace demod {
     enum RDSRegion {
@@ -288,6 +289,19 @@ namespace demod {
         static void rdsHandler(uint8_t* data, int count, void* ctx) {
             WFM* _this = (WFM*)ctx;
             _this->rdsDecode.process(data, count);
+
+            // When running over a recording, log the station name and radio text each time they change
+            if (!batch::isActive()) { return; }
+            if (_this->rdsDecode.PSNameValid()) {
+                std::string ps = _this->rdsDecode.getPSName();
+                if (ps != _this->lastPSName) { batch::writeLine(_this->name, "PS: " + ps); }
+                _this->lastPSName = ps;
+            }
+            if (_this->rdsDecode.radioTextValid()) {
+                std::string rt = _this->rdsDecode.getRadioText();
+                if (rt != _this->lastRadioText) { batch::writeLine(_this->name, "RT: " + rt); }
+                _this->lastRadioText = rt;
+            }
         }
 
         static void _diagHandler(float* data, int count, void* ctx) {
@@ -347,6 +361,8 @@ namespace demod {
         ImGui::SymbolDiagram diag;
 
         rds::Decoder rdsDecode;
+        std::string lastPSName;
+        std::string lastRadioText;
 
         ConfigManager* _config = NULL;
 
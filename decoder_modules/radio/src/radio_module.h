@@ -5,7 +5,7 @@
 #include <gui/style.h>
 #include <signal_path/signal_path.h>
 #include <config.h>
-#include <dsp/chain.h>
+#include <dsp/fused_chain.h>
 #include <dsp/noise_reduction/noise_blanker.h>
 #include <dsp/noise_reduction/fm_if.h>
 #include <dsp/noise_reduction/squelch.h>
@@ -68,11 +68,15 @@ public:
         // Initialize IF DSP chain
         ifChainOutputChanged.ctx = this;
         ifChainOutputChanged.handler = ifChainOutputChangeHandler;
-        ifChain.init(vfo->output);
+        // The squelch decides on whole buffers so the IF chain isn't split into tiles
+        ifChain.init(vfo->output, 0);
 
         nb.init(NULL, 500.0 / 24000.0, 10.0);
         fmnr.init(NULL, 32);
         squelch.init(NULL, MIN_SQUELCH);
+        nb.out.free();
+        fmnr.out.free();
+        squelch.out.free();
 
         ifChain.addBlock(&nb, false);
         ifChain.addBlock(&squelch, false);
@@ -83,6 +87,8 @@ public:
 
         resamp.init(NULL, 250000.0, 48000.0);
         deemp.init(NULL, 50e-6, 48000.0);
+        resamp.out.free();
+        deemp.out.free();
 
         afChain.addBlock(&resamp, true);
         afChain.addBlock(&deemp, false);
@@ -652,14 +658,14 @@ private:
     VFOManager::VFO* vfo = NULL;
 
     // IF chain
-    dsp::chain<dsp::complex_t> ifChain;
+    dsp::fused_chain<dsp::complex_t> ifChain;
     dsp::noise_reduction::NoiseBlanker nb;
     dsp::noise_reduction::FMIF fmnr;
     dsp::noise_reduction::Squelch squelch;
 
     // Audio chain
     dsp::stream<dsp::stereo_t> dummyAudioStream;
-    dsp::chain<dsp::stereo_t> afChain;
+    dsp::fused_chain<dsp::stereo_t> afChain;
     dsp::multirate::RationalResampler<dsp::stereo_t> resamp;
     dsp::filter::Deemphasis<dsp::stereo_t> deemp;
 
@@ -1,4 +1,5 @@
 #include <utils/net.h>
+#include <utils/proto/iq_udp.h>
 #include <imgui.h>
 #include <module.h>
 #include <gui/gui.h>
@@ -8,7 +9,6 @@
 #include <dsp/sink/handler_sink.h>
 #include <volk/volk.h>
 #include <signal_path/signal_path.h>
-#include <dsp/buffer/reshaper.h>
 #include <gui/dialogs/dialog_box.h>
 #include <core.h>
 
@@ -114,6 +114,12 @@ public:
             port = config.conf[name]["port"];
             port = std::clamp<int>(port, 1, 65535);
         }
+        if (config.conf[name].contains("header")) {
+            header = config.conf[name]["header"];
+        }
+        if (config.conf[name].contains("segmentOffload")) {
+            segmentOffload = config.conf[name]["segmentOffload"];
+        }
         if (config.conf[name].contains("running")) {
             autoStart = config.conf[name]["running"];
         }
@@ -126,12 +132,11 @@ public:
         sampTypeId = sampleTypes.valueId(sampType);
         packetSizeId = packetSizes.valueId(packetSize);
 
-        // Allocate buffer
-        buffer = dsp::buffer::alloc<uint8_t>(STREAM_BUFFER_SIZE * sizeof(dsp::complex_t));
+        // Allocate buffer, with room for the partial packet left over from the previous block
+        buffer = dsp::buffer::alloc<uint8_t>(STREAM_BUFFER_SIZE * sizeof(dsp::complex_t) + MAX_PACKET_SIZE);
 
         // Init DSP
-        reshape.init(&iqStream, packetSize/sampleSize(), 0);
-        handler.init(&reshape.out, dataHandler, this);
+        handler.init(&iqStream, dataHandler, this);
 
         // Set operating mode
         setMode(nMode);
@@ -194,6 +199,11 @@ public:
         // Acquire lock on the socket
         std::lock_guard lck1(sockMtx);
 
+        // Start a new packet sequence
+        pending = 0;
+        sequence = 0;
+        mediaRate = 0.0;
+
         // Start listening or open UDP socket
         try {
             if (proto == PROTOCOL_TCP_SERVER) {
@@ -327,7 +337,6 @@ private:
         ImGui::FillWidth();
         if (ImGui::Combo(("##iq_exporter_samp_" + _this->name).c_str(), &_this->sampTypeId, _this->sampleTypes.txt)) {
             _this->sampType = _this->sampleTypes.value(_this->sampTypeId);
-            _this->reshape.setKeep(_this->packetSize/_this->sampleSize());
             config.acquire();
             config.conf[_this->name]["sampleType"] = _this->sampleTypes.key(_this->sampTypeId);
             config.release(true);
@@ -338,12 +347,25 @@ private:
         ImGui::FillWidth();
         if (ImGui::Combo(("##iq_exporter_pkt_sz_" + _this->name).c_str(), &_this->packetSizeId, _this->packetSizes.txt)) {
             _this->packetSize = _this->packetSizes.value(_this->packetSizeId);
-            _this->reshape.setKeep(_this->packetSize/_this->sampleSize());
             config.acquire();
             config.conf[_this->name]["packetSize"] = _this->packetSizes.key(_this->packetSizeId);
             config.release(true);
         }
 
+        // UDP framing options
+        if (_this->proto == PROTOCOL_UDP) {
+            if (ImGui::Checkbox(("Sequence header##iq_exporter_header_" + _this->name).c_str(), &_this->header)) {
+                config.acquire();
+                config.conf[_this->name]["header"] = _this->header;
+                config.release(true);
+            }
+            if (ImGui::Checkbox(("Segmentation offload##iq_exporter_gso_" + _this->name).c_str(), &_this->segmentOffload)) {
+                config.acquire();
+                config.conf[_this->name]["segmentOffload"] = _this->segmentOffload;
+                config.release(true);
+            }
+        }
+
         // Hostname and port field
         if (ImGui::InputText(("##iq_exporter_host_" + _this->name).c_str(), _this->hostname, sizeof(_this->hostname))) {
             config.acquire();
@@ -413,7 +435,6 @@ private:
         if (!forceSet && mode == newMode) { return; }
 
         // Stop the DSP
-        reshape.stop();
         handler.stop();
 
         // Delete VFO or unbind IQ stream
@@ -435,7 +456,7 @@ private:
             vfo = sigpath::vfoManager.createVFO(name, ImGui::WaterfallVFO::REF_CENTER, 0, samplerate, samplerate, samplerate, samplerate, true);
 
             // Set its output as the input to the DSP
-            reshape.setInput(vfo->output);
+            handler.setInput(vfo->output);
         }
         else {
             // Bind IQ stream
@@ -443,11 +464,10 @@ private:
             streamBound = true;
 
             // Set its output as the input to the DSP
-            reshape.setInput(&iqStream);
+            handler.setInput(&iqStream);
         }
 
         // Start DSP
-        reshape.start();
         handler.start();
 
         // Update mode
@@ -497,36 +517,95 @@ private:
             return;
         }
         
-        // Convert the samples or send directory for float32
-        int size;
+        // Convert the samples after what's left of the previous block
+        uint8_t* out = &_this->buffer[_this->pending];
         switch (_this->sampType) {
         case SAMPLE_TYPE_INT8:
-            volk_32f_s32f_convert_8i((int8_t*)_this->buffer, (float*)data, 128.0f, count*2);
-            size = sizeof(int8_t)*2;
+            volk_32f_s32f_convert_8i((int8_t*)out, (float*)data, 128.0f, count*2);
             break;
         case SAMPLE_TYPE_INT16:
-            volk_32f_s32f_convert_16i((int16_t*)_this->buffer, (float*)data, 32768.0f, count*2);
-            size = sizeof(int16_t)*2;
+            volk_32f_s32f_convert_16i((int16_t*)out, (float*)data, 32768.0f, count*2);
             break;
         case SAMPLE_TYPE_INT32:
-            volk_32f_s32f_convert_32i((int32_t*)_this->buffer, (float*)data, 2147483647.0f, count*2);
-            size = sizeof(int32_t)*2;
+            volk_32f_s32f_convert_32i((int32_t*)out, (float*)data, 2147483647.0f, count*2);
             break;
         case SAMPLE_TYPE_FLOAT32:
-            _this->sock->send((uint8_t*)data, count*sizeof(dsp::complex_t));
+            memcpy(out, data, count*sizeof(dsp::complex_t));
+            break;
         default:
             // Unlock socket mutex
             _this->sockMtx.unlock();
             return;
         }
+        int total = _this->pending + count*_this->sampleSize();
+
+        // Over TCP there are no packet boundaries, send everything at once
+        if (_this->proto != PROTOCOL_UDP) {
+            _this->sock->send(_this->buffer, total);
+            _this->pending = 0;
+            _this->sockMtx.unlock();
+            return;
+        }
+
+        // Send all complete packets of the block in as few system calls as possible
+        int payload = _this->packetSize;
+        int packets = total / payload;
+        if (packets) {
+            if (_this->header) {
+                // Prefix each packet with its sequence number and the sampling time of its first sample
+                int pktSize = sizeof(net::iq_udp::PacketHeader) + payload;
+                if (_this->packetBuf.size() < packets * pktSize) { _this->packetBuf.resize(packets * pktSize); }
+                for (int i = 0; i < packets; i++) {
+                    uint8_t* pkt = &_this->packetBuf[i * pktSize];
+                    net::iq_udp::writeHeader((net::iq_udp::PacketHeader*)pkt, _this->sequence++, _this->mediaTime());
+                    memcpy(&pkt[sizeof(net::iq_udp::PacketHeader)], &_this->buffer[i * payload], payload);
+                    _this->mediaSamples += payload / _this->sampleSize();
+                }
+                _this->sendPackets(_this->packetBuf.data(), packets, pktSize);
+            }
+            else {
+                _this->sendPackets(_this->buffer, packets, payload);
+            }
+        }
 
-        // Send converted samples
-        _this->sock->send(_this->buffer, count*size);
+        // Keep the partial packet for the next block
+        _this->pending = total - packets*payload;
+        if (_this->pending) { memmove(_this->buffer, &_this->buffer[packets*payload], _this->pending); }
 
         // Unlock socket mutex
         _this->sockMtx.unlock();
     }
 
+    // Timestamps follow the sample clock as in RFC 3550, stamping packets with the time they were sent would
+    // only measure how the DSP batches them
+    uint64_t mediaTime() {
+        // Restart the timeline from the current position when the samplerate changes
+        double rate = (mode == MODE_VFO) ? (double)samplerate : sigpath::iqFrontEnd.getEffectiveSamplerate();
+        if (rate <= 0.0) { return net::iq_udp::now(); }
+        if (rate != mediaRate) {
+            mediaBase = mediaRate ? (mediaBase + (uint64_t)((double)mediaSamples * 1e6 / mediaRate)) : net::iq_udp::now();
+            mediaSamples = 0;
+            mediaRate = rate;
+        }
+        return mediaBase + (uint64_t)((double)mediaSamples * 1e6 / mediaRate);
+    }
+
+    void sendPackets(const uint8_t* data, int count, int size) {
+        if (segmentOffload) {
+            sock->sendSegments(data, count * size, size);
+            return;
+        }
+        if (packetPtrs.size() < count) {
+            packetPtrs.resize(count);
+            packetSizesBuf.resize(count);
+        }
+        for (int i = 0; i < count; i++) {
+            packetPtrs[i] = &data[i * size];
+            packetSizesBuf[i] = size;
+        }
+        sock->sendBatch(packetPtrs.data(), packetSizesBuf.data(), count);
+    }
+
     std::string name;
     bool enabled = true;
 
@@ -540,6 +619,8 @@ private:
     int sampTypeId;
     int packetSize = 1024;
     int packetSizeId;
+    bool header = false;
+    bool segmentOffload = true;
     char hostname[1024] = "localhost";
     int port = 1234;
     bool running = false;
@@ -557,9 +638,19 @@ private:
     VFOManager::VFO* vfo = NULL;
     bool streamBound = false;
     dsp::stream<dsp::complex_t> iqStream;
-    dsp::buffer::Reshaper<dsp::complex_t> reshape;
     dsp::sink::Handler<dsp::complex_t> handler;
     uint8_t* buffer = NULL;
+    int pending = 0;
+
+    // UDP packetization
+    static const int MAX_PACKET_SIZE = 32768;
+    std::vector<uint8_t> packetBuf;
+    std::vector<const uint8_t*> packetPtrs;
+    std::vector<int> packetSizesBuf;
+    uint32_t sequence = 0;
+    uint64_t mediaBase = 0;
+    uint64_t mediaSamples = 0;
+    double mediaRate = 0.0;
 
     std::thread listenWorkerThread;
 
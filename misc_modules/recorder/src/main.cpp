@@ -21,17 +21,23 @@
 #include <core.h>
 #include <utils/optionlist.h>
 #include <utils/wav.h>
+#include <utils/iqz.h>
 #include <radio_interface.h>
 
 #define CONCAT(a, b) ((std::string(a) + b).c_str())
 
 #define SILENCE_LVL 10e-6
 
+enum Container {
+    CONTAINER_WAV,
+    CONTAINER_IQZ
+};
+
 SDRPP_MOD_INFO{
     /* Name:            */ "recorder",
     /* Description:     */ "Recorder module for SDR++",
     /* Author:          */ "Ryzerth",
-    /* Version:         */ 0, 3, 0,
+    /* Version:         */ 0, 4, 0,
     /* Max instances    */ -1
 };
 
@@ -45,16 +51,33 @@ public:
         strcpy(nameTemplate, "$t_$f_$h-$m-$s_$d-$M-$y");
 
         // Define option lists
-        containers.define("WAV", wav::FORMAT_WAV);
+        containers.define("WAV", CONTAINER_WAV);
         // containers.define("RF64", wav::FORMAT_RF64); // Disabled for now
+        containers.define("IQZ", CONTAINER_IQZ);
         sampleTypes.define(wav::SAMP_TYPE_UINT8, "Uint8", wav::SAMP_TYPE_UINT8);
         sampleTypes.define(wav::SAMP_TYPE_INT16, "Int16", wav::SAMP_TYPE_INT16);
         sampleTypes.define(wav::SAMP_TYPE_INT32, "Int32", wav::SAMP_TYPE_INT32);
         sampleTypes.define(wav::SAMP_TYPE_FLOAT32, "Float32", wav::SAMP_TYPE_FLOAT32);
+        quantizations.define("i8", "Int8", dsp::compression::PCM_TYPE_I8);
+        quantizations.define("i16", "Int16", dsp::compression::PCM_TYPE_I16);
+        quantizations.define("f32", "Float32", dsp::compression::PCM_TYPE_F32);
+        compressions.define("none", "None", iqz::ENTROPY_NONE);
+        compressions.define("zstd", "Zstd", iqz::ENTROPY_ZSTD);
+        compressions.define("lpc", "Linear prediction", iqz::ENTROPY_LPC);
+        diskBackends.define("buffered", "Buffered", disk::BACKEND_BUFFERED);
+        if (disk::backendSupported(disk::BACKEND_DIRECT)) {
+            diskBackends.define("direct", "Direct I/O", disk::BACKEND_DIRECT);
+        }
+        if (disk::backendSupported(disk::BACKEND_IO_URING)) {
+            diskBackends.define("io_uring", "io_uring", disk::BACKEND_IO_URING);
+        }
 
         // Load default config for option lists
-        containerId = containers.valueId(wav::FORMAT_WAV);
+        containerId = containers.valueId(CONTAINER_WAV);
         sampleTypeId = sampleTypes.valueId(wav::SAMP_TYPE_INT16);
+        quantizationId = quantizations.valueId(dsp::compression::PCM_TYPE_I16);
+        compressionId = compressions.valueId(iqz::ENTROPY_LPC);
+        diskBackendId = diskBackends.valueId(disk::BACKEND_BUFFERED);
 
         // Load config
         config.acquire();
@@ -70,6 +93,21 @@ public:
         if (config.conf[name].contains("sampleType") && sampleTypes.keyExists(config.conf[name]["sampleType"])) {
             sampleTypeId = sampleTypes.keyId(config.conf[name]["sampleType"]);
         }
+        if (config.conf[name].contains("quantization") && quantizations.keyExists(config.conf[name]["quantization"])) {
+            quantizationId = quantizations.keyId(config.conf[name]["quantization"]);
+        }
+        if (config.conf[name].contains("compression") && compressions.keyExists(config.conf[name]["compression"])) {
+            compressionId = compressions.keyId(config.conf[name]["compression"]);
+        }
+        if (config.conf[name].contains("encoderThreads")) {
+            encoderThreads = config.conf[name]["encoderThreads"];
+        }
+        if (config.conf[name].contains("diskBackend") && diskBackends.keyExists(config.conf[name]["diskBackend"])) {
+            diskBackendId = diskBackends.keyId(config.conf[name]["diskBackend"]);
+        }
+        if (config.conf[name].contains("preallocate")) {
+            preallocate = config.conf[name]["preallocate"];
+        }
         if (config.conf[name].contains("audioStream")) {
             selectedStreamName = config.conf[name]["audioStream"];
         }
@@ -162,16 +200,33 @@ public:
         else {
             samplerate = sigpath::iqFrontEnd.getSampleRate();
         }
-        writer.setFormat(containers[containerId]);
+        compressed = (recMode == RECORDER_MODE_BASEBAND && containers[containerId] == CONTAINER_IQZ);
+        writer.setFormat(wav::FORMAT_WAV);
         writer.setChannels((recMode == RECORDER_MODE_AUDIO && !stereo) ? 1 : 2);
         writer.setSampleType(sampleTypes[sampleTypeId]);
         writer.setSamplerate(samplerate);
+        disk::Options diskOptions;
+        diskOptions.backend = diskBackends[diskBackendId];
+        if (!preallocate) { diskOptions.preallocate = 0; }
+        if (recMode == RECORDER_MODE_AUDIO) { diskOptions.bufferSize = 256 * 1024; }
+        writer.setDiskOptions(diskOptions);
 
         // Open file
         std::string vfoName = (recMode == RECORDER_MODE_AUDIO) ? selectedStreamName : "";
-        std::string extension = ".wav";
+        std::string extension = compressed ? ".iqz" : ".wav";
         std::string expandedPath = expandString(folderSelect.path + "/" + genFileName(nameTemplate, recMode, vfoName) + extension);
-        if (!writer.open(expandedPath)) {
+        bool opened;
+        if (compressed) {
+            iqz::Options iqzOptions;
+            iqzOptions.pcmType = quantizations[quantizationId];
+            iqzOptions.entropy = compressions[compressionId];
+            iqzOptions.threads = encoderThreads;
+            opened = iqzWriter.open(expandedPath, samplerate, gui::waterfall.getCenterFrequency(), iqzOptions, diskOptions);
+        }
+        else {
+            opened = writer.open(expandedPath);
+        }
+        if (!opened) {
             flog::error("Failed to open file for recording: {0}", expandedPath);
             return;
         }
@@ -219,7 +274,12 @@ public:
         }
 
         // Close file
-        writer.close();
+        if (compressed) {
+            iqzWriter.close();
+        }
+        else {
+            writer.close();
+        }
         
         recording = false;
     }
@@ -274,11 +334,54 @@ private:
             config.release(true);
         }
 
-        ImGui::LeftLabel("Sample type");
+        // Compressed recordings are only available for baseband
+        if (_this->recMode == RECORDER_MODE_BASEBAND && _this->containers[_this->containerId] == CONTAINER_IQZ) {
+            ImGui::LeftLabel("Quantization");
+            ImGui::FillWidth();
+            if (ImGui::Combo(CONCAT("##_recorder_quant_", _this->name), &_this->quantizationId, _this->quantizations.txt)) {
+                config.acquire();
+                config.conf[_this->name]["quantization"] = _this->quantizations.key(_this->quantizationId);
+                config.release(true);
+            }
+
+            ImGui::LeftLabel("Compression");
+            ImGui::FillWidth();
+            if (ImGui::Combo(CONCAT("##_recorder_compression_", _this->name), &_this->compressionId, _this->compressions.txt)) {
+                config.acquire();
+                config.conf[_this->name]["compression"] = _this->compressions.key(_this->compressionId);
+                config.release(true);
+            }
+
+            ImGui::LeftLabel("Encoder threads");
+            ImGui::FillWidth();
+            if (ImGui::InputInt(CONCAT("##_recorder_enc_threads_", _this->name), &_this->encoderThreads)) {
+                _this->encoderThreads = std::clamp<int>(_this->encoderThreads, 0, 64);
+                config.acquire();
+                config.conf[_this->name]["encoderThreads"] = _this->encoderThreads;
+                config.release(true);
+            }
+        }
+        else {
+            ImGui::LeftLabel("Sample type");
+            ImGui::FillWidth();
+            if (ImGui::Combo(CONCAT("##_recorder_st_", _this->name), &_this->sampleTypeId, _this->sampleTypes.txt)) {
+                config.acquire();
+                config.conf[_this->name]["sampleType"] = _this->sampleTypes.key(_this->sampleTypeId);
+                config.release(true);
+            }
+        }
+
+        ImGui::LeftLabel("Disk writes");
         ImGui::FillWidth();
-        if (ImGui::Combo(CONCAT("##_recorder_st_", _this->name), &_this->sampleTypeId, _this->sampleTypes.txt)) {
+        if (ImGui::Combo(CONCAT("##_recorder_disk_backend_", _this->name), &_this->diskBackendId, _this->diskBackends.txt)) {
             config.acquire();
-            config.conf[_this->name]["sampleType"] = _this->sampleTypes.key(_this->sampleTypeId);
+            config.conf[_this->name]["diskBackend"] = _this->diskBackends.key(_this->diskBackendId);
+            config.release(true);
+        }
+
+        if (ImGui::Checkbox(CONCAT("Preallocate##_recorder_preallocate_", _this->name), &_this->preallocate)) {
+            config.acquire();
+            config.conf[_this->name]["preallocate"] = _this->preallocate;
             config.release(true);
         }
 
@@ -339,7 +442,8 @@ private:
             if (ImGui::Button(CONCAT("Stop##_recorder_rec_", _this->name), ImVec2(menuWidth, 0))) {
                 _this->stop();
             }
-            uint64_t seconds = _this->writer.getSamplesWritten() / _this->samplerate;
+            size_t samplesWritten = _this->compressed ? _this->iqzWriter.getSamplesWritten() : _this->writer.getSamplesWritten();
+            uint64_t seconds = samplesWritten / _this->samplerate;
             time_t diff = seconds;
             tm* dtm = gmtime(&diff);
 
@@ -349,6 +453,28 @@ private:
             else {
                 ImGui::TextColored(ImVec4(1.0f, 0.0f, 0.0f, 1.0f), "Recording %02d:%02d:%02d", dtm->tm_hour, dtm->tm_min, dtm->tm_sec);
             }
+
+            // Disk writer health, overruns mean the disk couldn't keep up and samples were lost
+            disk::Stats stats;
+            if (_this->compressed) {
+                iqz::Stats iqzStats = _this->iqzWriter.getStats();
+                stats = iqzStats.disk;
+                ImGui::Text("Compression ratio: %.2f", iqzStats.outputBytes ? (double)iqzStats.inputBytes / (double)iqzStats.outputBytes : 0.0);
+                if (iqzStats.overruns) {
+                    ImGui::TextColored(ImVec4(1.0f, 0.0f, 0.0f, 1.0f), "Encoder overruns: %llu", (unsigned long long)iqzStats.overruns);
+                }
+            }
+            else {
+                stats = _this->writer.getDiskStats();
+            }
+            ImGui::Text("Disk buffers: %d/%d", stats.queued, stats.bufferCount);
+            if (stats.overruns) {
+                ImGui::TextColored(ImVec4(1.0f, 0.0f, 0.0f, 1.0f), "Overruns: %llu (%.1f MB lost)", (unsigned long long)stats.overruns, (double)stats.droppedBytes / 1e6);
+            }
+            else {
+                ImGui::TextUnformatted("Overruns: 0");
+            }
+            ImGui::Text("Write latency: %.1f ms (max %.1f ms)", stats.avgLatency / 1000.0, stats.maxLatency / 1000.0);
         }
     }
 
@@ -506,6 +632,10 @@ private:
 
     static void complexHandler(dsp::complex_t* data, int count, void* ctx) {
         RecorderModule* _this = (RecorderModule*)ctx;
+        if (_this->compressed) {
+            _this->iqzWriter.write(data, count);
+            return;
+        }
         _this->writer.write((float*)data, count);
     }
 
@@ -564,13 +694,21 @@ private:
     std::string root;
     char nameTemplate[1024];
 
-    OptionList<std::string, wav::Format> containers;
+    OptionList<std::string, Container> containers;
     OptionList<int, wav::SampleType> sampleTypes;
+    OptionList<std::string, dsp::compression::PCMType> quantizations;
+    OptionList<std::string, iqz::Entropy> compressions;
+    OptionList<std::string, disk::Backend> diskBackends;
     FolderSelect folderSelect;
 
     int recMode = RECORDER_MODE_AUDIO;
     int containerId;
     int sampleTypeId;
+    int quantizationId;
+    int compressionId;
+    int encoderThreads = 0;
+    int diskBackendId;
+    bool preallocate = true;
     bool stereo = true;
     std::string selectedStreamName = "";
     float audioVolume = 1.0f;
@@ -579,7 +717,9 @@ private:
 
     bool recording = false;
     bool ignoringSilence = false;
+    bool compressed = false;
     wav::Writer writer;
+    iqz::Writer iqzWriter;
     std::recursive_mutex recMtx;
     dsp::stream<dsp::complex_t>* basebandStream;
     dsp::stream<dsp::stereo_t> stereoStream;
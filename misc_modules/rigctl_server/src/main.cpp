@@ -308,9 +308,14 @@ private:
         SigctlServerModule* _this = (SigctlServerModule*)ctx;
         //flog::info("New client!");
 
+        // Handlers run on the network event loop, so wait for the disconnection instead of blocking here
         _this->client = std::move(_client);
+        _this->client->setCloseHandler(clientClosedHandler, _this);
         _this->client->readAsync(1024, _this->dataBuf, dataHandler, _this, false);
-        _this->client->waitForEnd();
+    }
+
+    static void clientClosedHandler(void* ctx) {
+        SigctlServerModule* _this = (SigctlServerModule*)ctx;
         _this->client->close();
 
         //flog::info("Client disconnected!");
@@ -261,18 +261,19 @@ private:
     static void clientHandler(net::Conn client, void* ctx) {
         NetworkSink* _this = (NetworkSink*)ctx;
 
-        {
-            std::lock_guard lck(_this->connMtx);
-            _this->conn = std::move(client);
-        }
-
+        // Handlers run on the network event loop, so wait for the disconnection instead of blocking here
+        std::lock_guard lck(_this->connMtx);
+        _this->conn = std::move(client);
         if (_this->conn) {
-            _this->conn->waitForEnd();
-            _this->conn->close();
+            _this->conn->setCloseHandler(clientClosedHandler, _this);
         }
         else {
+            _this->listener->acceptAsync(clientHandler, _this);
         }
+    }
 
+    static void clientClosedHandler(void* ctx) {
+        NetworkSink* _this = (NetworkSink*)ctx;
         _this->listener->acceptAsync(clientHandler, _this);
     }
 
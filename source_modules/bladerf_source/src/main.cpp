@@ -3,6 +3,7 @@
 #include <module.h>
 #include <gui/gui.h>
 #include <signal_path/signal_path.h>
+#include <dsp/convert/iq_to_complex.h>
 #include <core.h>
 #include <gui/style.h>
 #include <config.h>
@@ -584,7 +585,7 @@ private:
             if (ret != 0) { break; }
 
             // Convert to complex float and swap buffers
-            volk_16i_s32f_convert_32f((float*)stream.writeBuf, buffer, 32768.0f, bufferSize * 2);
+            dsp::convert::s16ToComplex(bufferSize, buffer, stream.writeBuf);
             if (!stream.swap(bufferSize)) { break; }
         }
 
@@ -3,38 +3,76 @@
 #include <utils/flog.h>
 #include <module.h>
 #include <gui/gui.h>
+#include <gui/style.h>
 #include <signal_path/signal_path.h>
-#include <wavreader.h>
+#include <utils/iq_reader.h>
 #include <core.h>
 #include <gui/widgets/file_select.h>
+#include <utils/optionlist.h>
 #include <filesystem>
 #include <regex>
 #include <gui/tuner.h>
 #include <algorithm>
 #include <stdexcept>
+#include <chrono>
+#include <atomic>
 
 #define CONCAT(a, b) ((std::string(a) + b).c_str())
 
 SDRPP_MOD_INFO{
     /* Name:            */ "file_source",
-    /* Description:     */ "Wav file source module for SDR++",
+    /* Description:     */ "IQ file source module for SDR++",
     /* Author:          */ "Ryzerth",
-    /* Version:         */ 0, 1, 1,
+    /* Version:         */ 0, 2, 0,
     /* Max instances    */ 1
 };
 
 ConfigManager config;
 
+enum Pacing {
+    PACING_REALTIME,
+    PACING_CUSTOM,
+    PACING_UNLIMITED
+};
+
 class FileSourceModule : public ModuleManager::Instance {
 public:
-    FileSourceModule(std::string name) : fileSelect("", { "Wav IQ Files (*.wav)", "*.wav", "All Files", "*" }) {
+    FileSourceModule(std::string name) : fileSelect("", { "IQ Files (*.wav *.iqz *.sigmf-meta *.sigmf-data *.cu8 *.cs8 *.cs16 *.cf32 *.raw *.iq)", "*.wav *.iqz *.sigmf-meta *.sigmf-data *.cu8 *.cs8 *.cs16 *.cf32 *.raw *.iq", "All Files", "*" }) {
         this->name = name;
 
         if (core::args["server"].b()) { return; }
 
+        // Define pacing modes
+        pacings.define("realtime", "Realtime", PACING_REALTIME);
+        pacings.define("custom", "Custom Speed", PACING_CUSTOM);
+        pacings.define("unlimited", "Unlimited", PACING_UNLIMITED);
+
+        // Define the sample formats of raw files
+        rawFormats.define("cu8", "Unsigned 8bit", SAMPLE_FORMAT_U8);
+        rawFormats.define("cs8", "Signed 8bit", SAMPLE_FORMAT_S8);
+        rawFormats.define("cs16", "Signed 16bit", SAMPLE_FORMAT_S16);
+        rawFormats.define("cs24", "Signed 24bit", SAMPLE_FORMAT_S24);
+        rawFormats.define("cs32", "Signed 32bit", SAMPLE_FORMAT_S32);
+        rawFormats.define("cf32", "Float32", SAMPLE_FORMAT_F32);
+
+        // Load config
+        pacingId = pacings.valueId(PACING_REALTIME);
+        rawFormatId = rawFormats.valueId(SAMPLE_FORMAT_F32);
         config.acquire();
         fileSelect.setPath(config.conf["path"], true);
+        if (config.conf.contains("pacing")) {
+            std::string pacingStr = config.conf["pacing"];
+            if (pacings.keyExists(pacingStr)) { pacingId = pacings.keyId(pacingStr); }
+        }
+        if (config.conf.contains("speed")) { speed = config.conf["speed"]; }
+        if (config.conf.contains("loop")) { loop = config.conf["loop"]; }
+        if (config.conf.contains("rawFormat")) {
+            std::string rawFormatStr = config.conf["rawFormat"];
+            if (rawFormats.keyExists(rawFormatStr)) { rawFormatId = rawFormats.keyId(rawFormatStr); }
+        }
+        if (config.conf.contains("rawSamplerate")) { rawSamplerate = config.conf["rawSamplerate"]; }
         config.release();
+        pacing = pacings.value(pacingId);
 
         handler.ctx = this;
         handler.selectHandler = menuSelected;
@@ -73,16 +111,12 @@ private:
         tuner::tune(tuner::TUNER_MODE_IQ_ONLY, "", _this->centerFreq);
         sigpath::iqFrontEnd.setBuffering(false);
         gui::waterfall.centerFrequencyLocked = true;
-        //gui::freqSelect.minFreq = _this->centerFreq - (_this->sampleRate/2);
-        //gui::freqSelect.maxFreq = _this->centerFreq + (_this->sampleRate/2);
-        //gui::freqSelect.limitFreq = true;
         flog::info("FileSourceModule '{0}': Menu Select!", _this->name);
     }
 
     static void menuDeselected(void* ctx) {
         FileSourceModule* _this = (FileSourceModule*)ctx;
         sigpath::iqFrontEnd.setBuffering(true);
-        //gui::freqSelect.limitFreq = false;
         gui::waterfall.centerFrequencyLocked = false;
         flog::info("FileSourceModule '{0}': Menu Deselect!", _this->name);
     }
@@ -90,21 +124,27 @@ private:
     static void start(void* ctx) {
         FileSourceModule* _this = (FileSourceModule*)ctx;
         if (_this->running) { return; }
-        if (_this->reader == NULL) { return; }
+        if (!_this->reader) { return; }
+
+        // Start over if the end of the file was reached
+        if (_this->reader->tell() >= _this->reader->getSampleCount()) { _this->reader->seek(0); }
+
         _this->running = true;
-        _this->workerThread = _this->float32Mode ? std::thread(floatWorker, _this) : std::thread(worker, _this);
+        _this->workerThread = std::thread(worker, _this);
         flog::info("FileSourceModule '{0}': Start!", _this->name);
     }
 
     static void stop(void* ctx) {
         FileSourceModule* _this = (FileSourceModule*)ctx;
         if (!_this->running) { return; }
-        if (_this->reader == NULL) { return; }
         _this->stream.stopWriter();
         _this->workerThread.join();
         _this->stream.clearWriteStop();
         _this->running = false;
-        _this->reader->rewind();
+
+        // Apply a seek that the worker didn't get to
+        int64_t target = _this->seekTarget.exchange(-1);
+        if (target >= 0) { _this->reader->seek(target); }
         flog::info("FileSourceModule '{0}': Stop!", _this->name);
     }
 
@@ -115,69 +155,187 @@ private:
 
     static void menuHandler(void* ctx) {
         FileSourceModule* _this = (FileSourceModule*)ctx;
+        float menuWidth = ImGui::GetContentRegionAvail().x;
+
+        // The file can't be changed while it's being read
+        if (_this->running) { style::beginDisabled(); }
 
         if (_this->fileSelect.render("##file_source_" + _this->name)) {
             if (_this->fileSelect.pathIsValid()) {
-                if (_this->reader != NULL) {
-                    _this->reader->close();
-                    delete _this->reader;
-                }
-                try {
-                    _this->reader = new WavReader(_this->fileSelect.path);
-                    if (_this->reader->getSampleRate() == 0) {
-                        _this->reader->close();
-                        delete _this->reader;
-                        _this->reader = NULL;
-                        throw std::runtime_error("Sample rate may not be zero");
-                    }
-                    _this->sampleRate = _this->reader->getSampleRate();
-                    core::setInputSampleRate(_this->sampleRate);
-                    std::string filename = std::filesystem::path(_this->fileSelect.path).filename().string();
-                    _this->centerFreq = _this->getFrequency(filename);
-                    tuner::tune(tuner::TUNER_MODE_IQ_ONLY, "", _this->centerFreq);
-                    //gui::freqSelect.minFreq = _this->centerFreq - (_this->sampleRate/2);
-                    //gui::freqSelect.maxFreq = _this->centerFreq + (_this->sampleRate/2);
-                    //gui::freqSelect.limitFreq = true;
+                _this->openFile();
+                config.acquire();
+                config.conf["path"] = _this->fileSelect.path;
+                config.release(true);
+            }
+        }
+
+        // Settings for raw files that have no metadata
+        if (_this->reader && _this->reader->getInfo().userFormat) {
+            ImGui::LeftLabel("Raw Format");
+            ImGui::SetNextItemWidth(menuWidth - ImGui::GetCursorPosX());
+            if (ImGui::Combo(CONCAT("##_file_source_raw_fmt_", _this->name), &_this->rawFormatId, _this->rawFormats.txt)) {
+                _this->openFile();
+                config.acquire();
+                config.conf["rawFormat"] = _this->rawFormats.key(_this->rawFormatId);
+                config.release(true);
+            }
+        }
+        if (_this->reader && _this->reader->getInfo().userSampleRate) {
+            ImGui::LeftLabel("Raw Samplerate");
+            ImGui::SetNextItemWidth(menuWidth - ImGui::GetCursorPosX());
+            if (ImGui::InputDouble(CONCAT("##_file_source_raw_sr_", _this->name), &_this->rawSamplerate, 0, 0, "%.0f", ImGuiInputTextFlags_EnterReturnsTrue)) {
+                _this->rawSamplerate = std::max<double>(_this->rawSamplerate, 1.0);
+                _this->openFile();
+                config.acquire();
+                config.conf["rawSamplerate"] = _this->rawSamplerate;
+                config.release(true);
+            }
+        }
+
+        if (_this->running) { style::endDisabled(); }
+
+        if (_this->reader) {
+            const IQFileInfo& info = _this->reader->getInfo();
+            double duration = (double)_this->reader->getSampleCount() / info.sampleRate;
+            ImGui::Text("%s, %s, %s", info.container.c_str(), _this->rawFormats.name(_this->rawFormats.valueId(info.format)).c_str(), formatTime(duration).c_str());
+
+            // Position, dragging it seeks
+            float position = (double)_this->reader->tell() / info.sampleRate;
+            ImGui::SetNextItemWidth(menuWidth - ImGui::GetCursorPosX());
+            if (ImGui::SliderFloat(CONCAT("##_file_source_pos_", _this->name), &position, 0.0f, duration, formatTime(position).c_str())) {
+                int64_t target = (double)position * info.sampleRate;
+                if (_this->running) {
+                    _this->seekTarget = target;
                 }
-                catch (const std::exception& e) {
-                    flog::error("Error: {}", e.what());
+                else {
+                    _this->reader->seek(target);
                 }
+            }
+        }
+
+        ImGui::LeftLabel("Pacing");
+        ImGui::SetNextItemWidth(menuWidth - ImGui::GetCursorPosX());
+        if (ImGui::Combo(CONCAT("##_file_source_pacing_", _this->name), &_this->pacingId, _this->pacings.txt)) {
+            _this->pacing = _this->pacings.value(_this->pacingId);
+            config.acquire();
+            config.conf["pacing"] = _this->pacings.key(_this->pacingId);
+            config.release(true);
+        }
+
+        if (_this->pacings.value(_this->pacingId) == PACING_CUSTOM) {
+            ImGui::LeftLabel("Speed");
+            ImGui::SetNextItemWidth(menuWidth - ImGui::GetCursorPosX());
+            float speed = _this->speed;
+            if (ImGui::InputFloat(CONCAT("##_file_source_speed_", _this->name), &speed, 0.5f, 2.0f, "%.2fx")) {
+                speed = std::clamp<float>(speed, 0.1f, 1000.0f);
+                _this->speed = speed;
                 config.acquire();
-                config.conf["path"] = _this->fileSelect.path;
+                config.conf["speed"] = speed;
                 config.release(true);
             }
         }
 
-        ImGui::Checkbox("Float32 Mode##_file_source", &_this->float32Mode);
-    }
+        bool loop = _this->loop;
+        if (ImGui::Checkbox(CONCAT("Loop##_file_source_loop_", _this->name), &loop)) {
+            _this->loop = loop;
+            config.acquire();
+            config.conf["loop"] = loop;
+            config.release(true);
+        }
 
-    static void worker(void* ctx) {
-        FileSourceModule* _this = (FileSourceModule*)ctx;
-        double sampleRate = std::max(_this->reader->getSampleRate(), (uint32_t)1);
-        int blockSize = std::min((int)(sampleRate / 200.0f), (int)STREAM_BUFFER_SIZE);
-        int16_t* inBuf = new int16_t[blockSize * 2];
+        if (_this->running && _this->endReached) {
+            ImGui::TextUnformatted("End of file reached");
+        }
+    }
 
-        while (true) {
-            _this->reader->readSamples(inBuf, blockSize * 2 * sizeof(int16_t));
-            volk_16i_s32f_convert_32f((float*)_this->stream.writeBuf, inBuf, 32768.0f, blockSize * 2);
-            if (!_this->stream.swap(blockSize)) { break; };
+    void openFile() {
+        reader.reset();
+        try {
+            reader = openIQFile(fileSelect.path, rawFormats.value(rawFormatId), rawSamplerate);
+        }
+        catch (const std::exception& e) {
+            flog::error("Could not open '{}': {}", fileSelect.path, e.what());
+            return;
         }
 
-        delete[] inBuf;
+        const IQFileInfo& info = reader->getInfo();
+        sampleRate = info.sampleRate;
+        if (info.frequencyKnown) {
+            centerFreq = info.frequency;
+        }
+        else {
+            std::string filename = std::filesystem::path(fileSelect.path).filename().string();
+            centerFreq = getFrequency(filename);
+        }
+        core::setInputSampleRate(sampleRate);
+        tuner::tune(tuner::TUNER_MODE_IQ_ONLY, "", centerFreq);
     }
 
-    static void floatWorker(void* ctx) {
+    static void worker(void* ctx) {
         FileSourceModule* _this = (FileSourceModule*)ctx;
-        double sampleRate = std::max(_this->reader->getSampleRate(), (uint32_t)1);
-        int blockSize = std::min((int)(sampleRate / 200.0f), (int)STREAM_BUFFER_SIZE);
-        dsp::complex_t* inBuf = new dsp::complex_t[blockSize];
+        IQReader* reader = _this->reader.get();
+        double sampleRate = reader->getInfo().sampleRate;
+        int blockSize = std::clamp<int>(sampleRate / 200.0, 1, STREAM_BUFFER_SIZE);
+        _this->endReached = false;
+
+        // Time at which the pacing started and the number of samples sent since then
+        auto pacingStart = std::chrono::steady_clock::now();
+        int64_t pacedSamples = 0;
+        double lastRate = 0.0;
 
         while (true) {
-            _this->reader->readSamples(_this->stream.writeBuf, blockSize * sizeof(dsp::complex_t));
-            if (!_this->stream.swap(blockSize)) { break; };
+            // Seek if requested by the UI
+            int64_t target = _this->seekTarget.exchange(-1);
+            if (target >= 0) {
+                reader->seek(target);
+                lastRate = 0.0;
+            }
+
+            // Read samples directly into the stream, wrapping around at the end if looping
+            int count = reader->read(_this->stream.writeBuf, blockSize);
+            if (count < blockSize && _this->loop) {
+                reader->seek(0);
+                count += reader->read(&_this->stream.writeBuf[count], blockSize - count);
+            }
+            if (!count) {
+                _this->endReached = true;
+                break;
+            }
+            if (!_this->stream.swap(count)) { break; }
+
+            // Just let the DSP consume samples as fast as it can if unlimited
+            Pacing pacing = _this->pacing;
+            if (pacing == PACING_UNLIMITED) {
+                lastRate = 0.0;
+                continue;
+            }
+
+            // Restart the pacing if the speed changed
+            double rate = sampleRate * ((pacing == PACING_CUSTOM) ? _this->speed.load() : 1.0);
+            auto now = std::chrono::steady_clock::now();
+            if (rate != lastRate) {
+                pacingStart = now;
+                pacedSamples = 0;
+                lastRate = rate;
+            }
+
+            // Wait until the samples are due. If the DSP can't keep up, don't try to catch up later on.
+            pacedSamples += count;
+            auto due = pacingStart + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>((double)pacedSamples / rate));
+            if (now - due > std::chrono::seconds(1)) {
+                pacingStart = now;
+                pacedSamples = 0;
+                continue;
+            }
+            std::this_thread::sleep_until(due);
         }
+    }
 
-        delete[] inBuf;
+    static std::string formatTime(double seconds) {
+        int total = seconds;
+        char buf[64];
+        sprintf(buf, "%02d:%02d:%02d", total / 3600, (total / 60) % 60, total % 60);
+        return buf;
     }
 
     double getFrequency(std::string filename) {
@@ -193,20 +351,36 @@ private:
     std::string name;
     dsp::stream<dsp::complex_t> stream;
     SourceManager::SourceHandler handler;
-    WavReader* reader = NULL;
+    std::unique_ptr<IQReader> reader;
     bool running = false;
     bool enabled = true;
-    float sampleRate = 1000000;
+    double sampleRate = 1000000;
     std::thread workerThread;
 
     double centerFreq = 100000000;
 
-    bool float32Mode = false;
+    OptionList<std::string, Pacing> pacings;
+    OptionList<std::string, SampleFormat> rawFormats;
+    int pacingId = 0;
+    int rawFormatId = 0;
+    double rawSamplerate = 1000000.0;
+
+    // Shared with the worker
+    std::atomic<Pacing> pacing = PACING_REALTIME;
+    std::atomic<float> speed = 1.0f;
+    std::atomic<bool> loop = true;
+    std::atomic<bool> endReached = false;
+    std::atomic<int64_t> seekTarget = -1;
 };
 
 MOD_EXPORT void _INIT_() {
     json def = json({});
     def["path"] = "";
+    def["pacing"] = "realtime";
+    def["speed"] = 1.0;
+    def["loop"] = true;
+    def["rawFormat"] = "cf32";
+    def["rawSamplerate"] = 1000000.0;
     config.setPath(core::args["root"].s() + "/file_source_config.json");
     config.load(def);
     config.enableAutoSave();
@@ -2,6 +2,7 @@
 #include <module.h>
 #include <gui/gui.h>
 #include <signal_path/signal_path.h>
+#include <dsp/convert/iq_to_complex.h>
 #include <core.h>
 #include <gui/style.h>
 #include <config.h>
@@ -383,7 +384,7 @@ private:
 
     static int callback(hackrf_transfer* transfer) {
         HackRFSourceModule* _this = (HackRFSourceModule*)transfer->rx_ctx;
-        volk_8i_s32f_convert_32f((float*)_this->stream.writeBuf, (int8_t*)transfer->buffer, 128.0f, transfer->valid_length);
+        dsp::convert::s8ToComplex(transfer->valid_length / 2, (int8_t*)transfer->buffer, _this->stream.writeBuf);
         if (!_this->stream.swap(transfer->valid_length / 2)) { return -1; }
         return 0;
     }
@@ -3,6 +3,7 @@
 #include <gui/gui.h>
 #include <gui/smgui.h>
 #include <signal_path/signal_path.h>
+#include <dsp/convert/iq_to_complex.h>
 #include <core.h>
 #include <utils/optionlist.h>
 #include "kcsdr.h"
@@ -273,7 +274,7 @@ private:
             }
 
             // Convert the samples to float
-            volk_16i_s32f_convert_32f((float*)stream.writeBuf, samps, 8192.0f, count*2);
+            dsp::convert::s16ToComplex(count, samps, stream.writeBuf, 1.0f / 8192.0f);
 
             // Send out the samples
             if (!stream.swap(count)) { break; }
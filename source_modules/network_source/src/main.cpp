@@ -1,14 +1,17 @@
 #include <utils/net.h>
+#include <utils/proto/iq_udp.h>
 #include <utils/flog.h>
 #include <module.h>
 #include <gui/gui.h>
 #include <signal_path/signal_path.h>
+#include <dsp/convert/iq_to_complex.h>
 #include <core.h>
 #include <gui/style.h>
 #include <config.h>
 #include <gui/smgui.h>
 #include <gui/widgets/stepped_slider.h>
 #include <utils/optionlist.h>
+#include <inttypes.h>
 
 #define CONCAT(a, b) ((std::string(a) + b).c_str())
 
@@ -91,6 +94,9 @@ public:
             port = config.conf[name]["port"];
             port = std::clamp<int>(port, 1, 65535);
         }
+        if (config.conf[name].contains("header")) {
+            header = config.conf[name]["header"];
+        }
         config.release();
 
         // Set menu IDs
@@ -173,7 +179,13 @@ private:
         }
 
         // Start receive worker
-        _this->workerThread = std::thread(&NetworkSourceModule::worker, _this);
+        _this->receiver.reset();
+        if (_this->proto == PROTOCOL_UDP) {
+            _this->workerThread = std::thread(&NetworkSourceModule::udpWorker, _this);
+        }
+        else {
+            _this->workerThread = std::thread(&NetworkSourceModule::worker, _this);
+        }
 
         _this->running = true;
         flog::info("NetworkSourceModule '{0}': Start!", _this->name);
@@ -270,7 +282,28 @@ private:
             SmGui::TextColored(ImVec4(1.0f, 1.0f, 0.0f, 1.0f), "Warning: Samplerate not applied yet");
         }
 
+        // UDP framing
+        if (_this->proto == PROTOCOL_UDP) {
+            if (SmGui::Checkbox(("Sequence header##network_source_header_" + _this->name).c_str(), &_this->header)) {
+                config.acquire();
+                config.conf[_this->name]["header"] = _this->header;
+                config.release(true);
+            }
+        }
+
         if (_this->running) { SmGui::EndDisabled(); }
+
+        // Link statistics, only available when the packets carry a sequence number
+        if (_this->running && _this->proto == PROTOCOL_UDP && _this->header) {
+            char buf[128];
+            net::iq_udp::ReceiveStats stats = _this->receiver.getStats();
+            sprintf(buf, "Loss: %.3lf%% (%" PRIu64 " packets)", stats.lossRate * 100.0, stats.lost);
+            SmGui::Text(buf);
+            sprintf(buf, "Reordered: %" PRIu64 ", Duplicates: %" PRIu64, stats.reordered, stats.duplicates);
+            SmGui::Text(buf);
+            sprintf(buf, "Jitter: %.3lf ms", stats.jitter / 1000.0);
+            SmGui::Text(buf);
+        }
     }
 
     void worker() {
@@ -294,13 +327,13 @@ private:
             int count = bytes / sampleSize;
             switch (sampType) {
             case SAMPLE_TYPE_INT8:
-                volk_8i_s32f_convert_32f((float*)stream.writeBuf, (int8_t*)buffer, 128.0f, count*2);
+                dsp::convert::s8ToComplex(count, (int8_t*)buffer, stream.writeBuf);
                 break;
             case SAMPLE_TYPE_INT16:
-                volk_16i_s32f_convert_32f((float*)stream.writeBuf, (int16_t*)buffer, 32768.0f, count*2);
+                dsp::convert::s16ToComplex(count, (int16_t*)buffer, stream.writeBuf);
                 break;
             case SAMPLE_TYPE_INT32:
-                volk_32i_s32f_convert_32f((float*)stream.writeBuf, (int32_t*)buffer, 2147483647.0f, count*2);
+                dsp::convert::s32ToComplex(count, (int32_t*)buffer, stream.writeBuf, 1.0f / 2147483647.0f);
                 break;
             case SAMPLE_TYPE_FLOAT32:
                 memcpy(stream.writeBuf, buffer, bytes);
@@ -317,6 +350,99 @@ private:
         dsp::buffer::free(buffer);
     }
 
+    void udpWorker() {
+        const int BATCH_SIZE = 32;
+        const int MAX_DATAGRAM_SIZE = 65536;
+        int sampleSize = SAMPLE_TYPE_SIZE[sampType];
+        int headerSize = header ? sizeof(net::iq_udp::PacketHeader) : 0;
+
+        // Allocate a buffer for each datagram of a batch
+        uint8_t* buffer = dsp::buffer::alloc<uint8_t>(BATCH_SIZE * MAX_DATAGRAM_SIZE);
+        uint8_t* datagrams[BATCH_SIZE];
+        int sizes[BATCH_SIZE];
+        uint64_t arrivals[BATCH_SIZE];
+        for (int i = 0; i < BATCH_SIZE; i++) { datagrams[i] = &buffer[i * MAX_DATAGRAM_SIZE]; }
+
+        // Samples are gathered across datagrams and sent out once per batch
+        int count = 0;
+        bool running = true;
+        while (running) {
+            // Receive all the datagrams that are available, along with when each of them arrived for the jitter
+            int n = sock->recvBatch(datagrams, MAX_DATAGRAM_SIZE, sizes, BATCH_SIZE, net::NO_TIMEOUT, header ? arrivals : NULL);
+            if (n <= 0) { break; }
+
+            for (int i = 0; i < n && running; i++) {
+                uint8_t* data = datagrams[i];
+                int bytes = sizes[i];
+
+                if (header) {
+                    // Drop anything that isn't framed or arrived too late to be used
+                    net::iq_udp::PacketHeader* hdr = (net::iq_udp::PacketHeader*)data;
+                    if (bytes < headerSize || hdr->magic != net::iq_udp::MAGIC) { continue; }
+                    int missing;
+                    if (!receiver.process(hdr, arrivals[i], missing)) { continue; }
+                    data += headerSize;
+                    bytes -= headerSize;
+
+                    // Fill in the lost packets with silence to keep the timing of the stream
+                    int fill = missing * (bytes / sampleSize);
+                    while (fill && running) {
+                        int chunk = std::min<int>(fill, STREAM_BUFFER_SIZE - count);
+                        memset(&stream.writeBuf[count], 0, chunk * sizeof(dsp::complex_t));
+                        count += chunk;
+                        fill -= chunk;
+                        if (count == STREAM_BUFFER_SIZE) {
+                            running = stream.swap(count);
+                            count = 0;
+                        }
+                    }
+                }
+
+                // Convert to CF32 (note: problem if partial sample)
+                int samples = bytes / sampleSize;
+                while (samples && running) {
+                    int chunk = std::min<int>(samples, STREAM_BUFFER_SIZE - count);
+                    convert(data, chunk, &stream.writeBuf[count]);
+                    data += chunk * sampleSize;
+                    samples -= chunk;
+                    count += chunk;
+                    if (count == STREAM_BUFFER_SIZE) {
+                        running = stream.swap(count);
+                        count = 0;
+                    }
+                }
+            }
+
+            // Send out converted samples
+            if (count && running) {
+                running = stream.swap(count);
+                count = 0;
+            }
+        }
+
+        // Free receive buffer
+        dsp::buffer::free(buffer);
+    }
+
+    void convert(uint8_t* in, int count, dsp::complex_t* out) {
+        switch (sampType) {
+        case SAMPLE_TYPE_INT8:
+            dsp::convert::s8ToComplex(count, (int8_t*)in, out);
+            break;
+        case SAMPLE_TYPE_INT16:
+            dsp::convert::s16ToComplex(count, (int16_t*)in, out);
+            break;
+        case SAMPLE_TYPE_INT32:
+            dsp::convert::s32ToComplex(count, (int32_t*)in, out, 1.0f / 2147483647.0f);
+            break;
+        case SAMPLE_TYPE_FLOAT32:
+            memcpy(out, in, count * sizeof(dsp::complex_t));
+            break;
+        default:
+            break;
+        }
+    }
+
     std::string name;
     bool enabled = true;
     dsp::stream<dsp::complex_t> stream;
@@ -332,6 +458,8 @@ private:
     int sampTypeId;
     char hostname[1024] = "localhost";
     int port = 1234;
+    bool header = false;
+    net::iq_udp::Receiver receiver;
 
     OptionList<std::string, Protocol> protocols;
     OptionList<std::string, SampleType> sampleTypes;
@@ -2,6 +2,7 @@
 #include <module.h>
 #include <gui/gui.h>
 #include <signal_path/signal_path.h>
+#include <dsp/convert/iq_to_complex.h>
 #include <core.h>
 #include <gui/style.h>
 #include <config.h>
@@ -406,19 +407,7 @@ private:
         PerseusSourceModule* _this = (PerseusSourceModule*)ctx;
         uint8_t* samples = (uint8_t*)buf;
         int sampleCount = bufferSize / 6;
-        for (int i = 0; i < sampleCount; i++) {
-            int32_t re, im;
-            re = *(samples++);
-            re |= *(samples++) << 8;
-            re |= *(samples++) << 16;
-            re |= (re >> 23) * (0xFF << 24); // Sign extend
-            im = *(samples++);
-            im |= *(samples++) << 8;
-            im |= *(samples++) << 16;
-            im |= (im >> 23) * (0xFF << 24); // Sign extend
-            _this->stream.writeBuf[i].re = ((float)re / (float)0x7FFFFF);
-            _this->stream.writeBuf[i].im = ((float)im / (float)0x7FFFFF);
-        }
+        dsp::convert::s24ToComplex(sampleCount, samples, _this->stream.writeBuf, 1.0f / (float)0x7FFFFF);
         _this->stream.swap(sampleCount);
         return 0;
     }
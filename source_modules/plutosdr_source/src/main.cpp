@@ -2,6 +2,7 @@
 #include <module.h>
 #include <gui/gui.h>
 #include <signal_path/signal_path.h>
+#include <dsp/convert/iq_to_complex.h>
 #include <core.h>
 #include <gui/style.h>
 #include <gui/smgui.h>
@@ -474,7 +475,7 @@ private:
             if (!buf) { break; }
 
             // Convert samples to CF32
-            volk_16i_s32f_convert_32f((float*)_this->stream.writeBuf, buf, 32768.0f, blockSize * 2);
+            dsp::convert::s16ToComplex(blockSize, buf, _this->stream.writeBuf);
 
             // Send out the samples
             if (!_this->stream.swap(blockSize)) { break; };
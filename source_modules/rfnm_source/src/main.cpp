@@ -3,6 +3,7 @@
 #include <gui/gui.h>
 #include <gui/smgui.h>
 #include <signal_path/signal_path.h>
+#include <dsp/convert/iq_to_complex.h>
 #include <librfnm/librfnm.h>
 #include <core.h>
 #include <utils/optionlist.h>
@@ -446,7 +447,7 @@ private:
             else if (fail) { break; }
 
             // Convert buffer to CF32
-            volk_16i_s32f_convert_32f((float*)&stream.writeBuf[(count++)*sampCount], (int16_t*)lrxbuf->buf, 32768.0f, sampCount * 2);
+            dsp::convert::s16ToComplex(sampCount, (int16_t*)lrxbuf->buf, &stream.writeBuf[(count++)*sampCount]);
 
             // Reque buffer
             openDev->rx_qbuf(lrxbuf);
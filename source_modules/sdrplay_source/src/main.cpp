@@ -3,6 +3,7 @@
 #include <module.h>
 #include <gui/gui.h>
 #include <signal_path/signal_path.h>
+#include <dsp/convert/iq_to_complex.h>
 #include <core.h>
 #include <gui/style.h>
 #include <config.h>
@@ -1094,12 +1095,14 @@ private:
     static void streamCB(short* xi, short* xq, sdrplay_api_StreamCbParamsT* params,
                          unsigned int numSamples, unsigned int reset, void* cbContext) {
         SDRPlaySourceModule* _this = (SDRPlaySourceModule*)cbContext;
-        // TODO: Optimise using volk and math
         if (!_this->running) { return; }
-        for (int i = 0; i < numSamples; i++) {
-            int id = _this->bufferIndex++;
-            _this->stream.writeBuf[id].re = (float)xi[i] / 32768.0f;
-            _this->stream.writeBuf[id].im = (float)xq[i] / 32768.0f;
+        int i = 0;
+        while (i < numSamples) {
+            // Convert as many samples as fit in the current buffer
+            int count = std::min<int>(numSamples - i, _this->bufferSize - _this->bufferIndex);
+            dsp::convert::planarToComplex(count, &xi[i], &xq[i], &_this->stream.writeBuf[_this->bufferIndex], 1.0f / 32768.0f);
+            _this->bufferIndex += count;
+            i += count;
 
             if (_this->bufferIndex >= _this->bufferSize) {
                 _this->stream.swap(_this->bufferSize);
@@ -54,11 +54,22 @@ public:
         config.release();
 
         sigpath::sourceManager.registerSource("SDR++ Server", &handler);
+
+        // Follow the local VFOs to mirror them on the server when not receiving the full IQ
+        vfoChangedHandler.handler = vfoChanged;
+        vfoChangedHandler.ctx = this;
+        vfoRemoveHandler.handler = vfoRemove;
+        vfoRemoveHandler.ctx = this;
+        sigpath::iqFrontEnd.onVFOChanged.bindHandler(&vfoChangedHandler);
+        sigpath::iqFrontEnd.onVFORemove.bindHandler(&vfoRemoveHandler);
     }
 
     ~SDRPPServerSourceModule() {
         stop(this);
         sigpath::sourceManager.unregisterSource("SDR++ Server");
+        if (core::args["server"].b()) { return; }
+        sigpath::iqFrontEnd.onVFOChanged.unbindHandler(&vfoChangedHandler);
+        sigpath::iqFrontEnd.onVFORemove.unbindHandler(&vfoRemoveHandler);
     }
 
     void postInit() {}
@@ -199,10 +210,23 @@ private:
                 config.release(true);
             }
 
-            bool dummy = true;
-            style::beginDisabled();
-            ImGui::Checkbox("Full IQ", &dummy);
-            style::endDisabled();
+            if (ImGui::Checkbox("Adaptive bitrate", &_this->adaptive)) {
+                _this->client->setCompressionOptions(true, _this->adaptive);
+
+                // Save config
+                config.acquire();
+                config.conf["servers"][_this->devConfName]["adaptive"] = _this->adaptive;
+                config.release(true);
+            }
+
+            if (ImGui::Checkbox("Full IQ", &_this->fullIQ)) {
+                _this->setFullIQ(_this->fullIQ);
+
+                // Save config
+                config.acquire();
+                config.conf["servers"][_this->devConfName]["fullIQ"] = _this->fullIQ;
+                config.release(true);
+            }
 
             // Calculate datarate
             _this->frametimeCounter += ImGui::GetIO().DeltaTime;
@@ -216,6 +240,20 @@ private:
             ImGui::SameLine();
             ImGui::TextColored(ImVec4(0.0f, 1.0f, 0.0f, 1.0f), "Connected (%.3f Mbit/s)", _this->datarate);
 
+            // Show what the server settled on
+            server::StreamStatus status;
+            if (_this->adaptive && _this->client->getStreamStatus(status)) {
+                dsp::compression::PCMType type = (dsp::compression::PCMType)status.pcmType;
+                std::string typeName = _this->sampleTypeList.valueExists(type) ? _this->sampleTypeList.key(_this->sampleTypeList.valueId(type)) : "Unknown";
+                if (status.level) {
+                    ImGui::Text("Stream: %s, zstd %d (ratio %.2f)", typeName.c_str(), status.level, status.ratio);
+                }
+                else {
+                    ImGui::Text("Stream: %s, uncompressed", typeName.c_str());
+                }
+                ImGui::Text("Server load: link %d%%, CPU %d%%", (int)(status.linkLoad * 100.0f), (int)(status.cpuLoad * 100.0f));
+            }
+
             ImGui::CollapsingHeader("Source [REMOTE]", ImGuiTreeNodeFlags_DefaultOpen);
 
             _this->client->showMenu();
@@ -231,6 +269,75 @@ private:
         return client && client->isOpen();
     }
 
+    // Switch between receiving the full IQ and only receiving the FFT and the channels of the local VFOs
+    void setFullIQ(bool enabled) {
+        if (!connected()) { return; }
+        if (enabled) {
+            for (auto& [name, id] : remoteVFOs) { client->removeVFO(id); }
+            remoteVFOs.clear();
+            client->setFFT(0, 0, 0, NULL, NULL);
+            client->setBaseband(true);
+            return;
+        }
+
+        // The waterfall keeps the FFT size from the display settings, the frames get resized to it if the server can't do it
+        core::configManager.acquire();
+        wfFFTSize = core::configManager.conf["fftSize"];
+        double fftRate = core::configManager.conf["fftRate"];
+        int fftWindow = core::configManager.conf["fftWindow"];
+        core::configManager.release();
+
+        client->setBaseband(false);
+        client->setFFT(std::clamp<int>(wfFFTSize, SERVER_MIN_FFT_SIZE, SERVER_MAX_FFT_SIZE), std::clamp<double>(fftRate, 1.0, SERVER_MAX_FFT_RATE), fftWindow, fftHandler, this);
+        for (auto& name : sigpath::iqFrontEnd.getVFONames()) { syncVFO(name); }
+    }
+
+    void syncVFO(std::string name) {
+        double sampleRate, bandwidth, offset;
+        dsp::channel::RxVFO* vfo = sigpath::iqFrontEnd.getVFO(name);
+        if (!vfo || !sigpath::iqFrontEnd.getVFOParams(name, sampleRate, bandwidth, offset)) { return; }
+
+        // The remote samples are written straight to the output of the local VFO, which gets no input in this mode
+        auto it = remoteVFOs.find(name);
+        if (it != remoteVFOs.end()) {
+            client->updateVFO(it->second, sampleRate, bandwidth, offset);
+            return;
+        }
+        uint32_t id = nextVFOId++;
+        remoteVFOs[name] = id;
+        client->addVFO(id, sampleRate, bandwidth, offset, &vfo->out);
+    }
+
+    static void vfoChanged(std::string name, void* ctx) {
+        SDRPPServerSourceModule* _this = (SDRPPServerSourceModule*)ctx;
+        if (!_this->connected() || _this->fullIQ) { return; }
+        _this->syncVFO(name);
+    }
+
+    static void vfoRemove(std::string name, void* ctx) {
+        SDRPPServerSourceModule* _this = (SDRPPServerSourceModule*)ctx;
+        auto it = _this->remoteVFOs.find(name);
+        if (it == _this->remoteVFOs.end()) { return; }
+        if (_this->client) { _this->client->removeVFO(it->second); }
+        _this->remoteVFOs.erase(it);
+    }
+
+    static void fftHandler(float* data, int size, void* ctx) {
+        SDRPPServerSourceModule* _this = (SDRPPServerSourceModule*)ctx;
+        float* buf = gui::waterfall.getFFTBuffer();
+        if (buf) {
+            if (size == _this->wfFFTSize) {
+                memcpy(buf, data, size * sizeof(float));
+            }
+            else {
+                for (int i = 0; i < _this->wfFFTSize; i++) {
+                    buf[i] = data[(int64_t)i * size / _this->wfFFTSize];
+                }
+            }
+        }
+        gui::waterfall.pushFFT();
+    }
+
     void tryConnect() {
         try {
             if (client) { client.reset(); }
@@ -258,10 +365,21 @@ private:
         if (config.conf["servers"][devConfName].contains("compression")) {
             compression = config.conf["servers"][devConfName]["compression"];
         }
+        fullIQ = true;
+        if (config.conf["servers"][devConfName].contains("fullIQ")) {
+            fullIQ = config.conf["servers"][devConfName]["fullIQ"];
+        }
+        adaptive = false;
+        if (config.conf["servers"][devConfName].contains("adaptive")) {
+            adaptive = config.conf["servers"][devConfName]["adaptive"];
+        }
 
         // Set settings
         client->setSampleType(sampleTypeList[sampleTypeId]);
         client->setCompression(compression);
+        client->setCompressionOptions(true, adaptive);
+        remoteVFOs.clear();
+        if (!fullIQ) { setFullIQ(false); }
     }
 
     std::string name;
@@ -284,6 +402,14 @@ private:
     OptionList<std::string, dsp::compression::PCMType> sampleTypeList;
     int sampleTypeId;
     bool compression = false;
+    bool adaptive = false;
+    bool fullIQ = true;
+
+    EventHandler<std::string> vfoChangedHandler;
+    EventHandler<std::string> vfoRemoveHandler;
+    std::map<std::string, uint32_t> remoteVFOs;
+    uint32_t nextVFOId = 0;
+    int wfFFTSize = 0;
 
     std::shared_ptr<server::Client> client;
 };
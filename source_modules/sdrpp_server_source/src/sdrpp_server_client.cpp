@@ -133,6 +133,85 @@ namespace server {
         sendCommand(COMMAND_SET_COMPRESSION, 1);
     }
 
+    void Client::setCompressionOptions(bool parallel, bool adaptive) {
+        if (!isOpen()) { return; }
+        CompressionOptions* opts = (CompressionOptions*)s_cmd_data;
+        opts->parallel = parallel;
+        opts->adaptive = adaptive;
+        sendCommand(COMMAND_SET_COMPRESSION_OPTIONS, sizeof(CompressionOptions));
+    }
+
+    void Client::setBaseband(bool enabled) {
+        if (!isOpen()) { return; }
+        s_cmd_data[0] = enabled;
+        sendCommand(COMMAND_SET_BASEBAND, 1);
+    }
+
+    void Client::addVFO(uint32_t id, double sampleRate, double bandwidth, double offset, dsp::stream<dsp::complex_t>* out) {
+        if (!isOpen()) { return; }
+        {
+            std::lock_guard<std::mutex> lck(vfoMtx);
+            vfoOutputs[id] = out;
+        }
+        sendVFOConfig(COMMAND_ADD_VFO, id, sampleRate, bandwidth, offset);
+    }
+
+    void Client::updateVFO(uint32_t id, double sampleRate, double bandwidth, double offset) {
+        if (!isOpen()) { return; }
+        sendVFOConfig(COMMAND_UPDATE_VFO, id, sampleRate, bandwidth, offset);
+    }
+
+    void Client::removeVFO(uint32_t id) {
+        dsp::stream<dsp::complex_t>* out = NULL;
+        {
+            std::lock_guard<std::mutex> lck(vfoMtx);
+            auto it = vfoOutputs.find(id);
+            if (it == vfoOutputs.end()) { return; }
+            out = it->second;
+            vfoOutputs.erase(it);
+        }
+
+        // Abort a write that might be waiting on the output, then wait for it to end
+        out->stopWriter();
+        {
+            std::lock_guard<std::mutex> lck(vfoWriteMtx);
+        }
+        out->clearWriteStop();
+
+        if (!isOpen()) { return; }
+        *(uint32_t*)s_cmd_data = id;
+        sendCommand(COMMAND_REMOVE_VFO, sizeof(uint32_t));
+    }
+
+    void Client::setFFT(int size, double rate, int window, void (*handler)(float* data, int size, void* ctx), void* ctx) {
+        {
+            std::lock_guard<std::mutex> lck(fftMtx);
+            fftHandler = size ? handler : NULL;
+            fftCtx = ctx;
+        }
+        if (!isOpen()) { return; }
+        FFTConfig* cfg = (FFTConfig*)s_cmd_data;
+        cfg->size = size;
+        cfg->rate = rate;
+        cfg->window = window;
+        sendCommand(COMMAND_SET_FFT, sizeof(FFTConfig));
+    }
+
+    void Client::sendVFOConfig(Command cmd, uint32_t id, double sampleRate, double bandwidth, double offset) {
+        VFOConfig* cfg = (VFOConfig*)s_cmd_data;
+        cfg->id = id;
+        cfg->sampleRate = sampleRate;
+        cfg->bandwidth = bandwidth;
+        cfg->offset = offset;
+        sendCommand(cmd, sizeof(VFOConfig));
+    }
+
+    bool Client::getStreamStatus(StreamStatus& status) {
+        std::lock_guard<std::mutex> lck(streamStatusMtx);
+        status = streamStatus;
+        return streamStatusValid;
+    }
+
     void Client::start() {
         if (!isOpen()) { return; }
         sendCommand(COMMAND_START, 0);
@@ -183,6 +262,11 @@ namespace server {
                     currentSampleRate = *(double*)r_cmd_data;
                     core::setInputSampleRate(currentSampleRate);
                 }
+                else if (r_cmd_hdr->cmd == COMMAND_SET_STREAM_STATUS && r_pkt_hdr->size == sizeof(PacketHeader) + sizeof(CommandHeader) + sizeof(StreamStatus)) {
+                    std::lock_guard<std::mutex> lck(streamStatusMtx);
+                    streamStatus = *(StreamStatus*)r_cmd_data;
+                    streamStatusValid = true;
+                }
                 else if (r_cmd_hdr->cmd == COMMAND_DISCONNECT) {
                     flog::error("Asked to disconnect by the server");
                     serverBusy = true;
@@ -226,6 +310,48 @@ namespace server {
                     if (!decompIn.swap(outCount)) { break; }
                 };
             }
+            else if (r_pkt_hdr->type == PACKET_TYPE_BASEBAND_COMPRESSED_MT) {
+                size_t outCount = pdecomp.decompress(r_pkt_data, r_pkt_hdr->size - sizeof(PacketHeader), decompIn.writeBuf, STREAM_BUFFER_SIZE*sizeof(dsp::complex_t)+8);
+                if (outCount) {
+                    if (!decompIn.swap(outCount)) { break; }
+                }
+                else {
+                    flog::error("Invalid compressed baseband packet");
+                }
+            }
+            else if (r_pkt_hdr->type == PACKET_TYPE_VFO && r_pkt_hdr->size >= sizeof(PacketHeader) + sizeof(VFOHeader) + 8) {
+                VFOHeader* vhdr = (VFOHeader*)r_pkt_data;
+                int len = r_pkt_hdr->size - sizeof(PacketHeader) - sizeof(VFOHeader);
+                if (len - 8 > STREAM_BUFFER_SIZE * sizeof(dsp::complex_t)) { continue; }
+
+                std::lock_guard<std::mutex> wlck(vfoWriteMtx);
+                dsp::stream<dsp::complex_t>* out;
+                {
+                    std::lock_guard<std::mutex> lck(vfoMtx);
+                    auto it = vfoOutputs.find(vhdr->id);
+                    if (it == vfoOutputs.end()) { continue; }
+                    out = it->second;
+                }
+
+                // A failed swap only means the VFO is being reconfigured, the samples are dropped
+                int count = dsp::compression::SampleStreamDecompressor::process(len, &r_pkt_data[sizeof(VFOHeader)], out->writeBuf);
+                if (count) { out->swap(count); }
+            }
+            else if (r_pkt_hdr->type == PACKET_TYPE_FFT && r_pkt_hdr->size >= sizeof(PacketHeader) + sizeof(FFTHeader)) {
+                FFTHeader* fhdr = (FFTHeader*)r_pkt_data;
+                if (r_pkt_hdr->size != sizeof(PacketHeader) + sizeof(FFTHeader) + fhdr->size || fhdr->size > SERVER_MAX_FFT_SIZE) { continue; }
+
+                // Expand the bins back to dB
+                std::lock_guard<std::mutex> lck(fftMtx);
+                if (!fftHandler) { continue; }
+                const uint8_t* bins = &r_pkt_data[sizeof(FFTHeader)];
+                float step = (fhdr->max - fhdr->min) / 255.0f;
+                fftFrame.resize(fhdr->size);
+                for (int i = 0; i < fhdr->size; i++) {
+                    fftFrame[i] = fhdr->min + ((float)bins[i] * step);
+                }
+                fftHandler(fftFrame.data(), fhdr->size, fftCtx);
+            }
             else if (r_pkt_hdr->type == PACKET_TYPE_ERROR) {
                 flog::error("SDR++ Server Error: {0}", rbuffer[sizeof(PacketHeader)]);
             }
@@ -12,6 +12,7 @@
 #include <dsp/sink.h>
 #include <dsp/routing/stream_link.h>
 #include <zstd.h>
+#include <utils/parallel_zstd.h>
 
 #define PROTOCOL_TIMEOUT_MS             10000
 
@@ -88,6 +89,38 @@ namespace server {
         
         void setSampleType(dsp::compression::PCMType type);
         void setCompression(bool enabled);
+        void setCompressionOptions(bool parallel, bool adaptive);
+
+        /**
+         * Get the last stream status reported by the server.
+         * @param status Status to fill out.
+         * @return True if the server reported a status, false otherwise.
+         */
+        bool getStreamStatus(StreamStatus& status);
+
+        void setBaseband(bool enabled);
+
+        /**
+         * Ask the server for a decimated channel of the baseband.
+         * @param id Identifier of the VFO, chosen by the caller.
+         * @param sampleRate Samplerate of the channel.
+         * @param bandwidth Bandwidth of the channel.
+         * @param offset Offset of the channel from the center frequency.
+         * @param out Stream the samples of the channel are written to.
+         */
+        void addVFO(uint32_t id, double sampleRate, double bandwidth, double offset, dsp::stream<dsp::complex_t>* out);
+        void updateVFO(uint32_t id, double sampleRate, double bandwidth, double offset);
+        void removeVFO(uint32_t id);
+
+        /**
+         * Ask the server for FFT frames.
+         * @param size Number of bins, zero to stop the frames.
+         * @param rate Frames per second.
+         * @param window FFT window, see IQFrontEnd::FFTWindow.
+         * @param handler Called from the network thread with each frame in dB.
+         * @param ctx Context passed to the handler.
+         */
+        void setFFT(int size, double rate, int window, void (*handler)(float* data, int size, void* ctx), void* ctx);
 
         void start();
         void stop();
@@ -107,6 +140,8 @@ namespace server {
         void sendCommand(Command cmd, int len);
         void sendCommandAck(Command cmd, int len);
 
+        void sendVFOConfig(Command cmd, uint32_t id, double sampleRate, double bandwidth, double offset);
+
         PacketWaiter* awaitCommandAck(Command cmd);
         void commandAckHandled(PacketWaiter* waiter);
         std::map<PacketWaiter*, Command> commandAckWaiters;
@@ -137,6 +172,21 @@ namespace server {
         std::mutex dlMtx;
 
         ZSTD_DCtx* dctx;
+        pzstd::Decompressor pdecomp;
+
+        StreamStatus streamStatus;
+        bool streamStatusValid = false;
+        std::mutex streamStatusMtx;
+
+        // The write mutex is held while samples are written to a VFO output so that it can be removed safely
+        std::map<uint32_t, dsp::stream<dsp::complex_t>*> vfoOutputs;
+        std::mutex vfoMtx;
+        std::mutex vfoWriteMtx;
+
+        void (*fftHandler)(float* data, int size, void* ctx) = NULL;
+        void* fftCtx = NULL;
+        std::vector<float> fftFrame;
+        std::mutex fftMtx;
 
         std::thread workerThread;
 
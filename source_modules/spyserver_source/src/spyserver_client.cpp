@@ -1,5 +1,7 @@
 #include <spyserver_client.h>
 #include <volk/volk.h>
+#include <dsp/convert/iq_to_complex.h>
+#include <utils/flog.h>
 #include <cstring>
 #include <chrono>
 
@@ -16,7 +18,7 @@ namespace spyserver {
 
         sendHandshake("SDR++");
 
-        client->readAsync(sizeof(SpyServerMessageHeader), (uint8_t*)&receivedHeader, dataHandler, this);
+        client->readAsync(sizeof(SpyServerMessageHeader), (uint8_t*)&receivedHeader, headerHandler, this);
     }
 
     SpyServerClientClass::~SpyServerClientClass() {
@@ -95,34 +97,30 @@ namespace spyserver {
         sendCommand(SPYSERVER_CMD_SET_SETTING, &target, sizeof(SpyServerSettingTarget));
     }
 
-    int SpyServerClientClass::readSize(int count, uint8_t* buffer) {
-        int read = 0;
-        int len = 0;
-        while (read < count) {
-            len = client->read(count - read, &buffer[read]);
-            if (len <= 0) { return len; }
-            read += len;
-        }
-        return read;
-    }
-
-    void SpyServerClientClass::dataHandler(int count, uint8_t* buf, void* ctx) {
+    void SpyServerClientClass::headerHandler(int count, uint8_t* buf, void* ctx) {
         SpyServerClientClass* _this = (SpyServerClientClass*)ctx;
 
-        if (count < sizeof(SpyServerMessageHeader)) {
-            _this->readSize(sizeof(SpyServerMessageHeader) - count, &buf[count]);
+        // Read the body without holding up the event loop
+        if (_this->receivedHeader.BodySize > SPYSERVER_MAX_MESSAGE_BODY_SIZE) {
+            flog::error("SpyServer sent a message with an invalid size, disconnecting");
+            _this->close();
+            return;
         }
-
-        int size = _this->readSize(_this->receivedHeader.BodySize, _this->readBuf);
-        if (size <= 0) {
-            printf("ERROR: Disconnected\n");
+        if (_this->receivedHeader.BodySize) {
+            _this->client->readAsync(_this->receivedHeader.BodySize, _this->readBuf, bodyHandler, _this);
             return;
         }
+        bodyHandler(0, _this->readBuf, ctx);
+    }
+
+    void SpyServerClientClass::bodyHandler(int count, uint8_t* buf, void* ctx) {
+        SpyServerClientClass* _this = (SpyServerClientClass*)ctx;
 
         //printf("MSG Proto: 0x%08X, MsgType: 0x%08X, StreamType: 0x%08X, Seq: 0x%08X, Size: %d\n", _this->receivedHeader.ProtocolID, _this->receivedHeader.MessageType, _this->receivedHeader.StreamType, _this->receivedHeader.SequenceNumber, _this->receivedHeader.BodySize);
 
         int mtype = _this->receivedHeader.MessageType & 0xFFFF;
         int mflags = (_this->receivedHeader.MessageType & 0xFFFF0000) >> 16;
+        bool iq = (mtype == SPYSERVER_MSG_TYPE_UINT8_IQ || mtype == SPYSERVER_MSG_TYPE_INT16_IQ || mtype == SPYSERVER_MSG_TYPE_FLOAT_IQ);
 
         if (mtype == SPYSERVER_MSG_TYPE_DEVICE_INFO) {
             {
@@ -133,26 +131,30 @@ namespace spyserver {
             }
             _this->deviceInfoCnd.notify_all();
         }
+        else if (mtype == SPYSERVER_MSG_TYPE_INT24_IQ) {
+            printf("ERROR: IQ format not supported\n");
+            return;
+        }
+        else if (iq && !_this->output->writable()) {
+            // The DSP is still busy with the previous block, drop this one rather than block the event loop
+            _this->droppedBlocks++;
+            if (!(_this->droppedBlocks % 100)) {
+                flog::warn("SpyServer: {} IQ blocks dropped because the DSP can't keep up", _this->droppedBlocks);
+            }
+        }
         else if (mtype == SPYSERVER_MSG_TYPE_UINT8_IQ) {
             int sampCount = _this->receivedHeader.BodySize / (sizeof(uint8_t) * 2);
             float gain = pow(10, (double)mflags / 20.0);
             float scale = 1.0f / (gain * 128.0f);
-            for (int i = 0; i < sampCount; i++) {
-                _this->output->writeBuf[i].re = ((float)_this->readBuf[(2 * i)] - 128.0f) * scale;
-                _this->output->writeBuf[i].im = ((float)_this->readBuf[(2 * i) + 1] - 128.0f) * scale;
-            }
+            dsp::convert::u8ToComplex(sampCount, (uint8_t*)_this->readBuf, _this->output->writeBuf, scale, { 128.0f, 128.0f });
             _this->output->swap(sampCount);
         }
         else if (mtype == SPYSERVER_MSG_TYPE_INT16_IQ) {
             int sampCount = _this->receivedHeader.BodySize / (sizeof(int16_t) * 2);
             float gain = pow(10, (double)mflags / 20.0);
-            volk_16i_s32f_convert_32f((float*)_this->output->writeBuf, (int16_t*)_this->readBuf, 32768.0 * gain, sampCount * 2);
+            dsp::convert::s16ToComplex(sampCount, (int16_t*)_this->readBuf, _this->output->writeBuf, 1.0f / (32768.0f * gain));
             _this->output->swap(sampCount);
         }
-        else if (mtype == SPYSERVER_MSG_TYPE_INT24_IQ) {
-            printf("ERROR: IQ format not supported\n");
-            return;
-        }
         else if (mtype == SPYSERVER_MSG_TYPE_FLOAT_IQ) {
             int sampCount = _this->receivedHeader.BodySize / sizeof(dsp::complex_t);
             float gain = pow(10, (double)mflags / 20.0);
@@ -160,7 +162,7 @@ namespace spyserver {
             _this->output->swap(sampCount);
         }
 
-        _this->client->readAsync(sizeof(SpyServerMessageHeader), (uint8_t*)&_this->receivedHeader, dataHandler, _this);
+        _this->client->readAsync(sizeof(SpyServerMessageHeader), (uint8_t*)&_this->receivedHeader, headerHandler, _this);
     }
 
     SpyServerClient connect(std::string host, uint16_t port, dsp::stream<dsp::complex_t>* out) {
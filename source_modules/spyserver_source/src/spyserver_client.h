@@ -28,9 +28,9 @@ namespace spyserver {
         void sendCommand(uint32_t command, void* data, int len);
         void sendHandshake(std::string appName);
 
-        int readSize(int count, uint8_t* buffer);
-
-        static void dataHandler(int count, uint8_t* buf, void* ctx);
+        // Both run on the event loop thread and must never block it
+        static void headerHandler(int count, uint8_t* buf, void* ctx);
+        static void bodyHandler(int count, uint8_t* buf, void* ctx);
 
         net::Conn client;
 
@@ -44,6 +44,7 @@ namespace spyserver {
         SpyServerMessageHeader receivedHeader;
 
         dsp::stream<dsp::complex_t>* output;
+        uint64_t droppedBlocks = 0;
     };
 
     typedef std::unique_ptr<SpyServerClientClass> SpyServerClient;
@@ -0,0 +1,346 @@
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <functional>
+#include <fstream>
+#include <sstream>
+#include <json.hpp>
+#include <volk/volk.h>
+#include <version.h>
+#include <command_args.h>
+#include <utils/flog.h>
+#include <dsp/bench/speed_tester.h>
+#include <dsp/scheduler.h>
+#include <dsp/filter/fir.h>
+#include <dsp/filter/decimating_fir.h>
+#include <dsp/filter/folded_decimating_fir.h>
+#include <dsp/multirate/power_decimator.h>
+#include <dsp/multirate/polyphase_resampler.h>
+#include <dsp/multirate/rational_resampler.h>
+#include <dsp/demod/fm.h>
+#include <dsp/demod/am.h>
+#include <dsp/demod/ssb.h>
+#include <dsp/demod/broadcast_fm.h>
+#include <dsp/demod/psk.h>
+#include <dsp/clock_recovery/mm.h>
+#include <dsp/loop/agc.h>
+#include <dsp/correction/dc_blocker.h>
+#include <dsp/noise_reduction/fm_if.h>
+#include <dsp/noise_reduction/noise_blanker.h>
+#include <dsp/taps/low_pass.h>
+
+using nlohmann::json;
+
+struct Benchmark {
+    std::string block;
+    std::string params;
+
+    // Build the block, run it for the given duration and return the input samplerate it sustained
+    std::function<double(int durationMs, int bufferSize)> run;
+};
+
+struct Result {
+    std::string block;
+    std::string params;
+    int bufferSize;
+    double samplerate;
+};
+
+// Run a started block between a SpeedTester writer and reader
+template <class I, class O, class B>
+double measure(B& blk, dsp::stream<I>& in, int durationMs, int bufferSize) {
+    blk.start();
+    dsp::bench::SpeedTester<I, O> tester(&in, &blk.out);
+    double sr = tester.benchmark(durationMs, bufferSize);
+    blk.stop();
+    return sr;
+}
+
+std::vector<Benchmark> listBenchmarks() {
+    std::vector<Benchmark> list;
+
+    // FIR filters with real and complex taps, the larger ones use fast convolution
+    for (int tc : { 16, 64, 256, 1024 }) {
+        list.push_back({ "FIR<float, float>", "taps=" + std::to_string(tc), [tc](int dur, int bs) {
+            dsp::tap<float> taps = dsp::taps::alloc<float>(tc);
+            for (int i = 0; i < tc; i++) { taps.taps[i] = 1.0f / (float)tc; }
+            dsp::stream<float> in;
+            dsp::filter::FIR<float, float> fir(&in, taps);
+            double sr = measure<float, float>(fir, in, dur, bs);
+            dsp::taps::free(taps);
+            return sr;
+        } });
+        list.push_back({ "FIR<complex_t, float>", "taps=" + std::to_string(tc), [tc](int dur, int bs) {
+            dsp::tap<float> taps = dsp::taps::alloc<float>(tc);
+            for (int i = 0; i < tc; i++) { taps.taps[i] = 1.0f / (float)tc; }
+            dsp::stream<dsp::complex_t> in;
+            dsp::filter::FIR<dsp::complex_t, float> fir(&in, taps);
+            double sr = measure<dsp::complex_t, dsp::complex_t>(fir, in, dur, bs);
+            dsp::taps::free(taps);
+            return sr;
+        } });
+        list.push_back({ "FIR<complex_t, complex_t>", "taps=" + std::to_string(tc), [tc](int dur, int bs) {
+            dsp::tap<dsp::complex_t> taps = dsp::taps::alloc<dsp::complex_t>(tc);
+            for (int i = 0; i < tc; i++) { taps.taps[i] = { 1.0f / (float)tc, 0.0f }; }
+            dsp::stream<dsp::complex_t> in;
+            dsp::filter::FIR<dsp::complex_t, dsp::complex_t> fir(&in, taps);
+            double sr = measure<dsp::complex_t, dsp::complex_t>(fir, in, dur, bs);
+            dsp::taps::free(taps);
+            return sr;
+        } });
+    }
+
+    // Decimating FIR
+    for (int tc : { 32, 128, 512 }) {
+        for (int decim : { 2, 8 }) {
+            list.push_back({ "DecimatingFIR<complex_t, float>", "taps=" + std::to_string(tc) + " decim=" + std::to_string(decim), [tc, decim](int dur, int bs) {
+                dsp::tap<float> taps = dsp::taps::alloc<float>(tc);
+                for (int i = 0; i < tc; i++) { taps.taps[i] = 1.0f / (float)tc; }
+                dsp::stream<dsp::complex_t> in;
+                dsp::filter::DecimatingFIR<dsp::complex_t, float> fir(&in, taps, decim);
+                double sr = measure<dsp::complex_t, dsp::complex_t>(fir, in, dur, bs);
+                dsp::taps::free(taps);
+                return sr;
+            } });
+            list.push_back({ "FoldedDecimatingFIR<complex_t>", "taps=" + std::to_string(tc) + " decim=" + std::to_string(decim), [tc, decim](int dur, int bs) {
+                dsp::tap<float> taps = dsp::taps::alloc<float>(tc);
+                for (int i = 0; i < tc; i++) { taps.taps[i] = 1.0f / (float)tc; }
+                dsp::stream<dsp::complex_t> in;
+                dsp::filter::FoldedDecimatingFIR<dsp::complex_t> fir(&in, taps, decim);
+                double sr = measure<dsp::complex_t, dsp::complex_t>(fir, in, dur, bs);
+                dsp::taps::free(taps);
+                return sr;
+            } });
+        }
+    }
+
+    // Power decimator, once for each optimized plan
+    for (int i = 0; i < dsp::multirate::decim::plans_len; i++) {
+        unsigned int ratio = 2 << i;
+        list.push_back({ "PowerDecimator<complex_t>", "ratio=" + std::to_string(ratio), [ratio](int dur, int bs) {
+            dsp::stream<dsp::complex_t> in;
+            dsp::multirate::PowerDecimator<dsp::complex_t> decim(&in, ratio);
+            return measure<dsp::complex_t, dsp::complex_t>(decim, in, dur, bs);
+        } });
+    }
+
+    // Polyphase resampler, the taps are designed like the rational resampler does it
+    for (auto ratio : std::vector<std::pair<int, int>>{ { 3, 2 }, { 147, 160 }, { 24, 125 } }) {
+        int interp = ratio.first;
+        int decim = ratio.second;
+        list.push_back({ "PolyphaseResampler<complex_t>", "interp=" + std::to_string(interp) + " decim=" + std::to_string(decim), [interp, decim](int dur, int bs) {
+            double tapSr = interp;
+            double tapBw = std::min<double>(1.0, (double)interp / (double)decim) / 2.0;
+            dsp::tap<float> taps = dsp::taps::lowPass(tapBw, 0.1 * tapBw, tapSr);
+            for (int i = 0; i < taps.size; i++) { taps.taps[i] *= (float)interp; }
+            dsp::stream<dsp::complex_t> in;
+            dsp::multirate::PolyphaseResampler<dsp::complex_t> resamp(&in, interp, decim, taps);
+            double sr = measure<dsp::complex_t, dsp::complex_t>(resamp, in, dur, bs);
+            dsp::taps::free(taps);
+            return sr;
+        } });
+    }
+
+    // Rational resampler for common front end and audio conversions
+    for (auto rates : std::vector<std::pair<double, double>>{ { 48000.0, 44100.0 }, { 250000.0, 48000.0 }, { 2.4e6, 48000.0 }, { 2.4e6, 44100.0 }, { 10e6, 1e6 } }) {
+        double inSr = rates.first;
+        double outSr = rates.second;
+        list.push_back({ "RationalResampler<complex_t>", "in=" + std::to_string((int)inSr) + " out=" + std::to_string((int)outSr), [inSr, outSr](int dur, int bs) {
+            dsp::stream<dsp::complex_t> in;
+            dsp::multirate::RationalResampler<dsp::complex_t> resamp(&in, inSr, outSr);
+            return measure<dsp::complex_t, dsp::complex_t>(resamp, in, dur, bs);
+        } });
+    }
+
+    // Demodulators, configured like the radio module does for a typical bandwidth
+    list.push_back({ "FM<stereo_t>", "samplerate=50000 bandwidth=12500", [](int dur, int bs) {
+        dsp::stream<dsp::complex_t> in;
+        dsp::demod::FM<dsp::stereo_t> demod;
+        demod.init(&in, 50000.0, 12500.0, true, false);
+        return measure<dsp::complex_t, dsp::stereo_t>(demod, in, dur, bs);
+    } });
+    list.push_back({ "AM<stereo_t>", "samplerate=15000 bandwidth=10000", [](int dur, int bs) {
+        dsp::stream<dsp::complex_t> in;
+        dsp::demod::AM<dsp::stereo_t> demod(&in, dsp::demod::AM<dsp::stereo_t>::AGCMode::CARRIER, 10000.0, 50.0 / 15000.0, 5.0 / 15000.0, 100.0 / 15000.0, 15000.0);
+        return measure<dsp::complex_t, dsp::stereo_t>(demod, in, dur, bs);
+    } });
+    list.push_back({ "SSB<stereo_t>", "samplerate=24000 bandwidth=2800 mode=USB", [](int dur, int bs) {
+        dsp::stream<dsp::complex_t> in;
+        dsp::demod::SSB<dsp::stereo_t> demod(&in, dsp::demod::SSB<dsp::stereo_t>::Mode::USB, 2800.0, 24000.0, 50.0 / 24000.0, 5.0 / 24000.0);
+        return measure<dsp::complex_t, dsp::stereo_t>(demod, in, dur, bs);
+    } });
+    for (bool stereo : { false, true }) {
+        list.push_back({ "BroadcastFM", std::string("samplerate=250000 stereo=") + (stereo ? "true" : "false"), [stereo](int dur, int bs) {
+            dsp::stream<dsp::complex_t> in;
+            dsp::demod::BroadcastFM demod(&in, 75000.0, 250000.0, stereo, true);
+            return measure<dsp::complex_t, dsp::stereo_t>(demod, in, dur, bs);
+        } });
+    }
+    list.push_back({ "PSK<4>", "symbolrate=72000 samplerate=144000 rrcTaps=33", [](int dur, int bs) {
+        dsp::stream<dsp::complex_t> in;
+        dsp::demod::PSK<4> demod(&in, 72000.0, 144000.0, 33, 0.6, 0.1, 0.005, 1e-6, 0.01);
+        return measure<dsp::complex_t, dsp::complex_t>(demod, in, dur, bs);
+    } });
+
+    // Clock recovery
+    list.push_back({ "MM<complex_t>", "omega=2", [](int dur, int bs) {
+        dsp::stream<dsp::complex_t> in;
+        dsp::clock_recovery::MM<dsp::complex_t> recov(&in, 2.0, 1e-6, 0.01, 0.01);
+        return measure<dsp::complex_t, dsp::complex_t>(recov, in, dur, bs);
+    } });
+    list.push_back({ "MM<float>", "omega=10", [](int dur, int bs) {
+        dsp::stream<float> in;
+        dsp::clock_recovery::MM<float> recov(&in, 10.0, 1e-6, 0.01, 0.01);
+        return measure<float, float>(recov, in, dur, bs);
+    } });
+
+    // Gain control, DC correction and noise reduction
+    list.push_back({ "AGC<float>", "", [](int dur, int bs) {
+        dsp::stream<float> in;
+        dsp::loop::AGC<float> agc(&in, 1.0, 50.0 / 48000.0, 5.0 / 48000.0, 10e6, 10.0);
+        return measure<float, float>(agc, in, dur, bs);
+    } });
+    list.push_back({ "AGC<complex_t>", "", [](int dur, int bs) {
+        dsp::stream<dsp::complex_t> in;
+        dsp::loop::AGC<dsp::complex_t> agc(&in, 1.0, 50.0 / 48000.0, 5.0 / 48000.0, 10e6, 10.0);
+        return measure<dsp::complex_t, dsp::complex_t>(agc, in, dur, bs);
+    } });
+    list.push_back({ "DCBlocker<complex_t>", "", [](int dur, int bs) {
+        dsp::stream<dsp::complex_t> in;
+        dsp::correction::DCBlocker<dsp::complex_t> dcBlock(&in, 50.0, 2.4e6);
+        return measure<dsp::complex_t, dsp::complex_t>(dcBlock, in, dur, bs);
+    } });
+    list.push_back({ "DCBlocker<float>", "", [](int dur, int bs) {
+        dsp::stream<float> in;
+        dsp::correction::DCBlocker<float> dcBlock(&in, 100.0, 48000.0);
+        return measure<float, float>(dcBlock, in, dur, bs);
+    } });
+    for (int bins : { 9, 15, 31, 32 }) {
+        list.push_back({ "FMIF", "bins=" + std::to_string(bins), [bins](int dur, int bs) {
+            dsp::stream<dsp::complex_t> in;
+            dsp::noise_reduction::FMIF fmnr(&in, bins);
+            return measure<dsp::complex_t, dsp::complex_t>(fmnr, in, dur, bs);
+        } });
+    }
+    list.push_back({ "NoiseBlanker", "", [](int dur, int bs) {
+        dsp::stream<dsp::complex_t> in;
+        dsp::noise_reduction::NoiseBlanker nb(&in, 500.0 / 24000.0, 10.0);
+        return measure<dsp::complex_t, dsp::complex_t>(nb, in, dur, bs);
+    } });
+
+    return list;
+}
+
+std::vector<int> parseSizes(const std::string& str) {
+    std::vector<int> sizes;
+    std::stringstream ss(str);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        int size = std::stoi(item);
+        if (size <= 0 || size > STREAM_BUFFER_SIZE / 4) {
+            throw std::runtime_error("Invalid block size: " + item);
+        }
+        sizes.push_back(size);
+    }
+    return sizes;
+}
+
+std::string toJSON(const std::vector<Result>& results, int durationMs, int threads) {
+    json doc;
+    doc["version"] = VERSION_STR;
+    doc["volkMachine"] = volk_get_machine();
+    doc["durationMs"] = durationMs;
+    doc["threads"] = threads;
+    doc["results"] = json::array();
+    for (const auto& r : results) {
+        json res;
+        res["block"] = r.block;
+        res["params"] = r.params;
+        res["bufferSize"] = r.bufferSize;
+        res["samplerate"] = r.samplerate;
+        doc["results"].push_back(res);
+    }
+    return doc.dump(4) + "\n";
+}
+
+std::string toCSV(const std::vector<Result>& results) {
+    std::string csv = "block,params,bufferSize,samplerate\n";
+    for (const auto& r : results) {
+        csv += "\"" + r.block + "\",\"" + r.params + "\"," + std::to_string(r.bufferSize) + "," + std::to_string(r.samplerate) + "\n";
+    }
+    return csv;
+}
+
+int main(int argc, char* argv[]) {
+    CommandArgsParser args;
+    args.define('h', "help", "Show help");
+    args.define('d', "duration", "Duration of each measurement in milliseconds", 1000);
+    args.define('b', "blocksizes", "Comma separated list of buffer sizes to test", "256,1024,4096,16384,65536");
+    args.define('f', "filter", "Only run the benchmarks whose block name contains this string", "");
+    args.define('o', "output", "File to write the results to, dsp_bench.json or dsp_bench.csv if empty", "");
+    args.define('F', "format", "Output format, json or csv", "json");
+    args.define('t', "threads", "Run the blocks on the scheduler with this many workers, 0 for one thread per block", 0);
+    args.define('l', "list", "List the benchmarks and exit");
+    if (args.parse(argc, argv) < 0) { return -1; }
+    if ((bool)args["help"]) {
+        args.showHelp();
+        return 0;
+    }
+
+    int durationMs = args["duration"];
+    int threads = args["threads"];
+    std::string filter = args["filter"];
+    std::string output = args["output"];
+    std::string format = args["format"];
+    if (format != "json" && format != "csv") {
+        flog::error("Unknown output format '{}'", format);
+        return -1;
+    }
+    std::vector<int> sizes;
+    try {
+        sizes = parseSizes(args["blocksizes"]);
+    }
+    catch (const std::exception& e) {
+        flog::error("{}", e.what());
+        return -1;
+    }
+
+    // Select benchmarks
+    std::vector<Benchmark> benchmarks;
+    for (auto& b : listBenchmarks()) {
+        if (b.block.find(filter) == std::string::npos) { continue; }
+        benchmarks.push_back(b);
+    }
+    if ((bool)args["list"]) {
+        for (const auto& b : benchmarks) {
+            printf("%s %s\n", b.block.c_str(), b.params.c_str());
+        }
+        return 0;
+    }
+
+    if (threads > 0) { dsp::scheduler::start(threads); }
+
+    // Run everything
+    std::vector<Result> results;
+    int total = benchmarks.size() * sizes.size();
+    for (const auto& b : benchmarks) {
+        for (int bs : sizes) {
+            double sr = b.run(durationMs, bs);
+            results.push_back({ b.block, b.params, bs, sr });
+            flog::info("[{}/{}] {} {} bs={}: {} MS/s", (int)results.size(), total, b.block, b.params, bs, sr / 1e6);
+        }
+    }
+
+    if (threads > 0) { dsp::scheduler::stop(); }
+
+    // Write results
+    if (output.empty()) { output = "dsp_bench." + format; }
+    std::ofstream file(output, std::ios::out | std::ios::binary);
+    if (!file.is_open()) {
+        flog::error("Could not open '{}' for writing", output);
+        return -1;
+    }
+    file << ((format == "csv") ? toCSV(results) : toJSON(results, durationMs, threads));
+    flog::info("Results written to '{}'", output);
+    return 0;
+}
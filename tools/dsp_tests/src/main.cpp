@@ -0,0 +1,248 @@
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <functional>
+#include <algorithm>
+#include <utils/flog.h>
+#include <dsp/stream.h>
+#include <dsp/convert/iq_to_complex.h>
+#include <dsp/fft/fallback.h>
+#include <utils/proto/iq_udp.h>
+#include <math.h>
+
+struct Test {
+    std::string name;
+    std::function<bool()> run;
+};
+
+#define CHECK(cond)                                                 \
+    if (!(cond)) {                                                  \
+        flog::error("{}:{}: check failed: {}", __FILE__, __LINE__, #cond); \
+        return false;                                               \
+    }
+
+// Write one sample holding the given value and publish it
+bool push(dsp::stream<float>& s, float value) {
+    s.writeBuf[0] = value;
+    return s.swap(1);
+}
+
+// Read one block and return its first sample, or -1 if the reader was stopped
+float pop(dsp::stream<float>& s) {
+    int count = s.read();
+    if (count < 0) { return -1.0f; }
+    float value = s.readBuf[0];
+    s.flush();
+    return value;
+}
+
+bool streamRingOrder() {
+    dsp::stream<float> s;
+    s.setRingSize(4);
+
+    // The writer must never get ahead of the reader by more than slots - 1 blocks
+    std::thread writer([&s]() {
+        for (int i = 1; i <= 1000; i++) {
+            if (!push(s, (float)i)) { return; }
+        }
+    });
+    bool ok = true;
+    for (int i = 1; i <= 1000; i++) {
+        if (pop(s) != (float)i) { ok = false; }
+    }
+    writer.join();
+    CHECK(ok);
+    CHECK(!s.readable());
+    return true;
+}
+
+bool streamRingStopOnFull() {
+    dsp::stream<float> s;
+    s.setRingSize(3);
+
+    // Fill the ring, the writer can publish slots - 1 blocks without the reader
+    CHECK(push(s, 1.0f));
+    CHECK(push(s, 2.0f));
+    CHECK(!s.writable());
+
+    // Stop the writer while it waits on the full ring, the block it was publishing is dropped
+    std::thread stopper([&s]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        s.stopWriter();
+    });
+    bool swapped = push(s, 3.0f);
+    stopper.join();
+    CHECK(!swapped);
+    s.clearWriteStop();
+
+    // Restart the writer, it must not overwrite any block the reader hasn't consumed yet
+    std::thread writer([&s]() { push(s, 4.0f); });
+    float a = pop(s);
+    float b = pop(s);
+    float c = pop(s);
+    writer.join();
+    CHECK(a == 1.0f && b == 2.0f && c == 4.0f);
+    CHECK(!s.readable());
+
+    // The ring must keep working normally afterwards
+    CHECK(push(s, 5.0f));
+    CHECK(pop(s) == 5.0f);
+    CHECK(!s.readable());
+    return true;
+}
+
+bool streamDoubleBufferStop() {
+    dsp::stream<float> s;
+
+    // The first block is taken right away, the second one waits for the reader
+    CHECK(push(s, 1.0f));
+    std::thread stopper([&s]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        s.stopWriter();
+    });
+    bool swapped = push(s, 2.0f);
+    stopper.join();
+    CHECK(!swapped);
+    s.clearWriteStop();
+
+    std::thread writer([&s]() { push(s, 3.0f); });
+    float a = pop(s);
+    float b = pop(s);
+    writer.join();
+    CHECK(a == 1.0f && b == 3.0f);
+    return true;
+}
+
+// Pack a signed 12bit I/Q pair into 3 bytes, I in the low 12 bits of a little endian 24bit word
+void packS12(int re, int im, uint8_t* out) {
+    uint32_t word = ((uint32_t)re & 0xFFF) | (((uint32_t)im & 0xFFF) << 12);
+    out[0] = word & 0xFF;
+    out[1] = (word >> 8) & 0xFF;
+    out[2] = (word >> 16) & 0xFF;
+}
+
+bool convertS12Packed() {
+    // Extremes and values around zero make sure both halves are sign extended
+    const int values[][2] = { { 0, 0 }, { 1, -1 }, { -1, 1 }, { 2047, -2048 }, { -2048, 2047 }, { 1234, -567 } };
+    const int count = sizeof(values) / sizeof(values[0]);
+    uint8_t packed[count * 3];
+    for (int i = 0; i < count; i++) { packS12(values[i][0], values[i][1], &packed[i * 3]); }
+
+    // Default scale maps the range to [-1, 1)
+    dsp::complex_t out[count];
+    dsp::convert::s12PackedToComplex(count, packed, out);
+    for (int i = 0; i < count; i++) {
+        CHECK(out[i].re == (float)values[i][0] / 2048.0f);
+        CHECK(out[i].im == (float)values[i][1] / 2048.0f);
+    }
+
+    // The offset is removed before scaling
+    dsp::convert::s12PackedToComplex(count, packed, out, 0.5f, { 10.0f, -4.0f });
+    for (int i = 0; i < count; i++) {
+        CHECK(out[i].re == ((float)values[i][0] - 10.0f) * 0.5f);
+        CHECK(out[i].im == ((float)values[i][1] + 4.0f) * 0.5f);
+    }
+    return true;
+}
+
+bool fftFallback() {
+    // Powers of two use the radix-2 path, the other sizes go through Bluestein's algorithm
+    const int sizes[] = { 1, 2, 16, 1024, 12, 37, 1000 };
+    for (int n : sizes) {
+        for (bool forward : { true, false }) {
+            std::vector<dsp::complex_t> in(n), out(n);
+            for (int i = 0; i < n; i++) { in[i] = { (float)sin(0.3 * i + 1.0), (float)cos(1.7 * i) }; }
+            dsp::fft::FallbackFFT fft;
+            fft.init(n, forward);
+            fft.execute(in.data(), out.data());
+
+            // Compare to a direct DFT
+            double sign = forward ? -1.0 : 1.0;
+            double maxErr = 0.0, maxMag = 0.0;
+            for (int k = 0; k < n; k++) {
+                double re = 0.0, im = 0.0;
+                for (int j = 0; j < n; j++) {
+                    double a = sign * 2.0 * DB_M_PI * (double)(((int64_t)j * k) % n) / (double)n;
+                    re += in[j].re * cos(a) - in[j].im * sin(a);
+                    im += in[j].re * sin(a) + in[j].im * cos(a);
+                }
+                maxErr = std::max<double>(maxErr, hypot(re - out[k].re, im - out[k].im));
+                maxMag = std::max<double>(maxMag, hypot(re, im));
+            }
+            CHECK(maxErr <= 1e-5 * maxMag);
+
+            // In-place must give the same result
+            std::vector<dsp::complex_t> inPlace = in;
+            fft.execute(inPlace.data(), inPlace.data());
+            for (int k = 0; k < n; k++) { CHECK(inPlace[k].re == out[k].re && inPlace[k].im == out[k].im); }
+        }
+    }
+    return true;
+}
+
+// Feed one packet with the given sequence number to the receiver
+bool feed(net::iq_udp::Receiver& rx, uint32_t seq, int& missing) {
+    net::iq_udp::PacketHeader hdr;
+    net::iq_udp::writeHeader(&hdr, seq, 0);
+    return rx.process(&hdr, 0, missing);
+}
+
+bool iqUdpLoss() {
+    net::iq_udp::Receiver rx;
+    int missing;
+
+    // A gap counts the skipped packets as lost, a late one takes it back
+    CHECK(feed(rx, 100, missing));
+    CHECK(feed(rx, 103, missing) && missing == 2);
+    CHECK(rx.getStats().lost == 2);
+    CHECK(!feed(rx, 101, missing));
+    CHECK(rx.getStats().lost == 1 && rx.getStats().reordered == 1);
+    CHECK(!feed(rx, 101, missing));
+    CHECK(rx.getStats().duplicates == 1);
+
+    // Packets sent before the first one received were never counted as lost
+    CHECK(!feed(rx, 99, missing));
+    CHECK(!feed(rx, 98, missing));
+    auto stats = rx.getStats();
+    CHECK(stats.lost == 1 && stats.reordered == 3 && stats.received == 5);
+
+    // Same after a sender restart
+    rx.reset();
+    CHECK(feed(rx, 5000, missing));
+    CHECK(!feed(rx, 4999, missing));
+    stats = rx.getStats();
+    CHECK(stats.lost == 0 && stats.reordered == 1 && stats.received == 2);
+    return true;
+}
+
+std::vector<Test> listTests() {
+    return {
+        { "stream/ring_order", streamRingOrder },
+        { "stream/ring_stop_on_full", streamRingStopOnFull },
+        { "stream/double_buffer_stop", streamDoubleBufferStop },
+        { "convert/s12_packed", convertS12Packed },
+        { "fft/fallback", fftFallback },
+        { "proto/iq_udp_loss", iqUdpLoss }
+    };
+}
+
+int main(int argc, char* argv[]) {
+    // Only run the tests whose name contains the first argument, if any
+    std::string filter = (argc > 1) ? argv[1] : "";
+
+    int failed = 0;
+    for (auto& t : listTests()) {
+        if (t.name.find(filter) == std::string::npos) { continue; }
+        bool ok = t.run();
+        flog::info("{}: {}", t.name, ok ? "passed" : "FAILED");
+        if (!ok) { failed++; }
+    }
+
+    if (failed) {
+        flog::error("{} test(s) failed", failed);
+        return -1;
+    }
+    return 0;
+}